@@ -4,11 +4,13 @@
 #include <cstdlib>
 #include <functional>
 
+#include <QLocalSocket>
 #include <QRegularExpression>
 #include <QSignalSpy>
 #include <QStandardPaths>
 #include <QTest>
 #include <QThread>
+#include <QUrlQuery>
 
 #include <socketconnectionbackend_p.h>
 
@@ -44,6 +46,173 @@ private Q_SLOTS:
         QCOMPARE(task.data.size(), data.size());
     }
 
+    // A peer connecting to a listener that advertises binary framing sends binary frames right
+    // away, and the accepting side answers in kind once it has seen one. Payloads of all sizes
+    // survive the round trip, including ones received before the switch.
+    void testBinaryFramingNegotiation()
+    {
+        KIO::SocketConnectionBackend server;
+        KIO::SocketConnectionBackend clientConnection;
+
+        QVERIFY(server.listenForRemote().success);
+        QCOMPARE(QUrlQuery(server.address).queryItemValue(QStringLiteral("framing")), QStringLiteral("binary"));
+        auto newConnectionSpy = std::make_unique<QSignalSpy>(&server, &KIO::SocketConnectionBackend::newConnection);
+        QVERIFY(clientConnection.connectToRemote(server.address));
+        QCOMPARE(clientConnection.sendFraming(), KIO::SocketConnectionBackend::Framing::Binary);
+        newConnectionSpy->wait();
+        QVERIFY(!newConnectionSpy->isEmpty());
+        auto serverConnection = std::unique_ptr<KIO::SocketConnectionBackend>(static_cast<KIO::SocketConnectionBackend *>(server.nextPendingConnection()));
+        QVERIFY(serverConnection);
+        QCOMPARE(serverConnection->sendFraming(), KIO::SocketConnectionBackend::Framing::Legacy);
+
+        // Legacy frame from the accepting side to the binary-capable client
+        QSignalSpy clientSpy(&clientConnection, &KIO::ConnectionBackend::commandReceived);
+        const auto hello = randomByteArray(20);
+        QVERIFY(serverConnection->sendCommand(64, hello));
+        QTRY_COMPARE(clientSpy.size(), 1);
+        QCOMPARE(clientSpy.at(0).at(0).value<KIO::Task>().data, hello);
+
+        QSignalSpy serverSpy(serverConnection.get(), &KIO::ConnectionBackend::commandReceived);
+        const QList<qsizetype> sizes = {0, 1, 7, 8, 9, 10, 4096, clientConnection.StandardBufferSize * 4L};
+        for (qsizetype size : sizes) {
+            QVERIFY(clientConnection.sendCommand(0x1234, randomByteArray(size)));
+        }
+        QTRY_COMPARE(serverSpy.size(), sizes.size());
+        for (qsizetype i = 0; i < sizes.size(); ++i) {
+            const auto task = serverSpy.at(i).at(0).value<KIO::Task>();
+            QCOMPARE(task.cmd, 0x1234);
+            QCOMPARE(task.data.size(), sizes.at(i));
+        }
+        QCOMPARE(serverConnection->sendFraming(), KIO::SocketConnectionBackend::Framing::Binary);
+
+        QVERIFY(serverConnection->sendCommand(65, hello));
+        QTRY_COMPARE(clientSpy.size(), 2);
+        const auto task = clientSpy.at(1).at(0).value<KIO::Task>();
+        QCOMPARE(task.cmd, 65);
+        QCOMPARE(task.data, hello);
+    }
+
+    // A peer that only looks at the path of the address (or gets an address without the framing
+    // query) keeps using the legacy framing, in both directions.
+    void testLegacyFramingFallback()
+    {
+        KIO::SocketConnectionBackend server;
+        KIO::SocketConnectionBackend clientConnection;
+
+        QVERIFY(server.listenForRemote().success);
+        QUrl legacyAddress = server.address;
+        legacyAddress.setQuery(QString());
+        auto newConnectionSpy = std::make_unique<QSignalSpy>(&server, &KIO::SocketConnectionBackend::newConnection);
+        QVERIFY(clientConnection.connectToRemote(legacyAddress));
+        QCOMPARE(clientConnection.sendFraming(), KIO::SocketConnectionBackend::Framing::Legacy);
+        newConnectionSpy->wait();
+        QVERIFY(!newConnectionSpy->isEmpty());
+        auto serverConnection = std::unique_ptr<KIO::SocketConnectionBackend>(static_cast<KIO::SocketConnectionBackend *>(server.nextPendingConnection()));
+        QVERIFY(serverConnection);
+
+        QSignalSpy serverSpy(serverConnection.get(), &KIO::ConnectionBackend::commandReceived);
+        const auto data = randomByteArray(100);
+        QVERIFY(clientConnection.sendCommand(64, data));
+        QTRY_COMPARE(serverSpy.size(), 1);
+        QCOMPARE(serverSpy.at(0).at(0).value<KIO::Task>().data, data);
+        QCOMPARE(serverConnection->sendFraming(), KIO::SocketConnectionBackend::Framing::Legacy);
+    }
+
+    // A frame announcing more than any peer sends ends the connection instead of having the
+    // receiver reserve a buffer of that size.
+    void testOversizedFrameDropsConnection_data()
+    {
+        QTest::addColumn<QByteArray>("header");
+
+        QTest::newRow("binary") << QByteArray("\xfe\x00\x40\x00\xf0\xff\xff\xff", KIO::SocketConnectionBackend::BinaryHeaderSize);
+        QTest::newRow("legacy negative") << QByteArray("    -1_40_");
+    }
+
+    void testOversizedFrameDropsConnection()
+    {
+        QFETCH(QByteArray, header);
+
+        KIO::SocketConnectionBackend server;
+        QVERIFY(server.listenForRemote().success);
+        auto newConnectionSpy = std::make_unique<QSignalSpy>(&server, &KIO::SocketConnectionBackend::newConnection);
+        QLocalSocket peer;
+        peer.connectToServer(server.address.path());
+        QVERIFY(peer.waitForConnected());
+        newConnectionSpy->wait();
+        QVERIFY(!newConnectionSpy->isEmpty());
+        auto serverConnection = std::unique_ptr<KIO::ConnectionBackend>(server.nextPendingConnection());
+        QVERIFY(serverConnection);
+
+        QSignalSpy commandSpy(serverConnection.get(), &KIO::ConnectionBackend::commandReceived);
+        QSignalSpy disconnectedSpy(serverConnection.get(), &KIO::ConnectionBackend::disconnected);
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Dropping connection")));
+        peer.write(header + QByteArray(64, 'x'));
+        QVERIFY(peer.waitForBytesWritten());
+
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+        QVERIFY(commandSpy.isEmpty());
+    }
+
+    // A command too large for a frame is not sent, instead of having the peer drop the connection.
+    void testOversizedCommandRejected()
+    {
+        KIO::SocketConnectionBackend server;
+        KIO::SocketConnectionBackend clientConnection;
+
+        QVERIFY(server.listenForRemote().success);
+        auto newConnectionSpy = std::make_unique<QSignalSpy>(&server, &KIO::SocketConnectionBackend::newConnection);
+        QVERIFY(clientConnection.connectToRemote(server.address));
+        newConnectionSpy->wait();
+        QVERIFY(!newConnectionSpy->isEmpty());
+        auto serverConnection = std::unique_ptr<KIO::ConnectionBackend>(server.nextPendingConnection());
+        QVERIFY(serverConnection);
+
+        QSignalSpy serverSpy(serverConnection.get(), &KIO::ConnectionBackend::commandReceived);
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Not sending command")));
+        QVERIFY(!clientConnection.sendCommand(64, QByteArray(KIO::SocketConnectionBackend::MaxTaskSize + 1, 'x')));
+
+        // The connection is still good for the next one
+        const auto data = randomByteArray(100);
+        QVERIFY(clientConnection.sendCommand(65, data));
+        QTRY_COMPARE(serverSpy.size(), 1);
+        const auto task = serverSpy.at(0).at(0).value<KIO::Task>();
+        QCOMPARE(task.cmd, 65);
+        QCOMPARE(task.data, data);
+    }
+
+    // What sendCommand() leaves queued on the socket still reaches the peer when the backend
+    // is destroyed right after.
+    void testDestructorFlushesWrites()
+    {
+        KIO::SocketConnectionBackend server;
+        auto *clientConnection = new KIO::SocketConnectionBackend;
+
+        QVERIFY(server.listenForRemote().success);
+        auto newConnectionSpy = std::make_unique<QSignalSpy>(&server, &KIO::SocketConnectionBackend::newConnection);
+        QVERIFY(clientConnection->connectToRemote(server.address));
+        newConnectionSpy->wait();
+        QVERIFY(!newConnectionSpy->isEmpty());
+        auto serverConnection = std::unique_ptr<KIO::ConnectionBackend>(server.nextPendingConnection());
+        QVERIFY(serverConnection);
+
+        // More than the socket buffer takes, so that the rest is queued when sendCommand() returns.
+        // The flush blocks until the peer read it, so it has to happen off the reading thread.
+        QSignalSpy serverSpy(serverConnection.get(), &KIO::ConnectionBackend::commandReceived);
+        const auto data = randomByteArray(4 * 1024 * 1024);
+        bool sendOk = false;
+        std::unique_ptr<QThread> sender(QThread::create([clientConnection, &data, &sendOk] {
+            sendOk = clientConnection->sendCommand(64, data);
+            delete clientConnection;
+        }));
+        clientConnection->moveToThread(sender.get());
+        sender->start();
+
+        QTRY_COMPARE_WITH_TIMEOUT(serverSpy.size(), 1, 30000);
+        QVERIFY(sender->wait());
+        QVERIFY(sendOk);
+        QCOMPARE(serverSpy.at(0).at(0).value<KIO::Task>().data, data);
+    }
+
     // Resuming a backend whose socket is not open must stay quiet. connectToRemote sets the
     // backend to Connected and returns at once, but if no server is listening the socket never
     // opens. On Windows the resume path reads one byte to kick the named pipe reader; doing that
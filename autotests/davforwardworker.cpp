@@ -0,0 +1,52 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// A minimal forwarding worker, like desktop:/ or remote:/, used by webdavtest
+// to check what reaches the dav worker through a ForwardingWorkerBase.
+
+#include <KIO/ForwardingWorkerBase>
+
+#include <QCoreApplication>
+#include <QUrl>
+
+class KIOPluginForMetaData : public QObject
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.kde.kio.worker.davforward" FILE "davforwardworker.json")
+};
+
+class DavForwardWorker : public KIO::ForwardingWorkerBase
+{
+public:
+    DavForwardWorker(const QByteArray &poolSocket, const QByteArray &appSocket)
+        : KIO::ForwardingWorkerBase("davforward", poolSocket, appSocket)
+    {
+    }
+
+protected:
+    bool rewriteUrl(const QUrl &url, QUrl &newURL) override
+    {
+        newURL = url;
+        newURL.setScheme(QStringLiteral("webdav"));
+        return true;
+    }
+};
+
+extern "C" {
+int Q_DECL_EXPORT kdemain(int argc, char **argv);
+}
+
+int kdemain(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kio_davforward"));
+
+    DavForwardWorker worker(argv[2], argv[3]);
+    worker.dispatchLoop();
+    return 0;
+}
+
+#include "davforwardworker.moc"
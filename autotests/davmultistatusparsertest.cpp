@@ -0,0 +1,157 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <davmultistatusparser.h>
+
+static const char s_multiStatus[] =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<D:multistatus xmlns:D=\"DAV:\" xmlns:X=\"urn:example\">\n"
+    "  <D:response>\n"
+    "    <D:href>/dir/</D:href>\n"
+    "    <D:propstat>\n"
+    "      <D:prop>\n"
+    "        <D:resourcetype><D:collection/></D:resourcetype>\n"
+    "        <D:getlastmodified D:dt=\"dateTime.rfc1123\">Mon, 12 Jan 1998 09:25:56 GMT</D:getlastmodified>\n"
+    "      </D:prop>\n"
+    "      <D:status>HTTP/1.1 200 OK</D:status>\n"
+    "    </D:propstat>\n"
+    "  </D:response>\n"
+    "  <D:response>\n"
+    "    <D:href>/dir/f%C3%A9e.txt</D:href>\n"
+    "    <D:propstat>\n"
+    "      <D:prop>\n"
+    "        <D:getcontentlength>1234</D:getcontentlength>\n"
+    "        <X:custom>ignored</X:custom>\n"
+    "        <D:lockdiscovery>\n"
+    "          <D:activelock>\n"
+    "            <D:lockscope><D:exclusive/></D:lockscope>\n"
+    "            <D:locktype><D:write/></D:locktype>\n"
+    "            <D:depth>0</D:depth>\n"
+    "          </D:activelock>\n"
+    "        </D:lockdiscovery>\n"
+    "      </D:prop>\n"
+    "      <D:status>HTTP/1.1 200 OK</D:status>\n"
+    "    </D:propstat>\n"
+    "  </D:response>\n"
+    "</D:multistatus>\n";
+
+class DavMultiStatusParserTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testParse_data();
+    void testParse();
+    void testResponsesAreEmittedIncrementally();
+    void testTruncatedDocument();
+    void testNotAMultiStatus();
+};
+
+void DavMultiStatusParserTest::testParse_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("whole document") << int(sizeof(s_multiStatus));
+    QTest::newRow("byte by byte") << 1;
+    QTest::newRow("small chunks") << 7;
+}
+
+void DavMultiStatusParserTest::testParse()
+{
+    QFETCH(int, chunkSize);
+
+    std::vector<DavElement> responses;
+    DavMultiStatusParser parser([&responses](const DavElement &response) {
+        responses.push_back(response);
+    });
+
+    const QByteArray document(s_multiStatus);
+    for (qsizetype pos = 0; pos < document.size(); pos += chunkSize) {
+        parser.addData(document.mid(pos, chunkSize));
+    }
+    QVERIFY(parser.finish());
+
+    QCOMPARE(responses.size(), size_t(2));
+    QCOMPARE(parser.responseCount(), 2);
+
+    const DavElement &dir = responses[0];
+    QCOMPARE(dir.name, QStringLiteral("response"));
+    QCOMPARE(dir.namespaceUri, QStringLiteral("DAV:"));
+    QVERIFY(dir.child(QLatin1StringView("href")));
+    QCOMPARE(dir.child(QLatin1StringView("href"))->text, QStringLiteral("/dir/"));
+
+    const DavElement *propstat = dir.child(QLatin1StringView("propstat"));
+    QVERIFY(propstat);
+    QCOMPARE(propstat->child(QLatin1StringView("status"))->text, QStringLiteral("HTTP/1.1 200 OK"));
+    const DavElement *prop = propstat->child(QLatin1StringView("prop"));
+    QVERIFY(prop);
+    QVERIFY(prop->child(QLatin1StringView("resourcetype"))->child(QLatin1StringView("collection")));
+    const DavElement *modified = prop->child(QLatin1StringView("getlastmodified"));
+    QVERIFY(modified);
+    QCOMPARE(modified->text, QStringLiteral("Mon, 12 Jan 1998 09:25:56 GMT"));
+    QCOMPARE(modified->attribute(QLatin1StringView("dt")), QStringLiteral("dateTime.rfc1123"));
+
+    const DavElement &file = responses[1];
+    QCOMPARE(file.child(QLatin1StringView("href"))->text, QStringLiteral("/dir/f%C3%A9e.txt"));
+    prop = file.child(QLatin1StringView("propstat"))->child(QLatin1StringView("prop"));
+    QCOMPARE(prop->child(QLatin1StringView("getcontentlength"))->text, QStringLiteral("1234"));
+    const DavElement *custom = prop->child(QLatin1StringView("custom"));
+    QVERIFY(custom);
+    QCOMPARE(custom->namespaceUri, QStringLiteral("urn:example"));
+    const DavElement *activeLock = prop->child(QLatin1StringView("lockdiscovery"))->child(QLatin1StringView("activelock"));
+    QVERIFY(activeLock);
+    QCOMPARE(activeLock->child(QLatin1StringView("lockscope"))->firstChild()->name, QStringLiteral("exclusive"));
+    QCOMPARE(activeLock->child(QLatin1StringView("depth"))->text, QStringLiteral("0"));
+}
+
+void DavMultiStatusParserTest::testResponsesAreEmittedIncrementally()
+{
+    int count = 0;
+    DavMultiStatusParser parser([&count](const DavElement &) {
+        ++count;
+    });
+
+    const QByteArray document(s_multiStatus);
+    const qsizetype endOfFirstResponse = document.indexOf("</D:response>") + qstrlen("</D:response>");
+
+    parser.addData(document.left(endOfFirstResponse));
+    QCOMPARE(count, 1);
+
+    parser.addData(document.mid(endOfFirstResponse));
+    QCOMPARE(count, 2);
+    QVERIFY(parser.finish());
+}
+
+void DavMultiStatusParserTest::testTruncatedDocument()
+{
+    int count = 0;
+    DavMultiStatusParser parser([&count](const DavElement &) {
+        ++count;
+    });
+
+    const QByteArray document(s_multiStatus);
+    parser.addData(document.left(document.lastIndexOf("<D:response>")));
+    QVERIFY(!parser.finish());
+    QCOMPARE(count, 1);
+}
+
+void DavMultiStatusParserTest::testNotAMultiStatus()
+{
+    int count = 0;
+    DavMultiStatusParser parser([&count](const DavElement &) {
+        ++count;
+    });
+
+    parser.addData("<html><body><p>Not Found</p></body></html>");
+    QVERIFY(parser.finish());
+    QCOMPARE(count, 0);
+}
+
+QTEST_GUILESS_MAIN(DavMultiStatusParserTest)
+
+#include "davmultistatusparsertest.moc"
@@ -10,6 +10,7 @@
 #include <QDirIterator>
 #include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
 #include <QSignalSpy>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
@@ -103,6 +104,49 @@ void DeleteJobTest::deleteDirectoryTestCase()
     }
 }
 
+void DeleteJobTest::deleteNestedDirectory()
+{
+    // Subtrees are emptied on several threads, every one of them must be gone in the end,
+    // and what the symlinks point to must stay.
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString root = tempDir.path() + QStringLiteral("/tree");
+    const QString outside = tempDir.path() + QStringLiteral("/outside");
+    QVERIFY(QDir().mkpath(outside));
+    createTestFiles({QStringLiteral("kept.txt")}, outside, 8);
+
+    int created = 0;
+    for (int a = 0; a < 4; ++a) {
+        for (int b = 0; b < 4; ++b) {
+            const QString sub = root + QStringLiteral("/a%1/b%2/c").arg(a).arg(b);
+            QVERIFY(QDir().mkpath(sub));
+            createTestFiles({QStringLiteral("1.txt"), QStringLiteral("2.txt")}, sub, 8);
+            created += 2;
+        }
+    }
+#ifndef Q_OS_WIN
+    QVERIFY(QFile::link(outside, root + QStringLiteral("/a0/dirlink")));
+    QVERIFY(QFile::link(outside + QStringLiteral("/kept.txt"), root + QStringLiteral("/a1/b1/filelink")));
+#endif
+
+    KIO::DeleteJob *job = KIO::del(QUrl::fromLocalFile(root), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+
+    qulonglong reportedBytes = 0;
+    connect(job, &KJob::processedAmountChanged, job, [&](KJob *, KJob::Unit unit, qulonglong amount) {
+        if (unit == KJob::Bytes) {
+            reportedBytes = amount;
+        }
+    });
+
+    QSignalSpy spy(job, &KJob::result);
+    QVERIFY(spy.wait(100000));
+    QCOMPARE(job->error(), KJOB_NO_ERROR);
+    QVERIFY(!QFileInfo::exists(root));
+    QVERIFY(QFile::exists(outside + QStringLiteral("/kept.txt")));
+    QVERIFY2(reportedBytes >= qulonglong(8 * created), qPrintable(QStringLiteral("reported %1 bytes for %2 files").arg(reportedBytes).arg(created)));
+}
+
 void DeleteJobTest::deletePartialFailureNotifiesRemovals()
 {
 #if !defined(WITH_QTDBUS)
@@ -17,6 +17,7 @@ private Q_SLOTS:
     void deleteFileTestCase();
     void deleteDirectoryTestCase_data() const;
     void deleteDirectoryTestCase();
+    void deleteNestedDirectory();
     void deletePartialFailureNotifiesRemovals();
     void killedRecursiveDeletionStopsEarly();
 
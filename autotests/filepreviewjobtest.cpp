@@ -12,16 +12,24 @@
 
 #include <KFileItem>
 
+#include <QColor>
 #include <QDateTime>
+#include <QDir>
+#include <QFile>
 #include <QImage>
+#include <QJsonObject>
+#include <QPointer>
 #include <QSignalSpy>
 #include <QSize>
 #include <QStandardPaths>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
+#include <QThread>
 #include <QTimer>
 
+#include <memory>
+
 QTEST_GUILESS_MAIN(FilePreviewJobTest)
 
 using namespace KIO;
@@ -233,3 +241,153 @@ void FilePreviewJobTest::testSupportedDevicePixelRatio()
 
     QCOMPARE(KIO::supportedDevicePixelRatio(imageSize, QSize(128, 128), 1.75), expectedDpr);
 }
+
+void FilePreviewJobTest::testThumbnailerPool()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("The dummy thumbnailer is a shell script");
+#endif
+    // A thumbnailer that runs until told to stop, then writes a thumbnail
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QImage thumb(16, 16, QImage::Format_ARGB32);
+    thumb.fill(Qt::red);
+    QVERIFY(thumb.save(dir.filePath(QStringLiteral("thumb.png"))));
+    const QString releaseFile = dir.filePath(QStringLiteral("release"));
+    const QString script = dir.filePath(QStringLiteral("thumbnailer.sh"));
+    QFile scriptFile(script);
+    QVERIFY(scriptFile.open(QIODevice::WriteOnly));
+    scriptFile.write(QStringLiteral("#!/bin/sh\n"
+                                    "while [ ! -e \"%1\" ]; do sleep 0.05; done\n"
+                                    "cp \"%2\" \"$2\"\n")
+                         .arg(releaseFile, dir.filePath(QStringLiteral("thumb.png")))
+                         .toLocal8Bit());
+    scriptFile.close();
+    QVERIFY(scriptFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner));
+
+    // As many as the pool runs at once, and two more that have to wait for them
+    const int maxRunning = std::max(QThread::idealThreadCount(), 1);
+    const int jobCount = maxRunning + 2;
+    int launched = 0;
+    int results = 0;
+    int errors = 0;
+    int images = 0;
+    QList<StandardThumbnailJob *> jobs;
+    for (int i = 0; i < jobCount; ++i) {
+        auto *job = new StandardThumbnailJob(script + QStringLiteral(" %i %o"), 16, 1.0, dir.filePath(QStringLiteral("input")));
+        connect(job, &StandardThumbnailJob::launched, this, [&launched] {
+            ++launched;
+        });
+        connect(job, &StandardThumbnailJob::data, this, [&images](KIO::Job *, const QImage &image) {
+            images += !image.isNull();
+        });
+        connect(job, &KJob::result, this, [&results, &errors](KJob *job) {
+            ++results;
+            errors += job->error() != 0;
+        });
+        jobs.append(job);
+        job->start();
+    }
+    QCOMPARE(launched, maxRunning);
+
+    // Killing a job still in the queue doesn't run it, nor take a slot
+    QPointer<StandardThumbnailJob> queuedJob = jobs.last();
+    QVERIFY(queuedJob->kill());
+    QCOMPARE(launched, maxRunning);
+    QTRY_VERIFY(!queuedJob);
+
+    // Each thumbnailer that ends lets the one still waiting run
+    QFile release(releaseFile);
+    QVERIFY(release.open(QIODevice::WriteOnly));
+    release.close();
+    QTRY_COMPARE_WITH_TIMEOUT(results, jobCount - 1, 10000);
+    QCOMPARE(launched, jobCount - 1);
+    QCOMPARE(errors, 0);
+    QCOMPARE(images, jobCount - 1);
+}
+
+void FilePreviewJobTest::testSharedMemoryReuse()
+{
+    // As large as the thumbnail of one preview, and the next of the same size
+    const int size = 256 * 256 * 4;
+    std::unique_ptr<SHM> first = SHM::create(size);
+    if (!first) {
+        QSKIP("No shared memory segments on this platform");
+    }
+    QVERIFY(first->size() >= size);
+    const int firstId = first->id();
+
+    // Done with by the worker, so the second preview gets it
+    SHM::release(std::move(first), 0);
+    std::unique_ptr<SHM> second = SHM::create(size);
+    QVERIFY(second);
+    QCOMPARE(second->id(), firstId);
+
+    // The worker of a killed job may still write to it, so it is not for the third one
+    const int secondId = second->id();
+    SHM::release(std::move(second), KIO::ERR_USER_CANCELED);
+    std::unique_ptr<SHM> third = SHM::create(size);
+    QVERIFY(third);
+    QVERIFY(third->id() != secondId);
+}
+
+void FilePreviewJobTest::testMemoryCache()
+{
+    QTemporaryDir thumbRoot;
+    QVERIFY(thumbRoot.isValid());
+
+    QTemporaryFile file(QDir::tempPath() + QLatin1String("/filepreviewjobtest-XXXXXX.txt"));
+    QVERIFY(file.open());
+    file.write("test");
+    file.close();
+    const KFileItem item(QUrl::fromLocalFile(file.fileName()));
+
+    PreviewOptions options;
+    options.size = QSize(128, 128);
+
+    // A plugin for the file, which is never run: with the device ids unknown, a preview that is
+    // neither in memory nor on disk ends without an image
+    PreviewSetupData setupData;
+    setupData.thumbRoot = thumbRoot.path() + QLatin1Char('/');
+    setupData.thumbRootDeviceId = FilePreviewJob::UnknownDeviceId;
+    const KPluginMetaData plugin(QJsonObject{{QStringLiteral("KPlugin"), QJsonObject{{QStringLiteral("Id"), QStringLiteral("filepreviewjobtest")}}}},
+                                 QStringLiteral("filepreviewjobtest"));
+    setupData.pluginByMimeTable.insert(QStringLiteral("text/plain"), plugin);
+
+    const auto runJob = [&item, &options, &setupData](std::unique_ptr<FilePreviewJob> &job) {
+        job = std::make_unique<FilePreviewJob>(item, FilePreviewJob::UnknownDeviceId, options, setupData);
+        job->setAutoDelete(false);
+        QSignalSpy resultSpy(job.get(), &KJob::result);
+        job->start();
+        QVERIFY(resultSpy.wait());
+    };
+    // Saves a thumbnail of the color for the item as the job would once generated, then
+    // removes it from disk so that only the memory has it
+    const auto saveThumbnail = [](FilePreviewJob *job, Qt::GlobalColor color) {
+        QImage thumb(16, 16, QImage::Format_ARGB32);
+        thumb.fill(color);
+        job->m_currentDeviceCachePolicy = FilePreviewJob::CachePolicy::Allow;
+        job->saveThumbnailData(thumb);
+        const QString thumbFilePath = job->m_thumbPath + job->m_thumbName;
+        QTRY_VERIFY(QFile::exists(thumbFilePath));
+        QVERIFY(QFile::remove(thumbFilePath));
+    };
+
+    std::unique_ptr<FilePreviewJob> first;
+    runJob(first);
+    QVERIFY(first->previewImage().isNull());
+    QVERIFY(!first->m_thumbName.isEmpty());
+    saveThumbnail(first.get(), Qt::red);
+
+    // A second job for the same item is served from memory
+    std::unique_ptr<FilePreviewJob> second;
+    runJob(second);
+    QVERIFY(!second->previewImage().isNull());
+    QCOMPARE(second->previewImage().pixelColor(0, 0), QColor(Qt::red));
+
+    // Saved again, the thumbnail replaces the one in memory
+    saveThumbnail(second.get(), Qt::blue);
+    std::unique_ptr<FilePreviewJob> third;
+    runJob(third);
+    QCOMPARE(third->previewImage().pixelColor(0, 0), QColor(Qt::blue));
+}
@@ -23,6 +23,9 @@ private Q_SLOTS:
     void testGeneratedImageDevicePixelRatio();
     void testSupportedDevicePixelRatio_data();
     void testSupportedDevicePixelRatio();
+    void testThumbnailerPool();
+    void testSharedMemoryReuse();
+    void testMemoryCache();
 };
 
 #endif
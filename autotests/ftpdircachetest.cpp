@@ -0,0 +1,126 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <ftpdircache.h>
+
+class FtpDirCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testListing();
+    void testMissingNameIsNotCached();
+    void testSymlink();
+    void testInsert();
+    void testInvalidate();
+};
+
+static FtpEntry makeEntry(const QString &name, mode_t type, KIO::filesize_t size = 0)
+{
+    FtpEntry entry;
+    entry.name = name;
+    entry.size = size;
+    entry.type = type;
+    entry.access = 0644;
+    return entry;
+}
+
+static QHash<QString, FtpEntry> makeListing(const QList<FtpEntry> &entries)
+{
+    QHash<QString, FtpEntry> listing;
+    for (const FtpEntry &entry : entries) {
+        listing.insert(entry.name, entry);
+    }
+    return listing;
+}
+
+void FtpDirCacheTest::testListing()
+{
+    FtpDirCache cache;
+    cache.setListing(QStringLiteral("/pub"), makeListing({makeEntry(QStringLiteral("file"), S_IFREG, 42), makeEntry(QStringLiteral("dir"), S_IFDIR)}));
+
+    FtpEntry entry;
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/file"), &entry), FtpDirCache::Lookup::Found);
+    QCOMPARE(entry.size, KIO::filesize_t(42));
+    QCOMPARE(entry.type, mode_t(S_IFREG));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub//dir/"), &entry), FtpDirCache::Lookup::Found);
+    QCOMPARE(entry.type, mode_t(S_IFDIR));
+
+    // Relative to a current directory the cache doesn't know, and the root which has no parent
+    QCOMPARE(cache.lookup(QStringLiteral("file")), FtpDirCache::Lookup::Unknown);
+    QCOMPARE(cache.lookup(QStringLiteral("/")), FtpDirCache::Lookup::Unknown);
+    // A dir that wasn't listed
+    QCOMPARE(cache.lookup(QStringLiteral("/other/file")), FtpDirCache::Lookup::Unknown);
+}
+
+void FtpDirCacheTest::testMissingNameIsNotCached()
+{
+    // Another connection may create it right after the listing, the server has to tell
+    FtpDirCache cache;
+    cache.setListing(QStringLiteral("/pub"), makeListing({makeEntry(QStringLiteral("file"), S_IFREG)}));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/new")), FtpDirCache::Lookup::Unknown);
+
+    // Nor after an empty listing
+    cache.setListing(QStringLiteral("/empty"), {});
+    QCOMPARE(cache.lookup(QStringLiteral("/empty/new")), FtpDirCache::Lookup::Unknown);
+}
+
+void FtpDirCacheTest::testSymlink()
+{
+    // Only a CWD tells whether it points to a dir
+    FtpEntry link = makeEntry(QStringLiteral("link"), S_IFREG);
+    link.link = QStringLiteral("/srv/data");
+    FtpDirCache cache;
+    cache.setListing(QStringLiteral("/pub"), makeListing({link}));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/link")), FtpDirCache::Lookup::Unknown);
+}
+
+void FtpDirCacheTest::testInsert()
+{
+    FtpDirCache cache;
+    cache.insert(QStringLiteral("/pub/file"), makeEntry(QStringLiteral("file"), S_IFREG, 7));
+    FtpEntry entry;
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/file"), &entry), FtpDirCache::Lookup::Found);
+    QCOMPARE(entry.size, KIO::filesize_t(7));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/other")), FtpDirCache::Lookup::Unknown);
+
+    // A listing replaces what was cached about the dir
+    cache.setListing(QStringLiteral("/pub"), makeListing({makeEntry(QStringLiteral("other"), S_IFREG)}));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/file")), FtpDirCache::Lookup::Unknown);
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/other")), FtpDirCache::Lookup::Found);
+}
+
+void FtpDirCacheTest::testInvalidate()
+{
+    FtpDirCache cache;
+    cache.setListing(QStringLiteral("/"), makeListing({makeEntry(QStringLiteral("pub"), S_IFDIR)}));
+    cache.setListing(QStringLiteral("/pub"), makeListing({makeEntry(QStringLiteral("dir"), S_IFDIR), makeEntry(QStringLiteral("file"), S_IFREG)}));
+    cache.setListing(QStringLiteral("/pub/dir"), makeListing({makeEntry(QStringLiteral("file"), S_IFREG)}));
+    cache.setListing(QStringLiteral("/public"), makeListing({makeEntry(QStringLiteral("file"), S_IFREG)}));
+
+    // Changing a file drops the listing of its dir only
+    cache.invalidate(QStringLiteral("/pub/file"));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/file")), FtpDirCache::Lookup::Unknown);
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/dir/file")), FtpDirCache::Lookup::Found);
+    QCOMPARE(cache.lookup(QStringLiteral("/pub")), FtpDirCache::Lookup::Found);
+
+    // Changing a dir drops its parent and everything below it, not its siblings
+    cache.setListing(QStringLiteral("/pub"), makeListing({makeEntry(QStringLiteral("dir"), S_IFDIR)}));
+    cache.invalidate(QStringLiteral("/pub"));
+    QCOMPARE(cache.lookup(QStringLiteral("/pub")), FtpDirCache::Lookup::Unknown);
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/dir")), FtpDirCache::Lookup::Unknown);
+    QCOMPARE(cache.lookup(QStringLiteral("/pub/dir/file")), FtpDirCache::Lookup::Unknown);
+    QCOMPARE(cache.lookup(QStringLiteral("/public/file")), FtpDirCache::Lookup::Found);
+
+    cache.clear();
+    QCOMPARE(cache.lookup(QStringLiteral("/public/file")), FtpDirCache::Lookup::Unknown);
+}
+
+QTEST_GUILESS_MAIN(FtpDirCacheTest)
+
+#include "ftpdircachetest.moc"
@@ -8,8 +8,10 @@
 #include <kio/storedtransferjob.h>
 
 #include <QBuffer>
+#include <QDir>
 #include <QProcess>
 #include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QTest>
 
 class FTPTest : public QObject
@@ -215,6 +217,71 @@ private Q_SLOTS:
         QVERIFY(file.open(QFile::ReadOnly));
         QCOMPARE(file.readAll(), QByteArray("testOverwriteCopy1\n")); // not 2!
     }
+
+    void testCopyDirectory()
+    {
+        // More files than workers per host, so that the copies run in parallel and queue up
+        QTemporaryDir localDir;
+        QVERIFY(localDir.isValid());
+        const QString srcPath = localDir.path() + "/testCopyDirectory";
+        QVERIFY(QDir().mkpath(srcPath));
+        for (int i = 0; i < 12; ++i) {
+            QFile file(srcPath + QStringLiteral("/file%1").arg(i));
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write(QByteArray::number(i).repeated(i + 1));
+        }
+
+        // One of them already exists, it is left alone
+        const QString remotePath = m_remoteDir.path() + "/testCopyDirectory";
+        QVERIFY(QDir().mkpath(remotePath));
+        QVERIFY(QFile::copy(QFINDTESTDATA("ftp/testOverwriteCopy1"), remotePath + "/file5"));
+
+        auto job = KIO::copy({QUrl::fromLocalFile(srcPath)}, url("/"), KIO::DefaultFlags);
+        job->setUiDelegate(nullptr);
+        job->setWriteIntoExistingDirectories(true);
+        job->setAutoSkip(true);
+        QVERIFY2(job->exec(), qUtf8Printable(job->errorString()));
+
+        for (int i = 0; i < 12; ++i) {
+            QFile file(remotePath + QStringLiteral("/file%1").arg(i));
+            QVERIFY(file.open(QFile::ReadOnly));
+            if (i == 5) {
+                QCOMPARE(file.readAll(), QByteArray("testOverwriteCopy1\n"));
+            } else {
+                QCOMPARE(file.readAll(), QByteArray::number(i).repeated(i + 1));
+            }
+        }
+        QVERIFY(!QFile::exists(remotePath + "/file0.part"));
+    }
+
+    void testCopyDirectoryConflict()
+    {
+        QTemporaryDir localDir;
+        QVERIFY(localDir.isValid());
+        const QString srcPath = localDir.path() + "/testCopyDirectoryConflict";
+        QVERIFY(QDir().mkpath(srcPath));
+        for (int i = 0; i < 8; ++i) {
+            QFile file(srcPath + QStringLiteral("/file%1").arg(i));
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write("new");
+        }
+
+        const QString remotePath = m_remoteDir.path() + "/testCopyDirectoryConflict";
+        QVERIFY(QDir().mkpath(remotePath));
+        QVERIFY(QFile::copy(QFINDTESTDATA("ftp/testOverwriteCopy1"), remotePath + "/file3"));
+
+        // Without a ui delegate the conflict can't be resolved, the job fails
+        // like it would when copying the files one by one.
+        auto job = KIO::copy({QUrl::fromLocalFile(srcPath)}, url("/"), KIO::DefaultFlags);
+        job->setUiDelegate(nullptr);
+        job->setWriteIntoExistingDirectories(true);
+        QVERIFY(!job->exec());
+        QCOMPARE(job->error(), KIO::ERR_FILE_ALREADY_EXIST);
+
+        QFile file(remotePath + "/file3");
+        QVERIFY(file.open(QFile::ReadOnly));
+        QCOMPARE(file.readAll(), QByteArray("testOverwriteCopy1\n"));
+    }
 };
 
 QTEST_MAIN(FTPTest)
@@ -151,6 +151,11 @@ void CookiesTest::testSendCookies_data()
     QTest::addRow("two_manual") << "http://localhost:5000/cookies/showsent"
                                 << "manual"
                                 << "Cookie: tasty_cookie=strawberry;cake=cheesecake" << QByteArray("tasty_cookie:strawberry\ncake:cheesecake\n");
+
+    // The worker keeps its cookie jar across requests, manual cookies must not leak into the next one
+    QTest::addRow("none_after_manual") << "http://localhost:5000/cookies/showsent"
+                                       << ""
+                                       << "" << QByteArray();
 }
 
 void CookiesTest::testSendCookies()
@@ -15,8 +15,12 @@
 #include <sys/acl.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+
 #include "kio/job.h"
 #include "kiotesthelper.h" // createTestFile etc.
+#include "scheduler_p.h"
 #include "worker_p.h"
 #include "workerbase.h"
 #include "workerfactory.h"
@@ -45,12 +49,15 @@
 #include <QFileInfo>
 #include <QHash>
 #include <QHostInfo>
+#include <QMutex>
 #include <QPointer>
 #include <QProcess>
 #include <QScopeGuard>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
+#include <QThread>
 #include <QTimer>
 #include <QUrl>
 #include <QVariant>
@@ -1150,6 +1157,77 @@ void JobTest::copyFolderWithUnaccessibleSubfolder()
     QCOMPARE(spy.count(), 1); // one warning should be emitted by the copy job
 }
 
+void JobTest::copyDirectoryWithFifo()
+{
+#ifdef Q_OS_WIN
+    QSKIP("Skipping fifo test on Windows");
+#endif
+    // The worker copying the tree leaves the fifo to CopyJob, which can't copy it either
+    const QString src = homeTmpDir() + "dirWithFifo";
+    const QString dest = homeTmpDir() + "dirWithFifo_copied";
+    createTestDirectory(src);
+    createTestDirectory(src + "/subdir");
+    createTestPipe(src + "/subdir/fifo");
+    setTimeStamp(src + "/subdir", s_referenceTimeStamp);
+    setTimeStamp(src, s_referenceTimeStamp);
+    ScopedCleaner cleaner([&] {
+        QDir(src).removeRecursively();
+        QDir(dest).removeRecursively();
+    });
+
+    KIO::CopyJob *job = KIO::copy(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setAutoSkip(true);
+    QSignalSpy copyingDoneSpy(job, &KIO::CopyJob::copyingDone);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    QVERIFY(QFile::exists(dest + "/subdir/testfile"));
+    QVERIFY(QFileInfo(dest + "/subdir/testlink").isSymLink());
+    QVERIFY(!QFileInfo::exists(dest + "/subdir/fifo"));
+    const auto copied = [&copyingDoneSpy](const QString &path) {
+        return std::any_of(copyingDoneSpy.cbegin(), copyingDoneSpy.cend(), [&path](const QList<QVariant> &args) {
+            return args.at(2).toUrl() == QUrl::fromLocalFile(path);
+        });
+    };
+    QVERIFY(copied(dest + "/subdir/testfile"));
+    QVERIFY(!copied(dest + "/subdir/fifo"));
+    // The worker couldn't set the times of subdir, CopyJob did once done with the fifo
+    QCOMPARE(QFileInfo(dest + "/subdir").lastModified(), QFileInfo(src + "/subdir").lastModified());
+    QCOMPARE(QFileInfo(dest).lastModified(), QFileInfo(src).lastModified());
+}
+
+void JobTest::copyDeepDirectory()
+{
+    // Deeper than the worker copying the tree descends itself: CopyJob lists and copies the rest
+    const QString src = homeTmpDir() + "deepDir";
+    const QString dest = homeTmpDir() + "deepDir_copied";
+    const int depth = 150;
+    QString relativePath;
+    for (int i = 0; i < depth; ++i) {
+        relativePath += QLatin1String("/d");
+    }
+    QVERIFY(QDir().mkpath(src + relativePath));
+    createTestFile(src + relativePath + "/testfile");
+    for (QString path = relativePath; !path.isEmpty(); path.chop(2)) {
+        setTimeStamp(src + path, s_referenceTimeStamp);
+    }
+    ScopedCleaner cleaner([&] {
+        QDir(src).removeRecursively();
+        QDir(dest).removeRecursively();
+    });
+
+    KIO::CopyJob *job = KIO::copy(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    QVERIFY(QFile::exists(dest + relativePath + "/testfile"));
+    QCOMPARE(job->processedAmount(KJob::Files), 1);
+    QCOMPARE(job->processedAmount(KJob::Directories), depth + 1);
+    for (QString path = relativePath; !path.isEmpty(); path.chop(2)) {
+        QCOMPARE(QFileInfo(dest + path).lastModified(), QFileInfo(src + path).lastModified());
+    }
+}
+
 void JobTest::copyDataUrl()
 {
     // GIVEN
@@ -1670,6 +1748,66 @@ void JobTest::listFile()
     QCOMPARE(job->error(), static_cast<int>(KIO::ERR_DOES_NOT_EXIST));
 }
 
+void JobTest::listDirMatchesStat()
+{
+    // Listing a local dir stats its entries in batches (through io_uring where available),
+    // they must describe them as stat'ing them one by one does
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    createTestFile(dir.filePath("file"));
+    createTestDirectory(dir.filePath("subdir"));
+#ifndef Q_OS_WIN
+    createTestSymlink(dir.filePath("symlink"), "file");
+    createTestSymlink(dir.filePath("brokenSymlink"));
+    createTestPipe(dir.filePath("fifo"));
+#endif
+    // More than one batch, of 1024 entries
+    for (int i = 0; i < 1100; ++i) {
+        createTestFile(dir.filePath(QStringLiteral("many%1").arg(i)));
+    }
+
+    const KIO::StatDetails details = KIO::StatDefaultDetails | KIO::StatInode;
+    KIO::ListJob *job = KIO::listDir(QUrl::fromLocalFile(dir.path()), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setDetails(details);
+    KIO::UDSEntryList listed;
+    connect(job, &KIO::ListJob::entries, this, [&listed](KIO::Job *, const KIO::UDSEntryList &entries) {
+        listed += entries;
+    });
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(listed.count(), QDir(dir.path()).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot).count() + 2);
+
+    const QList<uint> fields{
+        KIO::UDSEntry::UDS_FILE_TYPE,
+        KIO::UDSEntry::UDS_ACCESS,
+        KIO::UDSEntry::UDS_SIZE,
+        KIO::UDSEntry::UDS_MODIFICATION_TIME,
+        KIO::UDSEntry::UDS_CREATION_TIME,
+        KIO::UDSEntry::UDS_USER,
+        KIO::UDSEntry::UDS_GROUP,
+        KIO::UDSEntry::UDS_LINK_DEST,
+        KIO::UDSEntry::UDS_INODE,
+        KIO::UDSEntry::UDS_DEVICE_ID,
+    };
+    for (const KIO::UDSEntry &entry : std::as_const(listed)) {
+        const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME);
+        if (name == QLatin1String(".") || name == QLatin1String("..")) {
+            continue;
+        }
+        KIO::StatJob *statJob = KIO::stat(QUrl::fromLocalFile(dir.filePath(name)), KIO::StatJob::SourceSide, details, KIO::HideProgressInfo);
+        QVERIFY2(statJob->exec(), qPrintable(statJob->errorString()));
+        const KIO::UDSEntry statEntry = statJob->statResult();
+        for (uint field : fields) {
+            QVERIFY2(entry.contains(field) == statEntry.contains(field), qPrintable(name));
+            if (field == KIO::UDSEntry::UDS_USER || field == KIO::UDSEntry::UDS_GROUP || field == KIO::UDSEntry::UDS_LINK_DEST) {
+                QCOMPARE(entry.stringValue(field), statEntry.stringValue(field));
+            } else {
+                QCOMPARE(entry.numberValue(field), statEntry.numberValue(field));
+            }
+        }
+    }
+}
+
 void JobTest::killJob()
 {
     const QString src = homeTmpDir();
@@ -1742,6 +1880,34 @@ void JobTest::directorySizeError()
     qApp->sendPostedEvents(nullptr, QEvent::DeferredDelete);
 }
 
+void JobTest::directorySizeHardLinks()
+{
+#ifdef Q_OS_UNIX
+    QTemporaryDir tempDir(homeTmpDir() + "directorySizeHardLinks");
+    QVERIFY(tempDir.isValid());
+    const QString dir = tempDir.path();
+    createTestFile(dir + "/file");
+    createTestFile(dir + "/sub/other");
+    QCOMPARE(::link(QFile::encodeName(dir + "/file").constData(), QFile::encodeName(dir + "/sub/hardlink").constData()), 0);
+    createTestSymlink(dir + "/dirlink", "sub");
+
+    KIO::DirectorySizeJob *job = KIO::directorySize(QUrl::fromLocalFile(dir));
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    // The hard link is counted once, the symlink to a directory as a directory
+    QCOMPARE(job->totalFiles(), 2ULL);
+    QCOMPARE(job->totalSubdirs(), 2ULL);
+    QT_STATBUF dirBuf;
+    QT_STATBUF subBuf;
+    QCOMPARE(QT_STAT(QFile::encodeName(dir).constData(), &dirBuf), 0);
+    QCOMPARE(QT_STAT(QFile::encodeName(dir + "/sub").constData(), &subBuf), 0);
+    QCOMPARE(job->totalSize(), KIO::filesize_t(2 * 11 + dirBuf.st_size + subBuf.st_size));
+#else
+    QSKIP("Hard links are a unix thing");
+#endif
+}
+
 void JobTest::slotEntries(KIO::Job *, const KIO::UDSEntryList &lst)
 {
     for (KIO::UDSEntryList::ConstIterator it = lst.begin(); it != lst.end(); ++it) {
@@ -2348,6 +2514,294 @@ void JobTest::mostLocalUrl()
     QCOMPARE(job->mostLocalUrl().toLocalFile(), filePath);
 }
 
+void JobTest::schedulerStatistics()
+{
+    const QString filePath = homeTmpDir() + "fileFromHome";
+    createTestFile(filePath);
+    const auto interactive = int(KIO::SchedulingClass::Interactive);
+    const auto background = int(KIO::SchedulingClass::Background);
+    const auto before = KIO::schedulerStatistics(QStringLiteral("file"));
+
+    KIO::StatJob *statJob = KIO::stat(QUrl::fromLocalFile(filePath), KIO::HideProgressInfo);
+    QVERIFY2(statJob->exec(), qPrintable(statJob->errorString()));
+    KIO::StoredTransferJob *getJob = KIO::storedGet(QUrl::fromLocalFile(filePath), KIO::NoReload, KIO::HideProgressInfo);
+    QVERIFY2(getJob->exec(), qPrintable(getJob->errorString()));
+
+    const auto after = KIO::schedulerStatistics(QStringLiteral("file"));
+    QCOMPARE(after[interactive].startedJobs, before[interactive].startedJobs + 1);
+    QCOMPARE(after[background].startedJobs, before[background].startedJobs + 1);
+    QCOMPARE(after[interactive].queuedJobs, 0);
+    QCOMPARE(after[background].queuedJobs, 0);
+    QVERIFY(after[interactive].maxWaitMSecs >= before[interactive].maxWaitMSecs);
+    QVERIFY(after[interactive].totalWaitMSecs <= qint64(after[interactive].startedJobs) * after[interactive].maxWaitMSecs);
+}
+
+namespace
+{
+// What reached the workers of the kio-test-sched protocols, in the order the scheduler started the jobs.
+// A get of "/block" keeps its worker busy until releaseBlocked is set.
+struct SchedulingLog {
+    QMutex mutex;
+    QStringList startedPaths;
+    std::atomic<int> blockedJobs{0};
+    std::atomic<bool> releaseBlocked{false};
+
+    void reset()
+    {
+        QMutexLocker locker(&mutex);
+        startedPaths.clear();
+        blockedJobs = 0;
+        releaseBlocked = false;
+    }
+    void record(const QUrl &url)
+    {
+        QMutexLocker locker(&mutex);
+        startedPaths << url.path();
+    }
+    QStringList paths()
+    {
+        QMutexLocker locker(&mutex);
+        return startedPaths;
+    }
+};
+SchedulingLog s_schedulingLog;
+
+class SchedulingWorkerFactory : public KIO::WorkerFactory
+{
+public:
+    using KIO::WorkerFactory::WorkerFactory;
+    std::unique_ptr<KIO::WorkerBase> createWorker(const QByteArray &pool, const QByteArray &app) override
+    {
+        class SchedulingWorker : public KIO::WorkerBase
+        {
+        public:
+            SchedulingWorker(const QByteArray &pool, const QByteArray &app)
+                : WorkerBase(QByteArrayLiteral("kio-test-sched"), pool, app)
+            {
+            }
+
+            Q_REQUIRED_RESULT KIO::WorkerResult stat(const QUrl &url) override
+            {
+                s_schedulingLog.record(url);
+                KIO::UDSEntry entry;
+                entry.fastInsert(KIO::UDSEntry::UDS_NAME, url.fileName());
+                entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFREG);
+                statEntry(entry);
+                return KIO::WorkerResult::pass();
+            }
+            Q_REQUIRED_RESULT KIO::WorkerResult listDir(const QUrl &url) override
+            {
+                s_schedulingLog.record(url);
+                return KIO::WorkerResult::pass();
+            }
+            Q_REQUIRED_RESULT KIO::WorkerResult mkdir(const QUrl &url, int /*permissions*/) override
+            {
+                s_schedulingLog.record(url);
+                return KIO::WorkerResult::pass();
+            }
+            Q_REQUIRED_RESULT KIO::WorkerResult get(const QUrl &url) override
+            {
+                s_schedulingLog.record(url);
+                if (url.path() == QLatin1String("/block")) {
+                    ++s_schedulingLog.blockedJobs;
+                    while (!s_schedulingLog.releaseBlocked) {
+                        QThread::msleep(1);
+                    }
+                }
+                data(QByteArrayLiteral("data"));
+                data(QByteArray());
+                return KIO::WorkerResult::pass();
+            }
+            Q_REQUIRED_RESULT KIO::WorkerResult put(const QUrl &url, int /*permissions*/, KIO::JobFlags /*flags*/) override
+            {
+                s_schedulingLog.record(url);
+                int result;
+                do {
+                    QByteArray buffer;
+                    dataReq();
+                    result = readData(buffer);
+                } while (result > 0);
+                return KIO::WorkerResult::pass();
+            }
+        };
+
+        return std::unique_ptr<KIO::WorkerBase>(new SchedulingWorker(pool, app));
+    }
+};
+
+// A get of "/block" on protocol, it holds a connection until s_schedulingLog.releaseBlocked is set
+KIO::SimpleJob *startBlockingJob(const QString &protocol)
+{
+    s_schedulingLog.reset();
+    KIO::SimpleJob *job = KIO::get(QUrl(protocol + "://host/block"), KIO::NoReload, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    return job;
+}
+}
+
+void JobTest::schedulerOrdering()
+{
+    auto factory = std::make_shared<SchedulingWorkerFactory>();
+    KIO::Worker::setTestWorkerFactory(factory);
+    const QString protocol = QStringLiteral("kio-test-sched-order");
+    KIO::setTestProtocolLimits(protocol, 1, 1);
+
+    QList<KJob *> jobs{startBlockingJob(protocol)};
+    const auto releaseGuard = qScopeGuard([] {
+        s_schedulingLog.releaseBlocked = true;
+    });
+    QTRY_COMPARE(s_schedulingLog.blockedJobs.load(), 1);
+    const QString base = protocol + "://host";
+    jobs << KIO::get(QUrl(base + "/get"), KIO::NoReload, KIO::HideProgressInfo);
+    jobs << KIO::mkdir(QUrl(base + "/mkdir"));
+    jobs << KIO::stat(QUrl(base + "/stat"), KIO::HideProgressInfo);
+    jobs << KIO::listDir(QUrl(base + "/list"), KIO::HideProgressInfo);
+    int finishedJobs = 0;
+    for (KJob *job : std::as_const(jobs)) {
+        job->setUiDelegate(nullptr);
+        connect(job, &KJob::result, this, [&finishedJobs] {
+            ++finishedJobs;
+        });
+    }
+
+    s_schedulingLog.releaseBlocked = true;
+    QTRY_COMPARE(finishedJobs, jobs.size());
+    // Interactive jobs first, then the others by class, each class in the order it was queued
+    const QStringList expected{"/block", "/stat", "/list", "/mkdir", "/get"};
+    QCOMPARE(s_schedulingLog.paths(), expected);
+}
+
+void JobTest::schedulerFairness()
+{
+    auto factory = std::make_shared<SchedulingWorkerFactory>();
+    KIO::Worker::setTestWorkerFactory(factory);
+    const QString protocol = QStringLiteral("kio-test-sched-fair");
+    KIO::setTestProtocolLimits(protocol, 1, 1);
+
+    QList<KJob *> jobs{startBlockingJob(protocol)};
+    const auto releaseGuard = qScopeGuard([] {
+        s_schedulingLog.releaseBlocked = true;
+    });
+    QTRY_COMPARE(s_schedulingLog.blockedJobs.load(), 1);
+    const QString base = protocol + "://host";
+    jobs << KIO::get(QUrl(base + "/get"), KIO::NoReload, KIO::HideProgressInfo);
+    for (int i = 1; i <= 6; ++i) {
+        jobs << KIO::stat(QUrl(base + "/stat" + QString::number(i)), KIO::HideProgressInfo);
+    }
+    int finishedJobs = 0;
+    for (KJob *job : std::as_const(jobs)) {
+        job->setUiDelegate(nullptr);
+        connect(job, &KJob::result, this, [&finishedJobs] {
+            ++finishedJobs;
+        });
+    }
+
+    s_schedulingLog.releaseBlocked = true;
+    QTRY_COMPARE(finishedJobs, jobs.size());
+    // The get waits for four stats at most, even though all of them were queued after it
+    const QStringList expected{"/block", "/stat1", "/stat2", "/stat3", "/stat4", "/get", "/stat5", "/stat6"};
+    QCOMPARE(s_schedulingLog.paths(), expected);
+}
+
+void JobTest::schedulerReservation()
+{
+    auto factory = std::make_shared<SchedulingWorkerFactory>();
+    KIO::Worker::setTestWorkerFactory(factory);
+    const QString protocol = QStringLiteral("kio-test-sched-reserve");
+    KIO::setTestProtocolLimits(protocol, 2, 2);
+    const auto background = int(KIO::SchedulingClass::Background);
+
+    QList<KJob *> jobs{startBlockingJob(protocol)};
+    const auto releaseGuard = qScopeGuard([] {
+        s_schedulingLog.releaseBlocked = true;
+    });
+    QTRY_COMPARE(s_schedulingLog.blockedJobs.load(), 1);
+    const QString base = protocol + "://host";
+    jobs << KIO::get(QUrl(base + "/get"), KIO::NoReload, KIO::HideProgressInfo);
+    jobs << KIO::stat(QUrl(base + "/stat"), KIO::HideProgressInfo);
+    int finishedJobs = 0;
+    for (KJob *job : std::as_const(jobs)) {
+        job->setUiDelegate(nullptr);
+        connect(job, &KJob::result, this, [&finishedJobs] {
+            ++finishedJobs;
+        });
+    }
+
+    // The second connection is kept for the stat, the get waits for the first one
+    QTRY_COMPARE(finishedJobs, 1);
+    QCOMPARE(s_schedulingLog.paths(), QStringList({"/block", "/stat"}));
+    QCOMPARE(KIO::schedulerStatistics(protocol)[background].queuedJobs, 1);
+
+    s_schedulingLog.releaseBlocked = true;
+    QTRY_COMPARE(finishedJobs, jobs.size());
+    QCOMPARE(s_schedulingLog.paths(), QStringList({"/block", "/stat", "/get"}));
+}
+
+void JobTest::schedulerReservationDataPump()
+{
+    auto factory = std::make_shared<SchedulingWorkerFactory>();
+    KIO::Worker::setTestWorkerFactory(factory);
+    const QString protocol = QStringLiteral("kio-test-sched-pump");
+    KIO::setTestProtocolLimits(protocol, 2, 2);
+    s_schedulingLog.reset();
+
+    // Different users make a data pump of put and get on the same host. The put holds the only
+    // connection that isn't reserved, the get must still start or the copy never ends.
+    KIO::FileCopyJob *job = KIO::file_copy(QUrl(protocol + "://a@host/source"), QUrl(protocol + "://b@host/dest"), -1, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QSignalSpy spyResult(job, &KJob::result);
+    QVERIFY(spyResult.wait(5000));
+    QCOMPARE(job->error(), 0);
+    QCOMPARE(s_schedulingLog.paths(), QStringList({"/dest", "/source"}));
+}
+
+void JobTest::schedulerWarmPool()
+{
+    auto factory = std::make_shared<SchedulingWorkerFactory>();
+    KIO::Worker::setTestWorkerFactory(factory);
+    const QString protocol = QStringLiteral("kio-test-sched-warm");
+    KIO::setTestProtocolLimits(protocol, 3, 3);
+    KIO::setTestProtocolWarmWorkers(protocol, 1);
+
+    // Two jobs that had to wait for a worker to be spawned for them start the warming
+    QList<KJob *> jobs{startBlockingJob(protocol)};
+    const auto releaseGuard = qScopeGuard([] {
+        s_schedulingLog.releaseBlocked = true;
+    });
+    QTRY_COMPARE(s_schedulingLog.blockedJobs.load(), 1);
+    jobs << KIO::get(QUrl(protocol + "://host/block"), KIO::NoReload, KIO::HideProgressInfo);
+    jobs.last()->setUiDelegate(nullptr);
+    QTRY_COMPARE(s_schedulingLog.blockedJobs.load(), 2);
+    QCOMPARE(KIO::workerStartupStatistics(protocol).coldStarts, 2);
+    QTRY_COMPARE(KIO::workerStartupStatistics(protocol).warmSpawns, 1);
+
+    // The next job takes the worker spawned ahead of it, and another one is spawned for the one after
+    KIO::StatJob *statJob = KIO::stat(QUrl(protocol + "://otherhost/stat1"), KIO::HideProgressInfo);
+    QVERIFY2(statJob->exec(), qPrintable(statJob->errorString()));
+    KIO::WorkerStartupStatistics statistics = KIO::workerStartupStatistics(protocol);
+    QCOMPARE(statistics.coldStarts, 2);
+    QCOMPARE(statistics.warmStarts, 1);
+    QTRY_COMPARE(KIO::workerStartupStatistics(protocol).warmSpawns, 2);
+
+    // One that reuses the idle worker of its host leaves the pool as it is, already full
+    statJob = KIO::stat(QUrl(protocol + "://otherhost/stat2"), KIO::HideProgressInfo);
+    QVERIFY2(statJob->exec(), qPrintable(statJob->errorString()));
+    QTest::qWait(50);
+    statistics = KIO::workerStartupStatistics(protocol);
+    QCOMPARE(statistics.coldStarts, 2);
+    QCOMPARE(statistics.warmStarts, 1);
+    QCOMPARE(statistics.warmSpawns, 2);
+
+    int finishedJobs = 0;
+    for (KJob *job : std::as_const(jobs)) {
+        connect(job, &KJob::result, this, [&finishedJobs] {
+            ++finishedJobs;
+        });
+    }
+    s_schedulingLog.releaseBlocked = true;
+    QTRY_COMPARE(finishedJobs, jobs.size());
+}
+
 void JobTest::mostLocalUrlHttp()
 {
     // the url is returned as-is, as an http url can't have a mostLocalUrl
@@ -59,6 +59,8 @@ private Q_SLOTS:
     void copyRelativeSymlinkToSamePartition();
     void copyAbsoluteSymlinkToOtherPartition();
     void copyFolderWithUnaccessibleSubfolder();
+    void copyDirectoryWithFifo();
+    void copyDeepDirectory();
     void copyDataUrl();
     void suspendFileCopy();
     void suspendCopy();
@@ -67,11 +69,13 @@ private Q_SLOTS:
     void listRecursiveExcludeDotsHiddenToggle();
     void multipleListRecursive();
     void listFile();
+    void listDirMatchesStat();
     void killJob();
     void killJobBeforeStart();
     void deleteJobBeforeStart();
     void directorySize();
     void directorySizeError();
+    void directorySizeHardLinks();
     void moveFileToSamePartition();
     void moveDirectoryToSamePartition();
     void moveDirectoryIntoItself();
@@ -104,6 +108,12 @@ private Q_SLOTS:
 #endif
     void mostLocalUrl();
     void mostLocalUrlHttp();
+    void schedulerStatistics();
+    void schedulerOrdering();
+    void schedulerFairness();
+    void schedulerReservation();
+    void schedulerReservationDataPump();
+    void schedulerWarmPool();
     void chmodFile();
     void chmodFileSetAcl();    
 #ifdef Q_OS_UNIX
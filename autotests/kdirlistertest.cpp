@@ -9,7 +9,9 @@
 #include "kdirlistertest.h"
 
 #include "jobuidelegatefactory.h"
+#include "kcoredirlistersnapshots_p.h"
 #include "kiotesthelper.h"
+#include "scheduler_p.h"
 #include "worker_p.h"
 #include "workerbase.h"
 #include "workerfactory.h"
@@ -29,6 +31,8 @@
 #include <QDebug>
 #include <QTest>
 
+#include <cstdio>
+
 using namespace Qt::StringLiterals;
 
 QTEST_MAIN(KDirListerTest)
@@ -1570,6 +1574,131 @@ void KDirListerTest::testMimeFilter()
     }
 }
 
+void KDirListerTest::testRemoteListingSnapshot()
+{
+    QTemporaryDir snapshotDir;
+    QVERIFY(snapshotDir.isValid());
+
+    const QUrl url(u"kio-test://foo@bar/snapshot"_s);
+    QVERIFY(KCoreDirListerSnapshots::isWanted(url));
+    QVERIFY(!KCoreDirListerSnapshots::isWanted(QUrl::fromLocalFile(tempPath())));
+
+    auto fakeItem = [&url](const QString &name, long long mtime) {
+        KIO::UDSEntry entry;
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+        entry.fastInsert(KIO::UDSEntry::UDS_SIZE, 10);
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, mtime);
+        return KFileItem(entry, url, true, true);
+    };
+    auto names = [](const QList<KIO::UDSEntry> &entries) {
+        QStringList result;
+        for (const KIO::UDSEntry &entry : entries) {
+            result.append(entry.stringValue(KIO::UDSEntry::UDS_NAME));
+        }
+        return result;
+    };
+
+    {
+        KCoreDirListerSnapshots snapshots(snapshotDir.path());
+        QVERIFY(snapshots.load(url).isEmpty());
+        snapshots.save(url, fakeItem(u"."_s, 1000), {fakeItem(u"file1.txt"_s, 1000), fakeItem(u"file2.txt"_s, 1000)});
+        // Same directory mtime, so the snapshot on disk is still current and isn't written again
+        snapshots.save(url, fakeItem(u"."_s, 1000), {fakeItem(u"file1.txt"_s, 1000)});
+    }
+
+    KCoreDirListerSnapshots snapshots(snapshotDir.path());
+    QCOMPARE(names(snapshots.load(url)), QStringList({u"file1.txt"_s, u"file2.txt"_s}));
+    QVERIFY(snapshots.load(QUrl(u"kio-test://foo@bar/other"_s)).isEmpty());
+
+    snapshots.save(url, fakeItem(u"."_s, 2000), {fakeItem(u"file3.txt"_s, 2000)});
+    QCOMPARE(names(KCoreDirListerSnapshots(snapshotDir.path()).load(url)), QStringList({u"file3.txt"_s}));
+
+    snapshots.remove(url);
+    QVERIFY(KCoreDirListerSnapshots(snapshotDir.path()).load(url).isEmpty());
+}
+
+void KDirListerTest::testReplacedAndAddedFilesWithoutListing()
+{
+#ifdef Q_OS_WIN
+    QSKIP("Directories are listed again on every change on Windows");
+#endif
+    QTemporaryDir newDir(homeTmpDir());
+    const QString path = newDir.path() + QLatin1Char('/');
+    createTestFile(path + "saved.txt");
+
+    MyDirLister dirLister;
+    QSignalSpy spyNewItems(&dirLister, &KCoreDirLister::newItems);
+    QSignalSpy spyRefreshItems(&dirLister, &KCoreDirLister::refreshItems);
+    dirLister.openUrl(QUrl::fromLocalFile(newDir.path()));
+    QVERIFY(dirLister.spyCompleted.wait(1000));
+    QCOMPARE(dirLister.items().count(), 1);
+    dirLister.clearSpies();
+    spyNewItems.clear();
+    const auto interactive = int(KIO::SchedulingClass::Interactive);
+    const quint64 startedListings = KIO::schedulerStatistics(QStringLiteral("file"))[interactive].startedJobs;
+
+    // Saved the way editors do it, through a new file renamed over the old one
+    waitUntilMTimeChange(newDir.path());
+    QFile newVersion(path + "saved.txt.part");
+    QVERIFY(newVersion.open(QIODevice::WriteOnly));
+    newVersion.write(QByteArrayLiteral("Hello world, saved again"));
+    newVersion.close();
+    QCOMPARE(std::rename(QFile::encodeName(path + "saved.txt.part").constData(), QFile::encodeName(path + "saved.txt").constData()), 0);
+    createTestFile(path + "added.txt");
+
+    QTRY_VERIFY(dirLister.items().count() == 2 && dirLister.findByUrl(QUrl::fromLocalFile(path + "saved.txt")).size() == 24);
+    QTRY_VERIFY(!spyRefreshItems.isEmpty());
+    QVERIFY(!spyNewItems.isEmpty());
+    // Only the changed names were looked at, the directory wasn't listed again
+    QCOMPARE(KIO::schedulerStatistics(QStringLiteral("file"))[interactive].startedJobs, startedListings);
+    // but the update was announced like a listing
+    QVERIFY(dirLister.spyStarted.count() > 0);
+    QTRY_COMPARE(dirLister.spyCompleted.count(), dirLister.spyStarted.count());
+    QCOMPARE(dirLister.spyCompletedQUrl.count(), dirLister.spyStarted.count());
+}
+
+void KDirListerTest::testSymlinksWithoutListing()
+{
+#ifdef Q_OS_WIN
+    QSKIP("Directories are listed again on every change on Windows");
+#endif
+    QTemporaryDir newDir(homeTmpDir());
+    const QString path = newDir.path() + QLatin1Char('/');
+    createTestFile(path + "target.txt");
+    createTestFile(path + "other.txt");
+    QVERIFY(KIOPrivate::createSymlink(QStringLiteral("target.txt"), path + "kept.txt"));
+    QVERIFY(KIOPrivate::createSymlink(QStringLiteral("target.txt"), path + "moved.txt"));
+
+    MyDirLister dirLister;
+    QSignalSpy spyRefreshItems(&dirLister, &KCoreDirLister::refreshItems);
+    dirLister.openUrl(QUrl::fromLocalFile(newDir.path()));
+    QVERIFY(dirLister.spyCompleted.wait(1000));
+    QCOMPARE(dirLister.items().count(), 4);
+    dirLister.clearSpies();
+    const auto interactive = int(KIO::SchedulingClass::Interactive);
+    const quint64 startedListings = KIO::schedulerStatistics(QStringLiteral("file"))[interactive].startedJobs;
+
+    // One symlink pointing elsewhere, the other one left alone
+    waitUntilMTimeChange(newDir.path());
+    QVERIFY(QFile::remove(path + "moved.txt"));
+    QVERIFY(KIOPrivate::createSymlink(QStringLiteral("other.txt"), path + "moved.txt"));
+
+    QTRY_COMPARE(dirLister.findByUrl(QUrl::fromLocalFile(path + "moved.txt")).linkDest(), QStringLiteral("other.txt"));
+    QTRY_COMPARE(dirLister.spyCompleted.count(), dirLister.spyStarted.count());
+    QCOMPARE(KIO::schedulerStatistics(QStringLiteral("file"))[interactive].startedJobs, startedListings);
+    // Only the changed one was refreshed, besides the directory itself
+    QStringList refreshedNames;
+    for (const QVariantList &args : std::as_const(spyRefreshItems)) {
+        const auto items = args.at(0).value<QList<QPair<KFileItem, KFileItem>>>();
+        for (const auto &[oldItem, newItem] : items) {
+            if (newItem.url() != QUrl::fromLocalFile(newDir.path())) {
+                refreshedNames.append(newItem.name());
+            }
+        }
+    }
+    QCOMPARE(refreshedNames, QStringList{QStringLiteral("moved.txt")});
+}
+
 void KDirListerTest::testDeleteCurrentDir()
 {
     // ensure m_dirLister holds the items.
@@ -117,6 +117,9 @@ private Q_SLOTS:
     void testPathWithSquareBrackets();
     void testSFTPRedirect();
     void testDuplicatedEntries();
+    void testRemoteListingSnapshot();
+    void testReplacedAndAddedFilesWithoutListing();
+    void testSymlinksWithoutListing();
     void testDeleteCurrentDir(); // must be just before last!
     void testForgetDir(); // must be last!
 
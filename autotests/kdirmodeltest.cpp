@@ -1646,6 +1646,15 @@ void KDirModelTest::testDeleteFiles()
     const int topLevelRowCount = m_dirModel->rowCount();
     QCOMPARE(topLevelRowCount, oldTopLevelRowCount - 3); // three less than before
 
+    // The rows after the removed ones were renumbered, down to the parents of their children
+    for (int row = 0; row < topLevelRowCount; ++row) {
+        const QModelIndex index = m_dirModel->index(row, 0);
+        QCOMPARE(m_dirModel->indexForItem(m_dirModel->itemForIndex(index)).row(), row);
+        if (m_dirModel->rowCount(index) > 0) {
+            QCOMPARE(m_dirModel->parent(m_dirModel->index(0, 0, index)).row(), row);
+        }
+    }
+
     qDebug() << "Recreating test data";
     recreateTestData();
     qDebug() << "Re-filling model";
@@ -0,0 +1,198 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kdirsortfilterproxymodel.h"
+
+#include <KConfigGroup>
+#include <KDirLister>
+#include <KDirModel>
+#include <KSharedConfig>
+#include <kio/deletejob.h>
+#include <kio/simplejob.h>
+
+#include <QCollator>
+#include <QFile>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+
+class KDirSortFilterProxyModelTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testSortOrder_data();
+    void testSortOrder();
+    void testSortOrderAfterRenameAndRemove_data();
+    void testSortOrderAfterRenameAndRemove();
+
+private:
+    // Fills dir with count files of names that only sort right by number and by case
+    static QStringList createFiles(const QTemporaryDir &dir, int count);
+    // Lists dir in model, and waits for it to be done
+    static bool openDir(KDirModel &model, const QTemporaryDir &dir);
+    // The names, sorted the way KDirSortFilterProxyModel does with natural sorting
+    static QStringList sorted(QStringList names, Qt::CaseSensitivity caseSensitivity);
+    static QStringList names(const KDirSortFilterProxyModel &proxy);
+};
+
+void KDirSortFilterProxyModelTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    KConfigGroup group(KSharedConfig::openConfig(), QStringLiteral("KDE"));
+    group.writeEntry("NaturalSorting", true);
+}
+
+QStringList KDirSortFilterProxyModelTest::createFiles(const QTemporaryDir &dir, int count)
+{
+    static const QStringList prefixes = {QStringLiteral("file"), QStringLiteral("File"), QStringLiteral("FILE"), QStringLiteral("b"), QStringLiteral("ä")};
+    QStringList names;
+    for (int i = 0; i < count; ++i) {
+        const QString name = prefixes.at(i % prefixes.size()) + QString::number(i / prefixes.size()) + QLatin1String(".txt");
+        QFile file(dir.filePath(name));
+        if (!file.open(QIODevice::WriteOnly)) {
+            return {};
+        }
+        names.append(name);
+    }
+    return names;
+}
+
+bool KDirSortFilterProxyModelTest::openDir(KDirModel &model, const QTemporaryDir &dir)
+{
+    QSignalSpy completedSpy(model.dirLister(), qOverload<>(&KCoreDirLister::completed));
+    model.openUrl(QUrl::fromLocalFile(dir.path()));
+    return completedSpy.wait(30000);
+}
+
+QStringList KDirSortFilterProxyModelTest::sorted(QStringList names, Qt::CaseSensitivity caseSensitivity)
+{
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(caseSensitivity);
+    std::sort(names.begin(), names.end(), [&collator, caseSensitivity](const QString &a, const QString &b) {
+        int result = collator.compare(a, b);
+        if (result == 0 && caseSensitivity == Qt::CaseInsensitive) {
+            result = QString::compare(a, b, Qt::CaseSensitive);
+        }
+        return result < 0;
+    });
+    return names;
+}
+
+QStringList KDirSortFilterProxyModelTest::names(const KDirSortFilterProxyModel &proxy)
+{
+    QStringList names;
+    for (int row = 0; row < proxy.rowCount(); ++row) {
+        names.append(proxy.index(row, KDirModel::Name).data(Qt::DisplayRole).toString());
+    }
+    return names;
+}
+
+void KDirSortFilterProxyModelTest::testSortOrder_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<Qt::CaseSensitivity>("caseSensitivity");
+
+    // Fewer keys than it takes to compute them on all cores, and more
+    QTest::newRow("cached keys, case insensitive") << 50 << Qt::CaseInsensitive;
+    QTest::newRow("cached keys, case sensitive") << 50 << Qt::CaseSensitive;
+    QTest::newRow("parallel keys, case insensitive") << 1500 << Qt::CaseInsensitive;
+    QTest::newRow("parallel keys, case sensitive") << 1500 << Qt::CaseSensitive;
+}
+
+void KDirSortFilterProxyModelTest::testSortOrder()
+{
+    QFETCH(int, count);
+    QFETCH(Qt::CaseSensitivity, caseSensitivity);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QStringList fileNames = createFiles(dir, count);
+    QCOMPARE(fileNames.size(), count);
+
+    KDirModel model;
+    KDirSortFilterProxyModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.setSortCaseSensitivity(caseSensitivity);
+    QVERIFY(openDir(model, dir));
+    QCOMPARE(proxy.rowCount(), count);
+
+    // Sorted as the items came in, and sorted again all at once
+    const QStringList expected = sorted(fileNames, caseSensitivity);
+    QCOMPARE(names(proxy), expected);
+    proxy.invalidate();
+    QCOMPARE(names(proxy), expected);
+
+    // The keys of the other case sensitivity
+    const Qt::CaseSensitivity otherCaseSensitivity = caseSensitivity == Qt::CaseSensitive ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    proxy.setSortCaseSensitivity(otherCaseSensitivity);
+    QCOMPARE(names(proxy), sorted(fileNames, otherCaseSensitivity));
+}
+
+void KDirSortFilterProxyModelTest::testSortOrderAfterRenameAndRemove_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("cached keys") << 50;
+    QTest::newRow("parallel keys") << 1500;
+}
+
+void KDirSortFilterProxyModelTest::testSortOrderAfterRenameAndRemove()
+{
+    QFETCH(int, count);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QStringList fileNames = createFiles(dir, count);
+    QCOMPARE(fileNames.size(), count);
+
+    KDirModel model;
+    KDirSortFilterProxyModel proxy;
+    proxy.setSourceModel(&model);
+    QVERIFY(openDir(model, dir));
+    proxy.invalidate();
+    QCOMPARE(names(proxy), sorted(fileNames, Qt::CaseInsensitive));
+
+    // To names that sort somewhere else in the list
+    const QList<QPair<QString, QString>> renames = {
+        {QStringLiteral("b0.txt"), QStringLiteral("File10000.txt")},
+        {QStringLiteral("ä0.txt"), QStringLiteral("a1.txt")},
+    };
+    for (const auto &[from, to] : renames) {
+        QVERIFY(fileNames.contains(from));
+        KIO::Job *job = KIO::rename(QUrl::fromLocalFile(dir.filePath(from)), QUrl::fromLocalFile(dir.filePath(to)), KIO::HideProgressInfo);
+        QVERIFY2(job->exec(), qPrintable(job->errorString()));
+        fileNames.replace(fileNames.indexOf(from), to);
+        QTRY_COMPARE(names(proxy), sorted(fileNames, Qt::CaseInsensitive));
+    }
+
+    // Removed, then one of the names comes back
+    const QStringList removed = {QStringLiteral("file1.txt"), QStringLiteral("File1.txt"), QStringLiteral("FILE1.txt"), QStringLiteral("a1.txt")};
+    for (const QString &name : removed) {
+        KIO::Job *job = KIO::del(QUrl::fromLocalFile(dir.filePath(name)), KIO::HideProgressInfo);
+        QVERIFY2(job->exec(), qPrintable(job->errorString()));
+        fileNames.removeOne(name);
+    }
+    QTRY_COMPARE(names(proxy), sorted(fileNames, Qt::CaseInsensitive));
+    QVERIFY(KIO::rename(QUrl::fromLocalFile(dir.filePath(QStringLiteral("File10000.txt"))),
+                        QUrl::fromLocalFile(dir.filePath(QStringLiteral("File1.txt"))),
+                        KIO::HideProgressInfo)
+                ->exec());
+    fileNames.replace(fileNames.indexOf(QStringLiteral("File10000.txt")), QStringLiteral("File1.txt"));
+    QTRY_COMPARE(names(proxy), sorted(fileNames, Qt::CaseInsensitive));
+    proxy.invalidate();
+    QCOMPARE(names(proxy), sorted(fileNames, Qt::CaseInsensitive));
+}
+
+QTEST_MAIN(KDirSortFilterProxyModelTest)
+#include "kdirsortfilterproxymodeltest.moc"
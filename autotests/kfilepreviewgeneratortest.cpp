@@ -0,0 +1,274 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kfilepreviewgenerator.h"
+
+#include <KDirLister>
+#include <KDirModel>
+#include <kfileitem.h>
+#include <kio/previewjob.h>
+
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QListView>
+#include <QPointer>
+#include <QScrollBar>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+extern KIOFILEWIDGETS_EXPORT std::function<void(KIO::PreviewJob *, const KFileItemList &)> kfilepreviewgenerator_preview_job_started;
+
+static const int s_fileCount = 60;
+static const QString s_thumbnailerId = QStringLiteral("kfilepreviewgeneratortest");
+
+class KFilePreviewGeneratorTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void testNearItemsFirst();
+    void testResumeJobOfNearItems();
+    void testKillJobScrolledAway();
+
+private:
+    struct StartedJob {
+        QPointer<KIO::PreviewJob> job;
+        QList<QUrl> urls;
+        // Whether the jobs started before it had all finished then
+        bool earlierJobsDone = false;
+        bool done = false;
+        int error = 0;
+    };
+
+    // The items in the visible area moved down by offset screens
+    QSet<QUrl> urlsInArea(int offset) const;
+    // Lets the thumbnailers of the items of the listed directory write their thumbnail
+    void releaseThumbnailers();
+
+    QTemporaryDir m_dataDir;
+    QString m_thumbnailerFile;
+    std::unique_ptr<QTemporaryDir> m_dir;
+    std::unique_ptr<KDirModel> m_model;
+    std::unique_ptr<QListView> m_view;
+    KFilePreviewGenerator *m_generator = nullptr;
+    QList<StartedJob> m_jobs;
+};
+
+static QSet<QUrl> toSet(const QList<QUrl> &urls)
+{
+    return QSet<QUrl>(urls.cbegin(), urls.cend());
+}
+
+void KFilePreviewGeneratorTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_dataDir.isValid());
+
+    // A thumbnailer for text files that runs until there is a release file next to the
+    // directory of the file, so that the tests decide when the preview jobs are done
+    QImage thumb(16, 16, QImage::Format_ARGB32);
+    thumb.fill(Qt::red);
+    QVERIFY(thumb.save(m_dataDir.filePath(QStringLiteral("thumb.png"))));
+    const QString script = m_dataDir.filePath(QStringLiteral("thumbnailer.sh"));
+    QFile scriptFile(script);
+    QVERIFY(scriptFile.open(QIODevice::WriteOnly));
+    scriptFile.write(QStringLiteral("#!/bin/sh\n"
+                                    "while [ ! -e \"$(dirname \"$1\").release\" ]; do sleep 0.05; done\n"
+                                    "cp \"%1\" \"$2\"\n")
+                         .arg(m_dataDir.filePath(QStringLiteral("thumb.png")))
+                         .toLocal8Bit());
+    scriptFile.close();
+    QVERIFY(scriptFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner));
+
+    // Found by the preview jobs in the thumbnailers directory of the test data location
+    const QString thumbnailersDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/thumbnailers");
+    QVERIFY(QDir().mkpath(thumbnailersDir));
+    m_thumbnailerFile = thumbnailersDir + QLatin1Char('/') + s_thumbnailerId + QLatin1String(".thumbnailer");
+    QFile thumbnailerFile(m_thumbnailerFile);
+    QVERIFY(thumbnailerFile.open(QIODevice::WriteOnly));
+    thumbnailerFile.write(QStringLiteral("[Thumbnailer Entry]\n"
+                                         "Exec=%1 %i %o\n"
+                                         "MimeType=text/plain;\n")
+                              .arg(script)
+                              .toLocal8Bit());
+}
+
+void KFilePreviewGeneratorTest::cleanupTestCase()
+{
+    QFile::remove(m_thumbnailerFile);
+}
+
+void KFilePreviewGeneratorTest::init()
+{
+    // A directory of its own for each test, the thumbnails of another would be in the cache
+    m_dir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dir->isValid());
+    for (int i = 0; i < s_fileCount; ++i) {
+        QFile file(m_dir->filePath(QStringLiteral("file%1.txt").arg(i, 2, 10, QLatin1Char('0'))));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("Some text\n");
+    }
+
+    m_model = std::make_unique<KDirModel>();
+    QSignalSpy completedSpy(m_model->dirLister(), qOverload<>(&KCoreDirLister::completed));
+    m_model->openUrl(QUrl::fromLocalFile(m_dir->path()));
+    QVERIFY(completedSpy.wait());
+    QCOMPARE(m_model->rowCount(), s_fileCount);
+
+    // One column of items, of which a few screens full
+    m_view = std::make_unique<QListView>();
+    m_view->setUniformItemSizes(true);
+    m_view->setIconSize(QSize(16, 16));
+    m_view->setModel(m_model.get());
+    m_view->resize(200, 150);
+    m_view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_view.get()));
+
+    m_jobs.clear();
+    kfilepreviewgenerator_preview_job_started = [this](KIO::PreviewJob *job, const KFileItemList &items) {
+        StartedJob started;
+        started.job = job;
+        for (const KFileItem &item : items) {
+            started.urls.append(item.url());
+        }
+        // Possibly from the generator's slot for the finished signal of the last one, before ours
+        started.earlierJobsDone = std::all_of(m_jobs.cbegin(), m_jobs.cend(), [](const StartedJob &earlier) {
+            return !earlier.job || earlier.job->isFinished();
+        });
+        const qsizetype index = m_jobs.size();
+        connect(job, &KJob::finished, this, [this, index](KJob *job) {
+            m_jobs[index].done = true;
+            m_jobs[index].error = job->error();
+        });
+        m_jobs.append(started);
+    };
+
+    // Owned by the view
+    m_generator = new KFilePreviewGenerator(m_view.get());
+    m_generator->setEnabledPlugins({s_thumbnailerId});
+}
+
+void KFilePreviewGeneratorTest::cleanup()
+{
+    kfilepreviewgenerator_preview_job_started = nullptr;
+    m_view.reset();
+    m_generator = nullptr;
+    m_model.reset();
+    if (m_dir) {
+        QFile::remove(m_dir->path() + QLatin1String(".release"));
+        m_dir.reset();
+    }
+}
+
+QSet<QUrl> KFilePreviewGeneratorTest::urlsInArea(int offset) const
+{
+    const QRect visibleArea = m_view->viewport()->rect();
+    const QRect area = visibleArea.translated(0, offset * visibleArea.height());
+    QSet<QUrl> urls;
+    for (int row = 0; row < m_model->rowCount(); ++row) {
+        const QModelIndex index = m_model->index(row, 0);
+        if (m_view->visualRect(index).intersects(area)) {
+            urls.insert(m_model->itemForIndex(index).url());
+        }
+    }
+    return urls;
+}
+
+void KFilePreviewGeneratorTest::releaseThumbnailers()
+{
+    QFile release(m_dir->path() + QLatin1String(".release"));
+    QVERIFY(release.open(QIODevice::WriteOnly));
+}
+
+void KFilePreviewGeneratorTest::testNearItemsFirst()
+{
+    const QSet<QUrl> visibleUrls = urlsInArea(0);
+    const QSet<QUrl> nearUrls = visibleUrls + urlsInArea(1);
+    QVERIFY(!visibleUrls.isEmpty());
+    QVERIFY(nearUrls.size() < s_fileCount);
+
+    m_generator->updateIcons();
+
+    // The visible items and those of the next screen are asked for at once, the visible ones first
+    QTRY_COMPARE(m_jobs.size(), 1);
+    const QList<QUrl> firstUrls = m_jobs.at(0).urls;
+    QCOMPARE(toSet(firstUrls), nearUrls);
+    QCOMPARE(toSet(firstUrls.first(visibleUrls.size())), visibleUrls);
+
+    // The others wait for them
+    QTest::qWait(500);
+    QCOMPARE(m_jobs.size(), 1);
+    QVERIFY(!m_jobs.at(0).done);
+
+    releaseThumbnailers();
+    QTRY_COMPARE_WITH_TIMEOUT(m_jobs.size(), 2, 20000);
+    QVERIFY(m_jobs.at(1).earlierJobsDone);
+    QCOMPARE(m_jobs.at(0).error, 0);
+
+    QSet<QUrl> farUrls;
+    for (int row = 0; row < m_model->rowCount(); ++row) {
+        farUrls.insert(m_model->itemForIndex(m_model->index(row, 0)).url());
+    }
+    farUrls -= nearUrls;
+    QCOMPARE(toSet(m_jobs.at(1).urls), farUrls);
+}
+
+void KFilePreviewGeneratorTest::testResumeJobOfNearItems()
+{
+    m_generator->updateIcons();
+    QTRY_COMPARE(m_jobs.size(), 1);
+
+    // Scrolling suspends the job. Back where it was by the time the generator looks
+    // again, all its items are still near the visible area.
+    QScrollBar *scrollBar = m_view->verticalScrollBar();
+    QVERIFY(scrollBar->maximum() > 0);
+    scrollBar->setValue(1);
+    scrollBar->setValue(0);
+    QTest::qWait(500); // longer than the generator waits for scrolling to stop
+
+    // Resumed, not killed and started again
+    QCOMPARE(m_jobs.size(), 1);
+    QVERIFY(!m_jobs.at(0).done);
+
+    releaseThumbnailers();
+    QTRY_COMPARE_WITH_TIMEOUT(m_jobs.size(), 2, 20000);
+    QVERIFY(m_jobs.at(0).done);
+    QCOMPARE(m_jobs.at(0).error, 0);
+}
+
+void KFilePreviewGeneratorTest::testKillJobScrolledAway()
+{
+    m_generator->updateIcons();
+    QTRY_COMPARE(m_jobs.size(), 1);
+
+    // None of the items of the job are near the visible area at the end of the list
+    QScrollBar *scrollBar = m_view->verticalScrollBar();
+    scrollBar->setValue(scrollBar->maximum());
+    const QSet<QUrl> visibleUrls = urlsInArea(0);
+    QVERIFY(!visibleUrls.intersects(toSet(m_jobs.at(0).urls)));
+
+    QTRY_COMPARE(m_jobs.size(), 2);
+    QVERIFY(m_jobs.at(0).done);
+    QCOMPARE(m_jobs.at(0).error, int(KJob::KilledJobError));
+    // Nothing is below the end of the list
+    QCOMPARE(toSet(m_jobs.at(1).urls), visibleUrls);
+}
+
+QTEST_MAIN(KFilePreviewGeneratorTest)
+#include "kfilepreviewgeneratortest.moc"
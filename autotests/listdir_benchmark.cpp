@@ -0,0 +1,92 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kio/listjob.h>
+
+#include <QFile>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+/*
+   Lists a local directory with all details through the file worker, once with the
+   statx calls batched through io_uring (when the worker was built with liburing and
+   the kernel allows it) and once with one synchronous statx per entry.
+
+   The file worker runs in a thread of this process (unless KIO_ENABLE_WORKER_THREADS=0),
+   so switching KIO_FILE_NO_IO_URING between rows takes effect right away.
+
+   Point KIO_BENCHMARK_DIR to an existing directory (e.g. on NFS) to list that one
+   instead of a freshly created local directory.
+*/
+class ListDirBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void benchmarkDetailedListing_data()
+    {
+        QTest::addColumn<int>("numOfFiles");
+        QTest::addColumn<bool>("ioUring");
+
+        for (int numOfFiles : {1000, 10000, 100000}) {
+            QTest::addRow("%d files, io_uring", numOfFiles) << numOfFiles << true;
+            QTest::addRow("%d files, synchronous", numOfFiles) << numOfFiles << false;
+        }
+    }
+
+    void benchmarkDetailedListing()
+    {
+        QFETCH(int, numOfFiles);
+        QFETCH(bool, ioUring);
+
+        QString path = qEnvironmentVariable("KIO_BENCHMARK_DIR");
+        QTemporaryDir tempDir;
+        if (path.isEmpty()) {
+            QVERIFY(tempDir.isValid());
+            path = tempDir.path();
+            for (int i = 0; i < numOfFiles; ++i) {
+                QFile file(path + QStringLiteral("/file%1").arg(i));
+                QVERIFY(file.open(QIODevice::WriteOnly));
+            }
+        }
+
+        if (ioUring) {
+            qunsetenv("KIO_FILE_NO_IO_URING");
+        } else {
+            qputenv("KIO_FILE_NO_IO_URING", "1");
+        }
+
+        qsizetype count = 0;
+        QBENCHMARK {
+            count = 0;
+            KIO::ListJob *job = KIO::listDir(QUrl::fromLocalFile(path), KIO::HideProgressInfo);
+            job->setUiDelegate(nullptr);
+            job->setDetails(KIO::StatDefaultDetails);
+            connect(job, &KIO::ListJob::entries, this, [&count](KIO::Job *, const KIO::UDSEntryList &entries) {
+                count += entries.size();
+            });
+
+            QSignalSpy spy(job, &KJob::result);
+            QVERIFY(spy.wait(600000));
+            QCOMPARE(job->error(), 0);
+        }
+        QVERIFY(count > 0);
+
+        qunsetenv("KIO_FILE_NO_IO_URING");
+    }
+};
+
+QTEST_GUILESS_MAIN(ListDirBenchmark)
+
+#include "listdir_benchmark.moc"
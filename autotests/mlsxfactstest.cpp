@@ -0,0 +1,121 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+#include <QTimeZone>
+
+#include <mlsxfacts.h>
+
+class MlsxFactsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFile();
+    void testDirectoryWithPerm();
+    void testSpecialDirectories();
+    void testSymlink();
+    void testNameWithSpaces();
+    void testNoFacts();
+    void testInvalid();
+};
+
+void MlsxFactsTest::testFile()
+{
+    MlsxFacts facts;
+    QVERIFY(parseMlsxFacts("Type=file;Size=102;Modify=20241109123005.25;UNIX.mode=0644;UNIX.owner=1000;UNIX.ownername=dfaure;UNIX.groupname=users; log\r\n",
+                           facts));
+    QCOMPARE(facts.name, QByteArray("log"));
+    QCOMPARE(facts.kind, MlsxFacts::Entry);
+    QCOMPARE(facts.type, mode_t(S_IFREG));
+    QCOMPARE(facts.size, 102ULL);
+    QCOMPARE(facts.access, mode_t(0644));
+    QCOMPARE(facts.owner, QByteArray("dfaure"));
+    QCOMPARE(facts.group, QByteArray("users"));
+    QVERIFY(facts.link.isEmpty());
+    QCOMPARE(facts.modified, QDateTime(QDate(2024, 11, 9), QTime(12, 30, 5, 250), QTimeZone::UTC));
+}
+
+void MlsxFactsTest::testDirectoryWithPerm()
+{
+    MlsxFacts facts;
+    // perm before type, no unix.mode
+    QVERIFY(parseMlsxFacts("perm=flcdmpe;type=dir;sizd=4096;modify=20000101000000; pub", facts));
+    QCOMPARE(facts.type, mode_t(S_IFDIR));
+    QCOMPARE(facts.size, 4096ULL);
+    QCOMPARE(facts.access, mode_t(S_IRUSR | S_IWUSR | S_IXUSR));
+    QCOMPARE(facts.modified, QDateTime(QDate(2000, 1, 1), QTime(0, 0), QTimeZone::UTC));
+
+    QVERIFY(parseMlsxFacts("type=file;perm=r; readonly", facts));
+    QCOMPARE(facts.access, mode_t(S_IRUSR));
+    QVERIFY(!facts.modified.isValid());
+}
+
+void MlsxFactsTest::testSpecialDirectories()
+{
+    MlsxFacts facts;
+    QVERIFY(parseMlsxFacts("type=cdir;modify=20241109123005; /home/ftp", facts));
+    QCOMPARE(facts.kind, MlsxFacts::CurrentDir);
+    QCOMPARE(facts.type, mode_t(S_IFDIR));
+
+    QVERIFY(parseMlsxFacts("type=pdir;modify=20241109123005; /home", facts));
+    QCOMPARE(facts.kind, MlsxFacts::ParentDir);
+}
+
+void MlsxFactsTest::testSymlink()
+{
+    MlsxFacts facts;
+    QVERIFY(parseMlsxFacts("type=OS.unix=slink:/srv/data;size=9; data", facts));
+    QCOMPARE(facts.type, mode_t(S_IFREG));
+    QCOMPARE(facts.link, QByteArray("/srv/data"));
+    QVERIFY(facts.isLink);
+
+    QVERIFY(parseMlsxFacts("type=OS.unix=symlink;unix.slink=target; link", facts));
+    QCOMPARE(facts.link, QByteArray("target"));
+    QVERIFY(facts.isLink);
+
+    // Without the target, it's still known to be a symlink
+    QVERIFY(parseMlsxFacts("type=OS.unix=slink; link", facts));
+    QCOMPARE(facts.type, mode_t(S_IFREG));
+    QVERIFY(facts.link.isEmpty());
+    QVERIFY(facts.isLink);
+
+    QVERIFY(parseMlsxFacts("type=OS.unix=chardev; zero", facts));
+    QCOMPARE(facts.type, mode_t(S_IFCHR));
+    QVERIFY(facts.link.isEmpty());
+    QVERIFY(!facts.isLink);
+
+    QVERIFY(parseMlsxFacts("type=file;size=1; plain", facts));
+    QVERIFY(!facts.isLink);
+}
+
+void MlsxFactsTest::testNameWithSpaces()
+{
+    MlsxFacts facts;
+    QVERIFY(parseMlsxFacts("type=file;size=1;  two  spaces ", facts));
+    QCOMPARE(facts.name, QByteArray(" two  spaces "));
+}
+
+void MlsxFactsTest::testNoFacts()
+{
+    MlsxFacts facts;
+    QVERIFY(parseMlsxFacts(" bare", facts));
+    QCOMPARE(facts.name, QByteArray("bare"));
+    QCOMPARE(facts.type, mode_t(S_IFREG));
+    QCOMPARE(facts.access, mode_t(S_IRUSR | S_IRGRP | S_IROTH));
+}
+
+void MlsxFactsTest::testInvalid()
+{
+    MlsxFacts facts;
+    QVERIFY(!parseMlsxFacts("", facts));
+    QVERIFY(!parseMlsxFacts("type=file;size=1;\r\n", facts));
+    QVERIFY(!parseMlsxFacts("type=file; ", facts));
+}
+
+QTEST_GUILESS_MAIN(MlsxFactsTest)
+
+#include "mlsxfactstest.moc"
@@ -49,6 +49,7 @@ private Q_SLOTS:
     void testSuspendedApplicationBuffersUntilResumed();
     void testWorkerReceivesFromApplication();
     void testOwnedPayloadSurvivesSenderScope();
+    void testEntriesAreHandedOverWithoutSerialization();
     void testManyTasksPreserveOrderUnderBackPressure();
     void testWorkerCloseDisconnectsApplication();
 };
@@ -164,6 +165,37 @@ void ThreadConnectionBackendTest::testOwnedPayloadSurvivesSenderScope()
     QCOMPARE(sink.tasks().at(0).data, QByteArray(64, 'z'));
 }
 
+void ThreadConnectionBackendTest::testEntriesAreHandedOverWithoutSerialization()
+{
+    // sendEntries() queues the list itself: the application gets the very same (shared) entries
+    // and no serialized payload.
+    auto [appBackend, workerBackend] = ThreadConnectionBackend::createPair();
+
+    TaskSink sink;
+    connect(appBackend.get(), &ConnectionBackend::commandReceived, this, [&sink](const Task &task) {
+        sink.add(task);
+    });
+
+    UDSEntryList entries;
+    for (int i = 0; i < 3; ++i) {
+        UDSEntry entry;
+        entry.fastInsert(UDSEntry::UDS_NAME, QStringLiteral("file%1").arg(i));
+        entry.fastInsert(UDSEntry::UDS_SIZE, i);
+        entries.append(entry);
+    }
+    QVERIFY(workerBackend->sendEntries(106, entries));
+
+    QTRY_COMPARE(sink.count(), 1);
+    const Task task = sink.tasks().at(0);
+    QCOMPARE(task.cmd, 106);
+    QVERIFY(task.data.isEmpty());
+    QVERIFY(task.entries.has_value());
+    QCOMPARE(task.entries->size(), 3);
+    QCOMPARE(task.entries->at(2).stringValue(UDSEntry::UDS_NAME), QStringLiteral("file2"));
+    QCOMPARE(task.entries->at(2).numberValue(UDSEntry::UDS_SIZE), 2);
+    QVERIFY(task.entries->isSharedWith(entries));
+}
+
 void ThreadConnectionBackendTest::testManyTasksPreserveOrderUnderBackPressure()
 {
     auto [appBackend, workerBackend] = ThreadConnectionBackend::createPair();
@@ -316,6 +316,31 @@ void UDSEntryTest::testEquality()
     QVERIFY(list1 != list2);
 }
 
+/*!
+ * Test that the user of entries read apart, with another user in between, shares one string.
+ */
+void UDSEntryTest::testSharedStrings()
+{
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        for (const QString &user : {QStringLiteral("sharedUser"), QStringLiteral("otherUser"), QStringLiteral("sharedUser")}) {
+            KIO::UDSEntry entry;
+            entry.fastInsert(KIO::UDSEntry::UDS_NAME, QStringLiteral("file"));
+            entry.fastInsert(KIO::UDSEntry::UDS_USER, user);
+            stream << entry;
+        }
+    }
+
+    QDataStream stream(data);
+    KIO::UDSEntry first;
+    KIO::UDSEntry second;
+    KIO::UDSEntry third;
+    stream >> first >> second >> third;
+    QCOMPARE(third.stringValue(KIO::UDSEntry::UDS_USER), QStringLiteral("sharedUser"));
+    QCOMPARE(third.stringValue(KIO::UDSEntry::UDS_USER).constData(), first.stringValue(KIO::UDSEntry::UDS_USER).constData());
+}
+
 QTEST_MAIN(UDSEntryTest)
 
 #include "moc_udsentrytest.cpp"
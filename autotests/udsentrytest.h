@@ -18,6 +18,7 @@ private Q_SLOTS:
     void testSaveLoad();
     void testMove();
     void testEquality();
+    void testSharedStrings();
 };
 
 #endif
@@ -8,9 +8,11 @@
 
 #include <kio/copyjob.h>
 #include <kio/filesystemfreespacejob.h>
+#include <kio/listjob.h>
 #include <kio/storedtransferjob.h>
 
 #include <QBuffer>
+#include <QDir>
 #include <QObject>
 #include <QProcess>
 #include <QSignalSpy>
@@ -281,6 +283,61 @@ private Q_SLOTS:
         QVERIFY(file.open(QFile::ReadOnly));
         QCOMPARE(file.readAll(), QByteArray("testOverwriteCopy1\n")); // not 2!
     }
+
+    void testListRecursive()
+    {
+        const QString path("/testListRecursive");
+        const QString remotePath = m_remoteDir.path() + path;
+        QVERIFY(QDir().mkpath(remotePath + "/a/b"));
+        QVERIFY(QDir().mkpath(remotePath + "/c"));
+        for (const QString &file : {"/top", "/a/inA", "/a/b/inB"}) {
+            QFile f(remotePath + file);
+            QVERIFY(f.open(QFile::WriteOnly));
+        }
+
+        auto job = KIO::listRecursive(url(path), KIO::HideProgressInfo);
+        job->setUiDelegate(nullptr);
+        QStringList names;
+        connect(job, &KIO::ListJob::entries, this, [&names](KIO::Job *, const KIO::UDSEntryList &list) {
+            for (const KIO::UDSEntry &entry : list) {
+                names << entry.stringValue(KIO::UDSEntry::UDS_NAME);
+            }
+        });
+        QVERIFY2(job->exec(), qUtf8Printable(job->errorString()));
+
+        names.sort();
+        const QStringList expected{".", "a", "a/b", "a/b/inB", "a/inA", "c", "top"};
+        QCOMPARE(names, expected);
+    }
+
+    void testListRecursiveThroughForwardingWorker()
+    {
+        // The dav worker behind a forwarding worker must not list the tree on its own,
+        // since the outer ListJob recurses as well and would report every entry twice.
+        const QString path("/testListRecursiveForwarded");
+        const QString remotePath = m_remoteDir.path() + path;
+        QVERIFY(QDir().mkpath(remotePath + "/a/b"));
+        for (const QString &file : {"/top", "/a/inA", "/a/b/inB"}) {
+            QFile f(remotePath + file);
+            QVERIFY(f.open(QFile::WriteOnly));
+        }
+
+        QUrl forwardedUrl = url(path);
+        forwardedUrl.setScheme(QStringLiteral("davforward"));
+        auto job = KIO::listRecursive(forwardedUrl, KIO::HideProgressInfo);
+        job->setUiDelegate(nullptr);
+        QStringList names;
+        connect(job, &KIO::ListJob::entries, this, [&names](KIO::Job *, const KIO::UDSEntryList &list) {
+            for (const KIO::UDSEntry &entry : list) {
+                names << entry.stringValue(KIO::UDSEntry::UDS_NAME);
+            }
+        });
+        QVERIFY2(job->exec(), qUtf8Printable(job->errorString()));
+
+        names.sort();
+        const QStringList expected{".", "a", "a/b", "a/b/inB", "a/inA", "top"};
+        QCOMPARE(names, expected);
+    }
 };
 
 int main(int argc, char *argv[])
@@ -0,0 +1,46 @@
+# - Find liburing, the io_uring userspace library
+#
+# Once done this will define
+#
+#  LibURing_FOUND - system has liburing
+#  LibURing_INCLUDE_DIRS - the liburing include directory
+#  LibURing_LIBRARIES - the libraries needed to use liburing
+#  LibURing::LibURing - imported target
+#
+# SPDX-FileCopyrightText: 2026 KIO contributors
+#
+# SPDX-License-Identifier: BSD-3-Clause
+
+find_package(PkgConfig QUIET)
+pkg_check_modules(PC_LibURing QUIET liburing)
+
+find_path(LibURing_INCLUDE_DIR
+    NAMES liburing.h
+    HINTS ${PC_LibURing_INCLUDE_DIRS}
+)
+find_library(LibURing_LIBRARY
+    NAMES uring
+    HINTS ${PC_LibURing_LIBRARY_DIRS}
+)
+
+set(LibURing_VERSION ${PC_LibURing_VERSION})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibURing
+    FOUND_VAR LibURing_FOUND
+    REQUIRED_VARS LibURing_LIBRARY LibURing_INCLUDE_DIR
+    VERSION_VAR LibURing_VERSION
+)
+
+if(LibURing_FOUND AND NOT TARGET LibURing::LibURing)
+    add_library(LibURing::LibURing UNKNOWN IMPORTED)
+    set_target_properties(LibURing::LibURing PROPERTIES
+        IMPORTED_LOCATION "${LibURing_LIBRARY}"
+        INTERFACE_INCLUDE_DIRECTORIES "${LibURing_INCLUDE_DIR}"
+    )
+endif()
+
+set(LibURing_INCLUDE_DIRS ${LibURing_INCLUDE_DIR})
+set(LibURing_LIBRARIES ${LibURing_LIBRARY})
+
+mark_as_advanced(LibURing_INCLUDE_DIR LibURing_LIBRARY)
@@ -12,6 +12,7 @@
 #include "connectionbackend_p.h"
 #include "kiocoredebug.h"
 #include "socketconnectionbackend_p.h"
+#include <QDataStream>
 #include <QDebug>
 
 #include <cerrno>
@@ -25,7 +26,13 @@ void ConnectionPrivate::dequeue()
     }
 
     for (const Task &task : std::as_const(outgoingTasks)) {
-        q->sendnow(task.cmd, task.data);
+        if (task.entries.has_value()) {
+            if (q->isConnected()) {
+                backend->sendEntries(task.cmd, *task.entries);
+            }
+        } else {
+            q->sendnow(task.cmd, task.data);
+        }
     }
     outgoingTasks.clear();
 
@@ -184,6 +191,24 @@ bool Connection::send(int cmd, const QByteArray &data)
     }
 }
 
+bool Connection::sendEntries(int cmd, const UDSEntryList &entries)
+{
+    if (m_type == Type::Worker && !inited()) {
+        qCWarning(KIO_CORE) << "Connection::sendEntries() called with connection not inited";
+        return false;
+    }
+    if (!inited() || !d->outgoingTasks.isEmpty()) {
+        d->outgoingTasks.append(Task{.cmd = cmd, .entries = entries});
+        return true;
+    }
+
+    if (!isConnected()) {
+        qCWarning(KIO_CORE) << "Connection::sendEntries not connected";
+        return false;
+    }
+    return d->backend->sendEntries(cmd, entries);
+}
+
 bool Connection::sendnow(int cmd, const QByteArray &data)
 {
     if (!d->backend) {
@@ -233,6 +258,13 @@ int Connection::read(int *_cmd, QByteArray &data)
     // qDebug() << this << "Command" << task.cmd << "removed from the queue (size" << task.data.size() << ")";
     *_cmd = task.cmd;
     data = task.data;
+    if (task.entries.has_value()) {
+        // The caller only understands serialized payloads
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        for (const UDSEntry &entry : *task.entries) {
+            stream << entry;
+        }
+    }
 
     d->incomingTasks.removeFirst();
 
@@ -247,6 +279,24 @@ int Connection::read(int *_cmd, QByteArray &data)
     return data.size();
 }
 
+bool Connection::read(Task &task)
+{
+    if (d->incomingTasks.isEmpty()) {
+        return false;
+    }
+    task = d->incomingTasks.takeFirst();
+
+    // if we didn't empty our reading queue, emit again
+    if (!d->suspended && !d->incomingTasks.isEmpty() && d->readMode == Connection::ReadMode::EventDriven) {
+        auto dequeueFunc = [this]() {
+            d->dequeue();
+        };
+        QMetaObject::invokeMethod(this, dequeueFunc, Qt::QueuedConnection);
+    }
+
+    return true;
+}
+
 void Connection::setReadMode(ReadMode readMode)
 {
     d->readMode = readMode;
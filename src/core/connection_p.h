@@ -77,6 +77,13 @@ public:
      */
     bool send(int cmd, const QByteArray &arr = QByteArray());
 
+    /*!
+     * Sends/queues \a entries as the payload of \a cmd. Over a backend whose peer
+     * lives in the same process the list is handed over without being serialized.
+     * Returns true if successful, false otherwise
+     */
+    bool sendEntries(int cmd, const UDSEntryList &entries);
+
     /*!
      * Sends the given command immediately.
      * \a _cmd the command to set
@@ -111,6 +118,14 @@ public:
      */
     int read(int *_cmd, QByteArray &data);
 
+    /*!
+     * Receive the next task, including a typed payload the peer may have
+     * attached instead of serialized data (see sendEntries()).
+     *
+     * Returns false if there was no task to read.
+     */
+    bool read(Task &task);
+
     /*!
      * Don't handle incoming data until resumed.
      */
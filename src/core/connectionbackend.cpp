@@ -10,8 +10,22 @@
 
 #include "connectionbackend_p.h"
 
-// ConnectionBackend is an abstract base. This translation unit only exists to compile its
-// meta-object (signals). The concrete backends live in socketconnectionbackend.cpp and
-// threadconnectionbackend.cpp.
+#include <QDataStream>
+
+// ConnectionBackend is an abstract base. This translation unit compiles its meta-object (signals)
+// and the serializing fallback of sendEntries(). The concrete backends live in
+// socketconnectionbackend.cpp and threadconnectionbackend.cpp.
+
+using namespace KIO;
+
+bool ConnectionBackend::sendEntries(int command, const UDSEntryList &entries)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    for (const UDSEntry &entry : entries) {
+        stream << entry;
+    }
+    return sendCommand(command, data);
+}
 
 #include "moc_connectionbackend_p.cpp"
@@ -9,14 +9,21 @@
 #ifndef KIO_CONNECTIONBACKEND_P_H
 #define KIO_CONNECTIONBACKEND_P_H
 
+#include "udsentry.h"
+
 #include <QObject>
 #include <QUrl>
 
+#include <optional>
+
 namespace KIO
 {
 struct Task {
     int cmd = -1;
     QByteArray data{};
+    // Typed payload handed over as is, instead of being serialized into data. Only set
+    // by backends whose peer shares our address space, see ConnectionBackend::sendEntries().
+    std::optional<UDSEntryList> entries{};
 };
 
 /*!
@@ -52,6 +59,13 @@ public:
     virtual bool waitForIncomingTask(int ms) = 0;
     virtual bool sendCommand(int command, const QByteArray &data) = 0;
 
+    /*!
+     * Sends \a entries as the payload of \a command. The default implementation
+     * serializes them and calls sendCommand(); backends talking to a peer in the
+     * same process hand the (implicitly shared) list over without serializing it.
+     */
+    virtual bool sendEntries(int command, const UDSEntryList &entries);
+
 Q_SIGNALS:
     void disconnected();
     void commandReceived(const KIO::Task &task);
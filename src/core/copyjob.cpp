@@ -18,8 +18,10 @@
 #include "kfileitem.h"
 #include "kiocoredebug.h"
 #include "kioglobal_p.h"
+#include "kprotocolinfo.h"
 #include "listjob.h"
 #include "mkdirjob.h"
+#include "specialjob.h"
 #include "statjob.h"
 #include <cerrno>
 
@@ -57,7 +59,9 @@
 #include <KFileUtils>
 #include <KIO/FileSystemFreeSpaceJob>
 
+#include <climits>
 #include <list>
+#include <map>
 #include <optional>
 #include <set>
 
@@ -94,6 +98,8 @@ enum DestinationState {
  *         (on already exists, and user chooses rename, TODO: go to STATE_RENAMING again)
  *      STATE_STATING
  *         and then, if dir -> STATE_LISTING (filling 'd->dirs' and 'd->files')
+ *         or, for a local copy, STATE_COPYING_TREE (the file worker copies the whole dir,
+ *         'd->dirs' and 'd->files' only get what it couldn't copy)
  *     STATE_CREATING_DIRS (createNextDir, iterating over 'd->dirs')
  *          if conflict: STATE_CONFLICT_CREATING_DIRS
  *     STATE_COPYING_FILES (copyNextFile, iterating over 'd->files')
@@ -107,6 +113,7 @@ enum CopyJobState {
     STATE_STATING,
     STATE_RENAMING,
     STATE_LISTING,
+    STATE_COPYING_TREE,
     STATE_CREATING_DIRS,
     STATE_CONFLICT_CREATING_DIRS,
     STATE_COPYING_FILES,
@@ -231,6 +238,25 @@ struct CopyInfo {
     KIO::filesize_t size; // 0 for dirs
 };
 
+// Files are copied one after the other, unless a worker talking to a remote host
+// is involved: then each transfer mostly waits for the network, and as many of
+// them as that protocol allows workers per host run at the same time.
+static int maxParallelCopies(const CopyInfo &info)
+{
+    int limit = INT_MAX;
+    bool remote = false;
+    for (const QUrl *url : {&info.uSource, &info.uDest}) {
+        const QString protocol = url->scheme();
+        if (KProtocolInfo::protocolClass(protocol) != QLatin1String(":internet")) {
+            continue;
+        }
+        remote = true;
+        const int perHost = KProtocolInfo::maxWorkersPerHost(protocol);
+        limit = std::min(limit, perHost > 0 ? perHost : KProtocolInfo::maxWorkers(protocol));
+    }
+    return remote ? limit : 1;
+}
+
 class KIO::CopyJobPrivate : public KIO::JobPrivate
 {
 public:
@@ -299,6 +325,9 @@ public:
     int m_filesHandledByDirectRename;
     int m_processedFiles;
     int m_processedDirs;
+    // Copied by the file worker in STATE_COPYING_TREE, never part of 'files' and 'dirs'
+    int m_filesCopiedByWorker = 0;
+    int m_dirsCopiedByWorker = 0;
     QList<CopyInfo> files;
     QList<CopyInfo> dirs;
     // List of dirs that will be copied then deleted when CopyMode is Move
@@ -350,6 +379,18 @@ public:
     };
     QQueue<CopyProgressPoint> m_speedMeasurementPoints;
 
+    // Copies started by startParallelCopies(), running next to each other.
+    // Never used at the same time as a copy started by processCopyNextFile().
+    struct ParallelCopy {
+        CopyInfo info;
+        KIO::filesize_t processedSize = 0;
+    };
+    std::map<KJob *, ParallelCopy> m_parallelCopies;
+    // A parallel copy failed and was put back at the front of 'files': it is
+    // retried on its own once the others are done, so that the usual conflict
+    // and error handling applies to it
+    bool m_copyNextAlone = false;
+
     // The current src url being stat'ed or copied
     // During the stat phase, this is initially equal to *m_currentStatSrc but it can be resolved to a local file equivalent (#188903).
     QUrl m_currentSrcURL;
@@ -358,12 +399,27 @@ public:
     std::set<QString> m_parentDirs;
     bool m_ignoreSourcePermissions = false;
 
+    // The dir being copied in STATE_COPYING_TREE, and where its own CopyInfo is in 'dirs'
+    QUrl m_treeCopySrc;
+    QUrl m_treeCopyDest;
+    qsizetype m_treeCopyDirIndex = -1;
+    KIO::filesize_t m_treeCopyTotalSizeBefore = 0;
+    // Whether the worker created the destination dir, i.e. sent anything at all
+    bool m_treeCopyStarted = false;
+    // Paths of the dirs the worker left to us, their content still has to be listed
+    QStringList m_treeCopyUnlistedDirs;
+
     void statCurrentSrc();
     void statNextSrc();
 
     // Those aren't slots but submethods for slotResult.
     void slotResultStating(KJob *job);
     void startListing(const QUrl &src);
+    bool canCopyTreeInWorker(const QUrl &src);
+    void startTreeCopy(const QUrl &src);
+    void slotTreeCopyData(const QByteArray &data);
+    void slotResultCopyingTree(KJob *job);
+    void listNextUnlistedDir();
 
     void slotResultCreatingDirs(KJob *job);
     void slotResultConflictCreatingDirs(KJob *job);
@@ -380,6 +436,9 @@ public:
     // don't support symlinks, this method detects those conditions and tries to handle it
     bool handleMsdosFsQuirks(QList<CopyInfo>::Iterator it, KFileSystemType::Type fsType);
     void copyNextFile();
+    bool canCopyInParallel(const CopyInfo &info);
+    bool startParallelCopies();
+    void slotResultParallelCopy(KJob *job);
     // Filesystem type of m_globalDest, determined once and cached (see m_globalDestFsType). Returns
     // KFileSystemType::Unknown for a non-local destination.
     KFileSystemType::Type globalDestFsType()
@@ -719,7 +778,11 @@ void CopyJobPrivate::sourceStated(const UDSEntry &entry, const QUrl &sourceUrl)
             }
         }
 
-        startListing(srcurl);
+        if (canCopyTreeInWorker(srcurl)) {
+            startTreeCopy(srcurl);
+        } else {
+            startListing(srcurl);
+        }
     } else {
         qCDebug(KIO_COPYJOB_DEBUG) << "Source is a file (or a symlink), or we are linking -> no recursive listing";
 
@@ -780,7 +843,7 @@ void CopyJobPrivate::slotReport()
     case STATE_COPYING_FILES: {
         const bool bytesTotalUnknown = (m_totalSize == 0);
         const bool noByteProgress = ((m_processedSize + m_fileProcessedSize) == 0);
-        const int totalFiles = m_processedFiles + files.count() + m_filesHandledByDirectRename;
+        const int totalFiles = m_processedFiles + files.count() + int(m_parallelCopies.size()) + m_filesHandledByDirectRename;
         if ((bytesTotalUnknown || noByteProgress) && totalFiles > 0) {
             q->setProgressUnit(KJob::Files);
         } else {
@@ -826,8 +889,23 @@ void CopyJobPrivate::slotReport()
         }
         q->setProgressUnit(KJob::Bytes);
         q->setTotalAmount(KJob::Bytes, m_totalSize);
-        q->setTotalAmount(KJob::Files, files.count() + m_filesHandledByDirectRename);
-        q->setTotalAmount(KJob::Directories, dirs.count());
+        q->setTotalAmount(KJob::Files, files.count() + m_filesHandledByDirectRename + m_filesCopiedByWorker);
+        q->setTotalAmount(KJob::Directories, dirs.count() + m_dirsCopiedByWorker);
+        break;
+
+    case STATE_COPYING_TREE:
+        if (m_bURLDirty) {
+            m_bURLDirty = false;
+            emitCopying(q, m_currentSrcURL, m_currentDestURL);
+            Q_EMIT q->copying(q, m_currentSrcURL, m_currentDestURL);
+        }
+        q->setProgressUnit(KJob::Bytes);
+        q->setTotalAmount(KJob::Bytes, m_totalSize);
+        q->setProcessedAmount(KJob::Bytes, m_processedSize + m_fileProcessedSize);
+        q->setTotalAmount(KJob::Files, files.count() + m_filesHandledByDirectRename + m_filesCopiedByWorker);
+        q->setProcessedAmount(KJob::Files, m_processedFiles);
+        q->setTotalAmount(KJob::Directories, dirs.count() + m_dirsCopiedByWorker);
+        q->setProcessedAmount(KJob::Directories, m_processedDirs);
         break;
 
     default:
@@ -1181,6 +1259,201 @@ void CopyJobPrivate::startListing(const QUrl &src)
     q->addSubjob(newjob);
 }
 
+bool CopyJobPrivate::canCopyTreeInWorker(const QUrl &src)
+{
+    // Moves are renames, or copies followed by deletions that need to know what was copied.
+    // Names that are fine here may be invalid on the destination, which is for createNextDir()
+    // and copyNextFile() to sort out with the user.
+    return m_mode == CopyJob::Copy //
+        && src.isLocalFile() //
+        && m_currentDest.isLocalFile() //
+        && !destDisallowsMsdosChars(m_currentDest, globalDestFsType());
+}
+
+void CopyJobPrivate::startTreeCopy(const QUrl &src)
+{
+    Q_Q(CopyJob);
+    state = STATE_COPYING_TREE;
+    m_treeCopySrc = src;
+    m_treeCopyDest = m_currentDest;
+    // sourceStated() just added the dir itself
+    m_treeCopyDirIndex = dirs.size() - 1;
+    m_treeCopyTotalSizeBefore = m_totalSize;
+    m_treeCopyStarted = false;
+    m_treeCopyUnlistedDirs.clear();
+    m_currentSrcURL = src;
+    m_currentDestURL = m_currentDest;
+    m_bURLDirty = true;
+
+    const bool keepPermissions = !m_defaultPermissions && !m_ignoreSourcePermissions;
+    QByteArray packedArgs;
+    QDataStream stream(&packedArgs, QIODevice::WriteOnly);
+    stream << int(4) << src << m_currentDest << keepPermissions;
+
+    SpecialJob *newjob = new SpecialJob(src, packedArgs);
+    newjob->setParentJob(q);
+    q->connect(newjob, &TransferJob::data, q, [this](KIO::Job *, const QByteArray &data) {
+        slotTreeCopyData(data);
+    });
+    // speed is computed locally
+    QObject::disconnect(newjob, &KJob::speed, q, nullptr);
+    q->connect(newjob, &Job::processedSize, q, [this](KJob *job, qulonglong processedSize) {
+        slotProcessedSize(job, processedSize);
+    });
+    q->connect(newjob, &Job::totalSize, q, [this](KJob *, qulonglong totalSize) {
+        m_totalSize = std::max(m_totalSize, m_treeCopyTotalSizeBefore + totalSize);
+    });
+    q->addSubjob(newjob);
+}
+
+void CopyJobPrivate::slotTreeCopyData(const QByteArray &data)
+{
+    Q_Q(CopyJob);
+    if (data.isEmpty()) {
+        return;
+    }
+    m_treeCopyStarted = true;
+
+    const auto urlFor = [](const QUrl &base, const QString &path) {
+        return path.isEmpty() ? base : addPathToUrl(base, path);
+    };
+
+    // The records of the file worker's TreeCopier
+    enum Record : quint8 {
+        CopiedDir,
+        CopiedFile,
+        CopiedLink,
+        NotCopied,
+        NotListed,
+        DirTimeNotSet,
+    };
+    QDataStream stream(data);
+    while (!stream.atEnd()) {
+        quint8 record;
+        QString path;
+        stream >> record;
+        switch (record) {
+        case CopiedDir:
+        case CopiedFile: {
+            qint64 mtime;
+            stream >> path >> mtime;
+            const bool isDir = record == CopiedDir;
+            // required for the undo feature
+            Q_EMIT q->copyingDone(q,
+                                  urlFor(m_treeCopySrc, path),
+                                  urlFor(m_treeCopyDest, path),
+                                  QDateTime::fromMSecsSinceEpoch(mtime, QTimeZone::UTC),
+                                  isDir,
+                                  false);
+            if (isDir) {
+                ++m_dirsCopiedByWorker;
+                ++m_processedDirs;
+            } else {
+                ++m_filesCopiedByWorker;
+                ++m_processedFiles;
+            }
+            break;
+        }
+        case CopiedLink: {
+            QString target;
+            stream >> path >> target;
+            Q_EMIT q->copyingLinkDone(q, urlFor(m_treeCopySrc, path), target, urlFor(m_treeCopyDest, path));
+            ++m_filesCopiedByWorker;
+            ++m_processedFiles;
+            break;
+        }
+        case NotCopied: {
+            // Copied like what a listing finds, with the usual error handling
+            UDSEntry entry;
+            stream >> entry;
+            addCopyInfoFromUDSEntry(entry, m_treeCopySrc, true, m_treeCopyDest);
+            if (entry.isDir()) {
+                m_treeCopyUnlistedDirs.append(entry.stringValue(KIO::UDSEntry::UDS_NAME));
+            }
+            break;
+        }
+        case NotListed: {
+            stream >> path;
+            const QUrl url = urlFor(m_treeCopySrc, path);
+            qCWarning(KIO_CORE) << url << "could not be listed";
+            Q_EMIT q->warning(q, buildErrorString(ERR_CANNOT_ENTER_DIRECTORY, url.toDisplayString(QUrl::PreferLocalFile)));
+            break;
+        }
+        case DirTimeNotSet: {
+            qint64 mtime;
+            stream >> path >> mtime;
+            CopyInfo info;
+            info.uSource = urlFor(m_treeCopySrc, path);
+            info.uDest = urlFor(m_treeCopyDest, path);
+            info.mtime = QDateTime::fromMSecsSinceEpoch(mtime, QTimeZone::UTC);
+            m_directoriesCopied.push_back(info);
+            break;
+        }
+        default:
+            qCWarning(KIO_CORE) << "Unknown record from the tree copy:" << record;
+            return;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(KIO_CORE) << "Truncated record from the tree copy";
+            return;
+        }
+    }
+}
+
+void CopyJobPrivate::slotResultCopyingTree(KJob *job)
+{
+    Q_Q(CopyJob);
+    if (!m_treeCopyStarted) {
+        // The destination exists already, or couldn't be created, or the worker doesn't know
+        // how to copy a tree: nothing was done, go the usual way
+        q->removeSubjob(job);
+        startListing(m_treeCopySrc);
+        return;
+    }
+    if (job->error()) {
+        q->Job::slotResult(job); // will set the error and emit result(this)
+        return;
+    }
+    q->removeSubjob(job);
+    Q_ASSERT(!q->hasSubjobs());
+
+    m_processedSize += m_fileProcessedSize;
+    m_fileProcessedSize = 0;
+    // The worker created the dir, createNextDir() must not try again
+    dirs.removeAt(m_treeCopyDirIndex);
+    m_treeCopyDirIndex = -1;
+    q->setTotalAmount(KJob::Files, files.count() + m_filesHandledByDirectRename + m_filesCopiedByWorker);
+    q->setTotalAmount(KJob::Directories, dirs.count() + m_dirsCopiedByWorker);
+
+    listNextUnlistedDir();
+}
+
+void CopyJobPrivate::listNextUnlistedDir()
+{
+    Q_Q(CopyJob);
+    if (m_treeCopyUnlistedDirs.isEmpty()) {
+        statNextSrc();
+        return;
+    }
+    // The dir itself is in 'dirs' already, what is in it gets copied like what a listing finds
+    const QString path = m_treeCopyUnlistedDirs.takeFirst();
+    const QUrl src = addPathToUrl(m_treeCopySrc, path);
+    const QUrl dest = addPathToUrl(m_treeCopyDest, path);
+    state = STATE_LISTING;
+    m_bURLDirty = true;
+    ListJob *newjob = listRecursive(src, KIO::HideProgressInfo);
+    newjob->setUnrestricted(true);
+    q->connect(newjob, &ListJob::entries, q, [this, src, dest](KIO::Job *, const KIO::UDSEntryList &list) {
+        for (const UDSEntry &entry : list) {
+            addCopyInfoFromUDSEntry(entry, src, true, dest);
+        }
+    });
+    q->connect(newjob, &ListJob::subError, q, [this](KIO::ListJob *job, KIO::ListJob *subJob) {
+        slotSubError(job, subJob);
+    });
+    q->addSubjob(newjob);
+}
+
 void CopyJobPrivate::skip(const QUrl &sourceUrl, bool isDir)
 {
     QUrl dir(sourceUrl);
@@ -1586,6 +1859,11 @@ void CopyJobPrivate::processCreateNextDir(const QList<CopyInfo>::Iterator &it, i
 void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
 {
     Q_Q(CopyJob);
+    if (m_parallelCopies.count(job)) {
+        slotResultParallelCopy(job);
+        return;
+    }
+
     // The file we were trying to copy:
     QList<CopyInfo>::Iterator it = files.begin();
     if (job->error()) {
@@ -2013,12 +2291,133 @@ bool CopyJobPrivate::handleMsdosFsQuirks(QList<CopyInfo>::Iterator it, KFileSyst
     return false; // Not handled, move on
 }
 
+bool CopyJobPrivate::canCopyInParallel(const CopyInfo &info)
+{
+    if (m_mode == CopyJob::Link || m_bSingleFileCopy || !info.linkDest.isEmpty() || info.uSource == info.uDest) {
+        return false;
+    }
+    if (maxParallelCopies(info) < 2) {
+        return false;
+    }
+    // Leave the files that might need an error or a question to copyNextFile()
+    if (info.uDest.isLocalFile() && info.size > 0xFFFFFFFF) {
+        return false;
+    }
+    if (hasInvalidChars(info.uDest.fileName()) && destDisallowsMsdosChars(m_globalDest, globalDestFsType())) {
+        return false;
+    }
+    if (m_freeSpace != KIO::invalidFilesize && info.size != KIO::invalidFilesize) {
+        KIO::filesize_t needed = info.size;
+        for (const auto &[job, copy] : m_parallelCopies) {
+            if (copy.info.size != KIO::invalidFilesize) {
+                needed += copy.info.size;
+            }
+        }
+        if (m_freeSpace < needed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CopyJobPrivate::startParallelCopies()
+{
+    Q_Q(CopyJob);
+    while (!files.isEmpty() && !m_copyNextAlone) {
+        const CopyInfo &info = files.constFirst();
+        if (shouldSkip(info.uDest.path())) {
+            files.removeFirst();
+            continue;
+        }
+        if (!canCopyInParallel(info)) {
+            break;
+        }
+        if (int(m_parallelCopies.size()) >= maxParallelCopies(info)) {
+            return true; // wait for one of the running copies to finish
+        }
+
+        const CopyInfo copy = files.takeFirst();
+        int permissions = copy.permissions;
+        if (m_defaultPermissions || (m_ignoreSourcePermissions && copy.uDest.isLocalFile())) {
+            permissions = -1;
+        }
+        const JobFlags flags = shouldOverwriteFile(copy.uDest.path()) ? Overwrite : DefaultFlags;
+
+        KIO::FileCopyJob *copyJob = m_mode == CopyJob::Move ? KIO::file_move(copy.uSource, copy.uDest, permissions, flags | HideProgressInfo /*no GUI*/)
+                                                             : KIO::file_copy(copy.uSource, copy.uDest, permissions, flags | HideProgressInfo /*no GUI*/);
+        copyJob->setParentJob(q);
+        copyJob->setSourceSize(copy.size);
+        copyJob->setModificationTime(copy.mtime);
+        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << copy.uSource << "to" << copy.uDest << "next to" << m_parallelCopies.size() << "other files";
+        m_currentSrcURL = copy.uSource;
+        m_currentDestURL = copy.uDest;
+        m_bURLDirty = true;
+        m_parallelCopies.emplace(copyJob, ParallelCopy{copy, 0});
+
+        // speed is computed locally
+        QObject::disconnect(copyJob, &KJob::speed, q, nullptr);
+        q->addSubjob(copyJob);
+        q->connect(copyJob, &Job::processedSize, q, [this](KJob *job, qulonglong processedSize) {
+            slotProcessedSize(job, processedSize);
+        });
+    }
+    // Whatever comes next is handled on its own, once the running copies are done
+    return !m_parallelCopies.empty();
+}
+
+void CopyJobPrivate::slotResultParallelCopy(KJob *job)
+{
+    Q_Q(CopyJob);
+    auto node = m_parallelCopies.extract(job);
+    const ParallelCopy &copy = node.mapped();
+    m_fileProcessedSize -= copy.processedSize;
+
+    if (job->error()) {
+        if (m_bAutoSkipFiles) {
+            skip(copy.info.uSource, false);
+            m_processedSize += copy.info.size;
+        } else {
+            // Do it again alone, the regular code takes care of the conflict dialogs
+            qCDebug(KIO_COPYJOB_DEBUG) << "Retrying" << copy.info.uSource << "after error" << job->error();
+            files.prepend(copy.info);
+            m_copyNextAlone = true;
+        }
+    } else {
+        const QUrl finalUrl = finalDestUrl(copy.info.uSource, copy.info.uDest);
+        // required for the undo feature
+        Q_EMIT q->copyingDone(q, copy.info.uSource, finalUrl, copy.info.mtime, false, false);
+        if (m_mode == CopyJob::Move) {
+#ifdef WITH_QTDBUS
+            org::kde::KDirNotify::emitFileMoved(copy.info.uSource, finalUrl);
+#endif
+        }
+        m_successSrcList.append(copy.info.uSource);
+        if (m_freeSpace != KIO::invalidFilesize && copy.info.size != KIO::invalidFilesize) {
+            m_freeSpace -= copy.info.size;
+        }
+        ++m_processedFiles;
+        m_processedSize += copy.processedSize;
+    }
+
+    KIO::Job *kiojob = qobject_cast<KIO::Job *>(job);
+    Q_ASSERT(kiojob);
+    m_incomingMetaData += kiojob->metaData();
+    q->removeSubjob(job);
+    copyNextFile();
+}
+
 void CopyJobPrivate::copyNextFile()
 {
     Q_Q(CopyJob);
     bool bCopyFile = false;
     qCDebug(KIO_COPYJOB_DEBUG);
 
+    if (startParallelCopies()) {
+        return;
+    }
+    // The first file, if any, is copied alone
+    m_copyNextAlone = false;
+
     bool isDestLocal = m_globalDest.isLocalFile();
 
     // Take the first file in the list
@@ -2274,11 +2673,17 @@ void CopyJob::emitResult()
     Job::emitResult();
 }
 
-void CopyJobPrivate::slotProcessedSize(KJob *, qulonglong data_size)
+void CopyJobPrivate::slotProcessedSize(KJob *job, qulonglong data_size)
 {
     Q_Q(CopyJob);
     qCDebug(KIO_COPYJOB_DEBUG) << data_size;
-    m_fileProcessedSize = data_size;
+    if (auto it = m_parallelCopies.find(job); it != m_parallelCopies.end()) {
+        // m_fileProcessedSize sums up all the running copies
+        m_fileProcessedSize += data_size - it->second.processedSize;
+        it->second.processedSize = data_size;
+    } else {
+        m_fileProcessedSize = data_size;
+    }
 
     if (m_processedSize + m_fileProcessedSize > m_totalSize) {
         // Example: download any attachment from bugs.kde.org
@@ -2648,7 +3053,11 @@ void CopyJob::slotResult(KJob *job)
         removeSubjob(job);
         Q_ASSERT(!hasSubjobs());
 
-        d->statNextSrc();
+        // Goes on with statNextSrc() once the dirs left by a tree copy are listed too
+        d->listNextUnlistedDir();
+        break;
+    case STATE_COPYING_TREE:
+        d->slotResultCopyingTree(job);
         break;
     case STATE_CREATING_DIRS:
         d->slotResultCreatingDirs(job);
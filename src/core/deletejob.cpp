@@ -15,6 +15,9 @@
 #include "kprotocolmanager.h"
 #include "listjob.h"
 #include "statjob.h"
+#ifdef Q_OS_UNIX
+#include "localtreeremover_p.h"
+#endif
 #include <KDirWatch>
 #include <kdirnotify.h>
 
@@ -31,8 +34,20 @@
 
 #include "job_p.h"
 
+#include <algorithm>
+#include <atomic>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 extern bool kio_resolve_local_urls; // from copyjob.cpp, abused here to save a symbol.
 
+// How many local files are handed to the IO thread at once. It stops at the first one it can't
+// remove, so an error is still reported for that very file.
+static constexpr int s_localFilesBatchSize = 256;
+
 static bool isHttpProtocol(const QString &protocol)
 {
     return (protocol.startsWith(QLatin1String("webdav"), Qt::CaseInsensitive) || protocol.startsWith(QLatin1String("http"), Qt::CaseInsensitive));
@@ -51,28 +66,87 @@ class DeleteJobIOWorker : public QObject
     Q_OBJECT
 
 Q_SIGNALS:
-    void rmfileResult(bool succeeded, bool isLink);
-    void rmddirResult(bool succeeded);
+    void rmfilesResult(int removed, bool complete, bool isLink);
+    void rmddirResult(bool succeeded, qulonglong removedSize);
+
+public:
+    // Stops what is being removed at the next entry, from any thread
+    void cancel()
+    {
+        m_cancelled = true;
+    }
+
+    // Bytes removed so far by the running rmdir(), from any thread
+    KIO::filesize_t removedSize() const
+    {
+        return m_removedSize.load(std::memory_order_relaxed);
+    }
 
 public Q_SLOTS:
 
     /*
-     * Deletes the file url points to
-     * The file must be a LocalFile
+     * Deletes the files urls point to, in order, stopping at the first one that can't be.
+     * The files must be LocalFiles
      */
-    void rmfile(const QUrl &url, bool isLink)
+    void rmfiles(const QList<QUrl> &urls, bool isLink)
     {
-        Q_EMIT rmfileResult(QFile::remove(url.toLocalFile()), isLink);
+        int removed = 0;
+#ifdef Q_OS_UNIX
+        // They usually all are in the same directory, remove them relative to it
+        QString dirPath;
+        int dirfd = -1;
+        for (const QUrl &url : urls) {
+            if (m_cancelled) {
+                break;
+            }
+            const QString parentPath = url.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash).toLocalFile();
+            if (dirfd < 0 || parentPath != dirPath) {
+                if (dirfd >= 0) {
+                    ::close(dirfd);
+                }
+                dirPath = parentPath;
+                dirfd = ::open(QFile::encodeName(dirPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            }
+            const int ret = dirfd >= 0 ? ::unlinkat(dirfd, QFile::encodeName(url.fileName()).constData(), 0)
+                                       : ::unlink(QFile::encodeName(url.toLocalFile()).constData());
+            if (ret != 0) {
+                break;
+            }
+            ++removed;
+        }
+        if (dirfd >= 0) {
+            ::close(dirfd);
+        }
+#else
+        for (const QUrl &url : urls) {
+            if (m_cancelled || !QFile::remove(url.toLocalFile())) {
+                break;
+            }
+            ++removed;
+        }
+#endif
+        Q_EMIT rmfilesResult(removed, removed == urls.size(), isLink);
     }
 
     /*
-     * Deletes the directory url points to
+     * Deletes the directory url points to, and what is in it
      * The directory must be a LocalFile
      */
     void rmdir(const QUrl &url)
     {
-        Q_EMIT rmddirResult(QDir().rmdir(url.toLocalFile()));
+        m_removedSize = 0;
+#ifdef Q_OS_UNIX
+        LocalTreeRemover remover(m_cancelled, m_removedSize, std::min(QThread::idealThreadCount(), 4));
+        const bool succeeded = remover.remove(url.adjusted(QUrl::StripTrailingSlash).toLocalFile()) == 0;
+#else
+        const bool succeeded = QDir().rmdir(url.toLocalFile());
+#endif
+        Q_EMIT rmddirResult(succeeded, m_removedSize.load());
     }
+
+private:
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<KIO::filesize_t> m_removedSize{0};
 };
 
 class DeleteJobPrivate : public KIO::JobPrivate
@@ -106,6 +180,8 @@ public:
     QTimer *m_reportTimer;
     DeleteJobIOWorker *m_ioworker = nullptr;
     QThread *m_thread = nullptr;
+    // Whether the IO thread is emptying a directory, whose progress slotReport() picks up
+    bool m_removingLocalDir = false;
 
     void statNextSrc();
     DeleteJobIOWorker *worker();
@@ -119,10 +195,10 @@ public:
     void slotStart();
     void slotEntries(KIO::Job *, const KIO::UDSEntryList &list);
 
-    /// Callback of worker rmfile
-    void rmFileResult(bool result, bool isLink);
+    /// Callback of worker rmfiles
+    void rmFilesResult(int removed, bool complete, bool isLink);
     /// Callback of worker rmdir
-    void rmdirResult(bool result);
+    void rmdirResult(bool result, KIO::filesize_t removedSize);
     void deleteFileUsingJob(const QUrl &url, bool isLink);
     void deleteDirUsingJob(const QUrl &url);
 
@@ -169,6 +245,7 @@ DeleteJob::~DeleteJob()
 DeleteJobPrivate::~DeleteJobPrivate()
 {
     if (m_thread) {
+        m_ioworker->cancel();
         m_thread->quit();
         m_thread->wait();
         delete m_thread;
@@ -195,11 +272,11 @@ DeleteJobIOWorker *DeleteJobPrivate::worker()
         m_ioworker = new DeleteJobIOWorker;
         m_ioworker->moveToThread(m_thread);
         QObject::connect(m_thread, &QThread::finished, m_ioworker, &QObject::deleteLater);
-        QObject::connect(m_ioworker, &DeleteJobIOWorker::rmfileResult, q, [=, this](bool result, bool isLink) {
-            this->rmFileResult(result, isLink);
+        QObject::connect(m_ioworker, &DeleteJobIOWorker::rmfilesResult, q, [=, this](int removed, bool complete, bool isLink) {
+            this->rmFilesResult(removed, complete, isLink);
         });
-        QObject::connect(m_ioworker, &DeleteJobIOWorker::rmddirResult, q, [=, this](bool result) {
-            this->rmdirResult(result);
+        QObject::connect(m_ioworker, &DeleteJobIOWorker::rmddirResult, q, [=, this](bool result, qulonglong removedSize) {
+            this->rmdirResult(result, removedSize);
         });
         m_thread->start();
     }
@@ -223,6 +300,9 @@ void DeleteJobPrivate::slotReport()
     case DELETEJOB_STATE_DELETING_DIRS:
         q->setProcessedAmount(KJob::Directories, m_processedDirs);
         q->emitPercent(m_processedFiles + m_processedDirs, m_totalFilesDirs);
+        if (m_removingLocalDir) {
+            q->setProcessedAmount(KJob::Bytes, m_processedBytes + m_ioworker->removedSize());
+        }
         break;
     case DELETEJOB_STATE_DELETING_FILES:
         q->setProcessedAmount(KJob::Files, m_processedFiles);
@@ -335,21 +415,18 @@ void DeleteJobPrivate::finishedStatPhase()
     deleteNextFile();
 }
 
-void DeleteJobPrivate::rmFileResult(bool result, bool isLink)
+void DeleteJobPrivate::rmFilesResult(int removed, bool complete, bool isLink)
 {
-    if (result) {
-        m_processedFiles++;
-        m_deletedUrls.append(m_currentURL);
-
-        if (isLink) {
-            symlinks.removeFirst();
-        } else {
-            files.removeFirst();
-        }
+    QList<QUrl> &list = isLink ? symlinks : files;
+    m_processedFiles += removed;
+    m_deletedUrls.append(list.mid(0, removed));
+    list.remove(0, removed);
 
+    if (complete) {
         deleteNextFile();
     } else {
-        // fallback if QFile::remove() failed (we'll use the job's error handling in that case)
+        // fallback for the file that couldn't be removed (we'll use the job's error handling in that case)
+        m_currentURL = list.first();
         deleteFileUsingJob(m_currentURL, isLink);
     }
 }
@@ -380,7 +457,7 @@ void DeleteJobPrivate::deleteNextFile()
     // qDebug();
 
     // if there is something else to delete
-    // the loop is run using callbacks slotResult and rmFileResult
+    // the loop is run using callbacks slotResult and rmFilesResult
     if (!files.isEmpty() || !symlinks.isEmpty()) {
         // Take first file to delete out of list
         QList<QUrl>::iterator it = files.begin();
@@ -392,12 +469,20 @@ void DeleteJobPrivate::deleteNextFile()
 
         // If local file, try do it directly
         if (m_currentURL.isLocalFile()) {
-            // separate thread will do the work
+            // separate thread will do the work, for the local files that follow too
+            const QList<QUrl> &list = isLink ? symlinks : files;
+            QList<QUrl> batch;
+            for (const QUrl &url : list) {
+                if (!url.isLocalFile() || batch.size() == s_localFilesBatchSize) {
+                    break;
+                }
+                batch.append(url);
+            }
             DeleteJobIOWorker *w = worker();
-            auto rmfileFunc = [this, w, isLink]() {
-                w->rmfile(m_currentURL, isLink);
+            auto rmfilesFunc = [w, batch, isLink]() {
+                w->rmfiles(batch, isLink);
             };
-            QMetaObject::invokeMethod(w, rmfileFunc, Qt::QueuedConnection);
+            QMetaObject::invokeMethod(w, rmfilesFunc, Qt::QueuedConnection);
         } else {
             // if remote, use a job
             deleteFileUsingJob(m_currentURL, isLink);
@@ -409,8 +494,12 @@ void DeleteJobPrivate::deleteNextFile()
     deleteNextDir();
 }
 
-void DeleteJobPrivate::rmdirResult(bool result)
+void DeleteJobPrivate::rmdirResult(bool result, KIO::filesize_t removedSize)
 {
+    Q_Q(DeleteJob);
+    m_removingLocalDir = false;
+    m_processedBytes += removedSize;
+    q->setProcessedAmount(KJob::Bytes, m_processedBytes);
     if (result) {
         m_processedDirs++;
         m_deletedUrls.append(m_currentURL);
@@ -452,9 +541,10 @@ void DeleteJobPrivate::deleteNextDir()
         // Take first dir to delete out of list - last ones first !
         QList<QUrl>::iterator it = --dirs.end();
         m_currentURL = (*it);
-        // If local dir, try to rmdir it directly
+        // If local dir, try to remove it directly
         if (m_currentURL.isLocalFile()) {
-            // delete it on separate worker thread
+            // delete it, and what is in it, on separate worker thread
+            m_removingLocalDir = true;
             DeleteJobIOWorker *w = worker();
             auto rmdirFunc = [this, w]() {
                 w->rmdir(m_currentURL);
@@ -8,6 +8,8 @@
 #include "directorysizejob.h"
 #include "global.h"
 #include "listjob.h"
+#include "specialjob.h"
+#include <QDataStream>
 #include <QDebug>
 #include <QTimer>
 #include <kio/jobuidelegatefactory.h>
@@ -43,8 +45,20 @@ public:
     int m_currentItem;
     QHash<long, std::set<long>> m_visitedInodes; // device -> set of inodes
 
+    // Local directories are added up by the file worker ("du" special command), which only sends
+    // the running totals of the directory it walks. These are the totals from before it started.
+    KIO::SpecialJob *m_diskUsageJob = nullptr;
+    QUrl m_diskUsageUrl;
+    bool m_diskUsageReceived = false;
+    bool m_diskUsageUnsupported = false;
+    KIO::filesize_t m_sizeBefore = 0;
+    KIO::filesize_t m_filesBefore = 0;
+    KIO::filesize_t m_subdirsBefore = 0;
+
     void startNextJob(const QUrl &url);
+    void startDiskUsageJob(const QUrl &url);
     void slotEntries(KIO::Job *, const KIO::UDSEntryList &);
+    void slotDiskUsage(const QByteArray &data);
     void processNextItem();
 
     Q_DECLARE_PUBLIC(DirectorySizeJob)
@@ -131,6 +145,10 @@ void DirectorySizeJobPrivate::startNextJob(const QUrl &url)
 {
     Q_Q(DirectorySizeJob);
     // qDebug() << url;
+    if (url.isLocalFile() && !m_diskUsageUnsupported) {
+        startDiskUsageJob(url);
+        return;
+    }
     KIO::ListJob *listJob = KIO::listRecursive(url, KIO::HideProgressInfo);
     listJob->setDetails(KIO::StatBasic | KIO::StatResolveSymlink | KIO::StatInode);
     q->connect(listJob, &KIO::ListJob::entries, q, [this](KIO::Job *job, const KIO::UDSEntryList &list) {
@@ -139,6 +157,41 @@ void DirectorySizeJobPrivate::startNextJob(const QUrl &url)
     q->addSubjob(listJob);
 }
 
+void DirectorySizeJobPrivate::startDiskUsageJob(const QUrl &url)
+{
+    Q_Q(DirectorySizeJob);
+    QByteArray packedArgs;
+    QDataStream stream(&packedArgs, QIODevice::WriteOnly);
+    stream << int(3) << url;
+
+    m_diskUsageJob = new KIO::SpecialJob(url, packedArgs);
+    m_diskUsageUrl = url;
+    m_diskUsageReceived = false;
+    m_sizeBefore = m_totalSize;
+    m_filesBefore = m_totalFiles;
+    m_subdirsBefore = m_totalSubdirs;
+    q->connect(m_diskUsageJob, &KIO::TransferJob::data, q, [this](KIO::Job *, const QByteArray &data) {
+        slotDiskUsage(data);
+    });
+    q->addSubjob(m_diskUsageJob);
+}
+
+void DirectorySizeJobPrivate::slotDiskUsage(const QByteArray &data)
+{
+    QDataStream stream(data);
+    quint64 size;
+    quint64 files;
+    quint64 subdirs;
+    stream >> size >> files >> subdirs;
+    if (stream.status() != QDataStream::Ok) {
+        return;
+    }
+    m_diskUsageReceived = true;
+    m_totalSize = m_sizeBefore + size;
+    m_totalFiles = m_filesBefore + files;
+    m_totalSubdirs = m_subdirsBefore + subdirs;
+}
+
 void DirectorySizeJobPrivate::slotEntries(KIO::Job *, const KIO::UDSEntryList &list)
 {
     KIO::UDSEntryList::ConstIterator it = list.begin();
@@ -180,6 +233,15 @@ void DirectorySizeJob::slotResult(KJob *job)
     Q_D(DirectorySizeJob);
     // qDebug() << d->m_totalSize;
     removeSubjob(job);
+    if (job == d->m_diskUsageJob) {
+        d->m_diskUsageJob = nullptr;
+        // A worker that doesn't know the command does nothing, list the directory instead
+        if ((!job->error() && !d->m_diskUsageReceived) || job->error() == KIO::ERR_UNSUPPORTED_ACTION) {
+            d->m_diskUsageUnsupported = true;
+            d->startNextJob(d->m_diskUsageUrl);
+            return;
+        }
+    }
     if (d->m_currentItem < d->m_lstItems.count()) {
         d->processNextItem();
     } else {
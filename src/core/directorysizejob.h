@@ -25,6 +25,9 @@ class DirectorySizeJobPrivate;
  * Similar to "du", but doesn't give the same results
  * since we simply sum up the dir and file sizes, whereas du speaks disk blocks.
  *
+ * Local directories are walked by the file worker itself, which only sends back
+ * the totals; other directories are listed recursively.
+ *
  * \sa KIO::directorySize.
  */
 class KIOCORE_EXPORT DirectorySizeJob : public KIO::Job
@@ -339,7 +339,11 @@ void ForwardingWorkerBasePrivate::connectJob(KIO::Job *job)
     job->setUiDelegate(nullptr);
 
     // Forward metadata (e.g. modification time for put())
-    job->setMetaData(q->allMetaData());
+    MetaData metaData = q->allMetaData();
+    // The "listRecursive" answer of the worker behind the inner job is not passed
+    // back, so the outer ListJob recurses on its own; the inner one must not.
+    metaData.remove(QStringLiteral("listRecursive"));
+    job->setMetaData(metaData);
 
     q->connect(job, &KJob::result, q, [this](KJob *job) {
         _k_slotResult(job);
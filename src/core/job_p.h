@@ -139,6 +139,8 @@ public:
     // Worker::setProtocol().
     QString m_protocol;
     int m_schedSerial;
+    // When the job was queued, on the clock of its ProtoQueue
+    qint64 m_schedQueuedAt = 0;
     bool m_redirectionHandlingEnabled;
 
     void simpleJobInit();
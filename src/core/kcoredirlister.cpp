@@ -11,6 +11,7 @@
 
 #include "kcoredirlister.h"
 #include "kcoredirlister_p.h"
+#include "kcoredirlistersnapshots_p.h"
 
 #include "../utils_p.h"
 #include "kiocoredebug.h"
@@ -25,9 +26,15 @@
 #include <QMimeDatabase>
 #include <QRegularExpression>
 #include <QSet>
+#include <QStandardPaths>
 #include <QTextStream>
 #include <QThreadStorage>
 
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <qplatformdefs.h>
+#endif
+
 #include <QLoggingCategory>
 Q_DECLARE_LOGGING_CATEGORY(KIO_CORE_DIRLISTER)
 Q_LOGGING_CATEGORY(KIO_CORE_DIRLISTER, "kf.kio.core.dirlister", QtWarningMsg)
@@ -51,6 +58,89 @@ static constexpr std::chrono::minutes s_cachedDirectoryLifetime{3};
 // Keep the last few directories' ".hidden" files around, so revisiting one does not re-read it.
 static constexpr int s_maxCachedDotHiddenFiles = 10;
 
+// Past this many changed names in one go, like after an overflow of the watcher's event queue,
+// listing the whole directory again is cheaper than stat'ing them one by one
+static constexpr int s_maxIncrementalChanges = 256;
+
+// Local directories are listed with the inodes, so that an update can tell a file that was replaced
+// by another of the same name from the directory entries alone
+static KIO::StatDetails listingDetails(const QUrl &url, bool requestMimeType)
+{
+    KIO::StatDetails details = KIO::StatDefaultDetails;
+    if (requestMimeType) {
+        details |= KIO::StatMimeType;
+    }
+    if (url.isLocalFile()) {
+        details |= KIO::StatInode;
+    }
+    return details;
+}
+
+// The names in the local directory path, and their inodes, as read from the directory itself
+static bool readDirectoryEntries(const QString &path, QHash<QString, quint64> &entries)
+{
+#ifdef Q_OS_UNIX
+    DIR *dir = ::opendir(QFile::encodeName(path).constData());
+    if (!dir) {
+        return false;
+    }
+    while (const struct dirent *entry = ::readdir(dir)) {
+        const QByteArrayView name(entry->d_name);
+        if (name != "." && name != "..") {
+            entries.insert(QFile::decodeName(entry->d_name), entry->d_ino);
+        }
+    }
+    ::closedir(dir);
+    return true;
+#else
+    Q_UNUSED(path)
+    Q_UNUSED(entries)
+    return false;
+#endif
+}
+
+// The inode of the local file path as lstat reports it, like the listing did. For mount points and on
+// overlay filesystems, readdir reports another one.
+static quint64 statInode(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    QT_STATBUF buff;
+    if (QT_LSTAT(QFile::encodeName(path).constData(), &buff) == 0) {
+        return buff.st_ino;
+    }
+#else
+    Q_UNUSED(path)
+#endif
+    return 0;
+}
+
+// Whether the symlink at path no longer is the one of item: it points elsewhere, or its target was
+// replaced. Listings give symlinks the inode of their target, or their own when it is broken.
+static bool symlinkChanged(const QString &path, const KFileItem &item, quint64 inode)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray encodedPath = QFile::encodeName(path);
+    QT_STATBUF buff;
+    if (QT_LSTAT(encodedPath.constData(), &buff) != 0 || !S_ISLNK(buff.st_mode)) {
+        return true;
+    }
+    QByteArray target(buff.st_size + 1, Qt::Uninitialized);
+    const ssize_t length = ::readlink(encodedPath.constData(), target.data(), target.size());
+    if (length < 0 || length == target.size() || QByteArrayView(target.constData(), length) != QFile::encodeName(item.linkDest())) {
+        return true;
+    }
+    if (QT_STAT(encodedPath.constData(), &buff) != 0 && QT_LSTAT(encodedPath.constData(), &buff) != 0) {
+        return true;
+    }
+    return buff.st_ino != inode;
+#else
+    Q_UNUSED(path)
+    Q_UNUSED(item)
+    Q_UNUSED(inode)
+    return true;
+#endif
+}
+
 KCoreDirListerCache::KCoreDirListerCache()
     : itemsCached(s_maxCachedDirectories)
     , m_cacheHiddenFiles(s_maxCachedDotHiddenFiles)
@@ -64,6 +154,11 @@ KCoreDirListerCache::KCoreDirListerCache()
     connect(&pendingUpdateTimer, &QTimer::timeout, this, &KCoreDirListerCache::processPendingUpdates);
     pendingUpdateTimer.setSingleShot(true);
 
+    if (KCoreDirListerSnapshots::isEnabled()) {
+        snapshots = std::make_unique<KCoreDirListerSnapshots>(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                                                              + QLatin1String("/kio-dirlistings"));
+    }
+
     connect(KDirWatch::self(), &KDirWatch::dirty, this, &KCoreDirListerCache::slotFileDirty);
     connect(KDirWatch::self(), &KDirWatch::created, this, &KCoreDirListerCache::slotFileCreated);
     connect(KDirWatch::self(), &KDirWatch::deleted, this, &KCoreDirListerCache::slotFileDeleted);
@@ -205,10 +300,18 @@ bool KCoreDirListerCache::listDir(KCoreDirLister *lister, const QUrl &dirUrl, bo
                 itemU->incAutoUpdate();
             }
 
-            KIO::ListJob *job = KIO::listDir(_url, KIO::HideProgressInfo);
-            if (lister->requestMimeTypeWhileListing()) {
-                job->setDetails(KIO::StatDefaultDetails | KIO::StatMimeType);
+            if (!_reload && loadSnapshot(itemU)) {
+                qCDebug(KIO_CORE_DIRLISTER) << "Entry in snapshot:" << _url;
+                Q_EMIT lister->started(_url);
+
+                // Shown like cached items; as the item isn't complete, the directory is updated right
+                // after, and what changed since the snapshot goes through the diff of slotUpdateResult.
+                new KCoreDirListerPrivate::CachedItemsJob(lister, _url, true);
+                return true;
             }
+
+            KIO::ListJob *job = KIO::listDir(_url, KIO::HideProgressInfo);
+            job->setDetails(listingDetails(_url, lister->requestMimeTypeWhileListing()));
             runningListJobs.insert(job, KIO::UDSEntryList());
 
             lister->jobStarted(job);
@@ -631,9 +734,7 @@ void KCoreDirListerCache::updateDirectory(const QUrl &_dir)
         return lister->requestMimeTypeWhileListing();
     });
 
-    if (requestFromListers || requestFromholders) {
-        job->setDetails(KIO::StatDefaultDetails | KIO::StatMimeType);
-    }
+    job->setDetails(listingDetails(dir, requestFromListers || requestFromholders));
 
     connect(job, &KIO::ListJob::entries, this, &KCoreDirListerCache::slotUpdateEntries);
     connect(job, &KJob::result, this, &KCoreDirListerCache::slotUpdateResult);
@@ -1060,22 +1161,9 @@ void KCoreDirListerCache::slotFileDirty(const QString &path)
 // Called by slotFileDirty
 void KCoreDirListerCache::handleDirDirty(const QUrl &url)
 {
-    // A dir: launch an update job if anyone cares about it
-
-    // This also means we can forget about pending updates to individual files in that dir
+    // A dir: update it if anyone cares about it. This only looks for names that appeared or went
+    // away, so the pending updates to individual files in that dir are still needed.
     const QString dir = url.toLocalFile();
-    const QString dirPath = Utils::slashAppended(dir);
-
-    for (auto pendingIt = pendingUpdates.cbegin(); pendingIt != pendingUpdates.cend(); /* */) {
-        const QString updPath = *pendingIt;
-        qCDebug(KIO_CORE_DIRLISTER) << "had pending update" << updPath;
-        if (updPath.startsWith(dirPath) && updPath.indexOf(QLatin1Char('/'), dirPath.length()) == -1) { // direct child item
-            qCDebug(KIO_CORE_DIRLISTER) << "forgetting about individual update to" << updPath;
-            pendingIt = pendingUpdates.erase(pendingIt);
-        } else {
-            ++pendingIt;
-        }
-    }
 
     if (checkUpdate(url)) {
         const auto [it, isInserted] = pendingDirectoryUpdates.insert(dir);
@@ -1109,10 +1197,13 @@ void KCoreDirListerCache::handleFileDirty(const QUrl &url)
 void KCoreDirListerCache::slotFileCreated(const QString &path) // from KDirWatch
 {
     qCDebug(KIO_CORE_DIRLISTER) << path;
-    // XXX: how to avoid a complete rescan here?
-    // We'd need to stat that one file separately and refresh the item(s) for it.
+    // Other files may have been created along with this one, so the parent is looked at as a whole,
+    // which only stats the new names
     QUrl fileUrl(QUrl::fromLocalFile(path));
-    itemsAddedInDirectory(cleanUpTrailingSlash(fileUrl.adjusted(QUrl::RemoveFilename)));
+    const QList<QUrl> urls = directoriesForCanonicalPath(cleanUpTrailingSlash(fileUrl.adjusted(QUrl::RemoveFilename)));
+    for (const QUrl &dir : urls) {
+        handleDirDirty(dir);
+    }
 }
 
 void KCoreDirListerCache::slotFileDeleted(const QString &path) // from KDirWatch
@@ -1288,6 +1379,9 @@ void KCoreDirListerCache::slotResult(KJob *j)
     dirData.moveListersWithoutCachedItemsJob(jobUrl);
 
     if (job->error()) {
+        if (snapshots && job->error() == KIO::ERR_DOES_NOT_EXIST) {
+            snapshots->remove(jobUrl);
+        }
         bool errorShown = false;
         for (KCoreDirLister *lister : listers) {
             lister->d->jobDone(job);
@@ -1316,6 +1410,7 @@ void KCoreDirListerCache::slotResult(KJob *j)
         DirItem *dir = itemsInUse.value(jobUrl);
         Q_ASSERT(dir);
         dir->complete = true;
+        saveSnapshot(dir);
 
         for (KCoreDirLister *lister : listers) {
             lister->d->jobDone(job);
@@ -1698,6 +1793,9 @@ void KCoreDirListerCache::slotUpdateResult(KJob *j)
     Q_ASSERT(!listers.isEmpty());
 
     if (job->error()) {
+        if (snapshots && job->error() == KIO::ERR_DOES_NOT_EXIST) {
+            snapshots->remove(jobUrl);
+        }
         for (KCoreDirLister *lister : listers) {
             lister->d->jobDone(job);
 
@@ -1862,6 +1960,7 @@ void KCoreDirListerCache::slotUpdateResult(KJob *j)
     if (!fileItems.isEmpty()) {
         deleteUnmarkedItems(listers, dir->lstItems, fileItems);
     }
+    saveSnapshot(dir);
 
     for (KCoreDirLister *lister : listers) {
         lister->d->emitItems();
@@ -1885,6 +1984,38 @@ void KCoreDirListerCache::slotUpdateResult(KJob *j)
 
 // private
 
+bool KCoreDirListerCache::loadSnapshot(DirItem *dir)
+{
+    if (!snapshots || !KCoreDirListerSnapshots::isWanted(dir->url)) {
+        return false;
+    }
+    const QList<KIO::UDSEntry> entries = snapshots->load(dir->url);
+    if (entries.isEmpty()) {
+        return false;
+    }
+
+    KFileItemList items;
+    items.reserve(entries.size());
+    for (const KIO::UDSEntry &entry : entries) {
+        KFileItem item(entry, dir->url, true /*delayedMimeTypes*/, true /*urlIsDirectory*/);
+        const QString name = item.name();
+        if (name.isEmpty() || name == QLatin1Char('.') || name == QLatin1String("..")) {
+            continue;
+        }
+        items.append(item);
+    }
+    std::sort(items.begin(), items.end());
+    dir->insertSortedItems(items);
+    return !items.isEmpty();
+}
+
+void KCoreDirListerCache::saveSnapshot(const DirItem *dir)
+{
+    if (dir && snapshots && KCoreDirListerSnapshots::isWanted(dir->url)) {
+        snapshots->save(dir->url, dir->rootItem, dir->lstItems);
+    }
+}
+
 KIO::ListJob *KCoreDirListerCache::jobForUrl(const QUrl &url, KIO::ListJob *not_job)
 {
     for (auto it = runningListJobs.cbegin(); it != runningListJobs.cend(); ++it) {
@@ -2052,11 +2183,124 @@ void KCoreDirListerCache::processPendingUpdates()
         remove(removedUrl);
     }
 
-    // Directories in need of updating
-    for (const QString &dir : pendingDirectoryUpdates) {
-        updateDirectory(QUrl::fromLocalFile(dir));
+    // Directories in need of updating. Their items may be emitted right away, so what the listers
+    // do meanwhile must not change the set being walked.
+    const std::set<QString> directoryUpdates = std::exchange(pendingDirectoryUpdates, {});
+    for (const QString &dir : directoryUpdates) {
+        const QUrl dirUrl = QUrl::fromLocalFile(dir);
+        if (!updateDirectoryEntries(dirUrl)) {
+            updateDirectory(dirUrl);
+        }
+    }
+}
+
+bool KCoreDirListerCache::updateDirectoryEntries(const QUrl &dirUrl)
+{
+    DirItem *dir = itemsInUse.value(dirUrl);
+    const auto dit = directoryData.find(dirUrl);
+    // A listing on its way gets the changes anyway, and will be updated again at its end
+    if (!dir || !dir->complete || dit == directoryData.end() || jobForUrl(dirUrl)) {
+        return false;
+    }
+    KCoreDirListerCacheDirectoryData &dirData = *dit;
+    if (dirData.listerCountByStatus(ListerStatus::Listing) != 0) {
+        return false;
+    }
+
+    QHash<QString, quint64> entries;
+    if (!readDirectoryEntries(dirUrl.toLocalFile(), entries)) {
+        return false;
+    }
+
+    // Walk the known items, leaving in entries only the names that are new
+    QHash<QString, KFileItem> removedItems;
+    KFileItemList replacedItems;
+    for (const KFileItem &item : std::as_const(dir->lstItems)) {
+        const auto eit = entries.constFind(item.name());
+        if (eit == entries.cend()) {
+            removedItems.insert(item.name(), item);
+            continue;
+        }
+        // A file replaced by another one, like an editor saving through a temporary file, has a new
+        // inode. Symlinks are listed with the inode of their target, so readdir's always differs.
+        const long long inode = item.entry().numberValue(KIO::UDSEntry::UDS_INODE, -1);
+        if (inode < 0 || eit.value() == 0 || quint64(inode) != eit.value()) {
+            // Only stat's inode can tell, when readdir's differs for another reason
+            const QString path = Utils::concatPaths(dirUrl.toLocalFile(), item.name());
+            const bool replaced = inode < 0 || (item.isLink() ? symlinkChanged(path, item, inode) : quint64(inode) != statInode(path));
+            if (replaced) {
+                replacedItems.append(item);
+            }
+        }
+        entries.erase(eit);
+    }
+
+    if (entries.size() + removedItems.size() + replacedItems.size() > s_maxIncrementalChanges || entries.contains(QStringLiteral(".hidden"))
+        || removedItems.contains(QStringLiteral(".hidden"))) {
+        return false;
+    }
+    qCDebug(KIO_CORE_DIRLISTER) << dirUrl << entries.size() << "new," << removedItems.size() << "removed," << replacedItems.size() << "replaced";
+
+    // Like the relisting it replaces, the update is announced with started() and completed()
+    const QList<KCoreDirLister *> listers = dirData.allListers();
+    for (KCoreDirLister *lister : listers) {
+        lister->d->complete = false;
+        Q_EMIT lister->started(dirUrl);
+    }
+    CacheHiddenFile *cachedHidden = cachedDotHiddenForDir(dirUrl.toLocalFile());
+
+    for (const KFileItem &oldItem : std::as_const(replacedItems)) {
+        KFileItem item = oldItem;
+        item.refresh();
+        if (!item.exists()) {
+            removedItems.insert(oldItem.name(), oldItem);
+            continue;
+        }
+        // Kept even when nothing shown changed, for the inode to be that of the entry next time
+        reinsert(item, oldItem.url());
+        if (!oldItem.cmp(item)) {
+            for (KCoreDirLister *lister : listers) {
+                lister->d->addRefreshItem(dirUrl, oldItem, item);
+            }
+        }
+    }
+
+    KFileItemList newItems;
+    newItems.reserve(entries.size());
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        QUrl itemUrl(dirUrl);
+        itemUrl.setPath(Utils::concatPaths(itemUrl.path(), it.key()));
+        KFileItem item(itemUrl);
+        // Already gone again
+        if (!item.exists()) {
+            continue;
+        }
+        if (cachedHidden && cachedHidden->listedFiles.find(it.key()) != cachedHidden->listedFiles.cend()) {
+            item.setHidden();
+        }
+        newItems.append(item);
     }
-    pendingDirectoryUpdates.clear();
+
+    std::sort(newItems.begin(), newItems.end());
+    dir->insertSortedItems(newItems);
+    for (KCoreDirLister *lister : listers) {
+        lister->d->addNewItems(dirUrl, newItems);
+    }
+
+    if (!removedItems.isEmpty()) {
+        deleteUnmarkedItems(listers, dir->lstItems, removedItems);
+    }
+
+    for (KCoreDirLister *lister : listers) {
+        lister->d->emitItems();
+
+        Q_EMIT lister->listingDirCompleted(dirUrl);
+        if (lister->d->numJobs() == 0) {
+            lister->d->complete = true;
+            Q_EMIT lister->completed();
+        }
+    }
+    return true;
 }
 
 #ifndef NDEBUG
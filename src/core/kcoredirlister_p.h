@@ -24,6 +24,7 @@
 #include <QUrl>
 
 #include <chrono>
+#include <memory>
 
 #include <KDirWatch>
 #include <kio/global.h>
@@ -38,6 +39,7 @@ class Job;
 class ListJob;
 }
 class OrgKdeKDirNotifyInterface;
+class KCoreDirListerSnapshots;
 struct KCoreDirListerCacheDirectoryData;
 
 class KCoreDirListerPrivate
@@ -286,6 +288,10 @@ private:
 
     void killJob(KIO::ListJob *job);
 
+    // Fills dir with the items of its snapshot, returns false when there is none
+    bool loadSnapshot(DirItem *dir);
+    void saveSnapshot(const DirItem *dir);
+
     // Called when something tells us that the directory @p url has changed.
     // Returns true if @p url is held by some lister (meaning: do the update now)
     // otherwise mark the cached item as not-up-to-date for later and return false
@@ -294,6 +300,10 @@ private:
     // Helper method for slotFileDirty
     void handleFileDirty(const QUrl &url);
     void handleDirDirty(const QUrl &url);
+    // Brings the local directory url up to date by reading its entries and stat'ing only the names
+    // that appeared or point to another file than before. Returns false when it needs a full update
+    // instead: with many changes, or while it is being listed.
+    bool updateDirectoryEntries(const QUrl &url);
 
     // when there were items deleted from the filesystem all the listers holding
     // the parent directory need to be notified, the items have to be deleted
@@ -562,6 +572,9 @@ private:
     // this is why we need to remember those files here.
     std::set<KFileItem> pendingRemoteUpdates;
 
+    // The listings of remote directories kept on disk, when enabled
+    std::unique_ptr<KCoreDirListerSnapshots> snapshots;
+
 #ifdef WITH_QTDBUS
     // the KDirNotify signals
     OrgKdeKDirNotifyInterface *kdirnotify;
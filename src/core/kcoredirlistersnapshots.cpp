@@ -0,0 +1,168 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kcoredirlistersnapshots_p.h"
+#include "kfileitem.h"
+#include "kiocoredebug.h"
+#include "kprotocolinfo.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include <chrono>
+
+using namespace Qt::Literals::StringLiterals;
+
+static constexpr quint32 s_snapshotMagic = 0x4b444c53; // "KDLS"
+static constexpr quint32 s_snapshotVersion = 1;
+
+// What was in a directory that wasn't opened for a month is more confusing than useful
+static constexpr std::chrono::days s_snapshotLifetime{30};
+
+// Writing the snapshot of a huge directory each time it is listed would cost more than it saves
+static constexpr int s_maxSnapshotItems = 20000;
+
+static QByteArray validatorOf(const KFileItem &rootItem)
+{
+    if (rootItem.isNull()) {
+        return QByteArray();
+    }
+    const KIO::UDSEntry entry = rootItem.entry();
+    const long long mtime = entry.numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
+    if (mtime < 0) {
+        return QByteArray();
+    }
+    return QByteArray::number(mtime) + '.' + QByteArray::number(entry.numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME_NS_OFFSET, 0));
+}
+
+KCoreDirListerSnapshots::KCoreDirListerSnapshots(const QString &dir)
+    : m_dir(dir)
+{
+}
+
+bool KCoreDirListerSnapshots::isEnabled()
+{
+    const KConfigGroup group(KSharedConfig::openConfig(u"kiorc"_s, KConfig::NoGlobals), u"Directory Listing"_s);
+    return group.readEntry("RemoteListingSnapshots", false);
+}
+
+bool KCoreDirListerSnapshots::isWanted(const QUrl &url)
+{
+    return !url.isLocalFile() && KProtocolInfo::protocolClass(url.scheme()) != ":local"_L1;
+}
+
+QString KCoreDirListerSnapshots::fileName(const QUrl &url) const
+{
+    const QByteArray key = url.toEncoded(QUrl::RemovePassword | QUrl::StripTrailingSlash);
+    return m_dir + QLatin1Char('/') + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+}
+
+QList<KIO::UDSEntry> KCoreDirListerSnapshots::load(const QUrl &url)
+{
+    QFile file(fileName(url));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    if (file.fileTime(QFileDevice::FileModificationTime).addDays(s_snapshotLifetime.count()) < QDateTime::currentDateTime()) {
+        file.remove();
+        return {};
+    }
+    const qint64 size = file.size();
+    const uchar *data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data) {
+        return {};
+    }
+
+    // The entries copy what they keep, so the mapping can go away with the file
+    const QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), size);
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString urlString;
+    QByteArray validator;
+    quint32 count = 0;
+    stream >> magic >> version;
+    if (magic != s_snapshotMagic || version != s_snapshotVersion) {
+        return {};
+    }
+    stream >> urlString >> validator >> count;
+    // Two URLs with the same hash are not worth handling, but not worth showing the wrong one either
+    if (stream.status() != QDataStream::Ok || urlString != url.toString(QUrl::RemovePassword | QUrl::StripTrailingSlash)
+        || count > quint32(s_maxSnapshotItems)) {
+        return {};
+    }
+
+    QList<KIO::UDSEntry> entries;
+    entries.resize(count);
+    for (KIO::UDSEntry &entry : entries) {
+        stream >> entry;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(KIO_CORE) << "Ignoring the truncated listing snapshot of" << url.toDisplayString();
+        return {};
+    }
+
+    m_validators.insert(url, validator);
+    return entries;
+}
+
+void KCoreDirListerSnapshots::save(const QUrl &url, const KFileItem &rootItem, const QList<KFileItem> &items)
+{
+    const QByteArray validator = validatorOf(rootItem);
+    if (!validator.isEmpty()) {
+        const auto it = m_validators.constFind(url);
+        if (it != m_validators.cend() && it.value() == validator) {
+            // Still current, so it ages from now on
+            QFile file(fileName(url));
+            if (file.open(QIODevice::ReadWrite)) {
+                file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+            }
+            return;
+        }
+    }
+    if (items.size() > s_maxSnapshotItems) {
+        remove(url);
+        return;
+    }
+
+    // Listings of other machines may say more than their owner wants every user of this one to see
+    if (!QDir().mkpath(m_dir) || !QFile::setPermissions(m_dir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner)) {
+        return;
+    }
+
+    QSaveFile file(fileName(url));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KIO_CORE) << "Cannot write the listing snapshot of" << url.toDisplayString() << file.errorString();
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << s_snapshotMagic << s_snapshotVersion << url.toString(QUrl::RemovePassword | QUrl::StripTrailingSlash) << validator
+           << quint32(items.size());
+    for (const KFileItem &item : items) {
+        stream << item.entry();
+    }
+    if (!file.commit()) {
+        return;
+    }
+    m_validators.insert(url, validator);
+}
+
+void KCoreDirListerSnapshots::remove(const QUrl &url)
+{
+    m_validators.remove(url);
+    QFile::remove(fileName(url));
+}
@@ -0,0 +1,58 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCOREDIRLISTERSNAPSHOTS_P_H
+#define KCOREDIRLISTERSNAPSHOTS_P_H
+
+#include "kiocore_export.h"
+#include "udsentry.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+
+class KFileItem;
+
+/*
+ * The last listing of directories on other machines, kept on disk so that an application opening
+ * one shows what was there the last time at once, instead of waiting for the whole listing.
+ *
+ * There is a file per directory, named after a hash of its URL, which is mapped into memory to be
+ * read. A snapshot is written again only when the directory's validator, its modification time,
+ * differs from that of the snapshot already on disk. A snapshot is never trusted as current: the
+ * lister updates the directory right after showing it.
+ */
+class KIOCORE_EXPORT KCoreDirListerSnapshots
+{
+public:
+    // Keeps the snapshots in dir, created when the first one is written
+    explicit KCoreDirListerSnapshots(const QString &dir);
+
+    // Whether snapshots are kept at all, as configured in kiorc
+    static bool isEnabled();
+    // Whether url is slow enough to list to be worth a snapshot: not a local directory, nor one
+    // of a protocol showing local data, like trash:/
+    static bool isWanted(const QUrl &url);
+
+    // The entries of the snapshot of url, without "." and "..". Empty when there is none, or it is
+    // too old to be of use.
+    QList<KIO::UDSEntry> load(const QUrl &url);
+    // Writes the snapshot of url, unless the one on disk is for the same rootItem
+    void save(const QUrl &url, const KFileItem &rootItem, const QList<KFileItem> &items);
+    void remove(const QUrl &url);
+
+private:
+    QString fileName(const QUrl &url) const;
+
+    const QString m_dir;
+    // The validators of the snapshots read or written by this process
+    QHash<QUrl, QByteArray> m_validators;
+};
+
+#endif
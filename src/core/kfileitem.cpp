@@ -54,14 +54,7 @@ public:
                      bool urlIsDirectory,
                      bool delayedMimeTypes,
                      KFileItem::MimeTypeDetermination mimeTypeDetermination)
-        : m_entry(entry)
-        , m_url(itemOrDirUrl)
-        , m_strName()
-        , m_strText()
-        , m_iconName()
-        , m_strLowerCaseName()
-        , m_mimeType()
-        , m_fileMode(mode)
+        : m_fileMode(mode)
         , m_permissions(permissions)
         , m_addACL(false)
         , m_bLink(false)
@@ -74,6 +67,13 @@ public:
         , m_slow(SlowUnknown)
         , m_bSkipMimeTypeFromContent(mimeTypeDetermination == KFileItem::SkipMimeTypeFromContent)
         , m_bInitCalled(false)
+        , m_entry(entry)
+        , m_url(itemOrDirUrl)
+        , m_strName()
+        , m_strText()
+        , m_iconName()
+        , m_strLowerCaseName()
+        , m_mimeType()
     {
         if (entry.count() != 0) {
             readUDSEntry(urlIsDirectory);
@@ -120,40 +120,7 @@ public:
      */
     void determineMimeTypeHelper(const QUrl &url) const;
 
-    /*
-     * The UDSEntry that contains the data for this fileitem, if it came from a directory listing.
-     */
-    mutable KIO::UDSEntry m_entry;
-    /*
-     * The url of the file
-     */
-    QUrl m_url;
-
-    /*
-     * The text for this item, i.e. the file name without path,
-     */
-    QString m_strName;
-
-    /*
-     * The text for this item, i.e. the file name without path, decoded
-     * ('%%' becomes '%', '%2F' becomes '/')
-     */
-    QString m_strText;
-
-    /*
-     * The icon name for this item.
-     */
-    mutable QString m_iconName;
-
-    /*
-     * The filename in lower case (to speed up sorting)
-     */
-    mutable QString m_strLowerCaseName;
-
-    /*
-     * The MIME type of the file
-     */
-    mutable QMimeType m_mimeType;
+    // The modes and flags go first, in the padding after the reference count of QSharedData
 
     /*
      * The file mode
@@ -213,6 +180,41 @@ public:
      */
     mutable bool m_bInitCalled : 1;
 
+    /*
+     * The UDSEntry that contains the data for this fileitem, if it came from a directory listing.
+     */
+    mutable KIO::UDSEntry m_entry;
+    /*
+     * The url of the file
+     */
+    QUrl m_url;
+
+    /*
+     * The text for this item, i.e. the file name without path,
+     */
+    QString m_strName;
+
+    /*
+     * The text for this item, i.e. the file name without path, decoded
+     * ('%%' becomes '%', '%2F' becomes '/')
+     */
+    QString m_strText;
+
+    /*
+     * The icon name for this item.
+     */
+    mutable QString m_iconName;
+
+    /*
+     * The filename in lower case (to speed up sorting)
+     */
+    mutable QString m_strLowerCaseName;
+
+    /*
+     * The MIME type of the file
+     */
+    mutable QMimeType m_mimeType;
+
     // For special case like link to dirs over FTP
     QString m_guessedMimeType;
     mutable QString m_access;
@@ -1567,7 +1569,8 @@ QString KFileItem::permissionsString() const
     d->ensureInitialized();
 
     if (d->m_access.isNull() && d->m_permissions != KFileItem::Unknown) {
-        d->m_access = d->parsePermissions(d->m_permissions);
+        // A few strings in a whole process, not one per item
+        d->m_access = KIOPrivate::internedString(d->parsePermissions(d->m_permissions));
     }
 
     return d->m_access;
@@ -7,8 +7,14 @@
 
 #include "kioglobal_p.h"
 
+#include <QMutex>
+#include <QSet>
 #include <QStandardPaths>
 
+// Values that don't repeat, from a worker putting something unexpected in a field, stop being
+// interned once there are this many
+static constexpr qsizetype s_maxInternedStrings = 4096;
+
 using LocationMap = QMap<QString, QString>;
 
 static QMap<QString, QString> standardLocationsMap()
@@ -54,3 +60,23 @@ QString KIOPrivate::iconForStandardPath(const QString &localDirectory)
     }
     return map.value(path, QString());
 }
+
+QString KIOPrivate::internedString(const QString &string)
+{
+    static QMutex mutex;
+    static QSet<QString> strings;
+
+    QMutexLocker locker(&mutex);
+    const auto it = strings.constFind(string);
+    if (it != strings.cend()) {
+        return *it;
+    }
+    if (strings.size() >= s_maxInternedStrings) {
+        return string;
+    }
+    // Not to keep the spare capacity of a reused buffer alive
+    QString interned = string;
+    interned.squeeze();
+    strings.insert(interned);
+    return interned;
+}
@@ -125,6 +125,14 @@ KIOCORE_EXPORT bool changeOwnership(const QString &file, KUserId newOwner, KGrou
  * \internal
  */
 QString iconForStandardPath(const QString &localDirectory);
+
+/*!
+ * Returns \a string, sharing its data with the equal strings returned before.
+ * Meant for the values many items of a process have in common, like their user, group or
+ * MIME type, so that huge listings keep one copy of each. Thread-safe.
+ * \internal
+ */
+KIOCORE_EXPORT QString internedString(const QString &string);
 }
 
 #endif // KIO_KIOGLOBAL_P_H
@@ -31,6 +31,8 @@ public:
     {
     }
     bool recursive;
+    // The worker lists the whole tree itself, naming entries by their relative path
+    bool workerRecurses = false;
     ListJob::ListFlags listFlags;
     QString m_prefix;
     QString m_displayPrefix;
@@ -175,8 +177,9 @@ void ListJobPrivate::filterAndEmitEntries(const KIO::UDSEntryList &list)
                 }
             }
 
-            // skip hidden files/dirs if that was requested
-            if (!includeHidden && filename[0] == QLatin1Char('.')) {
+            // skip hidden files/dirs if that was requested, including anything below
+            // a hidden dir when the worker did the recursion
+            if (!includeHidden && (filename[0] == QLatin1Char('.') || (workerRecurses && filename.contains(QLatin1String("/."))))) {
                 return true;
             }
 
@@ -300,8 +303,20 @@ void ListJobPrivate::start(Worker *worker)
         QTimer::singleShot(0, q, &ListJob::slotFinished);
         return;
     }
+    // Workers that can list a whole tree at once (e.g. webdav) answer with the
+    // "listRecursive" metadata before sending any entries.
+    if (recursive && m_prefix.isNull()) {
+        q->addMetaData(QStringLiteral("listRecursive"), QStringLiteral("true"));
+    }
+
     QObject::connect(worker, &Worker::listEntries, q, [this](KIO::UDSEntryList list) {
-        maybeRecurse(list);
+        Q_Q(ListJob);
+        if (recursive && !workerRecurses) {
+            workerRecurses = q->queryMetaData(QStringLiteral("listRecursive")) == QLatin1String("true");
+        }
+        if (!workerRecurses) {
+            maybeRecurse(list);
+        }
         filterAndEmitEntries(list);
     });
 
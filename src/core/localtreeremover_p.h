@@ -0,0 +1,77 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KIO_LOCALTREEREMOVER_P_H
+#define KIO_LOCALTREEREMOVER_P_H
+
+#include "global.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace KIO
+{
+/*
+ * Removes a local directory and everything under it, on a few threads.
+ *
+ * Directories are opened relative to their parent's descriptor and their entries removed with
+ * unlinkat() relative to their own, so no path is resolved from the root more than once. The
+ * subdirectories found are put on a stack that all the threads take from, so distinct subtrees
+ * are emptied in parallel. A directory is removed from its parent as soon as the last of its
+ * subdirectories is, which keeps few descriptors open.
+ *
+ * The first entry that can't be removed stops everything, leaving the rest in place. Symlinks
+ * are removed, never followed.
+ */
+class LocalTreeRemover
+{
+public:
+    // cancelled is checked between entries. removedSize is increased by the size of every file
+    // removed, and can be read from another thread meanwhile.
+    LocalTreeRemover(const std::atomic<bool> &cancelled, std::atomic<KIO::filesize_t> &removedSize, int threadCount);
+
+    LocalTreeRemover(const LocalTreeRemover &) = delete;
+    LocalTreeRemover &operator=(const LocalTreeRemover &) = delete;
+
+    // Removes path, a directory. Returns 0 once it is gone, ECANCELED if cancelled is set on the
+    // way, or else the errno of the first entry that could not be removed.
+    int remove(const QString &path);
+
+private:
+    struct Dir;
+    struct Task {
+        std::shared_ptr<Dir> parent;
+        QByteArray name;
+    };
+
+    void run();
+    void removeContent(const Task &task);
+    void push(Task &&task);
+    void fail(int error);
+    bool stopped() const;
+
+    const std::atomic<bool> &m_cancelled;
+    std::atomic<KIO::filesize_t> &m_removedSize;
+    const int m_threadCount;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<Task> m_tasks;
+    // Tasks queued or being worked on; the removal is over when it drops to 0
+    int m_pending = 0;
+    std::atomic<int> m_error{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "localtreeremover_p.h"
+
+#include "../kioworkers/file/stat_unix.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QScopeGuard>
+
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace KIO;
+
+// Removes itself from its parent once the last reference to it, that of its last subdirectory
+// still being emptied, goes away
+struct LocalTreeRemover::Dir {
+    Dir(int fd, const std::shared_ptr<Dir> &parent, const QByteArray &name, LocalTreeRemover *remover)
+        : fd(fd)
+        , parent(parent)
+        , name(name)
+        , remover(remover)
+    {
+    }
+
+    ~Dir()
+    {
+        ::close(fd);
+        if (parent && !remover->stopped()) {
+            if (::unlinkat(parent->fd, name.constData(), AT_REMOVEDIR) != 0) {
+                remover->fail(errno);
+            }
+        }
+    }
+
+    const int fd;
+    const std::shared_ptr<Dir> parent;
+    const QByteArray name;
+    LocalTreeRemover *const remover;
+};
+
+LocalTreeRemover::LocalTreeRemover(const std::atomic<bool> &cancelled, std::atomic<KIO::filesize_t> &removedSize, int threadCount)
+    : m_cancelled(cancelled)
+    , m_removedSize(removedSize)
+    , m_threadCount(std::max(threadCount, 1))
+{
+}
+
+int LocalTreeRemover::remove(const QString &path)
+{
+    const QFileInfo info(path);
+    const int parentfd = ::open(QFile::encodeName(info.path()).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parentfd < 0) {
+        return errno;
+    }
+
+    m_error = 0;
+    m_pending = 1;
+    m_tasks.push_back(Task{std::make_shared<Dir>(parentfd, nullptr, QByteArray(), this), QFile::encodeName(info.fileName())});
+
+    std::vector<std::thread> threads;
+    threads.reserve(m_threadCount);
+    for (int i = 0; i < m_threadCount; ++i) {
+        threads.emplace_back(&LocalTreeRemover::run, this);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    // Left over when the removal stopped half way; they must not remove anything
+    m_tasks.clear();
+
+    if (m_error == 0 && m_cancelled) {
+        return ECANCELED;
+    }
+    return m_error;
+}
+
+bool LocalTreeRemover::stopped() const
+{
+    return m_error.load(std::memory_order_relaxed) != 0 || m_cancelled.load(std::memory_order_relaxed);
+}
+
+void LocalTreeRemover::fail(int error)
+{
+    int expected = 0;
+    m_error.compare_exchange_strong(expected, error);
+    {
+        // Not to notify between the check and the wait of a thread that is about to sleep
+        std::lock_guard lock(m_mutex);
+    }
+    m_changed.notify_all();
+}
+
+void LocalTreeRemover::run()
+{
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_changed.wait(lock, [this] {
+            return !m_tasks.empty() || m_pending == 0 || stopped();
+        });
+        if (m_pending == 0 || stopped()) {
+            m_changed.notify_all();
+            return;
+        }
+
+        Task task = std::move(m_tasks.back());
+        m_tasks.pop_back();
+        lock.unlock();
+        removeContent(task);
+        // Removes the directory, and maybe its parents, when this was the last of their subdirectories
+        task = Task();
+        lock.lock();
+
+        if (--m_pending == 0 || stopped()) {
+            m_changed.notify_all();
+        }
+    }
+}
+
+void LocalTreeRemover::push(Task &&task)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        ++m_pending;
+        m_tasks.push_back(std::move(task));
+    }
+    m_changed.notify_one();
+}
+
+void LocalTreeRemover::removeContent(const Task &task)
+{
+    const int fd = ::openat(task.parent->fd, task.name.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        fail(errno);
+        return;
+    }
+    const auto dir = std::make_shared<Dir>(fd, task.parent, task.name, this);
+
+    // readdir() gets a descriptor of its own, the one of dir is for the *at() calls
+    const int readfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    DIR *stream = readfd < 0 ? nullptr : ::fdopendir(readfd);
+    if (!stream) {
+        fail(errno);
+        if (readfd >= 0) {
+            ::close(readfd);
+        }
+        return;
+    }
+    const auto closeStream = qScopeGuard([stream] {
+        ::closedir(stream);
+    });
+
+    while (!stopped()) {
+        errno = 0;
+        const struct dirent *entry = ::readdir(stream);
+        if (!entry) {
+            if (errno != 0) {
+                fail(errno);
+            }
+            return;
+        }
+        const QByteArrayView name(entry->d_name);
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        bool isDir = entry->d_type == DT_DIR;
+        KIO::filesize_t size = 0;
+        if (!isDir) {
+            // Only for the progress, what can't be stat'ed can still be removed
+            QT_STATBUF buf;
+            if (KIO_FSTATAT(fd, entry->d_name, &buf, AT_SYMLINK_NOFOLLOW) == 0) {
+                isDir = S_ISDIR(buf.st_mode);
+                if (S_ISREG(buf.st_mode)) {
+                    size = buf.st_size;
+                }
+            }
+        }
+
+        if (isDir) {
+            push(Task{dir, QByteArray(entry->d_name)});
+            continue;
+        }
+        if (::unlinkat(fd, entry->d_name, 0) != 0) {
+            fail(errno);
+            return;
+        }
+        m_removedSize.fetch_add(size, std::memory_order_relaxed);
+    }
+}
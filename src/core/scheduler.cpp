@@ -10,6 +10,7 @@
 #include "scheduler.h"
 #include "scheduler_p.h"
 
+#include "commands_p.h"
 #include "job_p.h"
 #include "worker_p.h"
 #include "workerconfig.h"
@@ -25,9 +26,21 @@
 #include <QThread>
 #include <QThreadStorage>
 
+#include <algorithm>
+#include <tuple>
+
 // Workers may be idle for a certain time (3 minutes) before they are killed.
 static const int s_idleWorkerLifetime = 3 * 60;
 
+// How many jobs may start in a row ahead of an older one of a lower class
+static const int s_maxStartsAheadOfLowerClass = 4;
+
+// Idle workers kept spawned ahead of the jobs of a protocol, unless configured otherwise
+static const int s_defaultWarmWorkers = 1;
+// How many jobs must have waited for a worker to start before a protocol gets warm workers,
+// so that those used once in a while don't keep processes around
+static const quint64 s_coldStartsBeforeWarming = 2;
+
 using namespace KIO;
 
 static inline Worker *jobSWorker(SimpleJob *job)
@@ -89,6 +102,24 @@ public:
 
     ProtoQueue *protoQ(const QString &protocol, const QString &host);
 
+    std::array<SchedulingClassStatistics, s_schedulingClassCount> statistics(const QString &protocol) const
+    {
+        const ProtoQueue *pq = m_protocols.value(protocol);
+        return pq ? pq->statistics() : std::array<SchedulingClassStatistics, s_schedulingClassCount>();
+    }
+
+    WorkerStartupStatistics startupStatistics(const QString &protocol) const
+    {
+        const ProtoQueue *pq = m_protocols.value(protocol);
+        return pq ? pq->startupStatistics() : WorkerStartupStatistics();
+    }
+
+#ifdef BUILD_TESTING
+    // maxWorkers and maxWorkersPerHost of the kio-test protocols
+    QHash<QString, std::pair<int, int>> m_testProtocolLimits;
+    QHash<QString, int> m_testProtocolWarmWorkers;
+#endif
+
 private:
     QHash<QString, ProtoQueue *> m_protocols;
 };
@@ -212,6 +243,25 @@ void WorkerManager::grimReaper()
     }
 }
 
+SchedulingClass KIO::schedulingClassForCommand(int command)
+{
+    switch (command) {
+    case CMD_STAT:
+    case CMD_MIMETYPE:
+    case CMD_LISTDIR:
+    case CMD_FILESYSTEMFREESPACE:
+        return SchedulingClass::Interactive;
+    case CMD_GET:
+    case CMD_PUT:
+    case CMD_COPY:
+    case CMD_DEL:
+    case CMD_SPECIAL:
+        return SchedulingClass::Background;
+    default:
+        return SchedulingClass::Normal;
+    }
+}
+
 int HostQueue::lowestSerial() const
 {
     QMap<int, SimpleJob *>::ConstIterator first = m_queuedJobs.constBegin();
@@ -221,6 +271,23 @@ int HostQueue::lowestSerial() const
     return SerialPicker::maxSerial;
 }
 
+int HostQueue::lowestSerial(SchedulingClass schedulingClass) const
+{
+    QMap<int, SimpleJob *>::ConstIterator first = m_queuedJobs.lowerBound(SerialPicker::firstSerial(schedulingClass));
+    if (first != m_queuedJobs.constEnd()) {
+        return first.key();
+    }
+    return SerialPicker::maxSerial;
+}
+
+bool HostQueue::isSiblingRunning(SimpleJob *job) const
+{
+    const Job *parentJob = job->parentJob();
+    return parentJob && std::any_of(m_runningJobs.cbegin(), m_runningJobs.cend(), [parentJob](const SimpleJob *runningJob) {
+               return runningJob->parentJob() == parentJob;
+           });
+}
+
 void HostQueue::queueJob(SimpleJob *job)
 {
     const int serial = SimpleJobPrivate::get(job)->m_schedSerial;
@@ -230,12 +297,10 @@ void HostQueue::queueJob(SimpleJob *job)
     m_queuedJobs.insert(serial, job);
 }
 
-SimpleJob *HostQueue::takeFirstInQueue()
+SimpleJob *HostQueue::takeQueuedJob(int serial)
 {
-    Q_ASSERT(!m_queuedJobs.isEmpty());
-    QMap<int, SimpleJob *>::iterator first = m_queuedJobs.begin();
-    SimpleJob *job = first.value();
-    m_queuedJobs.erase(first);
+    SimpleJob *job = m_queuedJobs.take(serial);
+    Q_ASSERT(job);
     m_runningJobs.insert(job);
     return job;
 }
@@ -314,11 +379,14 @@ static void verifyRunningJobsCount(const std::unordered_map<QString, HostQueue>
 #endif
 }
 
-ProtoQueue::ProtoQueue(int maxWorkers, int maxWorkersPerHost)
-    : m_maxConnectionsPerHost(maxWorkersPerHost ? maxWorkersPerHost : maxWorkers)
+ProtoQueue::ProtoQueue(const QString &protocol, int maxWorkers, int maxWorkersPerHost, bool reserveInteractiveWorker, int warmWorkers)
+    : m_protocol(protocol)
+    , m_maxConnectionsPerHost(maxWorkersPerHost ? maxWorkersPerHost : maxWorkers)
     , m_maxConnectionsTotal(qMax(maxWorkers, maxWorkersPerHost))
     , m_runningJobsCount(0)
-
+    // with a single connection there would be none left for the other jobs
+    , m_reserveInteractiveWorker(reserveInteractiveWorker && m_maxConnectionsPerHost > 1)
+    , m_warmWorkers(qBound(0, warmWorkers, m_maxConnectionsTotal))
 {
     /*qDebug() << "m_maxConnectionsTotal:" << m_maxConnectionsTotal
                  << "m_maxConnectionsPerHost:" << m_maxConnectionsPerHost;*/
@@ -326,6 +394,9 @@ ProtoQueue::ProtoQueue(int maxWorkers, int maxWorkersPerHost)
     Q_ASSERT(maxWorkers >= maxWorkersPerHost);
     m_startJobTimer.setSingleShot(true);
     connect(&m_startJobTimer, &QTimer::timeout, this, &ProtoQueue::startAJob);
+    m_warmPoolTimer.setSingleShot(true);
+    connect(&m_warmPoolTimer, &QTimer::timeout, this, &ProtoQueue::fillWarmPool);
+    m_clock.start();
 }
 
 ProtoQueue::~ProtoQueue()
@@ -358,40 +429,119 @@ void ProtoQueue::killAllJobs()
     m_queuesByHostname.clear();
     m_queuesBySerial.clear();
     m_runningJobsCount = 0;
+    for (SchedulingClassStatistics &statistics : m_statistics) {
+        statistics.queuedJobs = 0;
+    }
+}
+
+std::array<SchedulingClassStatistics, s_schedulingClassCount> ProtoQueue::statistics() const
+{
+    return m_statistics;
+}
+
+WorkerStartupStatistics ProtoQueue::startupStatistics() const
+{
+    return m_startupStatistics;
+}
+
+// private slot
+void ProtoQueue::fillWarmPool()
+{
+    if (m_inProcessWorkers) {
+        return;
+    }
+    const QList<Worker *> idleWorkers = m_workerManager.allWorkers();
+    auto warmWorkers = std::count_if(idleWorkers.cbegin(), idleWorkers.cend(), [](const Worker *worker) {
+        return worker->m_warm;
+    });
+    for (; warmWorkers < m_warmWorkers; ++warmWorkers) {
+        // Set up for a host and started like an idle worker once a job takes it
+        Worker *worker = createWorker(m_protocol, nullptr, QUrl());
+        if (!worker) {
+            return;
+        }
+        worker->m_warm = true;
+        ++m_startupStatistics.warmSpawns;
+        m_workerManager.returnWorker(worker);
+    }
+}
+
+bool ProtoQueue::canStartJob(const HostQueue &hq, SimpleJob *job) const
+{
+    int maxConnections = m_maxConnectionsPerHost;
+    // A job that a running job of the host waits for, like the get of a FileCopyJob whose put
+    // holds a connection, may take the reserved one: holding it back would never free any.
+    if (m_reserveInteractiveWorker && SerialPicker::schedulingClass(SimpleJobPrivate::get(job)->m_schedSerial) != SchedulingClass::Interactive
+        && !hq.isSiblingRunning(job)) {
+        --maxConnections;
+    }
+    return hq.runningJobsCount() < maxConnections;
+}
+
+bool ProtoQueue::canStartAJob(const HostQueue &hq) const
+{
+    return !hq.isQueueEmpty() && canStartJob(hq, hq.queuedJob(hq.lowestSerial()));
+}
+
+void ProtoQueue::updateQueuesBySerial(HostQueue &hq)
+{
+    if (hq.indexedSerial()) {
+        const int removed = m_queuesBySerial.remove(hq.indexedSerial());
+        Q_UNUSED(removed);
+        Q_ASSERT(removed == 1);
+        hq.setIndexedSerial(0);
+    }
+    if (canStartAJob(hq)) {
+        m_queuesBySerial.insert(hq.lowestSerial(), &hq);
+        hq.setIndexedSerial(hq.lowestSerial());
+    }
+}
+
+bool ProtoQueue::isLessUrgentJobQueued(SchedulingClass schedulingClass) const
+{
+    return std::any_of(m_statistics.cbegin() + int(schedulingClass) + 1, m_statistics.cend(), [](const SchedulingClassStatistics &statistics) {
+        return statistics.queuedJobs > 0;
+    });
+}
+
+std::pair<HostQueue *, int> ProtoQueue::oldestStartableJobAfter(SchedulingClass schedulingClass) const
+{
+    std::pair<HostQueue *, int> oldest(nullptr, SerialPicker::maxSerial);
+    if (int(schedulingClass) + 1 >= s_schedulingClassCount) {
+        return oldest;
+    }
+    // A host whose first job can't start has no job that could, except for one
+    // exempt from the reservation, and those are not worth a scan of the whole queue
+    for (HostQueue *hq : m_queuesBySerial) {
+        const int serial = hq->lowestSerial(SchedulingClass(int(schedulingClass) + 1));
+        if (serial < oldest.second && canStartJob(*hq, hq->queuedJob(serial))) {
+            oldest = {hq, serial};
+        }
+    }
+    return oldest;
 }
 
 void ProtoQueue::queueJob(SimpleJob *job)
 {
-    QString hostname = SimpleJobPrivate::get(job)->m_url.host();
+    SimpleJobPrivate *jobPriv = SimpleJobPrivate::get(job);
+    QString hostname = jobPriv->m_url.host();
     HostQueue &hq = m_queuesByHostname[hostname];
     const int prevLowestSerial = hq.lowestSerial();
     Q_ASSERT(hq.runningJobsCount() <= m_maxConnectionsPerHost);
 
     // nevert insert a job twice
-    Q_ASSERT(SimpleJobPrivate::get(job)->m_schedSerial == 0);
-    SimpleJobPrivate::get(job)->m_schedSerial = m_serialPicker.next();
+    Q_ASSERT(jobPriv->m_schedSerial == 0);
+    const SchedulingClass schedulingClass = schedulingClassForCommand(jobPriv->m_command);
+    jobPriv->m_schedSerial = m_serialPicker.next(schedulingClass);
+    jobPriv->m_schedQueuedAt = m_clock.elapsed();
+    ++m_statistics[int(schedulingClass)].queuedJobs;
 
-    const bool wasQueueEmpty = hq.isQueueEmpty();
     hq.queueJob(job);
     // note that HostQueue::queueJob() into an empty queue changes its lowestSerial() too...
     // the queue's lowest serial job may have changed, so update the ordered list of queues.
     // however, we ignore all jobs that would cause more connections to a host than allowed.
     if (prevLowestSerial != hq.lowestSerial()) {
-        if (hq.runningJobsCount() < m_maxConnectionsPerHost) {
-            // if the connection limit didn't keep the HQ unscheduled it must have been lack of jobs
-            if (m_queuesBySerial.remove(prevLowestSerial) == 0) {
-                Q_UNUSED(wasQueueEmpty);
-                Q_ASSERT(wasQueueEmpty);
-            }
-            m_queuesBySerial.insert(hq.lowestSerial(), &hq);
-        } else {
-#ifdef SCHEDULER_DEBUG
-            // ### this assertion may fail if the limits were modified at runtime!
-            // if the per-host connection limit is already reached the host queue's lowest serial
-            // should not be queued.
-            Q_ASSERT(!m_queuesBySerial.contains(prevLowestSerial));
-#endif
-        }
+        updateQueuesBySerial(hq);
     }
     // just in case; startAJob() will refuse to start a job if it shouldn't.
     m_startJobTimer.start();
@@ -403,32 +553,23 @@ void ProtoQueue::removeJob(SimpleJob *job)
 {
     SimpleJobPrivate *jobPriv = SimpleJobPrivate::get(job);
     HostQueue &hq = m_queuesByHostname[jobPriv->m_url.host()];
-    const int prevLowestSerial = hq.lowestSerial();
     const int prevRunningJobs = hq.runningJobsCount();
 
     Q_ASSERT(hq.runningJobsCount() <= m_maxConnectionsPerHost);
 
     if (hq.removeJob(job)) {
-        if (hq.lowestSerial() != prevLowestSerial) {
-            // we have dequeued the not yet running job with the lowest serial
-            Q_ASSERT(!jobPriv->m_worker);
-            Q_ASSERT(prevRunningJobs == hq.runningJobsCount());
-            if (m_queuesBySerial.remove(prevLowestSerial) == 0) {
-                // make sure that the queue was not scheduled for a good reason
-                Q_ASSERT(hq.runningJobsCount() == m_maxConnectionsPerHost);
-            }
+        if (prevRunningJobs != hq.runningJobsCount()) {
+            // we have dequeued a previously running job
+            Q_ASSERT(prevRunningJobs - 1 == hq.runningJobsCount());
+            m_runningJobsCount--;
+            Q_ASSERT(m_runningJobsCount >= 0);
         } else {
-            if (prevRunningJobs != hq.runningJobsCount()) {
-                // we have dequeued a previously running job
-                Q_ASSERT(prevRunningJobs - 1 == hq.runningJobsCount());
-                m_runningJobsCount--;
-                Q_ASSERT(m_runningJobsCount >= 0);
-            }
-        }
-        if (!hq.isQueueEmpty() && hq.runningJobsCount() < m_maxConnectionsPerHost) {
-            // this may be a no-op, but it's faster than first checking if it's already in.
-            m_queuesBySerial.insert(hq.lowestSerial(), &hq);
+            // we have dequeued a job that was still waiting
+            Q_ASSERT(!jobPriv->m_worker);
+            --m_statistics[int(SerialPicker::schedulingClass(jobPriv->m_schedSerial))].queuedJobs;
         }
+        // a connection may be free now, or the first job may be another one
+        updateQueuesBySerial(hq);
 
         if (hq.isEmpty()) {
             // no queued jobs, no running jobs. this destroys hq from above.
@@ -454,6 +595,11 @@ Worker *ProtoQueue::createWorker(const QString &protocol, SimpleJob *job, const
         connect(worker, &Worker::workerDied, scheduler(), [](KIO::Worker *worker) {
             schedulerPrivate()->slotWorkerDied(worker);
         });
+        connect(worker, &Worker::workerStarted, this, [this](KIO::Worker *, qint64 startupMSecs) {
+            ++m_startupStatistics.startedWorkers;
+            m_startupStatistics.totalStartupMSecs += startupMSecs;
+            m_startupStatistics.maxStartupMSecs = std::max(m_startupStatistics.maxStartupMSecs, startupMSecs);
+        });
     } else {
         qCWarning(KIO_CORE) << "couldn't create worker:" << errortext;
         if (job) {
@@ -503,26 +649,47 @@ void ProtoQueue::startAJob()
         return;
     }
 
+    if (m_reserveInteractiveWorker) {
+        // A queued job may have become exempt from the reservation after it was filed, e.g.
+        // once FileCopyJob made its get a sibling of the running put
+        for (auto &[hostname, hq] : m_queuesByHostname) {
+            if (!hq.indexedSerial() && !hq.isQueueEmpty()) {
+                updateQueuesBySerial(hq);
+            }
+        }
+    }
+
     QMap<int, HostQueue *>::iterator first = m_queuesBySerial.begin();
     if (first != m_queuesBySerial.end()) {
         // pick a job and maintain the queue invariant: lower serials first
         HostQueue *hq = first.value();
-        const int prevLowestSerial = first.key();
-        Q_UNUSED(prevLowestSerial);
-        Q_ASSERT(hq->lowestSerial() == prevLowestSerial);
-        // the following assertions should hold due to queueJob(), takeFirstInQueue() and
+        int serial = first.key();
+        if (m_startsAheadOfLowerClass >= s_maxStartsAheadOfLowerClass) {
+            // let the oldest job of a less urgent class through, so that a steady flow of
+            // interactive jobs can't hold back a copy forever
+            const auto [lowerClassHq, lowerClassSerial] = oldestStartableJobAfter(SerialPicker::schedulingClass(serial));
+            if (lowerClassHq) {
+                hq = lowerClassHq;
+                serial = lowerClassSerial;
+            }
+        }
+        const SchedulingClass startingClass = SerialPicker::schedulingClass(serial);
+        if (isLessUrgentJobQueued(startingClass)) {
+            ++m_startsAheadOfLowerClass;
+        } else {
+            m_startsAheadOfLowerClass = 0;
+        }
+
+        // the following assertions should hold due to queueJob(), takeQueuedJob() and
         // removeJob() being correct
-        Q_ASSERT(hq->runningJobsCount() < m_maxConnectionsPerHost);
-        SimpleJob *startingJob = hq->takeFirstInQueue();
+        Q_ASSERT(hq->indexedSerial() == hq->lowestSerial());
+        Q_ASSERT(canStartJob(*hq, hq->queuedJob(serial)));
+        SimpleJob *startingJob = hq->takeQueuedJob(serial);
         Q_ASSERT(hq->runningJobsCount() <= m_maxConnectionsPerHost);
-        Q_ASSERT(hq->lowestSerial() != prevLowestSerial);
 
-        m_queuesBySerial.erase(first);
-        // we've increased hq's runningJobsCount() by calling nexStartingJob()
+        // we've increased hq's runningJobsCount() by calling takeQueuedJob()
         // so we need to check again.
-        if (!hq->isQueueEmpty() && hq->runningJobsCount() < m_maxConnectionsPerHost) {
-            m_queuesBySerial.insert(hq->lowestSerial(), hq);
-        }
+        updateQueuesBySerial(*hq);
 
         // always increase m_runningJobsCount because it's correct if there is a worker and if there
         // is no worker, removeJob() will balance the number again. removeJob() would decrease the
@@ -531,12 +698,33 @@ void ProtoQueue::startAJob()
         // so increase the count here already.
         m_runningJobsCount++;
 
+        SimpleJobPrivate *jobPriv = SimpleJobPrivate::get(startingJob);
+        SchedulingClassStatistics &statistics = m_statistics[int(startingClass)];
+        const qint64 waited = m_clock.elapsed() - jobPriv->m_schedQueuedAt;
+        --statistics.queuedJobs;
+        ++statistics.startedJobs;
+        statistics.totalWaitMSecs += waited;
+        statistics.maxWaitMSecs = std::max(statistics.maxWaitMSecs, waited);
+
         bool isNewWorker = false;
         Worker *worker = m_workerManager.takeWorkerForJob(startingJob);
-        SimpleJobPrivate *jobPriv = SimpleJobPrivate::get(startingJob);
         if (!worker) {
             isNewWorker = true;
             worker = createWorker(jobPriv->m_protocol, startingJob, jobPriv->m_url);
+            if (worker && worker->worker_pid() == 0 && !m_warmInProcessWorkers) {
+                m_inProcessWorkers = true;
+            } else if (worker) {
+                ++m_startupStatistics.coldStarts;
+            }
+        } else if (worker->m_warm) {
+            // it still needs everything a new worker gets
+            worker->m_warm = false;
+            isNewWorker = true;
+            ++m_startupStatistics.warmStarts;
+        }
+        if (m_warmWorkers > 0 && m_startupStatistics.coldStarts >= s_coldStartsBeforeWarming) {
+            // after this job has started
+            m_warmPoolTimer.start();
         }
 
         if (worker) {
@@ -851,7 +1039,7 @@ ProtoQueue *SchedulerPrivate::protoQ(const QString &protocol, const QString &hos
     if (!pq) {
         // qDebug() << "creating ProtoQueue instance for" << protocol;
 
-        const int maxWorkers = KProtocolInfo::maxWorkers(protocol);
+        int maxWorkers = KProtocolInfo::maxWorkers(protocol);
         int maxWorkersPerHost = -1;
         if (!host.isEmpty()) {
             bool ok = false;
@@ -863,12 +1051,64 @@ ProtoQueue *SchedulerPrivate::protoQ(const QString &protocol, const QString &hos
         if (maxWorkersPerHost == -1) {
             maxWorkersPerHost = KProtocolInfo::maxWorkersPerHost(protocol);
         }
+#ifdef BUILD_TESTING
+        if (const auto it = m_testProtocolLimits.constFind(protocol); it != m_testProtocolLimits.constEnd()) {
+            std::tie(maxWorkers, maxWorkersPerHost) = *it;
+        }
+#endif
+        // Keep a connection for what views wait for, unless configured otherwise
+        bool reserveInteractiveWorker = true;
+        if (!host.isEmpty()) {
+            const QString value = WorkerConfig::self()->configData(protocol, host, QStringLiteral("ReserveInteractiveConnection"));
+            if (!value.isEmpty()) {
+                reserveInteractiveWorker = value.compare(QLatin1String("false"), Qt::CaseInsensitive) != 0 && value != QLatin1String("0");
+            }
+        }
+        int warmWorkers = s_defaultWarmWorkers;
+        {
+            bool ok = false;
+            const int value = WorkerConfig::self()->configData(protocol, host, QStringLiteral("WarmWorkers")).toInt(&ok);
+            if (ok) {
+                warmWorkers = value;
+            }
+        }
+#ifdef BUILD_TESTING
+        const auto testWarmWorkers = m_testProtocolWarmWorkers.constFind(protocol);
+        if (testWarmWorkers != m_testProtocolWarmWorkers.constEnd()) {
+            warmWorkers = *testWarmWorkers;
+        }
+#endif
         // Never allow maxWorkersPerHost to exceed maxWorkers.
-        pq = new ProtoQueue(maxWorkers, qMin(maxWorkers, maxWorkersPerHost));
+        pq = new ProtoQueue(protocol, maxWorkers, qMin(maxWorkers, maxWorkersPerHost), reserveInteractiveWorker, warmWorkers);
+#ifdef BUILD_TESTING
+        pq->setWarmInProcessWorkers(testWarmWorkers != m_testProtocolWarmWorkers.constEnd());
+#endif
         m_protocols.insert(protocol, pq);
     }
     return pq;
 }
 
+std::array<SchedulingClassStatistics, s_schedulingClassCount> KIO::schedulerStatistics(const QString &protocol)
+{
+    return schedulerPrivate()->statistics(protocol);
+}
+
+WorkerStartupStatistics KIO::workerStartupStatistics(const QString &protocol)
+{
+    return schedulerPrivate()->startupStatistics(protocol);
+}
+
+#ifdef BUILD_TESTING
+void KIO::setTestProtocolLimits(const QString &protocol, int maxWorkers, int maxWorkersPerHost)
+{
+    schedulerPrivate()->m_testProtocolLimits.insert(protocol, {maxWorkers, maxWorkersPerHost});
+}
+
+void KIO::setTestProtocolWarmWorkers(const QString &protocol, int warmWorkers)
+{
+    schedulerPrivate()->m_testProtocolWarmWorkers.insert(protocol, warmWorkers);
+}
+#endif
+
 #include "moc_scheduler.cpp"
 #include "moc_scheduler_p.cpp"
@@ -8,14 +8,62 @@
 #ifndef SCHEDULER_P_H
 #define SCHEDULER_P_H
 
+#include "kiocore_export.h"
 #include "worker_p.h"
 
+#include <QElapsedTimer>
 #include <QSet>
 #include <QTimer>
+
+#include <array>
+#include <utility>
 // #define SCHEDULER_DEBUG
 
 namespace KIO
 {
+// How urgently a job wants a worker. Queued jobs of a class all start before those of the next
+// one, except that every few starts one of a lower class goes first so that it isn't starved.
+enum class SchedulingClass {
+    Interactive, // what a view or a dialog waits for: stat, listing, mimetype
+    Normal,
+    Background, // bulk transfers and deletions, as done for CopyJob and DeleteJob
+};
+static constexpr int s_schedulingClassCount = 3;
+
+SchedulingClass schedulingClassForCommand(int command);
+
+// What ProtoQueue did for the jobs of one class, since it was created
+struct SchedulingClassStatistics {
+    int queuedJobs = 0; // waiting for a worker right now
+    quint64 startedJobs = 0;
+    qint64 totalWaitMSecs = 0; // from being queued to getting a worker
+    qint64 maxWaitMSecs = 0;
+};
+
+// The statistics of the jobs of protocol, indexed by SchedulingClass; all zeros when no job used it yet
+KIOCORE_EXPORT std::array<SchedulingClassStatistics, s_schedulingClassCount> schedulerStatistics(const QString &protocol);
+
+// How the out-of-process workers of a protocol were started, since its ProtoQueue was created
+struct WorkerStartupStatistics {
+    quint64 coldStarts = 0; // jobs that had to wait for a worker to be spawned for them
+    quint64 warmStarts = 0; // jobs that got a worker spawned ahead of them
+    quint64 warmSpawns = 0; // workers spawned ahead of the jobs, the warm starts took some of them
+    quint64 startedWorkers = 0; // workers that connected back, the ones the times are about
+    qint64 totalStartupMSecs = 0; // from spawning kioworker to its connecting back
+    qint64 maxStartupMSecs = 0;
+};
+
+KIOCORE_EXPORT WorkerStartupStatistics workerStartupStatistics(const QString &protocol);
+
+#ifdef BUILD_TESTING
+// Connection limits for a kio-test protocol, which has no metadata to read them from.
+// Only used when the ProtoQueue of protocol is created, i.e. before its first job.
+KIOCORE_EXPORT void setTestProtocolLimits(const QString &protocol, int maxWorkers, int maxWorkersPerHost);
+// The size of the warm pool of a kio-test protocol. Its workers are threads, warmed as if they
+// were processes; they never connect back, so startedWorkers stays 0.
+KIOCORE_EXPORT void setTestProtocolWarmWorkers(const QString &protocol, int warmWorkers);
+#endif
+
 // The worker manager manages the list of idle workers that can be reused
 class WorkerManager : public QObject
 {
@@ -48,6 +96,8 @@ class HostQueue
 {
 public:
     int lowestSerial() const;
+    // The lowest serial of the queued jobs of schedulingClass or a less urgent one
+    int lowestSerial(SchedulingClass schedulingClass) const;
 
     bool isQueueEmpty() const
     {
@@ -71,9 +121,25 @@ public:
     {
         return m_runningJobs.contains(job);
     }
+    // Whether a running job has the same parent job as job, like the put of a FileCopyJob for its get
+    bool isSiblingRunning(KIO::SimpleJob *job) const;
+
+    // The serial this queue is filed under in ProtoQueue::m_queuesBySerial, 0 if it isn't
+    int indexedSerial() const
+    {
+        return m_indexedSerial;
+    }
+    void setIndexedSerial(int serial)
+    {
+        m_indexedSerial = serial;
+    }
 
     void queueJob(KIO::SimpleJob *job);
-    KIO::SimpleJob *takeFirstInQueue();
+    KIO::SimpleJob *queuedJob(int serial) const
+    {
+        return m_queuedJobs.value(serial);
+    }
+    KIO::SimpleJob *takeQueuedJob(int serial);
     bool removeJob(KIO::SimpleJob *job);
 
     QList<KIO::SimpleJob *> allJobs() const;
@@ -82,6 +148,7 @@ public:
 private:
     QMap<int, KIO::SimpleJob *> m_queuedJobs;
     QSet<KIO::SimpleJob *> m_runningJobs;
+    int m_indexedSerial = 0;
 };
 
 class SchedulerPrivate;
@@ -91,12 +158,25 @@ class SerialPicker
 public:
     // note that serial number zero is the default value from job_p.h and invalid!
 
-    int next()
+    // The serials of a class all come before those of the next one, so sorting by serial
+    // sorts by class first, then by age
+    int next(SchedulingClass schedulingClass)
     {
         if (m_offset >= m_jobsPerPriority) {
             m_offset = 1;
         }
-        return m_offset++;
+        return int(schedulingClass) * m_jobsPerPriority + m_offset++;
+    }
+
+    static SchedulingClass schedulingClass(int serial)
+    {
+        return SchedulingClass(serial / m_jobsPerPriority);
+    }
+
+    // Lower than the serial of any job of schedulingClass, higher than those of more urgent classes
+    static int firstSerial(SchedulingClass schedulingClass)
+    {
+        return int(schedulingClass) * m_jobsPerPriority;
     }
 
 private:
@@ -111,7 +191,10 @@ class ProtoQueue : public QObject
 {
     Q_OBJECT
 public:
-    ProtoQueue(int maxWorkers, int maxWorkersPerHost);
+    // With reserveInteractiveWorker, the last connection allowed to a host is kept for
+    // SchedulingClass::Interactive jobs. Once jobs had to wait for out-of-process workers to
+    // start a few times, warmWorkers idle workers are kept spawned ahead of the next jobs.
+    ProtoQueue(const QString &protocol, int maxWorkers, int maxWorkersPerHost, bool reserveInteractiveWorker = false, int warmWorkers = 0);
     ~ProtoQueue() override;
 
     void queueJob(KIO::SimpleJob *job);
@@ -120,20 +203,53 @@ public:
     bool removeWorker(KIO::Worker *worker);
     QList<KIO::Worker *> allWorkers() const;
     void killAllJobs();
+    std::array<SchedulingClassStatistics, s_schedulingClassCount> statistics() const;
+    WorkerStartupStatistics startupStatistics() const;
+    // Warms workers that turn out to run in-process too, for testing the warm pool
+    void setWarmInProcessWorkers(bool warm)
+    {
+        m_warmInProcessWorkers = warm;
+    }
 
 private Q_SLOTS:
     // start max one (non-connected) job and return
     void startAJob();
+    // spawn idle workers until there are m_warmWorkers of them not set up for a job yet
+    void fillWarmPool();
 
 private:
+    // Whether the queued job may take a connection to its host now
+    bool canStartJob(const HostQueue &hq, KIO::SimpleJob *job) const;
+    // Whether the first job of hq may start now, which is what puts it in m_queuesBySerial
+    bool canStartAJob(const HostQueue &hq) const;
+    // Puts hq in or out of m_queuesBySerial after its jobs changed
+    void updateQueuesBySerial(HostQueue &hq);
+    // Whether a job of a class less urgent than schedulingClass waits for a worker
+    bool isLessUrgentJobQueued(SchedulingClass schedulingClass) const;
+    // The oldest job of a class less urgent than schedulingClass that may start now, as the
+    // serial it is queued under and its host queue; the latter is null if there is none
+    std::pair<HostQueue *, int> oldestStartableJobAfter(SchedulingClass schedulingClass) const;
+
     SerialPicker m_serialPicker;
     QTimer m_startJobTimer;
     QMap<int, HostQueue *> m_queuesBySerial;
     std::unordered_map<QString, HostQueue> m_queuesByHostname;
     WorkerManager m_workerManager;
+    const QString m_protocol;
     int m_maxConnectionsPerHost;
     int m_maxConnectionsTotal;
     int m_runningJobsCount;
+    bool m_reserveInteractiveWorker;
+    int m_warmWorkers;
+    // Set once a worker turned out to run in-process, there is nothing to gain from warming those
+    bool m_inProcessWorkers = false;
+    bool m_warmInProcessWorkers = false;
+    QTimer m_warmPoolTimer;
+    WorkerStartupStatistics m_startupStatistics;
+    // Jobs started in a row while an older job of a lower class was waiting
+    int m_startsAheadOfLowerClass = 0;
+    QElapsedTimer m_clock;
+    std::array<SchedulingClassStatistics, s_schedulingClassCount> m_statistics;
 };
 
 } // namespace KIO
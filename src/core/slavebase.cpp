@@ -755,6 +755,15 @@ void SlaveBase::listEntry(const UDSEntry &entry)
 
 void SlaveBase::listEntries(const UDSEntryList &list)
 {
+    if (d->runInThread) {
+        // The application shares our address space: hand the list over instead of serializing it,
+        // the connection backend falls back to serializing if its peer is not in-process after all.
+        if (!d->appConnection.sendEntries(MSG_LIST_ENTRIES, list)) {
+            exit();
+        }
+        return;
+    }
+
     QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
 
@@ -18,12 +18,22 @@
 #include <QPointer>
 #include <QStandardPaths>
 #include <QTemporaryFile>
+#include <QUrlQuery>
+#include <QtEndian>
 #include <cerrno>
 
+#ifdef Q_OS_UNIX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #include "kiocoreconnectiondebug.h"
 
 using namespace KIO;
 
+static const QString s_framingQueryItem = QStringLiteral("framing");
+static const QString s_binaryFraming = QStringLiteral("binary");
+
 SocketConnectionBackend::SocketConnectionBackend(QObject *parent)
     : ConnectionBackend(parent)
     , socket(nullptr)
@@ -34,15 +44,26 @@ SocketConnectionBackend::SocketConnectionBackend(QObject *parent)
 
 SocketConnectionBackend::~SocketConnectionBackend()
 {
+    if (socket) {
+        // Like close(), the socket would drop what sendCommand() left queued on it
+        flushWrites();
+    }
 }
 
 void SocketConnectionBackend::close()
 {
     if (socket) {
+        // sendCommand() may have left tasks queued on the socket, don't drop them on the floor
+        flushWrites();
         socket->close();
     }
 }
 
+SocketConnectionBackend::Framing SocketConnectionBackend::sendFraming() const
+{
+    return m_sendFraming;
+}
+
 void SocketConnectionBackend::setSuspended(bool enable)
 {
     if (state != Connected) {
@@ -93,6 +114,11 @@ bool SocketConnectionBackend::connectToRemote(const QUrl &url)
     sock->connectToServer(path);
     socket = sock;
 
+    // The listening side told us in its address that it understands binary frames
+    if (QUrlQuery(url).queryItemValue(s_framingQueryItem) == s_binaryFraming) {
+        m_sendFraming = Framing::Binary;
+    }
+
     connect(socket, &QIODevice::readyRead, this, &SocketConnectionBackend::socketReadyRead);
     connect(socket, &QLocalSocket::disconnected, this, &SocketConnectionBackend::socketDisconnected);
     state = Connected;
@@ -124,6 +150,8 @@ SocketConnectionBackend::ConnectionResult SocketConnectionBackend::listenForRemo
     address.clear();
     address.setScheme(QStringLiteral("local"));
     address.setPath(sockname);
+    // Peers that predate binary framing only look at the path and ignore this
+    address.setQuery(QUrlQuery{{s_framingQueryItem, s_binaryFraming}});
     socketfile.setAutoRemove(false);
     socketfile.remove(); // can't bind if there is such a file
 
@@ -150,6 +178,9 @@ bool SocketConnectionBackend::waitForIncomingTask(int ms)
         return false; // socket has probably closed, what do we do?
     }
 
+    // The peer is most likely waiting for what we queued before it answers
+    socket->flush();
+
     signalEmitted = false;
     if (socket->bytesAvailable()) {
         socketReadyRead();
@@ -185,17 +216,32 @@ bool SocketConnectionBackend::sendCommand(int cmd, const QByteArray &data)
     Q_ASSERT(state == Connected);
     Q_ASSERT(socket);
 
-    char buffer[HeaderSize + 2];
-    sprintf(buffer, "%6zx_%2x_", static_cast<size_t>(data.size()), cmd);
-    socket->write(buffer, HeaderSize);
-    socket->write(data);
+    // The peer drops the connection on a frame that announces more, whichever the framing
+    if (data.size() > MaxTaskSize) {
+        qCWarning(KIO_CORE_CONNECTION) << this << "Not sending command" << cmd << "of" << data.size() << "bytes, more than a frame holds";
+        return false;
+    }
+
+    if (m_sendFraming == Framing::Binary) {
+        char header[BinaryHeaderSize];
+        header[0] = BinaryFrameMagic;
+        header[1] = 0; // reserved
+        qToLittleEndian<quint16>(static_cast<quint16>(cmd), header + 2);
+        qToLittleEndian<quint32>(static_cast<quint32>(data.size()), header + 4);
+        writeFrame(header, BinaryHeaderSize, data);
+    } else {
+        char buffer[HeaderSize + 2];
+        sprintf(buffer, "%6zx_%2x_", static_cast<size_t>(data.size()), cmd);
+        writeFrame(buffer, HeaderSize, data);
+    }
 
     // qCDebug(KIO_CORE) << this << "Sending command" << hex << cmd << "of"
     //         << data.size() << "bytes (" << socket->bytesToWrite()
     //         << "bytes left to write )";
 
-    // blocking mode:
-    while (socket->bytesToWrite() > 0 && socket->state() == QLocalSocket::LocalSocketState::ConnectedState) {
+    // Only block once the peer falls too far behind, everything below the high-water mark
+    // drains from the event loop or from the next waitForIncomingTask().
+    while (socket->bytesToWrite() > WriteQueueHighWaterMark && socket->state() == QLocalSocket::LocalSocketState::ConnectedState) {
         socket->waitForBytesWritten(-1);
     }
 
@@ -206,6 +252,62 @@ bool SocketConnectionBackend::sendCommand(int cmd, const QByteArray &data)
     return socket->state() == QLocalSocket::LocalSocketState::ConnectedState;
 }
 
+void SocketConnectionBackend::writeFrame(const char *header, qsizetype headerSize, const QByteArray &data)
+{
+#ifdef Q_OS_UNIX
+    // With nothing queued in QLocalSocket we can hand header and payload to the kernel in a
+    // single gathered write, without copying them into the socket's write buffer first. Only
+    // what the kernel did not take gets queued.
+    if (socket->bytesToWrite() == 0 && socket->state() == QLocalSocket::LocalSocketState::ConnectedState) {
+        iovec iov[2];
+        iov[0].iov_base = const_cast<char *>(header);
+        iov[0].iov_len = headerSize;
+        iov[1].iov_base = const_cast<char *>(data.constData());
+        iov[1].iov_len = data.size();
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = data.isEmpty() ? 1 : 2;
+
+        int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+        flags |= MSG_NOSIGNAL;
+#endif
+        ssize_t written;
+        do {
+            written = ::sendmsg(static_cast<int>(socket->socketDescriptor()), &msg, flags);
+        } while (written < 0 && errno == EINTR);
+
+        // On errors other than a full socket buffer, queue everything and let QLocalSocket
+        // run into the error itself so that it updates its state and emits disconnected().
+        if (written < 0) {
+            written = 0;
+        }
+
+        if (written < headerSize) {
+            socket->write(header + written, headerSize - written);
+            socket->write(data);
+        } else if (written - headerSize < data.size()) {
+            const qsizetype offset = written - headerSize;
+            socket->write(data.constData() + offset, data.size() - offset);
+        }
+        return;
+    }
+#endif
+    socket->write(header, headerSize);
+    socket->write(data);
+}
+
+bool SocketConnectionBackend::flushWrites()
+{
+    while (socket->bytesToWrite() > 0 && socket->state() == QLocalSocket::LocalSocketState::ConnectedState) {
+        if (!socket->waitForBytesWritten(30000)) {
+            return false;
+        }
+    }
+    return socket->bytesToWrite() == 0;
+}
+
 ConnectionBackend *SocketConnectionBackend::nextPendingConnection()
 {
     Q_ASSERT(state == Listening);
@@ -242,41 +344,23 @@ void SocketConnectionBackend::socketReadyRead()
         }
 
         qCDebug(KIO_CORE_CONNECTION) << this << "Got" << socket->bytesAvailable() << "bytes";
-        if (!pendingTask.has_value()) {
-            // We have to read the header
-            char buffer[HeaderSize];
-
-            if (socket->bytesAvailable() < HeaderSize) {
-                return; // wait for more data
-            }
-
-            socket->read(buffer, sizeof buffer);
-            buffer[6] = 0;
-            buffer[9] = 0;
-
-            const char *p = buffer;
-            while (*p == ' ') {
-                p++;
-            }
-            auto len = strtol(p, nullptr, 16);
-
-            p = buffer + 7;
-            while (*p == ' ') {
-                p++;
-            }
-            auto cmd = strtol(p, nullptr, 16);
-
-            pendingTask = Task{.cmd = static_cast<int>(cmd)};
-            pendingLen = len;
-
-            qCDebug(KIO_CORE_CONNECTION) << this << "Beginning of command" << pendingTask->cmd << "of size" << pendingLen;
+        if (!pendingTask.has_value() && !readHeader()) {
+            return; // wait for more data
         }
 
         QPointer<ConnectionBackend> that = this;
 
         const auto toRead = std::min<off_t>(socket->bytesAvailable(), pendingLen - pendingTask->data.size());
         qCDebug(KIO_CORE_CONNECTION) << socket << "Want to read" << toRead << "bytes; appending to already existing bytes" << pendingTask->data.size();
-        pendingTask->data += socket->read(toRead);
+        if (pendingTask->data.isEmpty() && toRead == pendingLen) {
+            // The whole payload is there, take the buffer read() hands us as is
+            pendingTask->data = socket->read(toRead);
+        } else {
+            if (pendingTask->data.isEmpty()) {
+                pendingTask->data.reserve(pendingLen);
+            }
+            pendingTask->data += socket->read(toRead);
+        }
 
         if (pendingTask->data.size() == pendingLen) { // read all data of this task -> emit it and reset
             signalEmitted = true;
@@ -291,13 +375,71 @@ void SocketConnectionBackend::socketReadyRead()
             return;
         }
 
-        // Do we have enough for an another read?
+        // Do we have enough for an another read? The binary header is the shorter one,
+        // readHeader() works out whether the full header of the next frame is there.
         if (!pendingTask.has_value()) {
-            shouldReadAnother = socket->bytesAvailable() >= HeaderSize;
+            shouldReadAnother = socket->bytesAvailable() >= BinaryHeaderSize;
         } else { // NOTE: if we don't have data pending we may still have a pendingTask that gets resumed when we get more data!
             shouldReadAnother = socket->bytesAvailable();
         }
     } while (shouldReadAnother);
 }
 
+bool SocketConnectionBackend::readHeader()
+{
+    char first;
+    if (socket->peek(&first, 1) != 1) {
+        return false;
+    }
+
+    if (first == BinaryFrameMagic) {
+        char buffer[BinaryHeaderSize];
+        if (socket->bytesAvailable() < BinaryHeaderSize) {
+            return false;
+        }
+        socket->read(buffer, sizeof buffer);
+
+        pendingTask = Task{.cmd = qFromLittleEndian<quint16>(buffer + 2)};
+        pendingLen = qFromLittleEndian<quint32>(buffer + 4);
+
+        // The peer speaks binary frames, so it will understand ours as well
+        m_sendFraming = Framing::Binary;
+    } else {
+        char buffer[HeaderSize];
+        if (socket->bytesAvailable() < HeaderSize) {
+            return false;
+        }
+        socket->read(buffer, sizeof buffer);
+        buffer[6] = 0;
+        buffer[9] = 0;
+
+        const char *p = buffer;
+        while (*p == ' ') {
+            p++;
+        }
+        auto len = strtol(p, nullptr, 16);
+
+        p = buffer + 7;
+        while (*p == ' ') {
+            p++;
+        }
+        auto cmd = strtol(p, nullptr, 16);
+
+        pendingTask = Task{.cmd = static_cast<int>(cmd)};
+        pendingLen = len;
+    }
+
+    // The length comes straight off the wire and sizes the buffer reserved for the payload,
+    // a peer announcing nonsense is not one we can keep talking to
+    if (pendingLen < 0 || pendingLen > MaxTaskSize) {
+        qCWarning(KIO_CORE_CONNECTION) << this << "Dropping connection, command" << pendingTask->cmd << "announces" << pendingLen << "bytes";
+        pendingTask = {};
+        socket->abort(); // emits disconnected, we may be gone once it returns
+        return false;
+    }
+
+    qCDebug(KIO_CORE_CONNECTION) << this << "Beginning of command" << pendingTask->cmd << "of size" << pendingLen;
+    return true;
+}
+
 #include "moc_socketconnectionbackend_p.cpp"
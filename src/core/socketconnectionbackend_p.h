@@ -23,6 +23,15 @@ namespace KIO
  *
  * ConnectionBackend talking to a peer over a QLocalSocket. Used for
  * out-of-process workers (and historically for in-process ones too).
+ *
+ * Two framings exist on the wire. The legacy one prefixes every task with an
+ * ASCII hex header ("%6zx_%2x_"). The binary one prefixes it with a fixed
+ * little-endian header that starts with BinaryFrameMagic, a byte that can never
+ * begin a legacy header, so incoming frames are always recognized by their first
+ * byte. A listening backend advertises binary framing in the query of its
+ * address; a peer connecting to such an address sends binary frames right away,
+ * and the accepting side switches to binary once it has received one. Peers that
+ * do not know about it keep talking the legacy framing in both directions.
  */
 class SocketConnectionBackend : public ConnectionBackend
 {
@@ -30,7 +39,18 @@ class SocketConnectionBackend : public ConnectionBackend
 
 public:
     static const int HeaderSize = 10;
+    static const int BinaryHeaderSize = 8;
+    static const char BinaryFrameMagic = '\xfe';
     static const int StandardBufferSize = 32 * 1024;
+    // Largest payload sent to or accepted from the peer, the most a legacy header can announce
+    static const long MaxTaskSize = 0xffffff;
+    // sendCommand() only blocks while more than this is queued for the peer
+    static const int WriteQueueHighWaterMark = 8 * StandardBufferSize;
+
+    enum class Framing {
+        Legacy,
+        Binary,
+    };
 
     struct ConnectionResult {
         bool success = true;
@@ -51,11 +71,21 @@ public:
     ConnectionResult listenForRemote();
     ConnectionBackend *nextPendingConnection();
 
+    /*!
+     * Returns the framing used for outgoing tasks.
+     */
+    Framing sendFraming() const;
+
 private:
+    bool readHeader();
+    void writeFrame(const char *header, qsizetype headerSize, const QByteArray &data);
+    bool flushWrites();
+
     QLocalSocket *socket;
     QLocalServer *localServer;
     std::optional<Task> pendingTask = std::nullopt;
     long pendingLen = 0; // expected payload size, valid while pendingTask has a value
+    Framing m_sendFraming = Framing::Legacy;
     bool signalEmitted;
 
 Q_SIGNALS:
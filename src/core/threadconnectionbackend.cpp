@@ -93,6 +93,21 @@ void ThreadConnectionBackend::drainIncoming()
 }
 
 bool ThreadConnectionBackend::sendCommand(int cmd, const QByteArray &data)
+{
+    // Share the payload (no copy): in-process workers must hand us an owned QByteArray,
+    // since we deliver it to the application asynchronously (after the worker has moved
+    // on). Its refcount keeps the bytes alive until the application has consumed them.
+    return enqueue(Task{.cmd = cmd, .data = data});
+}
+
+bool ThreadConnectionBackend::sendEntries(int cmd, const UDSEntryList &entries)
+{
+    // Same as for the payload of sendCommand(): the list and its entries are implicitly shared,
+    // the worker detaches from them if it modifies its copy after handing them over.
+    return enqueue(Task{.cmd = cmd, .entries = entries});
+}
+
+bool ThreadConnectionBackend::enqueue(Task &&task)
 {
     if (!m_channel) {
         return false;
@@ -113,10 +128,7 @@ bool ThreadConnectionBackend::sendCommand(int cmd, const QByteArray &data)
     if (out.closed) {
         return false;
     }
-    // Share the payload (no copy): in-process workers must hand us an owned QByteArray,
-    // since we deliver it to the application asynchronously (after the worker has moved
-    // on). Its refcount keeps the bytes alive until the application has consumed them.
-    out.queue.append(Task{.cmd = cmd, .data = data});
+    out.queue.append(std::move(task));
     out.dataAvailable.wakeOne(); // one consumer per direction
 
     // Post the wakeup to the event-loop consumer while still holding the mutex: the application
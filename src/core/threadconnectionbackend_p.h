@@ -36,6 +36,11 @@ namespace KIO
  * the caller's QByteArray and hands it to the peer asynchronously, so callers must
  * pass an OWNED QByteArray whose data outlives the task. In-process workers
  * (kio_file, kio_admin) honour this.
+ *
+ * sendEntries() goes one step further and skips serialization altogether: both
+ * ends share the address space, so the implicitly shared UDSEntryList is queued as
+ * the Task's typed payload and reaches the application without a save()/load()
+ * round trip.
  */
 class ThreadConnectionBackend : public ConnectionBackend
 {
@@ -61,6 +66,7 @@ public:
     void close() override;
     bool waitForIncomingTask(int ms) override;
     bool sendCommand(int command, const QByteArray &data) override;
+    bool sendEntries(int command, const UDSEntryList &entries) override;
 
 private Q_SLOTS:
     /// Emit commandReceived() for every queued task (drives the event-loop side).
@@ -93,6 +99,7 @@ private:
         std::atomic<bool> appDrainScheduled{false};
     };
 
+    bool enqueue(Task &&task); // queue task for the peer, applying back-pressure
     Direction &incoming(); // the direction this backend reads
     Direction &outgoing(); // the direction this backend writes
     void emitQueued(Direction &dir); // pop+emit commandReceived while not suspended
@@ -12,6 +12,7 @@
 
 #include "../kioworkers/file/stat_unix.h"
 #include "../utils_p.h"
+#include "kioglobal_p.h"
 
 #include <QDataStream>
 #include <QDebug>
@@ -281,6 +282,23 @@ static bool namesTheItem(uint udsField)
     }
 }
 
+// A process sees few distinct values of these fields, however many items it lists
+static bool hasFewValues(uint udsField)
+{
+    switch (udsField) {
+    case UDSEntry::UDS_USER:
+    case UDSEntry::UDS_GROUP:
+    case UDSEntry::UDS_MIME_TYPE:
+    case UDSEntry::UDS_GUESSED_MIME_TYPE:
+    case UDSEntry::UDS_ICON_NAME:
+    case UDSEntry::UDS_ICON_OVERLAY_NAMES:
+    case UDSEntry::UDS_DISPLAY_TYPE:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void UDSEntryPrivate::load(QDataStream &s)
 {
     clear();
@@ -323,7 +341,9 @@ void UDSEntryPrivate::load(QDataStream &s)
                 // a comparison.
                 QString &cachedString = cachedStrings[i];
                 if (buffer != cachedString) {
-                    cachedString = buffer;
+                    // The previous entry had another value, it may still be that of many other
+                    // entries of the process, e.g. those of another directory
+                    cachedString = hasFewValues(uds) ? KIOPrivate::internedString(buffer) : buffer;
                 }
 
                 stagedStrings.emplace_back(uds, cachedString);
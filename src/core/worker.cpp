@@ -117,6 +117,11 @@ void Worker::accept()
     connServer->deleteLater();
 
     connect(m_connection, &Connection::readyRead, this, &Worker::gotInput);
+
+    if (m_spawnTimer.isValid()) {
+        Q_EMIT workerStarted(this, m_spawnTimer.elapsed());
+        m_spawnTimer.invalidate();
+    }
 }
 
 std::unique_ptr<ThreadConnectionBackend> Worker::wireThreadConnection(Worker *worker)
@@ -517,6 +522,7 @@ Worker *Worker::createWorker(const QString &protocol, const QUrl &url, int &erro
     }
 
     qint64 pid = 0;
+    worker->m_spawnTimer.start();
     QProcess process;
     process.setProgram(kioworkerExecutable);
     process.setArguments(args);
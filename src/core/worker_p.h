@@ -205,6 +205,8 @@ public Q_SLOTS: // TODO KF6: make all three slots private
 
 Q_SIGNALS:
     void workerDied(KIO::Worker *worker);
+    // An out-of-process worker connected back, startupMSecs after it was spawned
+    void workerStarted(KIO::Worker *worker, qint64 startupMSecs);
 
 private:
     WorkerThread *m_workerThread = nullptr; // only set for in-process workers
@@ -217,7 +219,10 @@ private:
     quint16 m_port = 0;
     bool m_dead = false;
     QElapsedTimer m_idleSince;
+    QElapsedTimer m_spawnTimer; // only for out-of-process workers, until they connect back
     int m_refCount = 1;
+    // Spawned by ProtoQueue ahead of any job, it wasn't given a config and a host yet
+    bool m_warm = false;
 #ifdef BUILD_TESTING
     static inline std::weak_ptr<KIO::WorkerFactory> s_testFactory; // for testing purposes, can be set to a mock factory
 #endif
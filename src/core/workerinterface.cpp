@@ -46,15 +46,22 @@ bool WorkerInterface::dispatch()
 {
     Q_ASSERT(m_connection);
 
-    int cmd;
-    QByteArray data;
+    Task task;
+    if (!m_connection->read(task)) {
+        return false;
+    }
 
-    int ret = m_connection->read(&cmd, data);
-    if (ret == -1) {
+    // An in-process worker handed its entries over without serializing them
+    if (task.entries.has_value()) {
+        if (task.cmd == MSG_LIST_ENTRIES) {
+            Q_EMIT listEntries(*task.entries);
+            return true;
+        }
+        qCWarning(KIO_CORE) << "Unexpected typed payload for command" << task.cmd;
         return false;
     }
 
-    return dispatch(cmd, data);
+    return dispatch(task.cmd, task.data);
 }
 
 void WorkerInterface::calcSpeed()
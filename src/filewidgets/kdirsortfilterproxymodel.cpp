@@ -15,10 +15,20 @@
 #include <KConfigGroup>
 #include <KLocalizedString>
 #include <KSharedConfig>
+#include <kdirlister.h>
 #include <kdirmodel.h>
 #include <kfileitem.h>
 
 #include <QCollator>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <vector>
+
+// Below this many texts without a sort key, they cost less to compute on the fly than to hand
+// out to other threads
+static constexpr int s_minParallelSortKeys = 1000;
 
 class Q_DECL_HIDDEN KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate
 {
@@ -27,11 +37,38 @@ public:
 
     int compare(const QString &, const QString &, Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive);
     void slotNaturalSortingChanged();
+    // Computes the missing sort keys of the names of the top-level items of model on all cores,
+    // before a sort compares them
+    void prepareSortKeys(const QAbstractItemModel *model, Qt::CaseSensitivity caseSensitivity);
+    void clearSortKeys();
+    // Drops the sort keys of the names of item
+    void removeSortKeys(const KFileItem &item);
+    // Drops the sort keys of the items in rows first to last of parent, and of those below them
+    void removeSortKeys(const KDirModel *dirModel, const QModelIndex &parent, int first, int last);
 
     bool m_sortFoldersFirst;
     bool m_sortHiddenFilesLast;
     bool m_naturalSorting;
-    QCollator m_collator;
+
+    // A collator and the keys of the texts it sorted, per case sensitivity. Comparing two keys
+    // is a memcmp(), comparing two strings with a collator redoes the work of both keys.
+    struct Collation {
+        QCollator collator;
+        QHash<QString, QCollatorSortKey> sortKeys;
+
+        QCollatorSortKey sortKey(const QString &text)
+        {
+            auto it = sortKeys.constFind(text);
+            if (it == sortKeys.cend()) {
+                it = sortKeys.emplace(text, collator.sortKey(text));
+            }
+            return it.value();
+        }
+    };
+    Collation m_collations[2]; // indexed by Qt::CaseSensitivity
+
+    // To the source model, which keeps the sort keys in step with its items
+    QList<QMetaObject::Connection> m_sourceModelConnections;
 };
 
 KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::KDirSortFilterProxyModelPrivate()
@@ -46,8 +83,8 @@ int KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::compare(const QSt
     int result;
 
     if (m_naturalSorting) {
-        m_collator.setCaseSensitivity(caseSensitivity);
-        result = m_collator.compare(a, b);
+        Collation &collation = m_collations[caseSensitivity];
+        result = collation.sortKey(a).compare(collation.sortKey(b));
     } else {
         result = QString::compare(a, b, caseSensitivity);
     }
@@ -66,7 +103,95 @@ void KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::slotNaturalSorti
 {
     KConfigGroup g(KSharedConfig::openConfig(), QStringLiteral("KDE"));
     m_naturalSorting = g.readEntry("NaturalSorting", true);
-    m_collator.setNumericMode(m_naturalSorting);
+    for (Collation &collation : m_collations) {
+        collation.collator.setNumericMode(m_naturalSorting);
+    }
+    m_collations[Qt::CaseInsensitive].collator.setCaseSensitivity(Qt::CaseInsensitive);
+    m_collations[Qt::CaseSensitive].collator.setCaseSensitivity(Qt::CaseSensitive);
+    clearSortKeys();
+}
+
+void KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::prepareSortKeys(const QAbstractItemModel *model, Qt::CaseSensitivity caseSensitivity)
+{
+    const KDirModel *dirModel = qobject_cast<const KDirModel *>(model);
+    if (!m_naturalSorting || !dirModel) {
+        return;
+    }
+    Collation &collation = m_collations[caseSensitivity];
+
+    QStringList texts;
+    const int rowCount = dirModel->rowCount();
+    for (int row = 0; row < rowCount; ++row) {
+        const QString text = dirModel->itemForIndex(dirModel->index(row, 0)).text();
+        if (!collation.sortKeys.contains(text)) {
+            texts.append(text);
+        }
+    }
+    if (texts.size() < s_minParallelSortKeys) {
+        return;
+    }
+
+    const qsizetype chunkCount = std::max(QThread::idealThreadCount(), 1);
+    const qsizetype chunkSize = (texts.size() + chunkCount - 1) / chunkCount;
+    QList<QStringList> chunks;
+    for (qsizetype i = 0; i < texts.size(); i += chunkSize) {
+        chunks.append(texts.mid(i, chunkSize));
+    }
+
+    const QLocale locale = collation.collator.locale();
+    const auto computeSortKeys = [locale, caseSensitivity](const QStringList &chunk) {
+        // A collator of its own for each thread, a copy would share the one of the GUI thread
+        QCollator collator(locale);
+        collator.setNumericMode(true);
+        collator.setCaseSensitivity(caseSensitivity);
+        std::vector<QCollatorSortKey> sortKeys;
+        sortKeys.reserve(chunk.size());
+        for (const QString &text : chunk) {
+            sortKeys.push_back(collator.sortKey(text));
+        }
+        return sortKeys;
+    };
+    const QList<std::vector<QCollatorSortKey>> sortKeys = QtConcurrent::blockingMapped(chunks, computeSortKeys);
+
+    collation.sortKeys.reserve(collation.sortKeys.size() + texts.size());
+    for (qsizetype i = 0; i < chunks.size(); ++i) {
+        for (qsizetype j = 0; j < chunks.at(i).size(); ++j) {
+            collation.sortKeys.emplace(chunks.at(i).at(j), sortKeys.at(i).at(j));
+        }
+    }
+}
+
+void KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::clearSortKeys()
+{
+    for (Collation &collation : m_collations) {
+        collation.sortKeys.clear();
+    }
+}
+
+void KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::removeSortKeys(const KFileItem &item)
+{
+    // What subSortLessThan() compares names by
+    const QString text = item.text();
+    const QString name = item.name();
+    const QString lowerCaseName = item.name(true);
+    for (Collation &collation : m_collations) {
+        collation.sortKeys.remove(text);
+        collation.sortKeys.remove(name);
+        collation.sortKeys.remove(lowerCaseName);
+    }
+}
+
+void KDirSortFilterProxyModel::KDirSortFilterProxyModelPrivate::removeSortKeys(const KDirModel *dirModel, const QModelIndex &parent, int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        const QModelIndex index = dirModel->index(row, 0, parent);
+        removeSortKeys(dirModel->itemForIndex(index));
+        // The children of an expanded folder go with it
+        const int childCount = dirModel->rowCount(index);
+        if (childCount > 0) {
+            removeSortKeys(dirModel, index, 0, childCount - 1);
+        }
+    }
 }
 
 KDirSortFilterProxyModel::KDirSortFilterProxyModel(QObject *parent)
@@ -75,6 +200,51 @@ KDirSortFilterProxyModel::KDirSortFilterProxyModel(QObject *parent)
 {
     setDynamicSortFilter(true);
 
+    // Both sort() and invalidate() announce the new layout before sorting
+    connect(this, &QAbstractItemModel::layoutAboutToBeChanged, this, [this]() {
+        if (sortColumn() == KDirModel::Name) {
+            d->prepareSortKeys(sourceModel(), sortCaseSensitivity());
+        }
+    });
+    // The keys of the names of items gone, e.g. when another directory is opened, are of no use
+    connect(this, &QAbstractProxyModel::sourceModelChanged, this, [this]() {
+        for (const QMetaObject::Connection &connection : std::as_const(d->m_sourceModelConnections)) {
+            disconnect(connection);
+        }
+        d->m_sourceModelConnections.clear();
+        d->clearSortKeys();
+
+        KDirModel *dirModel = qobject_cast<KDirModel *>(sourceModel());
+        if (!dirModel) {
+            return;
+        }
+        d->m_sourceModelConnections = {
+            connect(dirModel,
+                    &QAbstractItemModel::rowsAboutToBeRemoved,
+                    this,
+                    [this, dirModel](const QModelIndex &parent, int first, int last) {
+                        d->removeSortKeys(dirModel, parent, first, last);
+                    }),
+            connect(dirModel,
+                    &QAbstractItemModel::modelReset,
+                    this,
+                    [this]() {
+                        d->clearSortKeys();
+                    }),
+            // A renamed item is compared by its new name from now on
+            connect(dirModel->dirLister(),
+                    &KCoreDirLister::refreshItems,
+                    this,
+                    [this](const QList<QPair<KFileItem, KFileItem>> &items) {
+                        for (const auto &[oldItem, newItem] : items) {
+                            if (oldItem.text() != newItem.text() || oldItem.name() != newItem.name()) {
+                                d->removeSortKeys(oldItem);
+                            }
+                        }
+                    }),
+        };
+    });
+
     // sort by the user visible string for now
     setSortCaseSensitivity(Qt::CaseInsensitive);
     sort(KDirModel::Name, Qt::AscendingOrder);
@@ -32,8 +32,19 @@
 #include <QPainter>
 #include <QPixmap>
 #include <QPointer>
+#include <QSet>
 #include <QTimer>
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#ifdef BUILD_TESTING
+// For kfilepreviewgeneratortest: called with each preview job started, and the items it is given
+KIOFILEWIDGETS_EXPORT std::function<void(KIO::PreviewJob *, const KFileItemList &)> kfilepreviewgenerator_preview_job_started;
+#endif
+
 class KFilePreviewGeneratorPrivate
 {
     class TileSet;
@@ -69,10 +80,22 @@ public:
 
     /*
      * Is invoked when the preview job has been finished and
-     * removes the job from the m_previewJobs list.
+     * removes the job from m_previewJobs. Once the items near the
+     * visible area are done, starts the previews of the others.
      */
     void slotPreviewJobFinished(KJob *job);
 
+    /*
+     * Remembers that the job job is done with the item url, whether
+     * it sent a preview for it or not.
+     */
+    void itemDone(KJob *job, const QUrl &url);
+
+    /*
+     * Removes the items of m_dispatchedItems from m_pendingItems.
+     */
+    void prunePendingItems();
+
     /* Synchronizes the icon of all items with the clipboard of cut items. */
     void updateCutItems();
 
@@ -155,12 +178,25 @@ public:
     void killPreviewJobs();
 
     /*
-     * Orders the items items in a way that the visible items
-     * are moved to the front of the list. When passing this
-     * list to a preview job, the visible items will get generated
-     * first.
+     * Orders the items items by their distance to the visible area:
+     * the visible items go first, then those of the next screen in the
+     * scroll direction, then the others from near to far. When passing
+     * this list to a preview job, the visible items will get generated
+     * first. Returns the number of visible and next screen items.
      */
-    void orderItems(KFileItemList &items);
+    int orderItems(KFileItemList &items);
+
+    /*
+     * Returns the rectangle of the item index of the directory model
+     * in the view, or an empty one if it is not laid out.
+     */
+    QRect visualRect(const QModelIndex &dirIndex) const;
+
+    /*
+     * Updates m_scrollDirection from where the anchor item of
+     * orderItems() has moved since.
+     */
+    void updateScrollDirection();
 
     /*
      * Helper method for KFilePreviewGenerator::updateIcons(). Adds
@@ -211,12 +247,6 @@ public:
 
     bool m_previewShown = true;
 
-    /*
-     * True, if m_pendingItems and m_dispatchedItems should be
-     * cleared when the preview jobs have been finished.
-     */
-    bool m_clearItemQueues = true;
-
     /*
      * True if a selection has been done which should cut items.
      */
@@ -241,7 +271,12 @@ public:
     QAbstractItemView *m_itemView = nullptr;
     QTimer *m_iconUpdateTimer = nullptr;
     QTimer *m_scrollAreaTimer = nullptr;
-    QList<KJob *> m_previewJobs;
+
+    /*
+     * The running preview jobs, with the URLs of the items each
+     * has not sent a preview or a failure for yet.
+     */
+    QHash<KJob *, QSet<QUrl>> m_previewJobs;
     QPointer<KDirModel> m_dirModel;
     QAbstractProxyModel *m_proxyModel = nullptr;
 
@@ -268,14 +303,27 @@ public:
     /*
      * Contains all items where a preview must be generated, but
      * where the preview job has not dispatched the items yet.
+     * Only the items near the visible area are given to preview
+     * jobs at once, the others wait here until these are done.
      */
     KFileItemList m_pendingItems;
 
     /*
-     * Contains all items, where a preview has already been
-     * generated by the preview jobs.
+     * Contains the URLs of all items, where a preview job is done
+     * with, whether it generated a preview or not. Instead of
+     * looking them up in m_pendingItems one by one, they are removed
+     * from there at once by prunePendingItems().
+     */
+    QSet<QUrl> m_dispatchedItems;
+
+    /*
+     * An item orderItems() found laid out, and its rectangle then.
+     * Where it is now tells in which direction the view has been
+     * scrolled since.
      */
-    KFileItemList m_dispatchedItems;
+    QUrl m_anchorUrl;
+    QRect m_anchorRect;
+    QPoint m_scrollDirection{0, 1};
 
     KFileItemList m_resolvedMimeTypes;
 
@@ -489,6 +537,7 @@ KFilePreviewGeneratorPrivate::~KFilePreviewGeneratorPrivate()
 
 void KFilePreviewGeneratorPrivate::requestSequenceIcon(const QModelIndex &index, int sequenceIndex)
 {
+    prunePendingItems();
     if (m_pendingItems.isEmpty() || (sequenceIndex == 0)) {
         KDirModel *dirModel = m_dirModel.data();
         if (!dirModel) {
@@ -516,15 +565,22 @@ void KFilePreviewGeneratorPrivate::updateIcons(const KFileItemList &items)
     applyCutItemEffect(items);
 
     KFileItemList orderedItems = items;
-    orderItems(orderedItems);
+    const int nearCount = orderItems(orderedItems);
 
     m_pendingItems.reserve(m_pendingItems.size() + orderedItems.size());
     for (const KFileItem &item : std::as_const(orderedItems)) {
+        // A changed item needs a new preview, even if it got one already
+        m_dispatchedItems.remove(item.url());
         m_pendingItems.append(item);
     }
 
     if (m_previewShown) {
-        createPreviews(orderedItems);
+        if (nearCount > 0) {
+            createPreviews(orderedItems.first(nearCount));
+        } else if (m_previewJobs.isEmpty()) {
+            createPreviews(orderedItems);
+        }
+        // else the other items wait for the running jobs, see slotPreviewJobFinished()
     } else {
         startMimeTypeResolving();
     }
@@ -635,35 +691,71 @@ void KFilePreviewGeneratorPrivate::addToPreviewQueue(const KFileItem &item, cons
     preview.url = item.url();
     preview.pixmap = icon;
     m_previews.append(preview);
-
-    m_pendingItems.removeOne(item);
-
-    m_dispatchedItems.append(item);
 }
 
 void KFilePreviewGeneratorPrivate::slotPreviewJobFinished(KJob *job)
 {
-    const int index = m_previewJobs.indexOf(job);
-    m_previewJobs.removeAt(index);
+    const auto it = m_previewJobs.find(job);
+    if (it == m_previewJobs.end()) {
+        // killed by killPreviewJobs() or resumeIconUpdates(), which take care of the items
+        return;
+    }
+    // The items the job did not report about won't get a preview either
+    for (const QUrl &url : std::as_const(*it)) {
+        m_dispatchedItems.insert(url);
+    }
+    m_previewJobs.erase(it);
 
-    if (m_previewJobs.isEmpty()) {
-        for (const KFileItem &item : std::as_const(m_pendingItems)) {
-            if (item.isMimeTypeKnown()) {
-                m_resolvedMimeTypes.append(item);
-            }
-        }
+    if (!m_previewJobs.isEmpty()) {
+        return;
+    }
 
-        if (m_clearItemQueues) {
-            m_pendingItems.clear();
-            m_dispatchedItems.clear();
-            m_pendingVisibleIconUpdates = 0;
-            auto dispatchFunc = [this]() {
-                dispatchIconUpdateQueue();
-            };
-            QMetaObject::invokeMethod(q, dispatchFunc, Qt::QueuedConnection);
+    prunePendingItems();
+    for (const KFileItem &item : std::as_const(m_pendingItems)) {
+        if (item.isMimeTypeKnown()) {
+            m_resolvedMimeTypes.append(item);
         }
-        m_sequenceIndices.clear(); // just to be sure that we don't leak anything
     }
+
+    if (m_iconUpdatesPaused) {
+        return;
+    }
+    if (m_previewShown && !m_pendingItems.isEmpty()) {
+        // The items near the visible area are done, now the
+        // others get their preview, from near to far.
+        orderItems(m_pendingItems);
+        createPreviews(m_pendingItems);
+        return;
+    }
+
+    m_pendingItems.clear();
+    m_dispatchedItems.clear();
+    m_pendingVisibleIconUpdates = 0;
+    auto dispatchFunc = [this]() {
+        dispatchIconUpdateQueue();
+    };
+    QMetaObject::invokeMethod(q, dispatchFunc, Qt::QueuedConnection);
+    m_sequenceIndices.clear(); // just to be sure that we don't leak anything
+}
+
+void KFilePreviewGeneratorPrivate::itemDone(KJob *job, const QUrl &url)
+{
+    const auto it = m_previewJobs.find(job);
+    if (it != m_previewJobs.end()) {
+        it->remove(url);
+    }
+    m_dispatchedItems.insert(url);
+}
+
+void KFilePreviewGeneratorPrivate::prunePendingItems()
+{
+    if (m_dispatchedItems.isEmpty()) {
+        return;
+    }
+    auto it = std::remove_if(m_pendingItems.begin(), m_pendingItems.end(), [this](const KFileItem &pending) {
+        return m_dispatchedItems.contains(pending.url());
+    });
+    m_pendingItems.erase(it, m_pendingItems.end());
 }
 
 void KFilePreviewGeneratorPrivate::updateCutItems()
@@ -763,9 +855,9 @@ void KFilePreviewGeneratorPrivate::dispatchIconUpdateQueue()
 void KFilePreviewGeneratorPrivate::pauseIconUpdates()
 {
     m_iconUpdatesPaused = true;
-    for (KJob *job : std::as_const(m_previewJobs)) {
-        Q_ASSERT(job);
-        job->suspend();
+    for (auto it = m_previewJobs.cbegin(); it != m_previewJobs.cend(); ++it) {
+        Q_ASSERT(it.key());
+        it.key()->suspend();
     }
     m_scrollAreaTimer->start();
 }
@@ -775,39 +867,58 @@ void KFilePreviewGeneratorPrivate::resumeIconUpdates()
     m_iconUpdatesPaused = false;
 
     // Before creating new preview jobs the m_pendingItems queue must be
-    // cleaned up by removing the already dispatched items. Implementation
-    // note: The order of the m_dispatchedItems queue and the m_pendingItems
-    // queue is usually equal. So even when having a lot of elements the
-    // nested loop is no performance bottle neck, as the inner loop is only
-    // entered once in most cases.
-    for (const KFileItem &item : std::as_const(m_dispatchedItems)) {
-        auto it = std::remove_if(m_pendingItems.begin(), m_pendingItems.end(), [&item](const KFileItem &pending) {
-            return pending.url() == item.url();
-        });
-        m_pendingItems.erase(it, m_pendingItems.end());
-    }
-
+    // cleaned up by removing the already dispatched items.
+    prunePendingItems();
     m_dispatchedItems.clear();
 
     m_pendingVisibleIconUpdates = 0;
     dispatchIconUpdateQueue();
 
-    if (m_previewShown) {
-        KFileItemList orderedItems = m_pendingItems;
-        orderItems(orderedItems);
-
-        // Kill all suspended preview jobs. Usually when a preview job
-        // has been finished, slotPreviewJobFinished() clears all item queues.
-        // This is not wanted in this case, as a new job is created afterwards
-        // for m_pendingItems.
-        m_clearItemQueues = false;
-        killPreviewJobs();
-        m_clearItemQueues = true;
-
-        createPreviews(orderedItems);
-    } else {
-        orderItems(m_pendingItems);
+    updateScrollDirection();
+    const int nearCount = orderItems(m_pendingItems);
+
+    if (!m_previewShown) {
         startMimeTypeResolving();
+        return;
+    }
+
+    QSet<QUrl> nearUrls;
+    nearUrls.reserve(nearCount);
+    for (int i = 0; i < nearCount; ++i) {
+        nearUrls.insert(m_pendingItems.at(i).url());
+    }
+
+    // The suspended preview jobs left with items that are still near the
+    // visible area go on, as a new job would have to start these items
+    // again. The others are killed, their items are asked for again in the
+    // new order.
+    QSet<QUrl> busyUrls;
+    for (auto it = m_previewJobs.begin(); it != m_previewJobs.end();) {
+        const bool stillNear = std::all_of(it->cbegin(), it->cend(), [&nearUrls](const QUrl &url) {
+            return nearUrls.contains(url);
+        });
+        KJob *job = it.key();
+        if (stillNear) {
+            busyUrls.unite(*it);
+            job->resume();
+            ++it;
+        } else {
+            it = m_previewJobs.erase(it);
+            job->kill();
+        }
+    }
+
+    KFileItemList nearItems;
+    for (int i = 0; i < nearCount; ++i) {
+        const KFileItem &item = m_pendingItems.at(i);
+        if (!busyUrls.contains(item.url())) {
+            nearItems.append(item);
+        }
+    }
+    if (!nearItems.isEmpty()) {
+        createPreviews(nearItems);
+    } else if (m_previewJobs.isEmpty()) {
+        createPreviews(m_pendingItems);
     }
 }
 
@@ -1011,67 +1122,140 @@ void KFilePreviewGeneratorPrivate::startPreviewJob(const KFileItemList &items, i
     }
 
     q->connect(job, &KIO::PreviewJob::gotPreview, q, [this, job](const KFileItem &item, const QPixmap &pixmap) {
+        itemDone(job, item.url());
         addToPreviewQueue(item, pixmap, job);
         m_dirModel->setData(m_dirModel->indexForItem(item), job->handlesSequences(), KDirModel::HandleSequencesRole);
     });
 
     q->connect(job, &KIO::PreviewJob::failed, q, [this, job](const KFileItem &item) {
+        itemDone(job, item.url());
         m_dirModel->setData(m_dirModel->indexForItem(item), job->handlesSequences(), KDirModel::HandleSequencesRole);
     });
 
     q->connect(job, &KIO::PreviewJob::finished, q, [this, job]() {
         slotPreviewJobFinished(job);
     });
-    m_previewJobs.append(job);
+
+    QSet<QUrl> urls;
+    urls.reserve(items.count());
+    for (const KFileItem &item : items) {
+        urls.insert(item.url());
+    }
+    m_previewJobs.insert(job, urls);
+#ifdef BUILD_TESTING
+    if (kfilepreviewgenerator_preview_job_started) {
+        kfilepreviewgenerator_preview_job_started(job, items);
+    }
+#endif
 }
 
 void KFilePreviewGeneratorPrivate::killPreviewJobs()
 {
-    for (KJob *job : std::as_const(m_previewJobs)) {
+    // Taken out first, slotPreviewJobFinished() ignores them then
+    const QList<KJob *> jobs = m_previewJobs.keys();
+    m_previewJobs.clear();
+    for (KJob *job : jobs) {
         Q_ASSERT(job);
         job->kill();
     }
-    m_previewJobs.clear();
     m_sequenceIndices.clear();
 
+    // No job is left to finish, so do what slotPreviewJobFinished() does after
+    // the last one: nothing is waited for anymore, and the previews already
+    // delivered get shown.
+    m_pendingVisibleIconUpdates = 0;
+    if (!jobs.isEmpty()) {
+        auto dispatchFunc = [this]() {
+            dispatchIconUpdateQueue();
+        };
+        QMetaObject::invokeMethod(q, dispatchFunc, Qt::QueuedConnection);
+    }
+
     m_iconUpdateTimer->stop();
     m_scrollAreaTimer->stop();
     m_changedItemsTimer->stop();
 }
 
-void KFilePreviewGeneratorPrivate::orderItems(KFileItemList &items)
+int KFilePreviewGeneratorPrivate::orderItems(KFileItemList &items)
 {
     KDirModel *dirModel = m_dirModel.data();
     if (!dirModel) {
-        return;
+        return 0;
     }
 
     // Order the items in a way that the preview for the visible items
     // is generated first, as this improves the felt performance a lot.
-    const bool hasProxy = m_proxyModel != nullptr;
-    const int itemCount = items.count();
+    // The next screen in the scroll direction comes right after, so that
+    // its previews are mostly there when the user gets to it.
     const QRect visibleArea = m_viewAdapter->visibleArea();
-
-    QModelIndex dirIndex;
-    QRect itemRect;
-    int insertPos = 0;
-    for (int i = 0; i < itemCount; ++i) {
-        dirIndex = dirModel->indexForItem(items.at(i)); // O(n) (n = number of rows)
-        if (hasProxy) {
-            const QModelIndex proxyIndex = m_proxyModel->mapFromSource(dirIndex);
-            itemRect = m_viewAdapter->visualRect(proxyIndex);
-        } else {
-            itemRect = m_viewAdapter->visualRect(dirIndex);
-        }
-
+    const QRect nextArea = visibleArea.translated(m_scrollDirection.x() * visibleArea.width(), m_scrollDirection.y() * visibleArea.height());
+
+    // Ranks of the items further away start here
+    constexpr qint64 farRank = std::numeric_limits<int>::max();
+    // Items not laid out, like those in collapsed folders of a tree view, go last
+    constexpr qint64 hiddenRank = std::numeric_limits<qint64>::max();
+
+    std::vector<std::pair<qint64, int>> ranks;
+    ranks.reserve(items.count());
+    int nearCount = 0;
+    for (int i = 0; i < items.count(); ++i) {
+        const QRect itemRect = visualRect(dirModel->indexForItem(items.at(i)));
+        qint64 rank = hiddenRank;
         if (itemRect.intersects(visibleArea)) {
-            // The current item is (at least partly) visible. Move it
-            // to the front of the list, so that the preview is
-            // generated earlier.
-            items.insert(insertPos, items.at(i));
-            items.removeAt(i + 1);
-            ++insertPos;
+            rank = 0;
             ++m_pendingVisibleIconUpdates;
+        } else if (!itemRect.isEmpty()) {
+            const int dx = std::max({0, visibleArea.left() - itemRect.right(), itemRect.left() - visibleArea.right()});
+            const int dy = std::max({0, visibleArea.top() - itemRect.bottom(), itemRect.top() - visibleArea.bottom()});
+            rank = 1 + dx + dy + (itemRect.intersects(nextArea) ? 0 : farRank);
+        }
+        if (rank < farRank) {
+            ++nearCount;
+        }
+        ranks.emplace_back(rank, i);
+    }
+    std::stable_sort(ranks.begin(), ranks.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    KFileItemList orderedItems;
+    orderedItems.reserve(items.count());
+    for (const auto &rank : ranks) {
+        orderedItems.append(items.at(rank.second));
+    }
+    items = orderedItems;
+
+    if (!ranks.empty() && ranks.front().first != hiddenRank) {
+        m_anchorUrl = items.constFirst().url();
+        m_anchorRect = visualRect(dirModel->indexForUrl(m_anchorUrl));
+    }
+    return nearCount;
+}
+
+QRect KFilePreviewGeneratorPrivate::visualRect(const QModelIndex &dirIndex) const
+{
+    if (!dirIndex.isValid()) {
+        return QRect();
+    }
+    if (m_proxyModel) {
+        return m_viewAdapter->visualRect(m_proxyModel->mapFromSource(dirIndex));
+    }
+    return m_viewAdapter->visualRect(dirIndex);
+}
+
+void KFilePreviewGeneratorPrivate::updateScrollDirection()
+{
+    KDirModel *dirModel = m_dirModel.data();
+    if (!dirModel || m_anchorUrl.isEmpty()) {
+        return;
+    }
+
+    // The items move the other way than the view is scrolled
+    const QRect anchorRect = visualRect(dirModel->indexForUrl(m_anchorUrl));
+    if (!anchorRect.isEmpty() && !m_anchorRect.isEmpty()) {
+        const QPoint moved = anchorRect.topLeft() - m_anchorRect.topLeft();
+        if (!moved.isNull()) {
+            m_scrollDirection = QPoint((moved.x() < 0) - (moved.x() > 0), (moved.y() < 0) - (moved.y() > 0));
         }
     }
 }
@@ -35,16 +35,19 @@
 #include <Solid/Device>
 #include <Solid/StorageAccess>
 
+#include <QCache>
 #include <QCoreApplication>
 #include <QCryptographicHash>
 #include <QFutureWatcher>
 #include <QJsonArray>
 #include <QMimeDatabase>
+#include <QMutex>
 #include <QSaveFile>
-#include <QTemporaryDir>
 #include <QTimer>
 #include <QtConcurrentRun>
 
+#include <vector>
+
 #ifdef WITH_QTDBUS
 #include <QDBusConnection>
 #include <QDBusError>
@@ -56,6 +59,53 @@ using namespace KIO;
 using namespace Qt::Literals;
 using namespace std::chrono_literals;
 
+// How long a preview may take, not counting the wait for a thumbnailer program to be run
+static constexpr auto s_previewTimeout = 5s;
+
+// Room for this many thumbnails of the size of the largest one kept yet, a few screens full
+static constexpr qsizetype s_memoryCacheThumbnails = 256;
+// But never more than a thousand thumbnails of the normal size, or a few dozen of the largest one
+static constexpr qsizetype s_maxMemoryCacheKiB = 64 * 1024;
+
+/*
+ * The thumbnails read from or written to the cache directory lately, shared by all the jobs of the
+ * process, so that scrolling back or opening a folder again doesn't read and decode the same PNG
+ * files again. They keep their Thumb:: texts, so they are checked like those read from disk.
+ */
+class ThumbnailMemoryCache
+{
+public:
+    QImage find(const QString &path)
+    {
+        QMutexLocker locker(&m_mutex);
+        const QImage *thumb = m_thumbs.object(path);
+        return thumb ? *thumb : QImage();
+    }
+
+    void insert(const QString &path, const QImage &thumb)
+    {
+        QMutexLocker locker(&m_mutex);
+        const qsizetype cost = std::max<qsizetype>(thumb.sizeInBytes() / 1024, 1);
+        // Grows with the thumbnails, a process showing small ones only keeps a little
+        if (cost * s_memoryCacheThumbnails > m_thumbs.maxCost()) {
+            m_thumbs.setMaxCost(std::min(cost * s_memoryCacheThumbnails, s_maxMemoryCacheKiB));
+        }
+        m_thumbs.insert(path, new QImage(thumb), cost);
+    }
+
+    void remove(const QString &path)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_thumbs.remove(path);
+    }
+
+private:
+    QMutex m_mutex;
+    QCache<QString, QImage> m_thumbs{0};
+};
+
+Q_GLOBAL_STATIC(ThumbnailMemoryCache, thumbnailMemoryCache)
+
 FilePreviewJob::FilePreviewJob(const KFileItem &fileItem, int parentDirDeviceId, const PreviewOptions &options, const PreviewSetupData &setupData)
     : m_fileItem(fileItem)
     , m_parentDirDeviceId(parentDirDeviceId)
@@ -75,13 +125,6 @@ FilePreviewJob::~FilePreviewJob()
             QFile::remove(m_tempName);
         }
     }
-    if (!m_tempDirPath.isEmpty()) {
-        QDir tempDir(m_tempDirPath);
-        if (tempDir.exists()) {
-            Q_ASSERT(m_tempDirPath.startsWith(QStandardPaths::writableLocation(QStandardPaths::TempLocation)));
-            tempDir.removeRecursively();
-        }
-    }
 }
 
 QString FilePreviewJob::parentDirPath(const QString &path)
@@ -96,6 +139,15 @@ QString FilePreviewJob::parentDirPath(const QString &path)
     return path;
 }
 
+bool FilePreviewJob::doKill()
+{
+    // The thumbnailer isn't a subjob; a file scrolled out of view gives its turn to the next one
+    if (m_standardThumbnailJob) {
+        m_standardThumbnailJob->kill();
+    }
+    return KIO::Job::doKill();
+}
+
 void FilePreviewJob::start()
 {
     QUrl targetUrl = m_fileItem.targetUrl();
@@ -126,7 +178,7 @@ void FilePreviewJob::start()
     // Stop the timeout timer as soon as the job finishes.
     connect(this, &KJob::finished, m_timeoutTimer, &QTimer::stop);
 
-    m_timeoutTimer->start(5s);
+    m_timeoutTimer->start(s_previewTimeout);
 }
 
 bool FilePreviewJob::preparePluginForMimetype(const QString &mimeType)
@@ -323,18 +375,31 @@ void FilePreviewJob::slotStatFile(KJob *job)
         return;
     }
 
+    const QString thumbFilePath = m_thumbPath + m_thumbName;
+    if (QImage thumb = thumbnailMemoryCache()->find(thumbFilePath); !thumb.isNull()) {
+        if (isCacheValid(thumb)) {
+            // Like loadThumbnailFromCache() does
+            thumb.setDevicePixelRatio(m_options.devicePixelRatio);
+            emitPreview(thumb);
+            emitResult();
+            return;
+        }
+        thumbnailMemoryCache()->remove(thumbFilePath);
+    }
+
     auto watcher = new QFutureWatcher<QImage>(this);
-    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher]() {
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, thumbFilePath]() {
         watcher->deleteLater();
         QImage thumb = watcher->result();
         if (isCacheValid(thumb)) {
+            thumbnailMemoryCache()->insert(thumbFilePath, thumb);
             emitPreview(thumb);
             emitResult();
         } else {
             getOrCreateThumbnail();
         }
     });
-    QFuture<QImage> future = QtConcurrent::run(loadThumbnailFromCache, QString(m_thumbPath + m_thumbName), m_options.devicePixelRatio);
+    QFuture<QImage> future = QtConcurrent::run(loadThumbnailFromCache, thumbFilePath, m_options.devicePixelRatio);
 
     watcher->setFuture(future);
 }
@@ -569,27 +634,21 @@ void FilePreviewJob::createThumbnail(const QString &pixPath)
     }
 
     if (m_standardThumbnailer) {
-        if (m_tempDirPath.isEmpty()) {
-            auto tempDir = QTemporaryDir();
-            Q_ASSERT(tempDir.isValid());
-
-            tempDir.setAutoRemove(false);
-            // restrict read access to current User
-            QFile::setPermissions(tempDir.path(), QFile::Permission::ReadOwner | QFile::Permission::WriteOwner | QFile::Permission::ExeOwner);
-
-            m_tempDirPath = tempDir.path();
-        }
-
-        if (pixPath.startsWith(m_tempDirPath)) {
+        const QString outputFolder = KIO::StandardThumbnailJob::outputFolder();
+        if (outputFolder.isEmpty() || pixPath.startsWith(outputFolder)) {
             // don't generate thumbnails for images already in temporary directory
             emitResult();
             return;
         }
 
-        m_standardThumbnailJob =
-            new KIO::StandardThumbnailJob(m_plugin.value(u"Exec"), m_options.size.width(), m_options.devicePixelRatio, pixPath, m_tempDirPath);
+        m_standardThumbnailJob = new KIO::StandardThumbnailJob(m_plugin.value(u"Exec"), m_options.size.width(), m_options.devicePixelRatio, pixPath);
         connect(m_standardThumbnailJob, &KIO::StandardThumbnailJob::data, this, &FilePreviewJob::slotStandardThumbData);
         connect(m_standardThumbnailJob, &KIO::StandardThumbnailJob::result, this, &FilePreviewJob::emitResult);
+        // The job may wait for the pool of thumbnailers, the timeout starts over once its program runs
+        m_timeoutTimer->stop();
+        connect(m_standardThumbnailJob, &KIO::StandardThumbnailJob::launched, this, [this] {
+            m_timeoutTimer->start(s_previewTimeout);
+        });
         m_standardThumbnailJob->start();
         return;
     }
@@ -602,7 +661,10 @@ void FilePreviewJob::createThumbnail(const QString &pixPath)
     connect(m_transferjob, &KIO::TransferJob::data, this, [this](KIO::Job *job, const QByteArray &data) {
         slotThumbData(job, data);
     });
-    connect(m_transferjob, &KIO::TransferJob::result, this, &FilePreviewJob::emitResult);
+    connect(m_transferjob, &KIO::TransferJob::result, this, [this](KJob *job) {
+        SHM::release(std::move(m_shm), job->error());
+        emitResult();
+    });
     int thumb_width = m_options.size.width();
     int thumb_height = m_options.size.height();
     if (save) {
@@ -692,6 +754,7 @@ void FilePreviewJob::saveThumbnailData(QImage &thumb)
             signature.append(QLatin1String(" (v") + thumbnailerVersion + QLatin1Char(')'));
         }
         thumb.setText(QStringLiteral("Software"), signature);
+        thumbnailMemoryCache()->insert(m_thumbPath + m_thumbName, thumb);
         // we don't need to block for the saving to complete, it can run in it's own time
         QFuture<void> future = QtConcurrent::run(saveThumbnailToCache, thumb, QString(m_thumbPath + m_thumbName));
     }
@@ -800,9 +863,56 @@ void FilePreviewJob::slotTimeout()
     emitResult();
 }
 
+// Segments are created in steps of this, so that thumbnails of about the same size share them
+static constexpr int s_segmentGranularity = 64 * 1024;
+// Creating and removing a segment per thumbnail costs as much as a small thumbnail itself, so
+// this much of them is kept for the next ones. Segments outlive a process that crashes, so
+// this is only enough for a screen full of thumbnails of normal size.
+static constexpr int s_maxPooledSegmentBytes = 4 * 1024 * 1024;
+
+struct SegmentPool {
+    QMutex mutex;
+    std::vector<std::unique_ptr<SHM>> segments;
+    int bytes = 0;
+    bool reapOnQuit = false;
+};
+
+Q_GLOBAL_STATIC(SegmentPool, segmentPool)
+
+// Removes the pooled segments when the application quits, in case it does not get to the
+// destruction of the statics
+static void reapSegmentPool()
+{
+    if (segmentPool.isDestroyed()) {
+        return;
+    }
+    SegmentPool *pool = segmentPool();
+    QMutexLocker locker(&pool->mutex);
+    pool->segments.clear();
+    pool->bytes = 0;
+}
+
 std::unique_ptr<SHM> SHM::create(int size)
 {
 #if WITH_SHM
+    {
+        SegmentPool *pool = segmentPool();
+        QMutexLocker locker(&pool->mutex);
+        auto best = pool->segments.end();
+        for (auto it = pool->segments.begin(); it != pool->segments.end(); ++it) {
+            if ((*it)->size() >= size && (best == pool->segments.end() || (*it)->size() < (*best)->size())) {
+                best = it;
+            }
+        }
+        if (best != pool->segments.end()) {
+            std::unique_ptr<SHM> shm = std::move(*best);
+            pool->segments.erase(best);
+            pool->bytes -= shm->size();
+            return shm;
+        }
+    }
+
+    size = (size + s_segmentGranularity - 1) / s_segmentGranularity * s_segmentGranularity;
     int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
 
     if (id == -1) {
@@ -816,12 +926,45 @@ std::unique_ptr<SHM> SHM::create(int size)
         return nullptr;
     }
 
-    return std::make_unique<SHM>(id, address);
+    return std::make_unique<SHM>(id, address, size);
 #else
     return nullptr;
 #endif
 }
 
+void SHM::recycle(std::unique_ptr<SHM> shm)
+{
+    if (!shm) {
+        return;
+    }
+    SegmentPool *pool = segmentPool();
+    QMutexLocker locker(&pool->mutex);
+    if (pool->bytes + shm->size() > s_maxPooledSegmentBytes) {
+        // The oldest go first
+        while (!pool->segments.empty() && pool->bytes + shm->size() > s_maxPooledSegmentBytes) {
+            pool->bytes -= pool->segments.front()->size();
+            pool->segments.erase(pool->segments.begin());
+        }
+        if (shm->size() > s_maxPooledSegmentBytes) {
+            return;
+        }
+    }
+    if (!pool->reapOnQuit) {
+        qAddPostRoutine(reapSegmentPool);
+        pool->reapOnQuit = true;
+    }
+    pool->bytes += shm->size();
+    pool->segments.push_back(std::move(shm));
+}
+
+void SHM::release(std::unique_ptr<SHM> shm, int error)
+{
+    if (error == KIO::ERR_USER_CANCELED) {
+        return;
+    }
+    recycle(std::move(shm));
+}
+
 int SHM::id() const
 {
     return m_id;
@@ -832,6 +975,11 @@ uchar *SHM::address() const
     return m_address;
 }
 
+int SHM::size() const
+{
+    return m_size;
+}
+
 SHM::~SHM()
 {
 #if WITH_SHM
@@ -840,9 +988,10 @@ SHM::~SHM()
 #endif
 }
 
-SHM::SHM(int id, uchar *address)
+SHM::SHM(int id, uchar *address, int size)
     : m_id(id)
     , m_address(address)
+    , m_size(size)
 {
 }
 
@@ -51,18 +51,25 @@ struct PreviewSetupData {
     QStringList enabledPluginIds;
 };
 
-class SHM
+class KIOGUI_TEST_EXPORT SHM
 {
 public:
-    SHM(int id, uchar *address);
+    SHM(int id, uchar *address, int size);
     ~SHM();
 
+    // Returns a segment of at least size bytes, one given back to recycle() if there is one
     static std::unique_ptr<SHM> create(int size);
+    // Keeps shm for a later create(), once no worker writes to it anymore
+    static void recycle(std::unique_ptr<SHM> shm);
+    // Gives shm back once the transfer of a thumbnail ended with error: recycled, unless the
+    // job was killed, as the worker may be writing to it still
+    static void release(std::unique_ptr<SHM> shm, int error);
 
     Q_DISABLE_COPY(SHM);
 
     int id() const;
     uchar *address() const;
+    int size() const;
 
 private:
     // Shared memory segment Id. The segment is allocated to a size
@@ -70,6 +77,7 @@ private:
     int m_id;
     // And the data area
     uchar *m_address;
+    int m_size;
 };
 
 // Time (in milliseconds) to wait for kio-fuse in a PreviewJob before giving up.
@@ -108,6 +116,7 @@ public:
     ~FilePreviewJob();
 
     void start() override;
+    bool doKill() override;
 
     QMap<QString, QString> thumbnailWorkerMetaData() const;
     QImage previewImage() const;
@@ -158,8 +167,6 @@ private:
     QMap<QString, QString> m_thumbnailWorkerMetaData;
     // Id of a device storing currently processed file
     int m_currentDeviceId = 0;
-    // the path of a unique temporary directory
-    QString m_tempDirPath;
     // Whether to try using KIOFuse to resolve files. Set to false if KIOFuse is not available.
     bool m_tryKioFuse = true;
     // The preview image. If when emitting return this is empty, job can be considered as failed.
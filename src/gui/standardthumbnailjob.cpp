@@ -4,11 +4,18 @@
 */
 
 #include "global.h"
+#include "kiogui_debug.h"
 #include "standardthumbnailjob_p.h"
 #include <KMacroExpander>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QImage>
 #include <QProcess>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
+#include <QThread>
+
+#include <optional>
 
 class ThumbnailerExpander : public KMacroExpanderBase
 {
@@ -71,91 +78,206 @@ int ThumbnailerExpander::expandEscapedMacro(const QString &str, int pos, QString
     return 2;
 }
 
+namespace KIO
+{
+// Runs the thumbnailer programs of all the jobs, no more at a time than there are CPUs: a folder
+// of files only external thumbnailers handle would otherwise start a process per visible file at
+// once. Used from the thread of the jobs only, like the jobs themselves.
+class ThumbnailerPool
+{
+public:
+    void enqueue(StandardThumbnailJob *job)
+    {
+        m_queue.append(job);
+        startQueued();
+    }
+
+    // Whether job was still waiting, and now won't run
+    bool dequeue(StandardThumbnailJob *job)
+    {
+        return m_queue.removeOne(job);
+    }
+
+    // Called once the process of a job started by the pool is over, or failed to start
+    void release()
+    {
+        --m_running;
+        startQueued();
+    }
+
+    void record(const QString &binary, qint64 elapsed, bool failed)
+    {
+        Latency &latency = m_latencies[binary];
+        ++latency.runs;
+        latency.failures += failed;
+        latency.total += elapsed;
+        latency.max = std::max(latency.max, elapsed);
+        qCDebug(KIO_GUI) << binary << "ran for" << elapsed << "ms, on average" << latency.total / latency.runs << "ms and at most" << latency.max
+                         << "ms over" << latency.runs << "runs," << latency.failures << "failed";
+    }
+
+    QString outputFolder()
+    {
+        if (!m_outputDir) {
+            m_outputDir.emplace();
+            // restrict read access to current User
+            QFile::setPermissions(m_outputDir->path(), QFile::Permission::ReadOwner | QFile::Permission::WriteOwner | QFile::Permission::ExeOwner);
+        }
+        return m_outputDir->isValid() ? m_outputDir->path() : QString();
+    }
+
+private:
+    void startQueued()
+    {
+        // A job failing to start releases its slot at once, and so starts the next one itself
+        if (m_running < m_maxRunning && !m_queue.isEmpty()) {
+            ++m_running;
+            m_queue.takeFirst()->launchProcess();
+        }
+    }
+
+    struct Latency {
+        int runs = 0;
+        int failures = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+    };
+
+    const int m_maxRunning = std::max(QThread::idealThreadCount(), 1);
+    int m_running = 0;
+    QList<StandardThumbnailJob *> m_queue;
+    // By thumbnailer program, only logged: they tell which thumbnailers slow down previews
+    QHash<QString, Latency> m_latencies;
+    // Shared by all the jobs, rather than a directory created and removed for each file
+    std::optional<QTemporaryDir> m_outputDir;
+};
+}
+
+Q_GLOBAL_STATIC(KIO::ThumbnailerPool, thumbnailerPool)
+
 class Q_DECL_HIDDEN KIO::StandardThumbnailJob::Private
 {
 public:
-    explicit Private(const QString &execString, int logicalWidth, qreal devicePixelRatio, const QString &inputFile, const QString &outputFolder)
+    explicit Private(const QString &execString, int logicalWidth, qreal devicePixelRatio, const QString &inputFile)
         : m_execString(execString)
         , m_logicalWidth(logicalWidth)
         , m_devicePixelRatio(devicePixelRatio)
         , m_inputFile(inputFile)
-        , m_outputFolder(outputFolder)
     {
     }
-    ~Private()
+
+    // Gives the slot of the job in the pool to the next one, once
+    void release()
     {
+        if (m_launched) {
+            m_launched = false;
+            thumbnailerPool->release();
+        }
+    }
+
+    // For a thumbnailer that ran until the end, not one killed
+    void finish(bool failed)
+    {
+        thumbnailerPool->record(m_binary, m_timer.elapsed(), failed);
+        release();
     }
 
     QString m_execString;
     int m_logicalWidth;
     qreal m_devicePixelRatio;
     QString m_inputFile;
-    QString m_outputFolder;
-    QProcess *m_proc;
-    QTemporaryFile *m_tempFile;
+    QString m_binary;
+    QProcess *m_proc = nullptr;
+    // Removes the thumbnail written by the thumbnailer once the job is gone
+    std::unique_ptr<QTemporaryFile> m_tempFile;
+    QElapsedTimer m_timer;
+    bool m_launched = false;
 };
 
-KIO::StandardThumbnailJob::StandardThumbnailJob(const QString &execString,
-                                                int logicalWidth,
-                                                qreal devicePixelRatio,
-                                                const QString &inputFile,
-                                                const QString &outputFolder)
-    : d(new Private(execString, logicalWidth, devicePixelRatio, inputFile, outputFolder))
+KIO::StandardThumbnailJob::StandardThumbnailJob(const QString &execString, int logicalWidth, qreal devicePixelRatio, const QString &inputFile)
+    : d(new Private(execString, logicalWidth, devicePixelRatio, inputFile))
 {
     setAutoDelete(true);
 }
 
-KIO::StandardThumbnailJob::~StandardThumbnailJob() = default;
+KIO::StandardThumbnailJob::~StandardThumbnailJob()
+{
+    if (!thumbnailerPool.isDestroyed()) {
+        thumbnailerPool->dequeue(this);
+        d->release();
+    }
+}
+
+QString KIO::StandardThumbnailJob::outputFolder()
+{
+    return thumbnailerPool->outputFolder();
+}
 
 bool KIO::StandardThumbnailJob::StandardThumbnailJob::doKill()
 {
-    d->m_proc->kill();
+    // Files scrolled out of view before their turn never get a process
+    if (thumbnailerPool->dequeue(this)) {
+        return true;
+    }
+    if (d->m_proc) {
+        d->m_proc->disconnect(this);
+        d->m_proc->kill();
+    }
+    d->release();
     return true;
 }
 
 void KIO::StandardThumbnailJob::StandardThumbnailJob::start()
 {
+    thumbnailerPool->enqueue(this);
+}
+
+void KIO::StandardThumbnailJob::launchProcess()
+{
+    d->m_launched = true;
+
     // Prepare the command
-    d->m_tempFile = new QTemporaryFile(QStringLiteral("%1/XXXXXX.png").arg(d->m_outputFolder));
-    if (!d->m_tempFile->open()) {
+    const QString outputFolder = thumbnailerPool->outputFolder();
+    d->m_tempFile = std::make_unique<QTemporaryFile>(QStringLiteral("%1/XXXXXX.png").arg(outputFolder));
+    if (outputFolder.isEmpty() || !d->m_tempFile->open()) {
         setErrorText(QStringLiteral("Standard Thumbnail Job had an error: could not open temporary file"));
         setError(KIO::ERR_CANNOT_OPEN_FOR_WRITING);
+        d->release();
         emitResult();
+        return;
     }
-    d->m_tempFile->setAutoRemove(false);
 
     ThumbnailerExpander thumbnailer(d->m_execString, d->m_logicalWidth * d->m_devicePixelRatio, d->m_inputFile, d->m_tempFile->fileName());
+    d->m_binary = thumbnailer.binary();
     // Emit data on command exit
-    d->m_proc = new QProcess();
-    connect(d->m_proc, &QProcess::finished, this, [=, this](const int exitCode, const QProcess::ExitStatus /* exitStatus */) {
-        d->m_proc->deleteLater();
-        if (exitCode != 0) {
+    d->m_proc = new QProcess(this);
+    connect(d->m_proc, &QProcess::finished, this, [this](const int exitCode, const QProcess::ExitStatus exitStatus) {
+        const bool failed = exitStatus != QProcess::NormalExit || exitCode != 0;
+        d->finish(failed);
+        if (failed) {
             setErrorText(QStringLiteral("Standard Thumbnail Job failed with exit code: %1 ").arg(exitCode));
             setError(KIO::ERR_CANNOT_LAUNCH_PROCESS);
             emitResult();
-
-            // clean temp file
-            d->m_tempFile->remove();
             return;
         }
         QImage thumb(d->m_tempFile->fileName());
         thumb.setDevicePixelRatio(supportedDevicePixelRatio(thumb.size(), QSize(d->m_logicalWidth, d->m_logicalWidth), d->m_devicePixelRatio));
         Q_EMIT data(this, thumb);
         emitResult();
-
-        // clean temp file
-        d->m_tempFile->remove();
     });
-    connect(d->m_proc, &QProcess::errorOccurred, this, [=, this](const QProcess::ProcessError error) {
-        d->m_proc->deleteLater();
+    connect(d->m_proc, &QProcess::errorOccurred, this, [this](const QProcess::ProcessError error) {
+        // Other errors are followed by finished()
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+        d->finish(true);
         setErrorText(QStringLiteral("Standard Thumbnail Job had an error: %1").arg(error));
         setError(KIO::ERR_CANNOT_LAUNCH_PROCESS);
         emitResult();
-
-        // clean temp file
-        d->m_tempFile->remove();
     });
-    d->m_proc->start(thumbnailer.binary(), thumbnailer.args());
+    Q_EMIT launched();
+    d->m_timer.start();
+    d->m_proc->start(d->m_binary, thumbnailer.args());
 }
 
 #include "moc_standardthumbnailjob_p.cpp"
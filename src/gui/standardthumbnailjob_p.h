@@ -4,10 +4,19 @@
 */
 #pragma once
 
+#include "kiogui_export.h"
 #include <kio/job.h>
 
 #include <QSize>
 
+#ifndef KIOGUI_TEST_EXPORT
+#ifdef BUILD_TESTING
+#define KIOGUI_TEST_EXPORT KIOGUI_EXPORT
+#else
+#define KIOGUI_TEST_EXPORT
+#endif
+#endif
+
 namespace KIO
 {
 
@@ -21,21 +30,31 @@ inline qreal supportedDevicePixelRatio(const QSize &imageSize, const QSize &logi
     return qBound(qreal(1), qreal(longerActual) / longerLogical, maxDevicePixelRatio);
 }
 
-class StandardThumbnailJob : public KIO::Job
+class KIOGUI_TEST_EXPORT StandardThumbnailJob : public KIO::Job
 {
     Q_OBJECT
 
 public:
-    StandardThumbnailJob(const QString &execString, int logicalWidth, qreal devicePixelRatio, const QString &inputFile, const QString &outputFile);
+    StandardThumbnailJob(const QString &execString, int logicalWidth, qreal devicePixelRatio, const QString &inputFile);
     ~StandardThumbnailJob() override;
 
+    // The directory all the jobs of the process have their thumbnailer write to, removed on exit.
+    // Empty when it can't be created.
+    static QString outputFolder();
+
+    // Waits for one of the thumbnailers already running to end, if there are as many as CPUs
     void start() override;
     bool doKill() override;
 
 Q_SIGNALS:
     void data(KIO::Job *job, const QImage &thumb);
+    // The thumbnailer program is being started, the job waited for the pool until now
+    void launched();
 
 private:
+    friend class ThumbnailerPool;
+    void launchProcess();
+
     class Private;
     std::unique_ptr<Private> const d;
     Q_DISABLE_COPY(StandardThumbnailJob)
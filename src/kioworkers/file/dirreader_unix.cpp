@@ -0,0 +1,127 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "dirreader_unix.h"
+
+#include "config-kioworker-file.h"
+
+#include <qplatformdefs.h>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+
+// getdents64() only got a glibc wrapper in 2.30, call it directly. The record layout is the
+// kernel's struct linux_dirent64.
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Large enough for a couple of thousand entries per syscall
+static constexpr qsizetype s_direntBufferSize = 128 * 1024;
+#endif
+
+DirReader::DirReader(int dirfd)
+    : m_fd(dirfd)
+{
+    if (m_fd < 0) {
+        m_error = errno;
+        return;
+    }
+#ifndef Q_OS_LINUX
+    // fdopendir takes the descriptor over, so closedir is what closes it.
+    m_dir = fdopendir(m_fd);
+    if (!m_dir) {
+        m_error = errno;
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+DirReader::DirReader(int dirfd, const char *path)
+    : DirReader(::openat(dirfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+{
+}
+
+DirReader::~DirReader()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+#else
+    if (m_dir) {
+        closedir(m_dir);
+    }
+#endif
+}
+
+bool DirReader::isValid() const
+{
+    return m_fd >= 0;
+}
+
+int DirReader::fd() const
+{
+    return m_fd;
+}
+
+int DirReader::error() const
+{
+    return m_error;
+}
+
+bool DirReader::next(Entry &entry)
+{
+    if (m_fd < 0) {
+        return false;
+    }
+#ifdef Q_OS_LINUX
+    if (m_pos >= m_end) {
+        if (m_buffer.isEmpty()) {
+            m_buffer.resize(s_direntBufferSize);
+        }
+        long n;
+        do {
+            n = ::syscall(SYS_getdents64, m_fd, m_buffer.data(), m_buffer.size());
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            m_error = n < 0 ? errno : 0;
+            return false;
+        }
+        m_pos = 0;
+        m_end = n;
+    }
+    const auto *dirent = reinterpret_cast<const LinuxDirent64 *>(m_buffer.constData() + m_pos);
+    m_pos += dirent->d_reclen;
+    entry.name = dirent->d_name;
+    entry.type = dirent->d_type;
+    return true;
+#else
+    errno = 0;
+    const QT_DIRENT *dirent = QT_READDIR(m_dir);
+    if (!dirent) {
+        m_error = errno;
+        return false;
+    }
+    entry.name = dirent->d_name;
+#if HAVE_DIRENT_D_TYPE
+    entry.type = dirent->d_type;
+#else
+    entry.type = DT_UNKNOWN;
+#endif
+    return true;
+#endif
+}
@@ -0,0 +1,69 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef DIRREADER_UNIX_H
+#define DIRREADER_UNIX_H
+
+#include <QByteArray>
+
+#include <dirent.h>
+
+#ifndef DT_UNKNOWN
+// No d_type in struct dirent on this system
+#define DT_UNKNOWN 0
+#endif
+
+/*
+ * Reads the entries of a directory from a descriptor on it.
+ *
+ * On Linux the entries are fetched with getdents64() into one large buffer, so a
+ * directory with many entries costs a handful of syscalls instead of one readdir()
+ * refill per 32 kB. Elsewhere this wraps fdopendir()/readdir().
+ *
+ * The descriptor stays available through fd() for the *at() calls (fstatat, statx,
+ * openat, unlinkat...) on the entries, so their paths don't have to be resolved from
+ * the root again. It is closed by the destructor.
+ */
+class DirReader
+{
+public:
+    struct Entry {
+        const char *name = nullptr; // valid until the next call to next()
+        unsigned char type = DT_UNKNOWN; // DT_DIR, DT_REG, DT_LNK... as reported by the filesystem
+    };
+
+    // Takes ownership of dirfd
+    explicit DirReader(int dirfd);
+    // Opens path, relative to dirfd unless it is absolute
+    DirReader(int dirfd, const char *path);
+    ~DirReader();
+
+    DirReader(const DirReader &) = delete;
+    DirReader &operator=(const DirReader &) = delete;
+
+    // Whether the directory could be opened; errno tells why when it could not
+    bool isValid() const;
+    int fd() const;
+
+    // Fills entry with the next directory entry. Returns false at the end of the
+    // directory, or on error in which case error() is set.
+    bool next(Entry &entry);
+    int error() const;
+
+private:
+    int m_fd = -1;
+    int m_error = 0;
+#ifdef Q_OS_LINUX
+    QByteArray m_buffer;
+    qsizetype m_pos = 0;
+    qsizetype m_end = 0;
+#else
+    DIR *m_dir = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,223 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "diskusage_unix.h"
+#include "dirreader_unix.h"
+#include "stat_unix.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// A directory with many entries shows up in the totals before it is read to the end
+static constexpr int s_flushInterval = 1024;
+
+// How long an idle thread sleeps before looking for work again, in case it missed a wake up
+static constexpr std::chrono::milliseconds s_idleTimeout(5);
+
+DiskUsageWalker::DirHandle::DirHandle(int fd)
+    : fd(fd)
+{
+}
+
+DiskUsageWalker::DirHandle::~DirHandle()
+{
+    ::close(fd);
+}
+
+DiskUsageWalker::DiskUsageWalker(int rootfd, int threadCount)
+{
+    threadCount = std::max(threadCount, 1);
+    m_stacks.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        m_stacks.push_back(std::make_unique<TaskStack>());
+    }
+
+    m_pending = 1;
+    m_stacks[0]->tasks.push_back(Task{std::make_shared<const DirHandle>(rootfd), QByteArrayLiteral(".")});
+
+    m_threads.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&DiskUsageWalker::run, this, size_t(i));
+    }
+}
+
+DiskUsageWalker::~DiskUsageWalker()
+{
+    stop();
+}
+
+void DiskUsageWalker::stop()
+{
+    {
+        std::lock_guard lock(m_waitMutex);
+        m_stopped = true;
+    }
+    m_workQueued.notify_all();
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+bool DiskUsageWalker::wait(std::chrono::milliseconds timeout)
+{
+    std::unique_lock lock(m_waitMutex);
+    return m_finished.wait_for(lock, timeout, [this] {
+        return m_pending == 0;
+    });
+}
+
+DiskUsage DiskUsageWalker::totals() const
+{
+    return DiskUsage{
+        .size = m_size.load(std::memory_order_relaxed),
+        .files = m_files.load(std::memory_order_relaxed),
+        .subdirs = m_subdirs.load(std::memory_order_relaxed),
+    };
+}
+
+void DiskUsageWalker::run(size_t self)
+{
+    Task task;
+    while (!m_stopped) {
+        if (takeTask(self, task)) {
+            walk(self, task);
+            // Drop the reference to the parent directory, so that its descriptor doesn't stay open
+            // while this thread waits for more work
+            task = Task();
+            if (--m_pending == 0) {
+                {
+                    std::lock_guard lock(m_waitMutex);
+                }
+                m_finished.notify_all();
+                m_workQueued.notify_all();
+                return;
+            }
+            continue;
+        }
+
+        std::unique_lock lock(m_waitMutex);
+        if (m_pending == 0 || m_stopped) {
+            return;
+        }
+        m_workQueued.wait_for(lock, s_idleTimeout);
+    }
+}
+
+bool DiskUsageWalker::takeTask(size_t self, Task &task)
+{
+    {
+        TaskStack &own = *m_stacks[self];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < m_stacks.size(); ++i) {
+        TaskStack &other = *m_stacks[(self + i) % m_stacks.size()];
+        std::lock_guard lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void DiskUsageWalker::push(size_t self, Task &&task)
+{
+    ++m_pending;
+    {
+        TaskStack &own = *m_stacks[self];
+        std::lock_guard lock(own.mutex);
+        own.tasks.push_back(std::move(task));
+    }
+    m_workQueued.notify_one();
+}
+
+bool DiskUsageWalker::firstLink(dev_t device, ino_t inode)
+{
+    std::lock_guard lock(m_inodesMutex);
+    return m_visitedInodes.insert({device, inode}).second;
+}
+
+void DiskUsageWalker::walk(size_t self, const Task &task)
+{
+    DirReader dir(task.parent->fd, task.name.constData());
+    if (!dir.isValid()) {
+        // Like a recursive listing, skip what can't be read
+        return;
+    }
+
+    // Created when the first subdirectory is found, it keeps this directory open until they are read
+    std::shared_ptr<const DirHandle> handle;
+
+    DiskUsage found;
+    int unflushed = 0;
+    const auto flush = [this, &found, &unflushed] {
+        m_size.fetch_add(found.size, std::memory_order_relaxed);
+        m_files.fetch_add(found.files, std::memory_order_relaxed);
+        m_subdirs.fetch_add(found.subdirs, std::memory_order_relaxed);
+        found = DiskUsage();
+        unflushed = 0;
+    };
+
+    DirReader::Entry entry;
+    while (!m_stopped.load(std::memory_order_relaxed) && dir.next(entry)) {
+        const QByteArrayView name(entry.name);
+        if (name == "." || name == "..") {
+            continue;
+        }
+        if (++unflushed == s_flushInterval) {
+            flush();
+        }
+
+        QT_STATBUF buf;
+        if (KIO_FSTATAT(dir.fd(), entry.name, &buf, AT_SYMLINK_NOFOLLOW) != 0) {
+            // Removed since the directory was read
+            continue;
+        }
+
+        if (S_ISLNK(buf.st_mode)) {
+            // Counted as what it points to, but neither followed nor added to the size
+            QT_STATBUF target;
+            if (KIO_FSTATAT(dir.fd(), entry.name, &target, 0) == 0 && S_ISDIR(target.st_mode)) {
+                ++found.subdirs;
+            } else {
+                ++found.files;
+            }
+            continue;
+        }
+
+        if (S_ISDIR(buf.st_mode)) {
+            ++found.subdirs;
+            found.size += buf.st_size;
+            if (!handle) {
+                const int fd = ::fcntl(dir.fd(), F_DUPFD_CLOEXEC, 0);
+                if (fd < 0) {
+                    continue;
+                }
+                handle = std::make_shared<const DirHandle>(fd);
+            }
+            push(self, Task{handle, QByteArray(entry.name)});
+            continue;
+        }
+
+        if (buf.st_nlink > 1 && !firstLink(buf.st_dev, buf.st_ino)) {
+            continue;
+        }
+        ++found.files;
+        found.size += buf.st_size;
+    }
+    flush();
+}
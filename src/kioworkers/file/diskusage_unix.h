@@ -0,0 +1,108 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef DISKUSAGE_UNIX_H
+#define DISKUSAGE_UNIX_H
+
+#include <kio/global.h>
+
+#include <QByteArray>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+/*
+ * What DirectorySizeJob reports: the sum of the sizes of the files and directories (symlinks
+ * count for nothing), the number of files (symlinks to files included) and of subdirectories
+ * (symlinks to directories included).
+ */
+struct DiskUsage {
+    KIO::filesize_t size = 0;
+    KIO::filesize_t files = 0;
+    KIO::filesize_t subdirs = 0;
+};
+
+/*
+ * Adds up what is under a directory, walking it on a few threads.
+ *
+ * Every thread has its own stack of directories still to read. It pushes the subdirectories
+ * it finds onto it and pops from its end, so it goes depth first and keeps few descriptors
+ * open; a thread that runs out takes the oldest directory of another thread, which is the
+ * one with the most under it. Entries are stat'ed relative to their directory descriptor.
+ *
+ * Files with several hard links are only counted the first time one of their names is met.
+ * Symlinks are not followed, mount points are crossed.
+ */
+class DiskUsageWalker
+{
+public:
+    // Takes ownership of rootfd, a descriptor on the directory to walk
+    DiskUsageWalker(int rootfd, int threadCount);
+    // Stops the walk if it is still running
+    ~DiskUsageWalker();
+
+    DiskUsageWalker(const DiskUsageWalker &) = delete;
+    DiskUsageWalker &operator=(const DiskUsageWalker &) = delete;
+
+    // Waits at most timeout for the walk to end. Returns true once it has.
+    bool wait(std::chrono::milliseconds timeout);
+    // What was found so far; the final result once wait() returned true
+    DiskUsage totals() const;
+
+private:
+    // Closes the descriptor once the last subdirectory opened relative to it was read
+    struct DirHandle {
+        explicit DirHandle(int fd);
+        ~DirHandle();
+        const int fd;
+    };
+    struct Task {
+        std::shared_ptr<const DirHandle> parent;
+        QByteArray name;
+    };
+    struct TaskStack {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(size_t self);
+    bool takeTask(size_t self, Task &task);
+    void push(size_t self, Task &&task);
+    void walk(size_t self, const Task &task);
+    // Whether this is the first time the file is met
+    bool firstLink(dev_t device, ino_t inode);
+    void stop();
+
+    std::vector<std::unique_ptr<TaskStack>> m_stacks;
+    std::vector<std::thread> m_threads;
+
+    // Directories queued or being read; the walk is over when it drops to 0
+    std::atomic<qint64> m_pending{0};
+    std::atomic<bool> m_stopped{false};
+    std::mutex m_waitMutex;
+    std::condition_variable m_workQueued;
+    std::condition_variable m_finished;
+
+    std::atomic<KIO::filesize_t> m_size{0};
+    std::atomic<KIO::filesize_t> m_files{0};
+    std::atomic<KIO::filesize_t> m_subdirs{0};
+
+    std::mutex m_inodesMutex;
+    std::set<std::pair<dev_t, ino_t>> m_visitedInodes;
+};
+
+#endif
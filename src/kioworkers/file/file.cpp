@@ -791,6 +791,20 @@ WorkerResult FileProtocol::special(const QByteArray &data)
         stream >> point;
         return unmount(point);
     }
+#ifndef Q_OS_WIN
+    case 3: {
+        QUrl url;
+        stream >> url;
+        return diskUsage(url);
+    }
+    case 4: {
+        QUrl src;
+        QUrl dest;
+        bool keepPermissions;
+        stream >> src >> dest >> keepPermissions;
+        return copyTree(src, dest, keepPermissions);
+    }
+#endif
     default:
         break;
     }
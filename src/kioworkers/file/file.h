@@ -20,6 +20,8 @@
 #include <config-kioworker-file.h>
 #include <qplatformdefs.h> // mode_t
 
+#include <atomic>
+
 #if HAVE_SYS_ACL_H
 #include <sys/acl.h>
 #endif
@@ -55,7 +57,7 @@ public:
     KIO::WorkerResult write(const QByteArray &data) override;
     KIO::WorkerResult seek(KIO::filesize_t offset) override;
     KIO::WorkerResult truncate(KIO::filesize_t length) override;
-    bool copyXattrs(const int src_fd, const int dest_fd);
+    static bool copyXattrs(const int src_fd, const int dest_fd);
     KIO::WorkerResult close() override;
 
     KIO::WorkerResult fileSystemFreeSpace(const QUrl &url) override;
@@ -64,6 +66,8 @@ public:
      * Special commands supported by this worker:
      * 1 - mount
      * 2 - unmount
+     * 3 - du: adds up the sizes under a directory, see diskUsage()
+     * 4 - copy a directory tree, see copyTree()
      */
     KIO::WorkerResult special(const QByteArray &data) override;
     KIO::WorkerResult unmount(const QString &point);
@@ -81,6 +85,23 @@ private:
     // Removes what is under the directory the descriptor is on, deepest first, and adds up the size of
     // what it removed. The descriptor is closed on the way out.
     KIO::WorkerResult deleteUnder(int dfd, KIO::filesize_t &removed);
+
+    // Walks the directory on a few threads and sends what DirectorySizeJob wants to know about it,
+    // the total size and the number of files and subdirectories, as data() a few times a second and
+    // once more at the end, each time as three quint64 in a QDataStream.
+    KIO::WorkerResult diskUsage(const QUrl &url);
+
+    // Copies the directory src to dest, which must not exist yet, on a few threads. What was and what
+    // couldn't be copied is sent as data() for CopyJob, in the records of TreeCopier. Nothing was
+    // done if this fails before any data was sent.
+    KIO::WorkerResult copyTree(const QUrl &src, const QUrl &dest, bool keepPermissions);
+    // The copying of copy(), for one file of copyTree(); called on the threads of its pool
+    static int copyOpenFile(int srcfd,
+                            const QT_STATBUF &srcBuf,
+                            int destfd,
+                            bool keepPermissions,
+                            const std::atomic<bool> &cancelled,
+                            std::atomic<KIO::filesize_t> &copied);
 #endif
 
 #ifdef Q_OS_WIN
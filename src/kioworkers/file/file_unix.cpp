@@ -10,18 +10,27 @@
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
 
+#include "dirreader_unix.h"
+#include "diskusage_unix.h"
 #include "file.h"
 #include "stat_unix.h"
+#include "treecopy_unix.h"
 
 #include "config-kioworker-file.h"
 
+#if HAVE_LIBURING && HAVE_STATX
+#include "statxbatch_linux.h"
+#endif
+
 #include "../utils_p.h"
 
 #if HAVE_POSIX_ACL
 #include <../../aclhelpers_p.h>
 #endif
 
+#include <QDataStream>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QMimeDatabase>
 #include <QStandardPaths>
@@ -34,6 +43,7 @@
 #include <QDebug>
 #include <kmountpoint.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <stdint.h>
 #include <utime.h>
@@ -100,7 +110,7 @@ using StatStruct = struct statx;
 using StatStruct = QT_STATBUF;
 #endif
 
-static QByteArray readlinkToBuffer(const StatStruct &buf, const QByteArray &path)
+static QByteArray readlinkToBuffer(const StatStruct &buf, int dirfd, const QByteArray &path)
 {
     // Use readlink on Unix because symLinkTarget turns relative targets into absolute (#352927)
     size_t size = stat_size(buf);
@@ -113,7 +123,7 @@ static QByteArray readlinkToBuffer(const StatStruct &buf, const QByteArray &path
     size_t bufferSize = qBound(lowerBound, size + 1, higherBound);
     QByteArray linkTargetBuffer(bufferSize, Qt::Initialization::Uninitialized);
     while (true) {
-        ssize_t n = readlink(path.constData(), linkTargetBuffer.data(), bufferSize);
+        ssize_t n = readlinkat(dirfd, path.constData(), linkTargetBuffer.data(), bufferSize);
         if (n < 0 && errno != ERANGE) {
             /* On AIX 5L v5.3 and HP-UX 11i v2 04/09, readlink returns -1
                with errno == ERANGE if the buffer is too small.
@@ -132,7 +142,16 @@ static QByteArray readlinkToBuffer(const StatStruct &buf, const QByteArray &path
     return linkTargetBuffer;
 }
 
-static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSEntry &entry, KIO::StatDetails details, const QString &fullPath)
+// path is relative to dirfd (or absolute, with dirfd being AT_FDCWD). fullPath is only needed for the
+// details that cannot be looked up relative to a directory: KIO::StatMimeType and KIO::StatAcl.
+// lstatBuf, if given, is the already known result of LSTAT_AT() on path.
+static bool createUDSEntry(const QString &filename,
+                           int dirfd,
+                           const QByteArray &path,
+                           UDSEntry &entry,
+                           KIO::StatDetails details,
+                           const QString &fullPath,
+                           const StatStruct *lstatBuf = nullptr)
 {
     assert(entry.count() == 0); // by contract :-)    assert(entry.count() == 0); // by contract :-)
     int numberEntries = 0;
@@ -186,16 +205,19 @@ static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSE
 
     bool isBrokenSymLink = false;
 #if HAVE_POSIX_ACL
-    QByteArray targetPath = path;
+    QByteArray targetPath = dirfd == AT_FDCWD ? path : QFile::encodeName(fullPath);
 #endif
 
     StatStruct buff;
+    if (lstatBuf) {
+        buff = *lstatBuf;
+    }
 
-    if (LSTAT(path.constData(), &buff, details) == 0) {
+    if (lstatBuf || LSTAT_AT(dirfd, path.constData(), &buff, details) == 0) {
         if (Utils::isLinkMask(stat_mode(buff))) {
             QByteArray linkTargetBuffer;
             if (details & (KIO::StatBasic | KIO::StatResolveSymlink)) {
-                linkTargetBuffer = readlinkToBuffer(buff, path);
+                linkTargetBuffer = readlinkToBuffer(buff, dirfd, path);
                 if (linkTargetBuffer.isEmpty()) {
                     return false;
                 }
@@ -205,7 +227,7 @@ static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSE
 
             // A symlink
             if (details & KIO::StatResolveSymlink) {
-                if (STAT(path.constData(), &buff, details) == -1) {
+                if (STAT_AT(dirfd, path.constData(), &buff, details) == -1) {
                     isBrokenSymLink = true;
                 } else {
 #if HAVE_POSIX_ACL
@@ -754,6 +776,202 @@ WorkerResult FileProtocol::copy(const QUrl &_srcUrl, const QUrl &_destUrl, int _
     return WorkerResult::pass();
 }
 
+int FileProtocol::copyOpenFile(int srcfd,
+                               const QT_STATBUF &srcBuf,
+                               int destfd,
+                               bool keepPermissions,
+                               const std::atomic<bool> &cancelled,
+                               std::atomic<KIO::filesize_t> &copied)
+{
+    if (keepPermissions && ::fchmod(destfd, srcBuf.st_mode & 07777) == -1) {
+        qCWarning(KIO_FILE) << "Could not change permissions of a copied file";
+    }
+
+    const off_t srcSize = srcBuf.st_size;
+    off_t sizeProcessed = 0;
+
+#ifdef FICLONE
+    if (::ioctl(destfd, FICLONE, srcfd) != -1) {
+        sizeProcessed = srcSize;
+        copied += srcSize;
+    }
+#endif
+
+#if HAVE_COPY_FILE_RANGE
+    while (!cancelled && sizeProcessed < srcSize) {
+        const ssize_t copiedBytes = ::copy_file_range(srcfd, nullptr, destfd, nullptr, s_maxIPCSize, 0);
+        if (copiedBytes == -1) {
+            // See copy() about ENOENT
+            if (errno == EINVAL || errno == EXDEV || errno == ENOENT) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (copiedBytes == 0) {
+            // The file got shorter since it was stat'ed
+            break;
+        }
+        sizeProcessed += copiedBytes;
+        copied += copiedBytes;
+    }
+#endif
+
+    if (sizeProcessed < srcSize) {
+        QByteArray buffer(s_maxIPCSize, Qt::Uninitialized);
+        while (!cancelled && sizeProcessed < srcSize) {
+            const ssize_t readBytes = ::read(srcfd, buffer.data(), s_maxIPCSize);
+            if (readBytes == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno;
+            }
+            if (readBytes == 0) {
+                break;
+            }
+            ssize_t written = 0;
+            while (written < readBytes) {
+                const ssize_t writtenBytes = ::write(destfd, buffer.constData() + written, readBytes - written);
+                if (writtenBytes == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                written += writtenBytes;
+            }
+            sizeProcessed += readBytes;
+            copied += readBytes;
+        }
+    }
+
+#if HAVE_SYS_XATTR_H || HAVE_SYS_EXTATTR_H
+    if (!copyXattrs(srcfd, destfd)) {
+        qCDebug(KIO_FILE) << "can't copy Extended attributes";
+    }
+#endif
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD) || defined(Q_OS_HAIKU)
+    struct timespec ut[2];
+    ut[0] = srcBuf.st_atim;
+    ut[1] = srcBuf.st_mtim;
+    if (::futimens(destfd, ut) != 0) {
+#else
+    struct timeval ut[2];
+    ut[0].tv_sec = srcBuf.st_atime;
+    ut[0].tv_usec = 0;
+    ut[1].tv_sec = srcBuf.st_mtime;
+    ut[1].tv_usec = 0;
+    if (::futimes(destfd, ut) != 0) {
+#endif
+        qCWarning(KIO_FILE) << "Couldn't preserve access and modification time of a copied file";
+    }
+
+    if (keepPermissions) {
+        if (::fchown(destfd, -1 /*keep user*/, srcBuf.st_gid) == 0) {
+            if (::fchown(destfd, srcBuf.st_uid, -1 /*keep group*/) < 0) {
+                qCDebug(KIO_FILE) << "Couldn't preserve the owner of a copied file";
+            }
+        } else {
+            qCDebug(KIO_FILE) << "Couldn't preserve the group of a copied file";
+        }
+    }
+
+#if HAVE_POSIX_ACL
+    if (!keepPermissions) {
+        if (acl_t acl = acl_get_fd(srcfd)) {
+            if (acl_set_fd(destfd, acl) != 0) {
+                qCWarning(KIO_FILE) << "Could not set ACL permissions of a copied file";
+            }
+            acl_free(acl);
+        }
+    }
+#endif
+
+    return 0;
+}
+
+// Copying small files is bound by the metadata updates, which scale with the threads up to a point
+static constexpr int s_treeCopyMaxThreads = 8;
+static constexpr qint64 s_treeCopyReportInterval = 200;
+
+WorkerResult FileProtocol::copyTree(const QUrl &_srcUrl, const QUrl &_destUrl, bool keepPermissions)
+{
+    const QString src = localFileWithoutHostname(_srcUrl).toLocalFile();
+    const QString dest = localFileWithoutHostname(_destUrl).toLocalFile();
+    const QByteArray _dest = QFile::encodeName(dest);
+
+    const int srcfd = ::open(QFile::encodeName(src).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (srcfd < 0) {
+        switch (errno) {
+        case ENOENT:
+            return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, src);
+        case ENOTDIR:
+            return WorkerResult::fail(KIO::ERR_IS_FILE, src);
+        case EACCES:
+            return WorkerResult::fail(KIO::ERR_ACCESS_DENIED, src);
+        default:
+            return WorkerResult::fail(KIO::ERR_CANNOT_ENTER_DIRECTORY, src);
+        }
+    }
+    QT_STATBUF srcBuf;
+    if (QT_FSTAT(srcfd, &srcBuf) != 0) {
+        ::close(srcfd);
+        return WorkerResult::fail(KIO::ERR_CANNOT_ENTER_DIRECTORY, src);
+    }
+
+    if (::mkdir(_dest.constData(), 0777) != 0) {
+        const int error = errno;
+        ::close(srcfd);
+        return WorkerResult::fail(error == EEXIST ? KIO::ERR_DIR_ALREADY_EXIST : KIO::ERR_CANNOT_MKDIR, dest);
+    }
+    const int destfd = ::open(_dest.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (destfd < 0) {
+        ::close(srcfd);
+        ::rmdir(_dest.constData());
+        return WorkerResult::fail(KIO::ERR_CANNOT_MKDIR, dest);
+    }
+
+    TreeCopier copier(&FileProtocol::copyOpenFile, keepPermissions, std::clamp(QThread::idealThreadCount(), 1, s_treeCopyMaxThreads));
+
+    bool sentLog = false;
+    const auto sendLog = [this, &copier, &sentLog] {
+        const QByteArray log = copier.takeLog();
+        if (!log.isEmpty()) {
+            data(log);
+            sentLog = true;
+        }
+        totalSize(copier.foundSize());
+        processedSize(copier.copiedSize());
+    };
+    QElapsedTimer sinceReport;
+    sinceReport.start();
+    const auto report = [this, &copier, &sentLog, &sinceReport, &sendLog] {
+        if (wasKilled()) {
+            copier.cancel();
+            return;
+        }
+        // CopyJob must know as soon as possible that dest was created
+        if (!sentLog || sinceReport.elapsed() >= s_treeCopyReportInterval) {
+            sendLog();
+            sinceReport.restart();
+        }
+    };
+
+    const int error = copier.copy(srcfd, destfd, srcBuf, report);
+    sendLog();
+    if (wasKilled()) {
+        return WorkerResult::pass();
+    }
+    if (error != 0) {
+        return WorkerResult::fail(error, Utils::concatPaths(dest, copier.errorPath()));
+    }
+    return WorkerResult::pass();
+}
+
 #if HAVE_SYS_XATTR_H
 static bool isNtfsHidden(const QString &filename)
 {
@@ -783,6 +1001,23 @@ static bool isNtfsHidden(const QString &filename)
 }
 #endif
 
+#if HAVE_LIBURING && HAVE_STATX
+// Entries stat'ed in one go by listDir(), roughly what one getdents64() call returns
+static constexpr size_t s_statxBatchSize = 1024;
+
+// The io_uring used to batch the statx calls of listDir(), or nullptr to do them one by one. In-process
+// workers run in threads of their own, so each thread gets its own ring. Setting KIO_FILE_NO_IO_URING
+// forces the synchronous path, e.g. to compare the two.
+static StatxBatch *statxBatch()
+{
+    if (qEnvironmentVariableIsSet("KIO_FILE_NO_IO_URING")) {
+        return nullptr;
+    }
+    thread_local StatxBatch batch;
+    return batch.isValid() ? &batch : nullptr;
+}
+#endif
+
 WorkerResult FileProtocol::listDir(const QUrl &url)
 {
     if (!isLocalFileSameHost(url)) {
@@ -802,8 +1037,8 @@ WorkerResult FileProtocol::listDir(const QUrl &url)
     }
     const QString path(url.toLocalFile());
     const QByteArray _path(QFile::encodeName(path));
-    DIR *dp = opendir(_path.data());
-    if (dp == nullptr) {
+    DirReader dir(AT_FDCWD, _path.constData());
+    if (!dir.isValid()) {
         switch (errno) {
         case ENOENT:
             return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, path);
@@ -819,26 +1054,84 @@ WorkerResult FileProtocol::listDir(const QUrl &url)
         }
     }
 
-    const QByteArray encodedBasePath = _path + '/';
-
     const KIO::StatDetails details = getStatDetails();
+    // The entries are stat'ed relative to the directory descriptor, a full path is only built for
+    // the details that need one.
+    const bool needsFullPath = details.testAnyFlags(KIO::StatMimeType | KIO::StatAcl);
+    const QString basePath = Utils::slashAppended(path);
     // qDebug() << "========= LIST " << url << "details=" << details << " =========";
     UDSEntry entry;
 
+    // The slow path: stat the entry (unless lstatBuf already holds the result) and emit it with all details
+    auto listDetailedEntry = [&](const QByteArray &name, unsigned char type, const StatStruct *lstatBuf) {
+        entry.clear();
+        const QString filename = QFile::decodeName(name);
+        const QString fullPath = needsFullPath ? basePath + filename : QString();
+
+        if (!createUDSEntry(filename, dir.fd(), name, entry, details, fullPath, lstatBuf)) {
+            return;
+        }
+#if HAVE_SYS_XATTR_H && HAVE_DIRENT_D_TYPE
+        if (isNtfsHidden(filename)) {
+            bool ntfsHidden = true;
+
+            // Bug 392913: NTFS root volume is always "hidden", ignore this
+            if (type == DT_DIR || type == DT_UNKNOWN || type == DT_LNK) {
+                const QString fullFilePath = QDir(filename).canonicalPath();
+                auto mountPoint = KMountPoint::currentMountPoints().findByPath(fullFilePath);
+                if (mountPoint && mountPoint->mountPoint() == fullFilePath) {
+                    ntfsHidden = false;
+                }
+            }
+
+            if (ntfsHidden) {
+                entry.fastInsert(KIO::UDSEntry::UDS_HIDDEN, 1);
+            }
+        }
+#else
+        Q_UNUSED(type)
+#endif
+        listEntry(entry);
+    };
+
+#if HAVE_LIBURING && HAVE_STATX
+    // With io_uring the lstat calls of a whole batch of entries are in flight at once, each entry is
+    // emitted as soon as its result comes in.
+    StatxBatch *batch = details != KIO::StatBasic ? statxBatch() : nullptr;
+    std::vector<StatxBatch::Request> requests;
+    auto runBatch = [&]() {
+        const bool ok = batch->run(dir.fd(), requests, AT_SYMLINK_NOFOLLOW, lstatMask(details), [&](StatxBatch::Request &request) {
+            if (request.result == 0) {
+                listDetailedEntry(request.name, request.type, &request.buf);
+            } else if (request.result != -ENOENT) {
+                // Not necessarily a real error, e.g. -EINVAL from kernels without IORING_OP_STATX: let lstat tell
+                listDetailedEntry(request.name, request.type, nullptr);
+            }
+        });
+        if (!ok) {
+            for (const StatxBatch::Request &request : requests) {
+                if (!request.completed) {
+                    listDetailedEntry(request.name, request.type, nullptr);
+                }
+            }
+            batch = nullptr;
+        } else if (!requests.empty() && requests.front().result == -EINVAL) {
+            // Most likely no IORING_OP_STATX support at all, don't bother for the rest of the directory
+            batch = nullptr;
+        }
+        requests.clear();
+    };
+#endif
+
 #if !(HAVE_DIRENT_D_TYPE)
     QT_STATBUF st;
 #endif
-    QT_DIRENT *ep;
-    while ((ep = QT_READDIR(dp)) != nullptr) {
+    DirReader::Entry ep;
+    while (dir.next(ep)) {
         if (wasKilled()) {
-            closedir(dp);
             return WorkerResult::pass();
         }
 
-        entry.clear();
-
-        const QString filename = QFile::decodeName(ep->d_name);
-
         /*
          * details == 0 (if statement) is the fast code path.
          * We only get the file name and type. After that we emit
@@ -850,13 +1143,14 @@ WorkerResult FileProtocol::listDir(const QUrl &url)
          *
          */
         if (details == KIO::StatBasic) {
-            entry.fastInsert(KIO::UDSEntry::UDS_NAME, filename);
+            entry.clear();
+            entry.fastInsert(KIO::UDSEntry::UDS_NAME, QFile::decodeName(ep.name));
 #if HAVE_DIRENT_D_TYPE
-            entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, (ep->d_type == DT_DIR) ? S_IFDIR : S_IFREG);
-            const bool isSymLink = (ep->d_type == DT_LNK);
+            entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, (ep.type == DT_DIR) ? S_IFDIR : S_IFREG);
+            const bool isSymLink = (ep.type == DT_LNK);
 #else
             // oops, no fast way, we need to stat (e.g. on Solaris)
-            if (QT_LSTAT(ep->d_name, &st) == -1) {
+            if (LSTAT_AT(dir.fd(), ep.name, &st, details) == -1) {
                 continue; // how can stat fail?
             }
             entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_ISDIR(st.st_mode) ? S_IFDIR : S_IFREG);
@@ -870,34 +1164,24 @@ WorkerResult FileProtocol::listDir(const QUrl &url)
             listEntry(entry);
 
         } else {
-            QString fullPath = Utils::slashAppended(path);
-            fullPath += filename;
-
-            if (createUDSEntry(filename, encodedBasePath + QByteArray(ep->d_name), entry, details, fullPath)) {
-#if HAVE_SYS_XATTR_H && HAVE_DIRENT_D_TYPE
-                if (isNtfsHidden(filename)) {
-                    bool ntfsHidden = true;
-
-                    // Bug 392913: NTFS root volume is always "hidden", ignore this
-                    if (ep->d_type == DT_DIR || ep->d_type == DT_UNKNOWN || ep->d_type == DT_LNK) {
-                        const QString fullFilePath = QDir(filename).canonicalPath();
-                        auto mountPoint = KMountPoint::currentMountPoints().findByPath(fullFilePath);
-                        if (mountPoint && mountPoint->mountPoint() == fullFilePath) {
-                            ntfsHidden = false;
-                        }
-                    }
-
-                    if (ntfsHidden) {
-                        entry.fastInsert(KIO::UDSEntry::UDS_HIDDEN, 1);
-                    }
+#if HAVE_LIBURING && HAVE_STATX
+            if (batch) {
+                requests.push_back(StatxBatch::Request{.name = QByteArray(ep.name), .type = ep.type});
+                if (requests.size() >= s_statxBatchSize) {
+                    runBatch();
                 }
-#endif
-                listEntry(entry);
+                continue;
             }
+#endif
+            listDetailedEntry(QByteArray(ep.name), ep.type, nullptr);
         }
     }
 
-    closedir(dp);
+#if HAVE_LIBURING && HAVE_STATX
+    if (!requests.empty() && !wasKilled()) {
+        runBatch();
+    }
+#endif
 
     return WorkerResult::pass();
 }
@@ -1109,6 +1393,46 @@ WorkerResult FileProtocol::deleteRecursive(const QString &path)
     return deleteUnder(dfd, removed);
 }
 
+// The disk is what limits a tree walk, more threads than this only add seeks
+static constexpr int s_diskUsageMaxThreads = 8;
+static constexpr std::chrono::milliseconds s_diskUsageReportInterval(200);
+
+WorkerResult FileProtocol::diskUsage(const QUrl &_url)
+{
+    const QString path = localFileWithoutHostname(_url).toLocalFile();
+    const int rootfd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootfd < 0) {
+        switch (errno) {
+        case ENOENT:
+            return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, path);
+        case ENOTDIR:
+            return WorkerResult::fail(KIO::ERR_IS_FILE, path);
+        default:
+            return WorkerResult::fail(KIO::ERR_CANNOT_ENTER_DIRECTORY, path);
+        }
+    }
+    // Like the "." entry of a listing, the directory itself is part of the size
+    QT_STATBUF buff;
+    const KIO::filesize_t rootSize = QT_FSTAT(rootfd, &buff) == 0 ? KIO::filesize_t(buff.st_size) : 0;
+
+    const auto sendTotals = [this, rootSize](const DiskUsage &usage) {
+        QByteArray packet;
+        QDataStream stream(&packet, QIODevice::WriteOnly);
+        stream << quint64(rootSize + usage.size) << quint64(usage.files) << quint64(usage.subdirs);
+        data(packet);
+    };
+
+    DiskUsageWalker walker(rootfd, std::clamp(QThread::idealThreadCount(), 1, s_diskUsageMaxThreads));
+    while (!walker.wait(s_diskUsageReportInterval)) {
+        if (wasKilled()) {
+            return WorkerResult::pass();
+        }
+        sendTotals(walker.totals());
+    }
+    sendTotals(walker.totals());
+    return WorkerResult::pass();
+}
+
 WorkerResult FileProtocol::del(const QUrl &_url, bool isfile)
 {
     const QUrl url = localFileWithoutHostname(_url);
@@ -1231,7 +1555,7 @@ WorkerResult FileProtocol::stat(const QUrl &url)
     const KIO::StatDetails details = getStatDetails();
 
     UDSEntry entry;
-    if (!createUDSEntry(url.fileName(), _path, entry, details, path)) {
+    if (!createUDSEntry(url.fileName(), AT_FDCWD, _path, entry, details, path)) {
         return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, path);
     }
     statEntry(entry);
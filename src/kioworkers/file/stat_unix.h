@@ -19,20 +19,39 @@
 #ifdef Q_OS_WIN
 // QT_LSTAT on Windows
 #include "kioglobal_p.h"
+#else
+#include <fcntl.h> // AT_FDCWD, AT_SYMLINK_NOFOLLOW
+#endif
+
+#ifndef Q_OS_WIN
+// Qt maps QT_STATBUF to struct stat64 under large file support, and there is no QT_FSTATAT, so the
+// same choice is made here for the directory-relative fstatat(). Takes a QT_STATBUF whether or not
+// statx is available.
+#if defined(QT_USE_XOPEN_LFS_EXTENSIONS) && defined(QT_LARGEFILE_SUPPORT)
+#define KIO_FSTATAT ::fstatat64
+#else
+#define KIO_FSTATAT ::fstatat
+#endif
 #endif
 
-// NOTE: these calls would be nicer if they used real dirfds instead of AT_FDCWD, but benchmarking suggests that
-// it makes no real difference since we need to concatenate a complete path anyway (for UDSEntry). The kernel seems
-// to not care much whether the input is relative or absolute either.
+// LSTAT()/STAT() resolve an absolute (or cwd-relative) path. The *_AT() variants take the path relative to
+// a directory descriptor, which saves the kernel from walking the whole path again for every entry when
+// listing a directory.
 
 #if HAVE_STATX
 // statx syscall is available
-inline int LSTAT(const char *path, struct statx *buff, KIO::StatDetails details)
+
+// The fields the lstat-like call has to fill in for the given details
+inline uint32_t lstatMask(KIO::StatDetails details)
 {
     uint32_t mask = 0;
     if (details & KIO::StatBasic) {
         // filename, access, type, size, linkdest
-        mask |= STATX_SIZE | STATX_TYPE;
+        mask |= STATX_SIZE | STATX_TYPE | STATX_MODE;
+    }
+    if (details & KIO::StatAcl) {
+        // ACLs are only looked up depending on the type
+        mask |= STATX_TYPE;
     }
     if (details & KIO::StatUser) {
         // uid, gid
@@ -58,15 +77,17 @@ inline int LSTAT(const char *path, struct statx *buff, KIO::StatDetails details)
         mask |= STATX_MNT_ID_UNIQUE;
     }
 #endif
-    return statx(AT_FDCWD, path, AT_SYMLINK_NOFOLLOW, mask, buff);
+    return mask;
 }
-inline int STAT(const char *path, struct statx *buff, const KIO::StatDetails &details)
+
+// The fields the stat-like call (following symlinks) has to fill in for the given details
+inline uint32_t statMask(KIO::StatDetails details)
 {
     uint32_t mask = 0;
     // KIO::StatAcl needs type
     if (details & (KIO::StatBasic | KIO::StatAcl | KIO::StatResolveSymlink)) {
         // filename, access, type
-        mask |= STATX_TYPE;
+        mask |= STATX_TYPE | STATX_MODE;
     }
     if (details & (KIO::StatBasic | KIO::StatResolveSymlink)) {
         // size, linkdest
@@ -93,7 +114,24 @@ inline int STAT(const char *path, struct statx *buff, const KIO::StatDetails &de
     }
 #endif
     // KIO::Inode is ignored as when STAT is called, the entry inode field has already been filled
-    return statx(AT_FDCWD, path, AT_STATX_SYNC_AS_STAT, mask, buff);
+    return mask;
+}
+
+inline int LSTAT_AT(int dirfd, const char *path, struct statx *buff, KIO::StatDetails details)
+{
+    return statx(dirfd, path, AT_SYMLINK_NOFOLLOW, lstatMask(details), buff);
+}
+inline int STAT_AT(int dirfd, const char *path, struct statx *buff, const KIO::StatDetails &details)
+{
+    return statx(dirfd, path, AT_STATX_SYNC_AS_STAT, statMask(details), buff);
+}
+inline int LSTAT(const char *path, struct statx *buff, KIO::StatDetails details)
+{
+    return LSTAT_AT(AT_FDCWD, path, buff, details);
+}
+inline int STAT(const char *path, struct statx *buff, const KIO::StatDetails &details)
+{
+    return STAT_AT(AT_FDCWD, path, buff, details);
 }
 inline static uint16_t stat_mode(const struct statx &buf)
 {
@@ -159,6 +197,18 @@ inline int STAT(const char *path, QT_STATBUF *buff, KIO::StatDetails details)
     Q_UNUSED(details)
     return QT_STAT(path, buff);
 }
+#ifndef Q_OS_WIN
+inline int LSTAT_AT(int dirfd, const char *path, QT_STATBUF *buff, KIO::StatDetails details)
+{
+    Q_UNUSED(details)
+    return KIO_FSTATAT(dirfd, path, buff, AT_SYMLINK_NOFOLLOW);
+}
+inline int STAT_AT(int dirfd, const char *path, QT_STATBUF *buff, KIO::StatDetails details)
+{
+    Q_UNUSED(details)
+    return KIO_FSTATAT(dirfd, path, buff, 0);
+}
+#endif
 #endif
 
 // QT_STATBUF overloads (always available regardless of HAVE_STATX)
@@ -0,0 +1,106 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "statxbatch_linux.h"
+
+#include <cerrno>
+
+// Number of statx requests kept in flight
+static constexpr unsigned int s_queueDepth = 256;
+
+StatxBatch::StatxBatch()
+{
+    m_valid = io_uring_queue_init(s_queueDepth, &m_ring, 0) == 0;
+}
+
+StatxBatch::~StatxBatch()
+{
+    if (m_valid) {
+        io_uring_queue_exit(&m_ring);
+    }
+}
+
+bool StatxBatch::isValid() const
+{
+    return m_valid;
+}
+
+bool StatxBatch::run(int dirfd, std::vector<Request> &requests, int flags, unsigned int mask, const std::function<void(Request &)> &done)
+{
+    if (!m_valid) {
+        return false;
+    }
+
+    size_t submitted = 0;
+    size_t completed = 0;
+    while (completed < requests.size()) {
+        // Top the ring up, but never have more in flight than the completion queue is guaranteed to hold
+        while (submitted < requests.size() && submitted - completed < s_queueDepth) {
+            io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+            if (!sqe) {
+                break;
+            }
+            Request &request = requests[submitted];
+            io_uring_prep_statx(sqe, dirfd, request.name.constData(), flags, mask, &request.buf);
+            io_uring_sqe_set_data(sqe, &request);
+            ++submitted;
+        }
+
+        int ret;
+        do {
+            ret = io_uring_submit_and_wait(&m_ring, 1);
+            // -EBUSY/-EAGAIN: the kernel wants us to reap completions before it takes more
+        } while (ret == -EINTR || ((ret == -EBUSY || ret == -EAGAIN) && io_uring_cq_ready(&m_ring) == 0));
+        if (ret < 0 && ret != -EBUSY && ret != -EAGAIN) {
+            // The kernel writes into the requests it took until they complete, even once the ring is
+            // closed: wait for them before handing the rest back. Those still in the submission
+            // queue never reached it. Don't reuse the ring afterwards.
+            completed += drain(submitted - completed - io_uring_sq_ready(&m_ring), done);
+            io_uring_queue_exit(&m_ring);
+            m_valid = false;
+            return false;
+        }
+
+        completed += reap(done);
+    }
+    return true;
+}
+
+size_t StatxBatch::reap(const std::function<void(Request &)> &done)
+{
+    io_uring_cqe *cqe;
+    unsigned int head;
+    unsigned int count = 0;
+    io_uring_for_each_cqe(&m_ring, head, cqe)
+    {
+        auto *request = static_cast<Request *>(io_uring_cqe_get_data(cqe));
+        request->result = cqe->res;
+        request->completed = true;
+        ++count;
+        done(*request);
+    }
+    io_uring_cq_advance(&m_ring, count);
+    return count;
+}
+
+size_t StatxBatch::drain(size_t inFlight, const std::function<void(Request &)> &done)
+{
+    size_t completed = 0;
+    while (completed < inFlight) {
+        io_uring_cqe *cqe;
+        const int ret = io_uring_wait_cqe(&m_ring, &cqe);
+        if (ret == -EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            // A broken ring, there is no waiting for the rest
+            break;
+        }
+        completed += reap(done);
+    }
+    return completed;
+}
@@ -0,0 +1,68 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef STATXBATCH_LINUX_H
+#define STATXBATCH_LINUX_H
+
+#include <QByteArray>
+
+#include <functional>
+#include <vector>
+
+#include <liburing.h>
+#include <sys/stat.h>
+
+/*
+ * Runs statx() on many entries of one directory at once through io_uring.
+ *
+ * listDir() issues one stat per entry. On network filesystems each of them is
+ * a full round trip, so submitting a whole batch of IORING_OP_STATX requests and
+ * handling each result as soon as it completes keeps many round trips in flight.
+ *
+ * The ring can be unavailable (kernel without io_uring, io_uring disabled by
+ * sysctl or seccomp): check isValid() and use the synchronous calls otherwise.
+ * Kernels without IORING_OP_STATX complete every request with -EINVAL, callers
+ * should treat any failure other than -ENOENT as "stat it synchronously".
+ */
+class StatxBatch
+{
+public:
+    struct Request {
+        QByteArray name; // relative to the directory descriptor given to run()
+        unsigned char type = 0; // d_type from the directory listing
+        struct statx buf;
+        int result = 0; // 0 on success, -errno on failure
+        bool completed = false; // set once handed to done()
+    };
+
+    StatxBatch();
+    ~StatxBatch();
+
+    StatxBatch(const StatxBatch &) = delete;
+    StatxBatch &operator=(const StatxBatch &) = delete;
+
+    bool isValid() const;
+
+    /*
+     * Stats every request relative to dirfd with the given flags and mask, calling
+     * done() for each of them in completion order. requests must not be resized
+     * while this runs. Returns false if the ring failed; the requests that are not
+     * completed yet have to be stat'ed by the caller then.
+     */
+    bool run(int dirfd, std::vector<Request> &requests, int flags, unsigned int mask, const std::function<void(Request &)> &done);
+
+private:
+    // Hands the completions that are there to done(), returns how many
+    size_t reap(const std::function<void(Request &)> &done);
+    // Waits for the inFlight requests the kernel has, returns how many completed
+    size_t drain(size_t inFlight, const std::function<void(Request &)> &done);
+
+    io_uring m_ring;
+    bool m_valid = false;
+};
+
+#endif
@@ -0,0 +1,485 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "treecopy_unix.h"
+#include "dirreader_unix.h"
+#include "stat_unix.h"
+
+#include <kio/udsentry.h>
+
+#include <QFile>
+#include <QLoggingCategory>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+Q_DECLARE_LOGGING_CATEGORY(KIO_FILE)
+
+// Files waiting for a thread of the pool, per thread. Each one keeps its directories open.
+static constexpr size_t s_queuedPerThread = 4;
+
+// How long the walk waits for room in the queue, or the end of the copies, before reporting again
+static constexpr std::chrono::milliseconds s_waitTimeout(100);
+
+// Directory levels the walk descends into itself, each keeping two descriptors open. What is
+// deeper is left to CopyJob, so that a deep tree doesn't run out of descriptors.
+static constexpr int s_maxDepth = 128;
+
+// Errors after which nothing else can be copied either
+static bool isFatal(int error)
+{
+    return error == ENOSPC || error == EDQUOT || error == EROFS;
+}
+
+static int fatalError(int error)
+{
+    return error == EROFS ? KIO::ERR_CANNOT_WRITE : KIO::ERR_DISK_FULL;
+}
+
+static qint64 mtimeMSecs(const QT_STATBUF &buf)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD) || defined(Q_OS_HAIKU)
+    return qint64(buf.st_mtim.tv_sec) * 1000 + buf.st_mtim.tv_nsec / 1000000;
+#else
+    return qint64(buf.st_mtime) * 1000;
+#endif
+}
+
+static void setTimes(int fd, const QT_STATBUF &buf, const QString &path)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD) || defined(Q_OS_HAIKU)
+    struct timespec ut[2];
+    ut[0] = buf.st_atim;
+    ut[1] = buf.st_mtim;
+    if (::futimens(fd, ut) != 0) {
+#else
+    struct timeval ut[2];
+    ut[0].tv_sec = buf.st_atime;
+    ut[0].tv_usec = 0;
+    ut[1].tv_sec = buf.st_mtime;
+    ut[1].tv_usec = 0;
+    if (::futimes(fd, ut) != 0) {
+#endif
+        qCWarning(KIO_FILE) << "Couldn't preserve access and modification time for directory" << path;
+    }
+}
+
+// Like KIO::mkdir() with the ownership CopyJob gives it, which only works out for root
+static void setOwnership(int fd, const QT_STATBUF &buf, const QString &path)
+{
+    if (::fchown(fd, buf.st_uid, buf.st_gid) != 0 && errno != EPERM) {
+        qCWarning(KIO_FILE) << "Couldn't chown directory" << path << ". Error:" << errno;
+    }
+}
+
+static QByteArray readLink(int dirfd, const char *name, const QT_STATBUF &buf)
+{
+    QByteArray target(std::max<qsizetype>(buf.st_size, 255) + 1, Qt::Uninitialized);
+    while (true) {
+        const ssize_t n = ::readlinkat(dirfd, name, target.data(), target.size());
+        if (n < 0) {
+            return {};
+        }
+        if (n < target.size()) {
+            target.truncate(n);
+            return target;
+        }
+        // Changed since it was stat'ed
+        target.resize(target.size() * 2);
+    }
+}
+
+struct TreeCopier::SourceDir {
+    explicit SourceDir(int fd)
+        : fd(fd)
+    {
+    }
+    ~SourceDir()
+    {
+        ::close(fd);
+    }
+    const int fd;
+};
+
+// Gets the times of its source once the last file copied into it, or its last subdirectory, is done
+struct TreeCopier::DestDir {
+    DestDir(TreeCopier *copier, int fd, const QString &path, const QT_STATBUF &srcBuf, const std::shared_ptr<DestDir> &parent)
+        : copier(copier)
+        , fd(fd)
+        , path(path)
+        , srcBuf(srcBuf)
+        , parent(parent)
+    {
+    }
+    ~DestDir()
+    {
+        if (incomplete) {
+            // CopyJob sets them after copying what is missing
+            copier->writeRecord([this](QDataStream &stream) {
+                stream << quint8(DirTimeNotSet) << path << mtimeMSecs(srcBuf);
+            });
+        } else {
+            setTimes(fd, srcBuf, path);
+        }
+        ::close(fd);
+    }
+    TreeCopier *const copier;
+    const int fd;
+    const QString path;
+    const QT_STATBUF srcBuf;
+    const std::shared_ptr<DestDir> parent;
+    std::atomic<bool> incomplete{false};
+};
+
+TreeCopier::TreeCopier(FileCopier copyFile, bool keepPermissions, int threadCount)
+    : m_copyFile(std::move(copyFile))
+    , m_keepPermissions(keepPermissions)
+    , m_maxQueued(s_queuedPerThread * std::max(threadCount, 1))
+{
+    threadCount = std::max(threadCount, 1);
+    m_threads.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&TreeCopier::runPool, this);
+    }
+}
+
+TreeCopier::~TreeCopier()
+{
+    cancel();
+    {
+        std::lock_guard lock(m_queueMutex);
+        m_stopping = true;
+    }
+    m_queueChanged.notify_all();
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void TreeCopier::cancel()
+{
+    m_cancelled = true;
+}
+
+QByteArray TreeCopier::takeLog()
+{
+    std::lock_guard lock(m_logMutex);
+    return std::exchange(m_log, QByteArray());
+}
+
+KIO::filesize_t TreeCopier::copiedSize() const
+{
+    return m_copiedSize.load(std::memory_order_relaxed);
+}
+
+KIO::filesize_t TreeCopier::foundSize() const
+{
+    return m_foundSize.load(std::memory_order_relaxed);
+}
+
+QString TreeCopier::errorPath() const
+{
+    std::lock_guard lock(m_logMutex);
+    return m_errorPath;
+}
+
+void TreeCopier::writeRecord(const std::function<void(QDataStream &)> &write)
+{
+    std::lock_guard lock(m_logMutex);
+    QDataStream stream(&m_log, QIODevice::WriteOnly | QIODevice::Append);
+    write(stream);
+}
+
+void TreeCopier::fail(int error, const QString &path)
+{
+    {
+        std::lock_guard lock(m_logMutex);
+        if (m_error == 0) {
+            m_error = error;
+            m_errorPath = path;
+        }
+    }
+    m_cancelled = true;
+}
+
+void TreeCopier::notCopied(const QString &path, const QT_STATBUF &buf, const QString &linkTarget)
+{
+    // What CopyJob needs to copy it itself, like an entry of a recursive listing
+    KIO::UDSEntry entry;
+    entry.reserve(8);
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, path);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, buf.st_mode & S_IFMT);
+    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, buf.st_mode & 07777);
+    entry.fastInsert(KIO::UDSEntry::UDS_SIZE, buf.st_size);
+    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, buf.st_mtime);
+    entry.fastInsert(KIO::UDSEntry::UDS_LOCAL_USER_ID, buf.st_uid);
+    entry.fastInsert(KIO::UDSEntry::UDS_LOCAL_GROUP_ID, buf.st_gid);
+    if (!linkTarget.isEmpty()) {
+        entry.fastInsert(KIO::UDSEntry::UDS_LINK_DEST, linkTarget);
+    }
+    writeRecord([&entry](QDataStream &stream) {
+        stream << quint8(NotCopied) << entry;
+    });
+}
+
+int TreeCopier::copy(int srcfd, int destfd, const QT_STATBUF &srcBuf, const std::function<void()> &report)
+{
+    QT_STATBUF destBuf;
+    if (QT_FSTAT(destfd, &destBuf) == 0) {
+        m_destDevice = destBuf.st_dev;
+        m_destInode = destBuf.st_ino;
+    }
+    setOwnership(destfd, srcBuf, QString());
+
+    writeRecord([&srcBuf](QDataStream &stream) {
+        stream << quint8(CopiedDir) << QString() << mtimeMSecs(srcBuf);
+    });
+    report();
+
+    {
+        auto srcDir = std::make_shared<SourceDir>(srcfd);
+        auto destDir = std::make_shared<DestDir>(this, destfd, QString(), srcBuf, nullptr);
+        walk(srcDir, destDir, QString(), 0, report);
+        // The copies still running hold the last references
+    }
+
+    std::unique_lock lock(m_queueMutex);
+    while (!m_queue.empty() || m_busy > 0) {
+        m_queueChanged.wait_for(lock, s_waitTimeout);
+        lock.unlock();
+        report();
+        lock.lock();
+    }
+
+    std::lock_guard logLock(m_logMutex);
+    return m_error;
+}
+
+void TreeCopier::walk(const std::shared_ptr<SourceDir> &srcDir, const std::shared_ptr<DestDir> &destDir, const QString &path, int depth, const std::function<void()> &report)
+{
+    // Read the whole directory first, so that its reader is closed before descending: every
+    // level below keeps only the descriptors of srcDir and destDir, which the pool needs
+    std::vector<QByteArray> names;
+    {
+        // The reader needs a descriptor of its own, the one of srcDir is shared with the pool
+        DirReader dir(::fcntl(srcDir->fd, F_DUPFD_CLOEXEC, 0));
+        if (!dir.isValid()) {
+            writeRecord([&path](QDataStream &stream) {
+                stream << quint8(NotListed) << path;
+            });
+            return;
+        }
+        DirReader::Entry entry;
+        while (dir.next(entry)) {
+            const QByteArrayView name(entry.name);
+            if (name != "." && name != "..") {
+                names.emplace_back(entry.name);
+            }
+        }
+    }
+
+    for (const QByteArray &name : names) {
+        if (m_cancelled) {
+            return;
+        }
+        report();
+
+        const QString entryPath = path.isEmpty() ? QFile::decodeName(name) : path + QLatin1Char('/') + QFile::decodeName(name);
+        QT_STATBUF buf;
+        if (KIO_FSTATAT(srcDir->fd, name.constData(), &buf, AT_SYMLINK_NOFOLLOW) != 0) {
+            // Removed since the directory was read
+            continue;
+        }
+
+        if (S_ISDIR(buf.st_mode)) {
+            if (buf.st_dev == m_destDevice && buf.st_ino == m_destInode) {
+                // Copying a directory into itself, don't copy the copy
+                continue;
+            }
+            if (depth >= s_maxDepth) {
+                // Out of descriptors to spend, CopyJob lists what is below
+                notCopied(entryPath, buf);
+                destDir->incomplete = true;
+                continue;
+            }
+            const int srcSubfd = ::openat(srcDir->fd, name.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (srcSubfd < 0 && errno != EACCES && errno != EPERM) {
+                // Not for lack of permissions (EMFILE, ENOMEM...): CopyJob tries again
+                notCopied(entryPath, buf);
+                destDir->incomplete = true;
+                continue;
+            }
+            if (::mkdirat(destDir->fd, name.constData(), 0777) != 0) {
+                const int error = errno;
+                if (srcSubfd >= 0) {
+                    ::close(srcSubfd);
+                }
+                if (isFatal(error)) {
+                    fail(fatalError(error), entryPath);
+                    return;
+                }
+                // A name the destination filesystem doesn't take, say: CopyJob asks the user
+                notCopied(entryPath, buf);
+                destDir->incomplete = true;
+                continue;
+            }
+            const int destfd = ::openat(destDir->fd, name.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (destfd < 0) {
+                // Leave it all to CopyJob, which creates the directory again
+                ::unlinkat(destDir->fd, name.constData(), AT_REMOVEDIR);
+                if (srcSubfd >= 0) {
+                    ::close(srcSubfd);
+                }
+                notCopied(entryPath, buf);
+                destDir->incomplete = true;
+                continue;
+            }
+            setOwnership(destfd, buf, entryPath);
+            auto subDest = std::make_shared<DestDir>(this, destfd, entryPath, buf, destDir);
+            writeRecord([&entryPath, &buf](QDataStream &stream) {
+                stream << quint8(CopiedDir) << entryPath << mtimeMSecs(buf);
+            });
+
+            if (srcSubfd < 0) {
+                writeRecord([&entryPath](QDataStream &stream) {
+                    stream << quint8(NotListed) << entryPath;
+                });
+                continue;
+            }
+            walk(std::make_shared<SourceDir>(srcSubfd), subDest, entryPath, depth + 1, report);
+            continue;
+        }
+
+        if (S_ISLNK(buf.st_mode)) {
+            // Recreated as is, like CopyJob does between two local paths
+            const QByteArray target = readLink(srcDir->fd, name.constData(), buf);
+            if (target.isEmpty() || ::symlinkat(target.constData(), destDir->fd, name.constData()) != 0) {
+                if (!target.isEmpty() && isFatal(errno)) {
+                    fail(fatalError(errno), entryPath);
+                    return;
+                }
+                notCopied(entryPath, buf, QFile::decodeName(target));
+                destDir->incomplete = true;
+                continue;
+            }
+            writeRecord([&entryPath, &target](QDataStream &stream) {
+                stream << quint8(CopiedLink) << entryPath << QFile::decodeName(target);
+            });
+            continue;
+        }
+
+        if (S_ISREG(buf.st_mode)) {
+            m_foundSize += buf.st_size;
+            enqueue(FileTask{srcDir, destDir, name, entryPath, buf}, report);
+            continue;
+        }
+
+        // Fifos, sockets and devices: KIO::file_copy() refuses them, with an error for the user
+        notCopied(entryPath, buf);
+        destDir->incomplete = true;
+    }
+}
+
+void TreeCopier::enqueue(FileTask &&task, const std::function<void()> &report)
+{
+    std::unique_lock lock(m_queueMutex);
+    while (m_queue.size() >= m_maxQueued && !m_cancelled) {
+        m_queueChanged.wait_for(lock, s_waitTimeout);
+        lock.unlock();
+        report();
+        lock.lock();
+    }
+    m_queue.push_back(std::move(task));
+    lock.unlock();
+    m_queueChanged.notify_all();
+}
+
+void TreeCopier::runPool()
+{
+    while (true) {
+        FileTask task;
+        {
+            std::unique_lock lock(m_queueMutex);
+            m_queueChanged.wait(lock, [this] {
+                return !m_queue.empty() || m_stopping;
+            });
+            if (m_queue.empty()) {
+                return;
+            }
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+            ++m_busy;
+        }
+        m_queueChanged.notify_all();
+
+        if (!m_cancelled) {
+            copyFile(task);
+        }
+        // Let go of the directories before saying this copy is over, the last one out sets their times
+        task = FileTask();
+
+        {
+            std::lock_guard lock(m_queueMutex);
+            --m_busy;
+        }
+        m_queueChanged.notify_all();
+    }
+}
+
+void TreeCopier::copyFile(const FileTask &task)
+{
+    const int srcfd = ::openat(task.srcDir->fd, task.name.constData(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (srcfd < 0) {
+        notCopied(task.path, task.buf);
+        task.destDir->incomplete = true;
+        return;
+    }
+    const int destfd = ::openat(task.destDir->fd, task.name.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (destfd < 0) {
+        const int error = errno;
+        ::close(srcfd);
+        if (isFatal(error)) {
+            fail(fatalError(error), task.path);
+        } else {
+            notCopied(task.path, task.buf);
+            task.destDir->incomplete = true;
+        }
+        return;
+    }
+
+    int error = m_copyFile(srcfd, task.buf, destfd, m_keepPermissions, m_cancelled, m_copiedSize);
+    ::close(srcfd);
+    if (::close(destfd) != 0 && error == 0) {
+        error = errno;
+    }
+
+    if (error != 0 || m_cancelled) {
+        // Don't keep partly copied files
+        ::unlinkat(task.destDir->fd, task.name.constData(), 0);
+        if (m_cancelled) {
+            return;
+        }
+        if (isFatal(error)) {
+            fail(fatalError(error), task.path);
+        } else {
+            notCopied(task.path, task.buf);
+            task.destDir->incomplete = true;
+        }
+        return;
+    }
+
+    writeRecord([&task](QDataStream &stream) {
+        stream << quint8(CopiedFile) << task.path << mtimeMSecs(task.buf);
+    });
+}
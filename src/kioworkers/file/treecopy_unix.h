@@ -0,0 +1,124 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef TREECOPY_UNIX_H
+#define TREECOPY_UNIX_H
+
+#include <kio/global.h>
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QString>
+#include <qplatformdefs.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Copies the content of a local directory into a new one, in the file worker itself.
+ *
+ * The calling thread walks the source with directory descriptors and creates the directories and
+ * symlinks as it goes; regular files are handed to a small pool of threads that copy them through
+ * descriptors relative to their directories. Each destination directory gets the times of its
+ * source once everything in it was copied.
+ *
+ * What happened is written to a log of records, which the caller sends to CopyJob from time to time:
+ * the copied items, so that it can tell the undo manager, and the items that could not be copied, so
+ * that it copies them itself and asks the user what to do about them. A directory not copied is left
+ * to CopyJob with all its content, it lists it itself. Only running out of disk space or writing to
+ * a read-only filesystem ends the copy.
+ */
+class TreeCopier
+{
+public:
+    // The records of the log, read by CopyJob
+    enum Record : quint8 {
+        CopiedDir, // path, mtime
+        CopiedFile, // path, mtime
+        CopiedLink, // path, target
+        NotCopied, // UDSEntry named by its path
+        NotListed, // path of a directory created empty because it could not be read
+        DirTimeNotSet, // path, mtime: a directory whose content isn't complete yet
+    };
+
+    // Copies the content of srcfd to destfd, both regular files, and the times, extended attributes
+    // and, with keepPermissions, mode and ownership that go with it. Returns 0 or an errno. Called on
+    // the threads of the pool; cancelled becomes true when the copy should stop, copied is increased
+    // as data is written.
+    using FileCopier =
+        std::function<int(int srcfd, const QT_STATBUF &srcBuf, int destfd, bool keepPermissions, const std::atomic<bool> &cancelled, std::atomic<KIO::filesize_t> &copied)>;
+
+    TreeCopier(FileCopier copyFile, bool keepPermissions, int threadCount);
+    // Stops the threads, cancelling the copies they are doing
+    ~TreeCopier();
+
+    TreeCopier(const TreeCopier &) = delete;
+    TreeCopier &operator=(const TreeCopier &) = delete;
+
+    // Copies what is in srcfd into destfd, the descriptor on the directory just created for it.
+    // Takes ownership of both descriptors. report is called every now and then from this thread.
+    // Returns 0 when done, or the KIO error that ended the copy, with the failing path in errorPath().
+    int copy(int srcfd, int destfd, const QT_STATBUF &srcBuf, const std::function<void()> &report);
+    void cancel();
+
+    // The records written since the last call
+    QByteArray takeLog();
+    // Bytes of file data written, and found to be written
+    KIO::filesize_t copiedSize() const;
+    KIO::filesize_t foundSize() const;
+    QString errorPath() const;
+
+private:
+    struct SourceDir;
+    struct DestDir;
+    struct FileTask {
+        std::shared_ptr<SourceDir> srcDir;
+        std::shared_ptr<DestDir> destDir;
+        QByteArray name;
+        QString path;
+        QT_STATBUF buf;
+    };
+
+    void walk(const std::shared_ptr<SourceDir> &srcDir, const std::shared_ptr<DestDir> &destDir, const QString &path, int depth, const std::function<void()> &report);
+    void copyFile(const FileTask &task);
+    void runPool();
+    void enqueue(FileTask &&task, const std::function<void()> &report);
+    void fail(int error, const QString &path);
+    void writeRecord(const std::function<void(QDataStream &)> &write);
+    void notCopied(const QString &path, const QT_STATBUF &buf, const QString &linkTarget = QString());
+
+    const FileCopier m_copyFile;
+    const bool m_keepPermissions;
+    const size_t m_maxQueued;
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueChanged;
+    std::deque<FileTask> m_queue;
+    int m_busy = 0;
+    bool m_stopping = false;
+
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<KIO::filesize_t> m_copiedSize{0};
+    std::atomic<KIO::filesize_t> m_foundSize{0};
+
+    mutable std::mutex m_logMutex;
+    QByteArray m_log;
+    int m_error = 0;
+    QString m_errorPath;
+    // Device and inode of the destination, not to be copied into itself
+    dev_t m_destDevice = 0;
+    ino_t m_destInode = 0;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include <config-kioworker-ftp.h>
 
 #include "ftp.h"
+#include "mlsxfacts.h"
 
 #ifdef Q_OS_WIN
 #include <sys/utime.h>
@@ -207,7 +208,9 @@ void FtpInternal::ftpCloseControlConnection()
     m_cDataMode = 0;
     m_bLoggedOn = false; // logon needs control connection
     m_bTextMode = false;
+    m_bMlsdListing = false;
     m_bBusy = false;
+    m_dirCache.clear();
 }
 
 /*!
@@ -230,7 +233,9 @@ const char *FtpInternal::ftpResponse(int iOffset)
 
         // If the server sends a multiline response starting with
         // "nnn-text" we loop here until a final "nnn text" line is
-        // reached. Only data from the final line will be stored.
+        // reached. Only data from the final line will be stored in
+        // m_lastControlLine, the lines in between go to m_lastResponseBody.
+        m_lastResponseBody.clear();
         do {
             while (!m_control->canReadLine() && m_control->waitForReadyRead((DEFAULT_READ_TIMEOUT * 1000))) { }
             m_lastControlLine = m_control->readLine();
@@ -253,6 +258,8 @@ const char *FtpInternal::ftpResponse(int iOffset)
                 qCDebug(KIO_FTP) << "    > " << pTxt;
                 if (iCode >= 100 && iCode == iMore && pTxt[3] == ' ') {
                     iMore = 0;
+                } else {
+                    m_lastResponseBody.append(m_lastControlLine);
                 }
             }
         } while (iMore != 0);
@@ -639,15 +646,6 @@ Result FtpInternal::ftpLogin(bool *userChanged)
                     q->cacheAuthentication(info);
                 }
             }
-            if (!ftpSendCmd(QByteArrayLiteral("CLNT kio_ftp")) || m_iRespType != 2) {
-                qCDebug(KIO_FTP) << "CLNT command failed or is not supported (code:" << m_iRespCode << ")";
-            }
-            if (ftpSendCmd(QByteArrayLiteral("OPTS UTF8 ON")) && m_iRespCode == 200) {
-                qCDebug(KIO_FTP) << "UTF-8 enabled successfully (code 200)";
-                q->remoteEncoding()->setEncoding("UTF-8");
-            } else {
-                qCDebug(KIO_FTP) << "OPTS UTF8 ON failed or not supported (code: " << m_iRespCode << "), falling back to default encoding";
-            }
             failedAuth = -1;
         } else {
             // some servers don't let you login anymore
@@ -663,42 +661,96 @@ Result FtpInternal::ftpLogin(bool *userChanged)
     qCDebug(KIO_FTP) << "Login OK";
     q->infoMessage(i18n("Login OK"));
 
+    // None of the following commands depends on the reply to another one,
+    // so they are sent in one go instead of paying a round trip each.
+    bool isWindowsNT = false;
+    bool pwdSucceeded = false;
+    const bool sent = ftpSendCmds({
+        {QByteArrayLiteral("CLNT kio_ftp"),
+         [this] {
+             if (m_iRespType != 2) {
+                 qCDebug(KIO_FTP) << "CLNT command failed or is not supported (code:" << m_iRespCode << ")";
+             }
+         }},
+        {QByteArrayLiteral("OPTS UTF8 ON"),
+         [this] {
+             if (m_iRespCode == 200) {
+                 qCDebug(KIO_FTP) << "UTF-8 enabled successfully (code 200)";
+                 q->remoteEncoding()->setEncoding("UTF-8");
+             } else {
+                 qCDebug(KIO_FTP) << "OPTS UTF8 ON failed or not supported (code: " << m_iRespCode << "), falling back to default encoding";
+             }
+         }},
+        {QByteArrayLiteral("SYST"),
+         [this, &isWindowsNT] {
+             if (m_iRespType == 2) {
+                 isWindowsNT = !qstrncmp(ftpResponse(0), "215 Windows_NT", 14); // should do for any version
+             } else {
+                 qCWarning(KIO_FTP) << "SYST failed";
+             }
+         }},
+        // MLSD and MLST (RFC 3659) give exact sizes, UTC times and file types,
+        // and let stat() get away with a single command.
+        {QByteArrayLiteral("FEAT"),
+         [this] {
+             if (m_iRespType != 2) {
+                 return;
+             }
+             for (const QByteArray &line : std::as_const(m_lastResponseBody)) {
+                 const QByteArray feature = line.trimmed();
+                 if (qstrnicmp(feature.constData(), "MLST", 4) == 0 && (feature.size() == 4 || feature.at(4) == ' ')) {
+                     m_extControl |= mlstSupported;
+                     break;
+                 }
+             }
+         }},
+        // Get the current working directory
+        {QByteArrayLiteral("PWD"),
+         [this, &pwdSucceeded] {
+             if (m_iRespType != 2) {
+                 return;
+             }
+             pwdSucceeded = true;
+             QString sTmp = q->remoteEncoding()->decode(ftpResponse(3));
+             const int iBeg = sTmp.indexOf(QLatin1Char('"'));
+             const int iEnd = sTmp.lastIndexOf(QLatin1Char('"'));
+             if (iBeg > 0 && iBeg < iEnd) {
+                 m_initialPath = sTmp.mid(iBeg + 1, iEnd - iBeg - 1);
+                 if (!m_initialPath.startsWith(QLatin1Char('/'))) {
+                     m_initialPath.prepend(QLatin1Char('/'));
+                 }
+                 qCDebug(KIO_FTP) << "Initial path set to: " << m_initialPath;
+                 m_currentPath = m_initialPath;
+             }
+         }},
+    });
+
+    if (!sent || !pwdSucceeded) {
+        qCDebug(KIO_FTP) << "Couldn't issue pwd command";
+        return Result::fail(ERR_CANNOT_LOGIN, i18n("Could not login to %1.", m_host)); // or anything better ?
+    }
+
     // Okay, we're logged in. If this is IIS 4, switch dir listing style to Unix:
     // Thanks to jk@soegaard.net (Jens Kristian Sgaard) for this hint
-    if (ftpSendCmd(QByteArrayLiteral("SYST")) && (m_iRespType == 2)) {
-        if (!qstrncmp(ftpResponse(0), "215 Windows_NT", 14)) { // should do for any version
+    if (isWindowsNT) {
+        (void)ftpSendCmd(QByteArrayLiteral("site dirstyle"));
+        // Check if it was already in Unix style
+        // Patch from Keith Refson <Keith.Refson@earth.ox.ac.uk>
+        if (!qstrncmp(ftpResponse(0), "200 MSDOS-like directory output is on", 37))
+        // It was in Unix style already!
+        {
             (void)ftpSendCmd(QByteArrayLiteral("site dirstyle"));
-            // Check if it was already in Unix style
-            // Patch from Keith Refson <Keith.Refson@earth.ox.ac.uk>
-            if (!qstrncmp(ftpResponse(0), "200 MSDOS-like directory output is on", 37))
-            // It was in Unix style already!
-            {
-                (void)ftpSendCmd(QByteArrayLiteral("site dirstyle"));
-            }
-            // windows won't support chmod before KDE konquers their desktop...
-            m_extControl |= chmodUnknown;
         }
-    } else {
-        qCWarning(KIO_FTP) << "SYST failed";
-    }
-
-    // Get the current working directory
-    qCDebug(KIO_FTP) << "Searching for pwd";
-    if (!ftpSendCmd(QByteArrayLiteral("PWD")) || (m_iRespType != 2)) {
-        qCDebug(KIO_FTP) << "Couldn't issue pwd command";
-        return Result::fail(ERR_CANNOT_LOGIN, i18n("Could not login to %1.", m_host)); // or anything better ?
+        // windows won't support chmod before KDE konquers their desktop...
+        m_extControl |= chmodUnknown;
     }
 
-    QString sTmp = q->remoteEncoding()->decode(ftpResponse(3));
-    const int iBeg = sTmp.indexOf(QLatin1Char('"'));
-    const int iEnd = sTmp.lastIndexOf(QLatin1Char('"'));
-    if (iBeg > 0 && iBeg < iEnd) {
-        m_initialPath = sTmp.mid(iBeg + 1, iEnd - iBeg - 1);
-        if (!m_initialPath.startsWith(QLatin1Char('/'))) {
-            m_initialPath.prepend(QLatin1Char('/'));
+    if (m_extControl & mlstSupported) {
+        // Servers pick what they support and ignore the rest
+        if (!ftpSendCmd(QByteArrayLiteral("OPTS MLST type;size;sizd;modify;perm;unix.mode;unix.owner;unix.group;unix.ownername;unix.groupname;unix.slink;"))
+            || (m_iRespType != 2)) {
+            qCDebug(KIO_FTP) << "OPTS MLST failed (code:" << m_iRespCode << "), using the default facts";
         }
-        qCDebug(KIO_FTP) << "Initial path set to: " << m_initialPath;
-        m_currentPath = m_initialPath;
     }
 
     return Result::pass();
@@ -789,6 +841,49 @@ bool FtpInternal::ftpSendCmd(const QByteArray &cmd, int maxretries)
     return true;
 }
 
+bool FtpInternal::ftpSendCmds(const QList<PipelinedCommand> &cmds)
+{
+    Q_ASSERT(m_control); // must have control connection socket
+
+    if (q->configValue(QStringLiteral("DisablePipelining"), false)) {
+        for (const PipelinedCommand &cmd : cmds) {
+            if (!ftpSendCmd(cmd.command)) {
+                return false;
+            }
+            cmd.onResponse();
+        }
+        return true;
+    }
+
+    QByteArray buf;
+    for (const PipelinedCommand &cmd : cmds) {
+        if (cmd.command.indexOf('\r') != -1 || cmd.command.indexOf('\n') != -1) {
+            qCWarning(KIO_FTP) << "Invalid command received (contains CR or LF):" << cmd.command.data();
+            return false;
+        }
+        qCDebug(KIO_FTP) << "pipelining" << cmd.command;
+        buf += cmd.command + "\r\n";
+    }
+
+    const qint64 num = m_control->write(buf);
+    while (m_control->bytesToWrite() && m_control->waitForBytesWritten()) { }
+    if (num <= 0) {
+        m_iRespType = m_iRespCode = 0;
+        return false;
+    }
+
+    // The server answers in the order the commands were sent
+    for (const PipelinedCommand &cmd : cmds) {
+        ftpResponse(-1);
+        if ((m_iRespType <= 0) || (m_iRespCode == 421)) {
+            qCWarning(KIO_FTP) << "Lost the connection while reading the response to" << cmd.command;
+            return false;
+        }
+        cmd.onResponse();
+    }
+    return true;
+}
+
 /*
  * ftpOpenPASVDataConnection - set up data connection, using PASV mode
  *
@@ -1080,6 +1175,7 @@ bool FtpInternal::ftpCloseCommand()
     // first close data sockets (if opened), then read response that
     // we got for whatever was used in ftpOpenCommand ( should be 226 )
     ftpCloseDataConnection();
+    m_bMlsdListing = false;
 
     if (!m_bBusy) {
         return true;
@@ -1105,6 +1201,7 @@ Result FtpInternal::mkdir(const QUrl &url, int permissions)
     const QByteArray encodedPath(q->remoteEncoding()->encode(url));
     const QString path = QString::fromLatin1(encodedPath.constData(), encodedPath.size());
 
+    ftpCacheInvalidate(url.path());
     if (!ftpSendCmd((QByteArrayLiteral("mkd ") + encodedPath)) || (m_iRespType != 2)) {
         QString currentPath(m_currentPath);
 
@@ -1162,13 +1259,24 @@ Result FtpInternal::ftpRename(const QString &src, const QString &dst, KIO::JobFl
         }
     }
 
-    const QByteArray from_cmd = "RNFR " + q->remoteEncoding()->encode(src.mid(pos + 1));
-    if (!ftpSendCmd(from_cmd) || (m_iRespType != 3)) {
-        return Result::fail(ERR_CANNOT_RENAME, src);
-    }
-
-    const QByteArray to_cmd = "RNTO " + q->remoteEncoding()->encode(dst);
-    if (!ftpSendCmd(to_cmd) || (m_iRespType != 2)) {
+    ftpCacheInvalidate(src);
+    ftpCacheInvalidate(dst);
+
+    // The server rejects RNTO unless the RNFR right before it succeeded,
+    // so both can be sent without waiting for the first reply.
+    bool fromAccepted = false;
+    bool renamed = false;
+    const bool sent = ftpSendCmds({
+        {"RNFR " + q->remoteEncoding()->encode(src.mid(pos + 1)),
+         [this, &fromAccepted] {
+             fromAccepted = (m_iRespType == 3);
+         }},
+        {"RNTO " + q->remoteEncoding()->encode(dst),
+         [this, &renamed] {
+             renamed = (m_iRespType == 2);
+         }},
+    });
+    if (!sent || !fromAccepted || !renamed) {
         return Result::fail(ERR_CANNOT_RENAME, src);
     }
 
@@ -1188,6 +1296,7 @@ Result FtpInternal::del(const QUrl &url, bool isfile)
         (void)ftpFolder(q->remoteEncoding()->decode(q->remoteEncoding()->directory(url))); // ignore errors
     }
 
+    ftpCacheInvalidate(url.path());
     const QByteArray cmd = (isfile ? "DELE " : "RMD ") + q->remoteEncoding()->encode(url);
 
     if (!ftpSendCmd(cmd) || (m_iRespType != 2)) {
@@ -1208,6 +1317,7 @@ bool FtpInternal::ftpChmod(const QString &path, int permissions)
     // we need to do bit AND 777 to get permissions, in case
     // we were sent a full mode (unlikely)
     const QByteArray cmd = "SITE CHMOD " + QByteArray::number(permissions & 0777 /*octal*/, 8 /*octal*/) + ' ' + q->remoteEncoding()->encode(path);
+    ftpCacheInvalidate(path);
 
     if (ftpSendCmd(cmd)) {
         qCDebug(KIO_FTP) << "ftpChmod: Failed to issue chmod";
@@ -1247,8 +1357,10 @@ void FtpInternal::ftpCreateUDSEntry(const QString &filename, const FtpEntry &ftp
     entry.reserveNumbers(5);
     entry.fastInsert(KIO::UDSEntry::UDS_NAME, filename);
     entry.fastInsert(KIO::UDSEntry::UDS_SIZE, ftpEnt.size);
-    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, ftpEnt.date.toSecsSinceEpoch());
-    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME_NS_OFFSET, ftpEnt.date.time().msec() * 1000000);
+    if (ftpEnt.date.isValid()) {
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, ftpEnt.date.toSecsSinceEpoch());
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME_NS_OFFSET, ftpEnt.date.time().msec() * 1000000);
+    }
     entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, ftpEnt.access);
     entry.fastInsert(KIO::UDSEntry::UDS_USER, ftpEnt.owner);
     if (!ftpEnt.group.isEmpty()) {
@@ -1352,6 +1464,53 @@ Result FtpInternal::stat(const QUrl &url)
     const QString filename = tempurl.fileName();
     Q_ASSERT(!filename.isEmpty());
 
+    FtpEntry cachedEnt;
+    switch (ftpCacheLookup(path, &cachedEnt)) {
+    case CacheLookup::Found: {
+        UDSEntry entry;
+        ftpCreateUDSEntry(filename, cachedEnt, entry, false);
+        q->statEntry(entry);
+        return Result::pass();
+    }
+    case CacheLookup::Unknown:
+        break;
+    }
+
+    if (m_extControl & mlstSupported) {
+        // The reply looks like
+        // 250-Listing /path/to/file
+        //  type=file;size=102;modify=20241109123000; /path/to/file
+        // 250 End
+        // so one command tells whether the path exists, its type and all details.
+        if (ftpSendCmd("MLST " + q->remoteEncoding()->encode(path)) && (m_iRespType == 2)) {
+            for (const QByteArray &line : std::as_const(m_lastResponseBody)) {
+                MlsxFacts facts;
+                if (!line.startsWith(' ') || !parseMlsxFacts(line.mid(1), facts)) {
+                    continue;
+                }
+                FtpEntry ftpEnt;
+                ftpEntryFromMlsxFacts(facts, ftpEnt);
+                ftpEnt.name = filename;
+                if (facts.isLink) {
+                    // The facts don't tell whether a symlink points to a dir, cwd into it like below.
+                    // Not cached, only a CWD can tell that next time too.
+                    if (ftpFolder(path)) {
+                        ftpEnt.type = S_IFDIR;
+                    }
+                } else {
+                    ftpCacheEntry(path, ftpEnt);
+                }
+                UDSEntry entry;
+                ftpCreateUDSEntry(filename, ftpEnt, entry, ftpEnt.type == S_IFDIR);
+                q->statEntry(entry);
+                return Result::pass();
+            }
+            qCWarning(KIO_FTP) << "No facts in MLST reply, falling back to LIST";
+        } else if (m_iRespCode == 550) {
+            return ftpStatAnswerNotFound(path, filename);
+        }
+    }
+
     // Try cwd into it, if it works it's a dir (and then we'll list the parent directory to get more info)
     // if it doesn't work, it's a file (and then we'll use dir filename)
     bool isDir = ftpFolder(path);
@@ -1501,11 +1660,18 @@ Result FtpInternal::listDir(const QUrl &url)
     UDSEntry entry;
     FtpEntry ftpEnt;
     QList<FtpEntry> ftpValidateEntList;
+    QHash<QString, FtpEntry> listedEntries;
+    auto addToListed = [&listedEntries](const FtpEntry &ftpEnt) {
+        if (ftpEnt.name != QLatin1String(".") && ftpEnt.name != QLatin1String("..")) {
+            listedEntries.insert(ftpEnt.name, ftpEnt);
+        }
+    };
     while (ftpReadDir(ftpEnt)) {
         qCDebug(KIO_FTP) << ftpEnt.name;
         // Q_ASSERT( !ftpEnt.name.isEmpty() );
         if (!ftpEnt.name.isEmpty()) {
-            if (ftpEnt.name.at(0).isSpace()) {
+            // MLSD names are exact, only LIST output needs the leading space fixup
+            if (!m_bMlsdListing && ftpEnt.name.at(0).isSpace()) {
                 ftpValidateEntList.append(ftpEnt);
                 continue;
             }
@@ -1517,6 +1683,7 @@ Result FtpInternal::listDir(const QUrl &url)
             ftpCreateUDSEntry(ftpEnt.name, ftpEnt, entry, false);
             q->listEntry(entry);
             entry.clear();
+            addToListed(ftpEnt);
         }
     }
 
@@ -1526,9 +1693,12 @@ Result FtpInternal::listDir(const QUrl &url)
         ftpCreateUDSEntry(ftpEnt.name, ftpEnt, entry, false);
         q->listEntry(entry);
         entry.clear();
+        addToListed(ftpEnt);
     }
 
-    ftpCloseCommand(); // closes the data connection only
+    if (ftpCloseCommand()) { // closes the data connection only
+        m_dirCache.setListing(ftpCleanPath(path), std::move(listedEntries));
+    }
     return Result::pass();
 }
 
@@ -1553,7 +1723,15 @@ Result FtpInternal::ftpOpenDir(const QString &path)
     // In fact we have to use -la otherwise -a removes the default -l (e.g. ftp.trolltech.com)
     // Pass KJob::NoError first because we don't want to emit error before we
     // have tried all commands.
-    auto result = ftpOpenCommand("list -la", QString(), 'I', KJob::NoError);
+    auto result = Result::fail();
+    if (m_extControl & mlstSupported) {
+        // MLSD lists hidden files too, and its output doesn't need guessing
+        result = ftpOpenCommand("MLSD", QString(), 'I', KJob::NoError);
+        m_bMlsdListing = result.success();
+    }
+    if (!result.success()) {
+        result = ftpOpenCommand("list -la", QString(), 'I', KJob::NoError);
+    }
     if (!result.success()) {
         result = ftpOpenCommand("list", QString(), 'I', KJob::NoError);
     }
@@ -1587,6 +1765,29 @@ bool FtpInternal::ftpReadDir(FtpEntry &de)
         const char *buffer = data.data();
         qCDebug(KIO_FTP) << "dir > " << buffer;
 
+        if (m_bMlsdListing) {
+            MlsxFacts facts;
+            if (!parseMlsxFacts(data, facts)) {
+                continue;
+            }
+            switch (facts.kind) {
+            case MlsxFacts::CurrentDir:
+                facts.name = ".";
+                break;
+            case MlsxFacts::ParentDir:
+                facts.name = "..";
+                break;
+            case MlsxFacts::Entry:
+                if (facts.name.indexOf('/') != -1) {
+                    continue; // Don't trick us!
+                }
+                break;
+            }
+            de.name = q->remoteEncoding()->decode(facts.name);
+            ftpEntryFromMlsxFacts(facts, de);
+            return true;
+        }
+
         // Normally the listing looks like
         // -rw-r--r--   1 dfaure   dfaure        102 Nov  9 12:30 log
         // but on Netware servers like ftp://ci-1.ci.pwr.wroc.pl/ it looks like (#76442)
@@ -1811,6 +2012,32 @@ bool FtpInternal::ftpReadDir(FtpEntry &de)
     return false;
 }
 
+FtpInternal::CacheLookup FtpInternal::ftpCacheLookup(const QString &path, FtpEntry *ftpEnt)
+{
+    return m_dirCache.lookup(ftpCleanPath(path), ftpEnt);
+}
+
+void FtpInternal::ftpCacheEntry(const QString &path, const FtpEntry &ftpEnt)
+{
+    m_dirCache.insert(ftpCleanPath(path), ftpEnt);
+}
+
+void FtpInternal::ftpCacheInvalidate(const QString &path)
+{
+    m_dirCache.invalidate(ftpCleanPath(path));
+}
+
+void FtpInternal::ftpEntryFromMlsxFacts(const MlsxFacts &facts, FtpEntry &de)
+{
+    de.owner = q->remoteEncoding()->decode(facts.owner);
+    de.group = q->remoteEncoding()->decode(facts.group);
+    de.link = q->remoteEncoding()->decode(facts.link);
+    de.size = facts.size;
+    de.type = facts.type;
+    de.access = facts.access;
+    de.date = facts.modified;
+}
+
 //===============================================================================
 // public: get           download file from server
 // helper: ftpGet        called from get() and copy()
@@ -2040,6 +2267,8 @@ Result FtpInternal::ftpPut(int iCopyFile, const QUrl &dest_url, int permissions,
         }
     }
 
+    // Covers the .part file as well, it lives in the same directory
+    ftpCacheInvalidate(dest_orig);
     const auto storResult = ftpOpenCommand("stor", dest, '?', ERR_CANNOT_WRITE, offset);
     if (!storResult.success()) {
         return storResult;
@@ -2130,6 +2359,20 @@ bool FtpInternal::ftpSize(const QString &path, char mode)
         return false;
     }
 
+    // In ASCII mode SIZE counts the line ends the server would send
+    FtpEntry ftpEnt;
+    const CacheLookup lookup = (m_cDataMode == 'I') ? ftpCacheLookup(path, &ftpEnt) : CacheLookup::Unknown;
+    if (lookup == CacheLookup::Found) {
+        if (ftpEnt.type != S_IFDIR) {
+            m_size = ftpEnt.size;
+            return true;
+        }
+        // What the server replies to SIZE for directories
+        m_iRespCode = 550;
+        m_iRespType = 5;
+        return false;
+    }
+
     const QByteArray buf = "SIZE " + q->remoteEncoding()->encode(path);
     if (!ftpSendCmd(buf) || (m_iRespType != 2)) {
         return false;
@@ -2150,6 +2393,14 @@ bool FtpInternal::ftpSize(const QString &path, char mode)
 
 bool FtpInternal::ftpFileExists(const QString &path)
 {
+    FtpEntry ftpEnt;
+    switch (ftpCacheLookup(path, &ftpEnt)) {
+    case CacheLookup::Found:
+        return ftpEnt.type != S_IFDIR;
+    case CacheLookup::Unknown:
+        break;
+    }
+
     const QByteArray buf = "SIZE " + q->remoteEncoding()->encode(path);
     if (!ftpSendCmd(buf) || (m_iRespType != 2)) {
         return false;
@@ -11,27 +11,21 @@
 
 #include <qplatformdefs.h>
 
+#include <QByteArrayList>
 #include <QDateTime>
 #include <QUrl>
 
 #include <workerbase.h>
 
+#include "ftpdircache.h"
+
+#include <functional>
+
 class QTcpServer;
 class QTcpSocket;
 class QNetworkProxy;
 class QAuthenticator;
-
-struct FtpEntry {
-    QString name;
-    QString owner;
-    QString group;
-    QString link;
-
-    KIO::filesize_t size;
-    mode_t type;
-    mode_t access;
-    QDateTime date;
-};
+struct MlsxFacts;
 
 class FtpInternal;
 
@@ -192,6 +186,26 @@ public:
      */
     Q_REQUIRED_RESULT bool ftpSendCmd(const QByteArray &cmd, int maxretries = 1);
 
+    struct PipelinedCommand {
+        QByteArray command;
+        // Called once the response has been read, m_iRespCode, ftpResponse(0)
+        // etc. refer to it. Must not send commands itself.
+        std::function<void()> onResponse;
+    };
+
+    /*!
+     * Sends all of \a cmds before reading the first response, then reads the
+     * responses in order. Nothing in RFC 959 requires a client to wait for a
+     * reply before sending its next command, so a batch of independent commands
+     * costs a single round trip. Servers that don't cope can be dealt with using
+     * the DisablePipelining option, which sends the commands one by one.
+     *
+     * Unlike ftpSendCmd() this doesn't reconnect when the connection broke.
+     *
+     * return true if all responses were received, false on error
+     */
+    Q_REQUIRED_RESULT bool ftpSendCmds(const QList<PipelinedCommand> &cmds);
+
     /*!
      * Use the SIZE command to get the file size.
      * \a mode the size depends on the transfer mode, hence this arg.
@@ -273,6 +287,10 @@ public:
      * Called to parse directory listings, call this until it returns false
      */
     bool ftpReadDir(FtpEntry &ftpEnt);
+    /*!
+     * Fills \a ftpEnt from the facts of an MLSD or MLST line, except for the name
+     */
+    void ftpEntryFromMlsxFacts(const MlsxFacts &facts, FtpEntry &ftpEnt);
 
     /*!
      * Helper to fill an UDSEntry
@@ -283,6 +301,22 @@ public:
 
     Q_REQUIRED_RESULT Result ftpStatAnswerNotFound(const QString &path, const QString &filename);
 
+    using CacheLookup = FtpDirCache::Lookup;
+    /*!
+     * Looks \a path up in the directory cache, see m_dirCache. On success the
+     * cached entry is stored in \a ftpEnt.
+     */
+    CacheLookup ftpCacheLookup(const QString &path, FtpEntry *ftpEnt = nullptr);
+    /*!
+     * Adds the entry for \a path, e.g. the result of MLST, to the directory cache.
+     */
+    void ftpCacheEntry(const QString &path, const FtpEntry &ftpEnt);
+    /*!
+     * Forgets everything cached about \a path, its parent directory and, if it
+     * is a directory, everything below it. Called whenever we modify the server.
+     */
+    void ftpCacheInvalidate(const QString &path);
+
     /*!
      * This is the internal implementation of rename() - set put().
      *
@@ -442,6 +476,12 @@ private: // data members
 
     bool m_bPasv;
 
+    /*!
+     * true while the open data connection carries an MLSD listing rather than
+     * the output of LIST, see ftpOpenDir() and ftpReadDir().
+     */
+    bool m_bMlsdListing = false;
+
     KIO::filesize_t m_size;
     static const KIO::filesize_t UnknownSize;
 
@@ -452,6 +492,7 @@ private: // data members
         epsvAllSent = 0x10,
         pasvUnknown = 0x20,
         chmodUnknown = 0x100,
+        mlstSupported = 0x200, // FEAT announced MLST, which implies MLSD
     };
     int m_extControl;
 
@@ -460,6 +501,13 @@ private: // data members
      */
     QTcpSocket *m_control = nullptr;
     QByteArray m_lastControlLine;
+    /*!
+     * The lines between the first and the final line of the last multi-line
+     * response, e.g. the features listed in reply to FEAT.
+     */
+    QByteArrayList m_lastResponseBody;
+
+    FtpDirCache m_dirCache;
 
     /*!
      * data connection socket
@@ -0,0 +1,124 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ftpdircache.h"
+
+#include <QDir>
+
+#include <chrono>
+
+// How long listings and stat results are trusted, other clients may change
+// the server meanwhile
+static constexpr std::chrono::seconds s_lifetime{10};
+static constexpr int s_maxDirs = 64;
+
+static QString cacheKey(const QString &path)
+{
+    const QString cleanPath = QDir::cleanPath(path);
+    return cleanPath.isEmpty() ? QStringLiteral("/") : cleanPath;
+}
+
+static QString cacheParent(const QString &key)
+{
+    const int pos = key.lastIndexOf(QLatin1Char('/'));
+    return pos > 0 ? key.left(pos) : QStringLiteral("/");
+}
+
+static QString cacheName(const QString &key)
+{
+    return key.mid(key.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+FtpDirCache::CachedDir &FtpDirCache::dir(const QString &key)
+{
+    auto it = m_dirs.find(key);
+    if (it != m_dirs.end() && !it->expiry.hasExpired()) {
+        return *it;
+    }
+
+    if (it == m_dirs.end() && m_dirs.size() >= s_maxDirs) {
+        m_dirs.removeIf([](QHash<QString, CachedDir>::iterator dirIt) {
+            return dirIt->expiry.hasExpired();
+        });
+        if (m_dirs.size() >= s_maxDirs) {
+            m_dirs.clear();
+        }
+    }
+
+    CachedDir &cachedDir = m_dirs[key];
+    cachedDir = CachedDir();
+    cachedDir.expiry = QDeadlineTimer(s_lifetime);
+    return cachedDir;
+}
+
+void FtpDirCache::setListing(const QString &path, QHash<QString, FtpEntry> &&entries)
+{
+    CachedDir &cachedDir = dir(cacheKey(path));
+    cachedDir.entries = std::move(entries);
+}
+
+void FtpDirCache::insert(const QString &path, const FtpEntry &ftpEnt)
+{
+    const QString key = cacheKey(path);
+    if (key == QLatin1String("/")) {
+        return;
+    }
+    dir(cacheParent(key)).entries.insert(cacheName(key), ftpEnt);
+}
+
+FtpDirCache::Lookup FtpDirCache::lookup(const QString &path, FtpEntry *ftpEnt)
+{
+    // Relative names, as used by fixupEntryName(), depend on the current directory
+    if (!path.startsWith(QLatin1Char('/'))) {
+        return Lookup::Unknown;
+    }
+
+    const QString key = cacheKey(path);
+    if (key == QLatin1String("/")) {
+        return Lookup::Unknown;
+    }
+
+    const auto dirIt = m_dirs.find(cacheParent(key));
+    if (dirIt == m_dirs.end()) {
+        return Lookup::Unknown;
+    }
+    if (dirIt->expiry.hasExpired()) {
+        m_dirs.erase(dirIt);
+        return Lookup::Unknown;
+    }
+
+    const auto it = dirIt->entries.constFind(cacheName(key));
+    if (it == dirIt->entries.cend()) {
+        return Lookup::Unknown;
+    }
+    if (!it->link.isEmpty()) {
+        // Only a CWD tells whether a link points to a directory
+        return Lookup::Unknown;
+    }
+    if (ftpEnt) {
+        *ftpEnt = *it;
+    }
+    return Lookup::Found;
+}
+
+void FtpDirCache::invalidate(const QString &path)
+{
+    if (m_dirs.isEmpty()) {
+        return;
+    }
+
+    const QString key = cacheKey(path);
+    const QString prefix = key.endsWith(QLatin1Char('/')) ? key : key + QLatin1Char('/');
+    m_dirs.remove(cacheParent(key));
+    m_dirs.removeIf([&key, &prefix](QHash<QString, CachedDir>::iterator it) {
+        return it.key() == key || it.key().startsWith(prefix);
+    });
+}
+
+void FtpDirCache::clear()
+{
+    m_dirs.clear();
+}
@@ -0,0 +1,80 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef FTPDIRCACHE_H
+#define FTPDIRCACHE_H
+
+#include <qplatformdefs.h>
+
+#include <kio/global.h>
+
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QString>
+
+struct FtpEntry {
+    QString name;
+    QString owner;
+    QString group;
+    QString link;
+
+    KIO::filesize_t size;
+    mode_t type;
+    mode_t access;
+    QDateTime date;
+};
+
+/*!
+ * Recently listed directories and stat results of one connection, by directory
+ * path. Lets e.g. a CopyJob stat what it just listed without going back to the
+ * server.
+ *
+ * Only what the server said exists is cached: a name missing from a listing
+ * may have been created since, by another connection or another client, so
+ * the server is asked about it.
+ */
+class FtpDirCache
+{
+public:
+    enum class Lookup {
+        Unknown,
+        Found,
+    };
+
+    /*!
+     * Replaces what is cached about the directory \a path with \a entries, its
+     * listing, by name.
+     */
+    void setListing(const QString &path, QHash<QString, FtpEntry> &&entries);
+    /*!
+     * Adds the entry for \a path, e.g. the result of MLST.
+     */
+    void insert(const QString &path, const FtpEntry &ftpEnt);
+    /*!
+     * Looks \a path up. On success the cached entry is stored in \a ftpEnt.
+     * Relative paths, which depend on the current directory, are never found.
+     */
+    Lookup lookup(const QString &path, FtpEntry *ftpEnt = nullptr);
+    /*!
+     * Forgets everything cached about \a path, its parent directory and, if it
+     * is a directory, everything below it. Called whenever we modify the server.
+     */
+    void invalidate(const QString &path);
+    void clear();
+
+private:
+    struct CachedDir {
+        QHash<QString, FtpEntry> entries;
+        QDeadlineTimer expiry;
+    };
+    // Returns the cache of the directory key, replacing it with an empty one if it expired
+    CachedDir &dir(const QString &key);
+
+    QHash<QString, CachedDir> m_dirs;
+};
+
+#endif
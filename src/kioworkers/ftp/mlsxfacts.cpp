@@ -0,0 +1,184 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "mlsxfacts.h"
+
+#include <QTimeZone>
+
+#include <algorithm>
+
+static bool factIs(QByteArrayView name, QByteArrayView fact)
+{
+    // Fact names and most values are case insensitive
+    return name.compare(fact, Qt::CaseInsensitive) == 0;
+}
+
+// "YYYYMMDDHHMMSS[.sss]", always in UTC
+static QDateTime parseTimeVal(QByteArrayView value)
+{
+    if (value.size() < 14) {
+        return QDateTime();
+    }
+    const QDate date(value.sliced(0, 4).toInt(), value.sliced(4, 2).toInt(), value.sliced(6, 2).toInt());
+    int msec = 0;
+    if (value.size() > 15 && value.at(14) == '.') {
+        // The fraction can have any number of digits, only keep milliseconds
+        const QByteArrayView fraction = value.sliced(15).first(std::min<qsizetype>(3, value.size() - 15));
+        msec = fraction.toInt();
+        for (qsizetype i = fraction.size(); i < 3; ++i) {
+            msec *= 10;
+        }
+    }
+    const QTime time(value.sliced(8, 2).toInt(), value.sliced(10, 2).toInt(), value.sliced(12, 2).toInt(), msec);
+    return QDateTime(date, time, QTimeZone::UTC);
+}
+
+static void parseType(QByteArrayView value, MlsxFacts &facts)
+{
+    if (factIs(value, "file")) {
+        facts.type = S_IFREG;
+    } else if (factIs(value, "dir")) {
+        facts.type = S_IFDIR;
+    } else if (factIs(value, "cdir")) {
+        facts.type = S_IFDIR;
+        facts.kind = MlsxFacts::CurrentDir;
+    } else if (factIs(value, "pdir")) {
+        facts.type = S_IFDIR;
+        facts.kind = MlsxFacts::ParentDir;
+    } else if (value.size() > 8 && factIs(value.first(8), "OS.unix=")) {
+        // e.g. "OS.unix=slink:/target", "OS.unix=chardev"
+        QByteArrayView osType = value.sliced(8);
+        const qsizetype colon = osType.indexOf(':');
+        if (colon >= 0) {
+            facts.link = osType.sliced(colon + 1).toByteArray();
+            osType = osType.first(colon);
+        }
+        if (factIs(osType, "blkdev") || factIs(osType, "block")) {
+            facts.type = S_IFBLK;
+        } else if (factIs(osType, "chardev") || factIs(osType, "char")) {
+            facts.type = S_IFCHR;
+        } else if (factIs(osType, "fifo") || factIs(osType, "pipe")) {
+            facts.type = S_IFIFO;
+        } else if (factIs(osType, "socket")) {
+            facts.type = S_IFSOCK;
+        } else {
+            // slink/symlink: like the LIST parser, we don't set S_IFLNK, the link target says it
+            facts.type = S_IFREG;
+            facts.isLink = factIs(osType, "slink") || factIs(osType, "symlink");
+        }
+    } else {
+        facts.type = S_IFREG;
+    }
+}
+
+// Maps the "perm" fact, which describes what the logged in user may do, to user permission bits
+static mode_t permToAccess(QByteArrayView perm, mode_t type)
+{
+    mode_t access = 0;
+    if (type == S_IFDIR) {
+        if (perm.contains('e') || perm.contains('l')) {
+            access |= S_IRUSR | S_IXUSR;
+        }
+        if (perm.contains('c') || perm.contains('m') || perm.contains('p')) {
+            access |= S_IWUSR;
+        }
+    } else {
+        if (perm.contains('r')) {
+            access |= S_IRUSR;
+        }
+        if (perm.contains('w') || perm.contains('a')) {
+            access |= S_IWUSR;
+        }
+    }
+    return access;
+}
+
+bool parseMlsxFacts(const QByteArray &line, MlsxFacts &facts)
+{
+    QByteArrayView view(line);
+    while (!view.isEmpty() && (view.back() == '\n' || view.back() == '\r')) {
+        view.chop(1);
+    }
+
+    // The facts never contain a space, the pathname follows the first one
+    const qsizetype space = view.indexOf(' ');
+    if (space < 0 || space + 1 == view.size()) {
+        return false;
+    }
+
+    facts = MlsxFacts();
+    facts.name = view.sliced(space + 1).toByteArray();
+
+    QByteArrayView perm;
+    bool hasMode = false;
+    bool hasSize = false;
+    QByteArrayView owner;
+    QByteArrayView group;
+
+    qsizetype pos = 0;
+    while (pos < space) {
+        qsizetype end = view.indexOf(';', pos);
+        if (end < 0 || end > space) {
+            end = space;
+        }
+        const QByteArrayView fact = view.sliced(pos, end - pos);
+        pos = end + 1;
+
+        const qsizetype equal = fact.indexOf('=');
+        if (equal <= 0) {
+            continue;
+        }
+        const QByteArrayView name = fact.first(equal);
+        const QByteArrayView value = fact.sliced(equal + 1);
+
+        if (factIs(name, "type")) {
+            parseType(value, facts);
+        } else if (factIs(name, "size")) {
+            facts.size = value.toULongLong();
+            hasSize = true;
+        } else if (factIs(name, "sizd")) {
+            // Size of a directory listing, only use it when there is no size fact
+            if (!hasSize) {
+                facts.size = value.toULongLong();
+            }
+        } else if (factIs(name, "modify")) {
+            facts.modified = parseTimeVal(value);
+        } else if (factIs(name, "perm")) {
+            perm = value;
+        } else if (factIs(name, "unix.mode")) {
+            bool ok = false;
+            const uint mode = value.toUInt(&ok, 8);
+            if (ok) {
+                facts.access = mode & 07777;
+                hasMode = true;
+            }
+        } else if (factIs(name, "unix.ownername") || (owner.isEmpty() && (factIs(name, "unix.owner") || factIs(name, "unix.uid")))) {
+            // Prefer names over the numeric ids some servers send in unix.owner
+            owner = value;
+        } else if (factIs(name, "unix.groupname") || (group.isEmpty() && (factIs(name, "unix.group") || factIs(name, "unix.gid")))) {
+            group = value;
+        } else if (factIs(name, "unix.slink")) {
+            facts.link = value.toByteArray();
+            facts.isLink = true;
+        }
+    }
+
+    facts.owner = owner.toByteArray();
+    facts.group = group.toByteArray();
+
+    if (!hasMode) {
+        if (!perm.isEmpty()) {
+            facts.access = permToAccess(perm, facts.type);
+        } else {
+            // No clue, assume readable
+            facts.access = S_IRUSR | S_IRGRP | S_IROTH;
+            if (facts.type == S_IFDIR) {
+                facts.access |= S_IXUSR | S_IXGRP | S_IXOTH;
+            }
+        }
+    }
+    return true;
+}
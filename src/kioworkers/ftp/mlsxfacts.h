@@ -0,0 +1,53 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef MLSXFACTS_H
+#define MLSXFACTS_H
+
+#include <qplatformdefs.h>
+
+#include <QByteArray>
+#include <QDateTime>
+
+/*!
+ * One entry of a machine-readable listing, as sent in reply to MLSD or MLST (RFC 3659).
+ */
+struct MlsxFacts {
+    enum Kind {
+        Entry,
+        CurrentDir, // type=cdir, the listed directory itself
+        ParentDir, // type=pdir
+    };
+
+    // Strings are kept in the remote encoding, the caller decodes them
+    QByteArray name;
+    QByteArray owner;
+    QByteArray group;
+    QByteArray link;
+
+    qulonglong size = 0;
+    mode_t type = S_IFREG;
+    mode_t access = 0;
+    // Invalid if the server did not send a modify fact
+    QDateTime modified;
+    Kind kind = Entry;
+    // A symlink, whose target may or may not be in link. type says S_IFREG like for LIST,
+    // whether it points to a dir isn't known from the facts.
+    bool isLink = false;
+};
+
+/*!
+ * Parses a "fact=value;fact=value; pathname" line into \a facts.
+ *
+ * The pathname is whatever the server sent: a plain name for MLSD, usually
+ * a full path for MLST. Trailing line breaks are ignored; the leading space
+ * of the fact line in an MLST reply must already be stripped.
+ *
+ * Returns false if the line is not a fact line.
+ */
+bool parseMlsxFacts(const QByteArray &line, MlsxFacts &facts);
+
+#endif
@@ -0,0 +1,119 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "davmultistatusparser.h"
+
+#include <QXmlStreamWriter>
+
+const DavElement *DavElement::child(QLatin1StringView name) const
+{
+    for (const DavElement &element : children) {
+        if (element.name == name) {
+            return &element;
+        }
+    }
+    return nullptr;
+}
+
+QString DavElement::attribute(QLatin1StringView name) const
+{
+    for (const QXmlStreamAttribute &attribute : attributes) {
+        if (attribute.name() == name) {
+            return attribute.value().toString();
+        }
+    }
+    return QString();
+}
+
+const DavElement *DavElement::firstChild() const
+{
+    return children.empty() ? nullptr : &children.front();
+}
+
+static void writeElement(QXmlStreamWriter &writer, const DavElement &element)
+{
+    writer.writeStartElement(element.namespaceUri, element.name);
+    writer.writeAttributes(element.attributes);
+    if (element.children.empty()) {
+        writer.writeCharacters(element.text);
+    } else {
+        for (const DavElement &child : element.children) {
+            writeElement(writer, child);
+        }
+    }
+    writer.writeEndElement();
+}
+
+QString DavElement::toXml() const
+{
+    QString xml;
+    QXmlStreamWriter writer(&xml);
+    writeElement(writer, *this);
+    return xml;
+}
+
+DavMultiStatusParser::DavMultiStatusParser(ResponseHandler handler)
+    : m_handler(std::move(handler))
+{
+}
+
+void DavMultiStatusParser::addData(const QByteArray &data)
+{
+    m_reader.addData(data);
+    parse();
+}
+
+bool DavMultiStatusParser::finish()
+{
+    parse();
+    return !m_reader.hasError() && m_reader.isEndDocument();
+}
+
+void DavMultiStatusParser::parse()
+{
+    while (!m_reader.atEnd()) {
+        switch (m_reader.readNext()) {
+        case QXmlStreamReader::StartElement:
+            ++m_depth;
+            // Depth 1 is <multistatus>, its children are the responses
+            if (!m_stack.empty() || (m_depth == 2 && m_reader.name() == QLatin1StringView("response"))) {
+                m_stack.push_back(DavElement{
+                    .name = m_reader.name().toString(),
+                    .namespaceUri = m_reader.namespaceUri().toString(),
+                    .attributes = m_reader.attributes(),
+                    .text = {},
+                    .children = {},
+                });
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            --m_depth;
+            if (!m_stack.empty()) {
+                DavElement element = std::move(m_stack.back());
+                m_stack.pop_back();
+                if (m_stack.empty()) {
+                    ++m_responseCount;
+                    m_handler(element);
+                } else {
+                    DavElement &parent = m_stack.back();
+                    parent.text += element.text;
+                    parent.children.push_back(std::move(element));
+                }
+            }
+            break;
+        case QXmlStreamReader::Characters:
+            // Like QDomDocument, ignore the indentation between elements
+            if (!m_stack.empty() && !m_reader.isWhitespace()) {
+                m_stack.back().text += m_reader.text();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    // PrematureEndOfDocumentError only means that more data is needed,
+    // the reader picks up where it stopped once it gets it.
+}
@@ -0,0 +1,91 @@
+/*
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef DAVMULTISTATUSPARSER_H
+#define DAVMULTISTATUSPARSER_H
+
+#include <QString>
+#include <QXmlStreamAttributes>
+#include <QXmlStreamReader>
+
+#include <functional>
+#include <vector>
+
+/*!
+ * An element of a WebDAV multistatus response, as collected by DavMultiStatusParser.
+ *
+ * Only the bits the http worker needs are kept: names, attributes,
+ * children and the text content.
+ */
+struct DavElement {
+    QString name; // local name, without prefix
+    QString namespaceUri;
+    QXmlStreamAttributes attributes;
+    // Text of this element and all its descendants, like QDomElement::text()
+    QString text;
+    std::vector<DavElement> children;
+
+    /*!
+     * Returns the first direct child called \a name (in any namespace), or nullptr.
+     */
+    const DavElement *child(QLatin1StringView name) const;
+
+    /*!
+     * Returns the value of the attribute called \a name (in any namespace).
+     */
+    QString attribute(QLatin1StringView name) const;
+
+    /*!
+     * Returns the first direct child that is an element, or nullptr.
+     */
+    const DavElement *firstChild() const;
+
+    /*!
+     * Serializes the element and its children back to XML.
+     */
+    QString toXml() const;
+};
+
+/*!
+ * Incremental parser for the body of a PROPFIND or SEARCH multistatus response.
+ *
+ * Data is fed as it arrives from the network with addData(). Each \c response
+ * child of the root element is handed to the callback as soon as its end tag
+ * has been read, and dropped afterwards, so memory use does not grow with
+ * the number of entries in the listing.
+ */
+class DavMultiStatusParser
+{
+public:
+    using ResponseHandler = std::function<void(const DavElement &response)>;
+
+    explicit DavMultiStatusParser(ResponseHandler handler);
+
+    void addData(const QByteArray &data);
+
+    /*!
+     * Returns false if the document is malformed or was cut short. All responses
+     * read before the error have already been passed to the handler.
+     */
+    bool finish();
+
+    int responseCount() const
+    {
+        return m_responseCount;
+    }
+
+private:
+    void parse();
+
+    ResponseHandler m_handler;
+    QXmlStreamReader m_reader;
+    // Open elements, from the current <response> down to the innermost one
+    std::vector<DavElement> m_stack;
+    int m_depth = 0;
+    int m_responseCount = 0;
+};
+
+#endif
@@ -13,8 +13,10 @@
 */
 
 #include "http.h"
+#include "davmultistatusparser.h"
 #include "debug.h"
 #include "kioglobal_p.h"
+#include "../../utils_p.h"
 
 #include <QAuthenticator>
 #include <QBuffer>
@@ -26,6 +28,10 @@
 #include <QNetworkCookieJar>
 #include <QNetworkProxy>
 #include <QSslCipher>
+#include <QSslConfiguration>
+
+#include <deque>
+#include <memory>
 
 #include <KLocalizedString>
 
@@ -117,6 +123,70 @@ QUrl protocolChangedToHttp(const QUrl &url)
     }
     return newUrl;
 }
+
+// The scheduler kills workers that have been idle for three minutes. Drop pooled
+// connections at half that, so a worker kept around for reuse does not hold on to
+// sockets the server is likely to have timed out already.
+constexpr int s_connectionIdleTimeout = 90;
+// The special command the worker sends itself when s_connectionIdleTimeout is over. Out of the
+// range of those that jobs send, like 1 for POST and 7 for WebDAV.
+constexpr int s_closeIdleConnectionsCommand = 99;
+
+// We are only after certain features...
+QByteArray propfindRequestBody()
+{
+    return QByteArrayLiteral(
+        "<?xml version=\"1.0\" encoding=\"utf-8\" ?>"
+        "<D:propfind xmlns:D=\"DAV:\">"
+        "<D:prop>"
+        "<D:creationdate/>"
+        "<D:getcontentlength/>"
+        "<D:displayname/>"
+        "<D:source/>"
+        "<D:getcontentlanguage/>"
+        "<D:getcontenttype/>"
+        "<D:getlastmodified/>"
+        "<D:getetag/>"
+        "<D:supportedlock/>"
+        "<D:lockdiscovery/>"
+        "<D:resourcetype/>"
+        "<D:quota-available-bytes/>"
+        "<D:quota-used-bytes/>"
+        "</D:prop>"
+        "</D:propfind>");
+}
+
+// Returns the path of resource relative to the collection at basePath, "." for the
+// collection itself, or a null string if resource is not inside that collection.
+QString relativeDavPath(const QString &basePath, const QUrl &resource)
+{
+    const QString path = resource.adjusted(QUrl::StripTrailingSlash).path();
+    if (path == basePath) {
+        return QStringLiteral(".");
+    }
+
+    const QString prefix = basePath.endsWith(QLatin1Char('/')) ? basePath : basePath + QLatin1Char('/');
+    if (path.size() <= prefix.size() || !path.startsWith(prefix)) {
+        return QString();
+    }
+    return path.mid(prefix.size());
+}
+
+// Qt opens at most six connections per host for HTTP/1.1, over HTTP/2 the requests share one.
+constexpr int s_maxConcurrentPropfinds = 6;
+
+QString elementName(const DavElement *element)
+{
+    return element ? element->name : QString();
+}
+
+QByteArray closeIdleConnectionsCommand()
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << s_closeIdleConnectionsCommand;
+    return data;
+}
 };
 
 HTTPProtocol::HTTPProtocol(const QByteArray &protocol, const QByteArray &pool, const QByteArray &app)
@@ -239,7 +309,8 @@ HTTPProtocol::Response HTTPProtocol::makeDavRequest(const QUrl &url,
                                                     KIO::HTTP_METHOD method,
                                                     QByteArray &inputData,
                                                     DataMode dataMode,
-                                                    const QMap<QByteArray, QByteArray> &extraHeaders)
+                                                    const QMap<QByteArray, QByteArray> &extraHeaders,
+                                                    const StreamHandler &streamHandler)
 {
     auto headers = extraHeaders;
     const QString locks = davProcessLocks();
@@ -252,11 +323,15 @@ HTTPProtocol::Response HTTPProtocol::makeDavRequest(const QUrl &url,
         headers.insert("If", locks.toLatin1());
     }
 
-    return makeRequest(url, method, inputData, dataMode, headers);
+    return makeRequest(url, method, inputData, dataMode, headers, streamHandler);
 }
 
-HTTPProtocol::Response
-HTTPProtocol::makeRequest(const QUrl &url, KIO::HTTP_METHOD method, QByteArray &inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders)
+HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
+                                                 KIO::HTTP_METHOD method,
+                                                 QByteArray &inputData,
+                                                 DataMode dataMode,
+                                                 const QMap<QByteArray, QByteArray> &extraHeaders,
+                                                 const StreamHandler &streamHandler)
 {
     /* HTTPProtocol::get(...) creates an empty inputData whether or not the calling function
      * sent data to the request. QNetworkRequest sends "Content-Length: 0" for all requests
@@ -268,7 +343,7 @@ HTTPProtocol::makeRequest(const QUrl &url, KIO::HTTP_METHOD method, QByteArray &
     const bool noBodyWhenEmpty = (method == KIO::HTTP_GET || method == KIO::HTTP_HEAD || method == KIO::HTTP_DELETE);
     QBuffer buffer(&inputData);
     QIODevice *bodyDevice = (noBodyWhenEmpty && inputData.isEmpty()) ? nullptr : &buffer;
-    return makeRequest(url, method, bodyDevice, dataMode, extraHeaders);
+    return makeRequest(url, method, bodyDevice, dataMode, extraHeaders, streamHandler);
 }
 
 static QString protocolForProxyType(QNetworkProxy::ProxyType type)
@@ -289,35 +364,30 @@ static QString protocolForProxyType(QNetworkProxy::ProxyType type)
     return QStringLiteral("http");
 }
 
-HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
-                                                 KIO::HTTP_METHOD method,
-                                                 QIODevice *inputData,
-                                                 HTTPProtocol::DataMode dataMode,
-                                                 const QMap<QByteArray, QByteArray> &extraHeaders)
+QNetworkAccessManager *HTTPProtocol::networkAccessManager()
 {
-    QNetworkAccessManager nam;
+    if (m_networkAccessManager) {
+        return m_networkAccessManager;
+    }
+
+    m_networkAccessManager = new QNetworkAccessManager(this);
 
     // Disable automatic redirect handling from Qt. We need to intercept redirects
     // to let KIO handle them
-    nam.setRedirectPolicy(QNetworkRequest::ManualRedirectPolicy);
-
-    auto cookies = new Cookies;
+    m_networkAccessManager->setRedirectPolicy(QNetworkRequest::ManualRedirectPolicy);
 
-    if (metaData(QStringLiteral("cookies")) == QStringLiteral("manual")) {
-        cookies->setCookies(metaData(QStringLiteral("setcookies")));
-
-        connect(cookies, &Cookies::cookiesAdded, this, [this](const QString &cookiesString) {
+    // The jar is refilled from the job's metadata before every request, see makeRequest()
+    m_cookieJar = new Cookies;
+    connect(m_cookieJar, &Cookies::cookiesAdded, this, [this](const QString &cookiesString) {
+        if (metaData(QStringLiteral("cookies")) == QStringLiteral("manual")) {
             setMetaData(QStringLiteral("setcookies"), cookiesString);
-        });
-    }
-
-    nam.setCookieJar(cookies);
-
-    QUrl properUrl = protocolChangedToHttp(url);
+        }
+    });
+    m_networkAccessManager->setCookieJar(m_cookieJar);
 
-    m_hostName = properUrl.host();
+    connect(m_networkAccessManager, &QNetworkAccessManager::authenticationRequired, this, [this](QNetworkReply * /*reply*/, QAuthenticator *authenticator) {
+        const QUrl url = m_requestUrl;
 
-    connect(&nam, &QNetworkAccessManager::authenticationRequired, this, [this, url](QNetworkReply * /*reply*/, QAuthenticator *authenticator) {
         if (configValue(QStringLiteral("no-www-auth"), false)) {
             return;
         }
@@ -360,7 +430,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         }
     });
 
-    connect(&nam, &QNetworkAccessManager::proxyAuthenticationRequired, this, [this](const QNetworkProxy &proxy, QAuthenticator *authenticator) {
+    connect(m_networkAccessManager, &QNetworkAccessManager::proxyAuthenticationRequired, this, [this](const QNetworkProxy &proxy, QAuthenticator *authenticator) {
         if (configValue(QStringLiteral("no-proxy-auth"), false)) {
             return;
         }
@@ -413,6 +483,23 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         }
     });
 
+    return m_networkAccessManager;
+}
+
+QNetworkRequest HTTPProtocol::prepareRequest(const QUrl &url, const QMap<QByteArray, QByteArray> &extraHeaders)
+{
+    networkAccessManager(); // makes sure the cookie jar exists
+
+    m_cookieJar->m_cookies.clear();
+    if (metaData(QStringLiteral("cookies")) == QStringLiteral("manual")) {
+        m_cookieJar->setCookies(metaData(QStringLiteral("setcookies")));
+    }
+
+    QUrl properUrl = protocolChangedToHttp(url);
+
+    m_hostName = properUrl.host();
+    m_requestUrl = url;
+
     QNetworkRequest request(properUrl);
 
     const QByteArray contentType = getContentType().toUtf8();
@@ -441,6 +528,14 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
     }
 
+    if (properUrl.scheme() == QLatin1String("https")) {
+        // Let new connections to the same host resume the TLS session instead of
+        // doing a full handshake each time.
+        QSslConfiguration sslConfiguration = request.sslConfiguration();
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        request.setSslConfiguration(sslConfiguration);
+    }
+
     for (auto [key, value] : extraHeaders.asKeyValueRange()) {
         request.setRawHeader(key, value);
     }
@@ -457,6 +552,25 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         }
     }
 
+    return request;
+}
+
+HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
+                                                 KIO::HTTP_METHOD method,
+                                                 QIODevice *inputData,
+                                                 HTTPProtocol::DataMode dataMode,
+                                                 const QMap<QByteArray, QByteArray> &extraHeaders,
+                                                 const StreamHandler &streamHandler)
+{
+    // Whatever the outcome, the pooled connections start a new idle period.
+    const auto idleTimeoutGuard = qScopeGuard([this] {
+        setTimeoutSpecialCommand(s_connectionIdleTimeout, closeIdleConnectionsCommand());
+    });
+
+    QNetworkAccessManager *nam = networkAccessManager();
+
+    QNetworkRequest request = prepareRequest(url, extraHeaders);
+
     if (inputData) {
         inputData->startTransaction(); // To be able to restart after redirects.
     }
@@ -469,22 +583,22 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     QNetworkReply *reply = nullptr;
     switch (method) {
     case KIO::HTTP_GET:
-        reply = nam.get(request, inputData);
+        reply = nam->get(request, inputData);
         break;
     case KIO::HTTP_PUT:
-        reply = nam.put(request, inputData);
+        reply = nam->put(request, inputData);
         break;
     case KIO::HTTP_POST:
-        reply = nam.post(request, inputData);
+        reply = nam->post(request, inputData);
         break;
     case KIO::HTTP_HEAD:
-        reply = nam.head(request);
+        reply = nam->head(request);
         break;
     case KIO::HTTP_DELETE:
-        reply = nam.deleteResource(request);
+        reply = nam->deleteResource(request);
         break;
     default:
-        reply = nam.sendCustomRequest(request, methodToString(method), inputData);
+        reply = nam->sendCustomRequest(request, methodToString(method), inputData);
     }
 
     const auto replyDeleter = qScopeGuard([reply] {
@@ -501,7 +615,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
 
     qint64 lastTotalSize = -1;
 
-    QObject::connect(reply, &QNetworkReply::downloadProgress, this, [this, &lastTotalSize](qint64 received, qint64 total) {
+    QObject::connect(reply, &QNetworkReply::downloadProgress, &loop, [this, &lastTotalSize](qint64 received, qint64 total) {
         if (total != lastTotalSize) {
             lastTotalSize = total;
             totalSize(total);
@@ -516,7 +630,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     // KIO doesn't handle trailing slashes well (especially in KDirLister), so handle it transparently.
     bool redirectToTrailingSlash = false;
 
-    QObject::connect(reply, &QNetworkReply::metaDataChanged, [this, &mimeTypeEmitted, &redirectToTrailingSlash, reply, dataMode, url, method]() {
+    QObject::connect(reply, &QNetworkReply::metaDataChanged, &loop, [this, &mimeTypeEmitted, &redirectToTrailingSlash, reply, dataMode, url, method]() {
         const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
         if (statusCode >= 300 && statusCode < 400) {
@@ -578,7 +692,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     });
 
     if (dataMode == Emit) {
-        QObject::connect(reply, &QNetworkReply::readyRead, &nam, [this, reply] {
+        QObject::connect(reply, &QNetworkReply::readyRead, &loop, [this, reply] {
             while (reply->bytesAvailable() > 0) {
                 QByteArray buf(2048, Qt::Uninitialized);
                 qint64 readBytes = reply->read(buf.data(), 2048);
@@ -592,6 +706,21 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         });
     }
 
+    // Hand the body over as it arrives, so the caller can process it with bounded memory.
+    // Error pages and redirect bodies are kept for the Response instead.
+    const auto streamsReply = [reply] {
+        const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        return statusCode >= 200 && statusCode < 300;
+    };
+
+    if (dataMode == Stream) {
+        QObject::connect(reply, &QNetworkReply::readyRead, &loop, [reply, &streamHandler, streamsReply] {
+            if (streamsReply()) {
+                streamHandler(reply->readAll());
+            }
+        });
+    }
+
     QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
     QObject::connect(this, &HTTPProtocol::errorOut, &loop, [this, &loop](KIO::Error error) {
         lastError = error;
@@ -607,7 +736,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         QUrl newUrl = url;
         newUrl.setPath(newUrl.path() + QLatin1Char('/'));
         redirection(newUrl);
-        return makeRequest(newUrl, method, inputData, dataMode, extraHeaders);
+        return makeRequest(newUrl, method, inputData, dataMode, extraHeaders, streamHandler);
     }
     if (inputData) {
         inputData->commitTransaction();
@@ -661,6 +790,12 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
 
     if (dataMode == Return) {
         returnData = reply->readAll();
+    } else if (dataMode == Stream) {
+        if (!streamsReply()) {
+            returnData = reply->readAll();
+        } else if (reply->bytesAvailable() > 0) {
+            streamHandler(reply->readAll());
+        }
     }
 
     setMetaData(QStringLiteral("responsecode"), QString::number(statusCode));
@@ -744,10 +879,20 @@ KIO::WorkerResult HTTPProtocol::special(const QByteArray &data)
         stream >> url >> method >> size;
         return davGeneric(url, (KIO::HTTP_METHOD)method, size);
     }
+    case s_closeIdleConnectionsCommand:
+        closeConnection();
+        break;
     }
     return KIO::WorkerResult::pass();
 }
 
+void HTTPProtocol::closeConnection()
+{
+    if (m_networkAccessManager) {
+        m_networkAccessManager->clearConnectionCache();
+    }
+}
+
 QByteArray HTTPProtocol::getData()
 {
     // TODO this is probably not great. Instead create a QIODevice that calls readData and pass that to QNAM?
@@ -782,15 +927,16 @@ QString HTTPProtocol::getContentType()
 
 KIO::WorkerResult HTTPProtocol::listDir(const QUrl &url)
 {
+    // A recursive ListJob lets us list the whole tree, instead of doing one request per directory
+    if (metaData(QStringLiteral("listRecursive")) == QLatin1String("true") && metaData(QStringLiteral("davSearchQuery")).isEmpty()) {
+        return davListRecursive(url);
+    }
+
     return davStatList(url, false);
 }
 
 KIO::WorkerResult HTTPProtocol::davStatList(const QUrl &url, bool stat)
 {
-    KIO::UDSEntry entry;
-
-    QMimeDatabase db;
-
     KIO::HTTP_METHOD method;
     QByteArray inputData;
 
@@ -804,26 +950,7 @@ KIO::WorkerResult HTTPProtocol::davStatList(const QUrl &url, bool stat)
 
         method = KIO::DAV_SEARCH;
     } else {
-        // We are only after certain features...
-        inputData =
-            "<?xml version=\"1.0\" encoding=\"utf-8\" ?>"
-            "<D:propfind xmlns:D=\"DAV:\">"
-            "<D:prop>"
-            "<D:creationdate/>"
-            "<D:getcontentlength/>"
-            "<D:displayname/>"
-            "<D:source/>"
-            "<D:getcontentlanguage/>"
-            "<D:getcontenttype/>"
-            "<D:getlastmodified/>"
-            "<D:getetag/>"
-            "<D:supportedlock/>"
-            "<D:lockdiscovery/>"
-            "<D:resourcetype/>"
-            "<D:quota-available-bytes/>"
-            "<D:quota-used-bytes/>"
-            "</D:prop>"
-            "</D:propfind>";
+        inputData = propfindRequestBody();
         method = KIO::DAV_PROPFIND;
     }
 
@@ -831,80 +958,297 @@ KIO::WorkerResult HTTPProtocol::davStatList(const QUrl &url, bool stat)
         {"Depth", stat ? "0" : "1"},
     };
 
-    Response response = makeDavRequest(url, method, inputData, DataMode::Return, extraHeaders);
+    bool hasResponse = false;
+    bool statEmitted = false;
+
+    // Entries are emitted while the multistatus body is still coming in,
+    // instead of after parsing the whole document.
+    DavMultiStatusParser parser([&](const DavElement &thisResponse) {
+        if (statEmitted) {
+            return;
+        }
+
+        hasResponse = true;
+
+        const DavElement *href = thisResponse.child(QLatin1StringView("href"));
+        if (!href) {
+            // qCDebug(KIO_HTTP) << "Error: no URL contained in response to PROPFIND on" << url;
+            return;
+        }
+
+        KIO::UDSEntry entry;
+
+        const QUrl thisURL(href->text); // href->text is a percent-encoded url.
+        if (thisURL.isValid()) {
+            const QUrl adjustedThisURL = thisURL.adjusted(QUrl::StripTrailingSlash);
+            const QUrl adjustedUrl = url.adjusted(QUrl::StripTrailingSlash);
+
+            // base dir of a listDir(): name should be "."
+            QString name;
+            if (!stat && adjustedThisURL.path() == adjustedUrl.path()) {
+                name = QLatin1Char('.');
+            } else {
+                name = adjustedThisURL.fileName();
+            }
+
+            entry.fastInsert(KIO::UDSEntry::UDS_NAME, name.isEmpty() ? href->text : name);
+        }
+
+        davParseResponse(thisResponse, thisURL, entry);
+
+        if (stat) {
+            // return an item
+            statEntry(entry);
+            statEmitted = true;
+            return;
+        }
+        listEntry(entry);
+    });
+
+    Response response = makeDavRequest(url, method, inputData, DataMode::Stream, extraHeaders, [&parser](const QByteArray &data) {
+        parser.addData(data);
+    });
 
     // If this is a redirection we don't have anything to do
     if (response.httpCode >= 300 && response.httpCode < 400) {
         return KIO::WorkerResult::pass();
     }
 
-    QDomDocument multiResponse;
-    multiResponse.setContent(response.data, QDomDocument::ParseOption::UseNamespaceProcessing);
+    if (!parser.finish()) {
+        qCWarning(KIOHTTP_LOG) << "Malformed or truncated multistatus response for" << url;
+    }
+
+    if (statEmitted) {
+        return KIO::WorkerResult::pass();
+    }
+
+    if (stat || !hasResponse) {
+        return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
+    }
+
+    return KIO::WorkerResult::pass();
+}
 
+KIO::WorkerResult HTTPProtocol::davListRecursive(const QUrl &url)
+{
+    // Tell the ListJob that the entries are named relative to url and that it must not recurse on its own.
+    setMetaData(QStringLiteral("listRecursive"), QStringLiteral("true"));
+    sendMetaData();
+
+    const QString basePath = url.adjusted(QUrl::StripTrailingSlash).path();
     bool hasResponse = false;
 
-    for (QDomNode n = multiResponse.documentElement().firstChild(); !n.isNull(); n = n.nextSibling()) {
-        QDomElement thisResponse = n.toElement();
-        if (thisResponse.isNull()) {
-            continue;
+    DavMultiStatusParser parser([&](const DavElement &thisResponse) {
+        hasResponse = true;
+
+        const DavElement *href = thisResponse.child(QLatin1StringView("href"));
+        if (!href) {
+            return;
         }
 
-        hasResponse = true;
+        const QUrl thisURL(href->text);
+        const QString name = relativeDavPath(basePath, thisURL);
+        if (name.isEmpty()) {
+            return;
+        }
+
+        KIO::UDSEntry entry;
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+        davParseResponse(thisResponse, thisURL, entry);
+        listEntry(entry);
+    });
 
-        QDomElement href = thisResponse.namedItem(QStringLiteral("href")).toElement();
-        if (!href.isNull()) {
-            entry.clear();
+    QByteArray inputData = propfindRequestBody();
+    const QMap<QByteArray, QByteArray> extraHeaders = {
+        {"Depth", "infinity"},
+    };
 
-            const QUrl thisURL(href.text()); // href.text() is a percent-encoded url.
-            if (thisURL.isValid()) {
-                const QUrl adjustedThisURL = thisURL.adjusted(QUrl::StripTrailingSlash);
-                const QUrl adjustedUrl = url.adjusted(QUrl::StripTrailingSlash);
+    Response response = makeDavRequest(url, KIO::DAV_PROPFIND, inputData, DataMode::Stream, extraHeaders, [&parser](const QByteArray &data) {
+        parser.addData(data);
+    });
 
-                // base dir of a listDir(): name should be "."
-                QString name;
-                if (!stat && adjustedThisURL.path() == adjustedUrl.path()) {
-                    name = QLatin1Char('.');
-                } else {
-                    name = adjustedThisURL.fileName();
-                }
+    // If this is a redirection we don't have anything to do
+    if (response.httpCode >= 300 && response.httpCode < 400) {
+        return KIO::WorkerResult::pass();
+    }
+
+    if (response.kioCode != KJob::NoError) {
+        return KIO::WorkerResult::fail(response.kioCode, url.toDisplayString());
+    }
+
+    // RFC 4918 9.1: servers may refuse Depth: infinity with 403 and a
+    // propfind-finite-depth precondition. Some just reject the header as a bad request.
+    // Any other 403 is a real access denial, which listing level by level would hide.
+    const bool depthRefused = (response.httpCode == 403 && response.data.contains("propfind-finite-depth")) //
+        || response.httpCode == 400 || response.httpCode == 501;
+    if (!hasResponse && depthRefused) {
+        return davListByLevel(url);
+    }
+
+    if (response.httpCode == 401 || response.httpCode == 403) {
+        return KIO::WorkerResult::fail(KIO::ERR_ACCESS_DENIED, url.toDisplayString());
+    }
+
+    if (!parser.finish()) {
+        qCWarning(KIOHTTP_LOG) << "Malformed or truncated multistatus response for" << url;
+    }
+
+    if (!hasResponse) {
+        return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
+    }
+
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult HTTPProtocol::davListByLevel(const QUrl &url)
+{
+    const auto idleTimeoutGuard = qScopeGuard([this] {
+        setTimeoutSpecialCommand(s_connectionIdleTimeout, closeIdleConnectionsCommand());
+    });
+
+    const QString basePath = url.adjusted(QUrl::StripTrailingSlash).path();
+    const QByteArray body = propfindRequestBody();
+
+    QMap<QByteArray, QByteArray> headers = {
+        {"Depth", "1"},
+        {"Content-Type", "text/xml; charset=utf-8"},
+    };
+    const QString locks = davProcessLocks();
+    if (!locks.isEmpty()) {
+        headers.insert("If", locks.toLatin1());
+    }
+
+    QNetworkAccessManager *nam = networkAccessManager();
 
-                entry.fastInsert(KIO::UDSEntry::UDS_NAME, name.isEmpty() ? href.text() : name);
+    // Directories still to be listed, relative to url. The empty string stands for url itself.
+    std::deque<QString> pendingDirs{QString()};
+    QList<QNetworkReply *> runningReplies;
+    bool baseListed = false;
+    bool aborted = false;
+
+    QEventLoop loop;
+
+    // Keep several Depth: 1 requests in flight, so that listing the tree costs
+    // roughly one round trip per level instead of one per directory.
+    std::function<void()> startRequests = [&] {
+        while (!aborted && runningReplies.size() < s_maxConcurrentPropfinds && !pendingDirs.empty()) {
+            const QString relativeDir = pendingDirs.front();
+            pendingDirs.pop_front();
+
+            QString dirPath = relativeDir.isEmpty() ? basePath : Utils::concatPaths(basePath, relativeDir);
+            if (!dirPath.endsWith(QLatin1Char('/'))) {
+                dirPath += QLatin1Char('/');
             }
+            QUrl dirUrl = url;
+            dirUrl.setPath(dirPath);
 
-            QDomNodeList propstats = thisResponse.elementsByTagName(QStringLiteral("propstat"));
+            auto parser = std::make_shared<DavMultiStatusParser>([&, relativeDir](const DavElement &thisResponse) {
+                const DavElement *href = thisResponse.child(QLatin1StringView("href"));
+                if (!href) {
+                    return;
+                }
 
-            davParsePropstats(propstats, entry);
+                const QUrl thisURL(href->text);
+                const QString name = relativeDavPath(basePath, thisURL);
+                // Subdirectories have been listed as part of their parent already
+                if (name.isEmpty() || name == relativeDir) {
+                    return;
+                }
 
-            // Since a lot of webdav servers seem not to send the content-type information
-            // for the requested directory listings, we attempt to guess the MIME type from
-            // the resource name so long as the resource is not a directory.
-            if (entry.stringValue(KIO::UDSEntry::UDS_MIME_TYPE).isEmpty() && entry.numberValue(KIO::UDSEntry::UDS_FILE_TYPE) != S_IFDIR) {
-                QMimeType mime = db.mimeTypeForFile(thisURL.path(), QMimeDatabase::MatchExtension);
-                if (mime.isValid() && !mime.isDefault()) {
-                    // qCDebug(KIO_HTTP) << "Setting" << mime.name() << "as guessed MIME type for" << thisURL.path();
-                    entry.fastInsert(KIO::UDSEntry::UDS_GUESSED_MIME_TYPE, mime.name());
+                KIO::UDSEntry entry;
+                entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+                davParseResponse(thisResponse, thisURL, entry);
+                if (name != QLatin1String(".") && entry.isDir()) {
+                    pendingDirs.push_back(name);
+                }
+                listEntry(entry);
+            });
+
+            QNetworkReply *reply = nam->sendCustomRequest(prepareRequest(dirUrl, headers), methodToString(KIO::DAV_PROPFIND), body);
+            runningReplies.append(reply);
+
+            const auto isMultiStatus = [reply] {
+                const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                return statusCode >= 200 && statusCode < 300;
+            };
+
+            QObject::connect(reply, &QNetworkReply::sslErrors, &loop, [this, reply](const QList<QSslError> errors) {
+                handleSslErrors(reply, errors);
+            });
+            QObject::connect(reply, &QNetworkReply::readyRead, &loop, [reply, parser, isMultiStatus] {
+                if (isMultiStatus()) {
+                    parser->addData(reply->readAll());
+                }
+            });
+            QObject::connect(reply, &QNetworkReply::finished, &loop, [&, reply, parser, isMultiStatus, relativeDir, dirUrl] {
+                runningReplies.removeOne(reply);
+                reply->deleteLater();
+
+                if (isMultiStatus()) {
+                    parser->addData(reply->readAll());
+                    if (!parser->finish()) {
+                        qCWarning(KIOHTTP_LOG) << "Malformed or truncated multistatus response for" << dirUrl;
+                    }
+                    if (relativeDir.isEmpty()) {
+                        baseListed = true;
+                    }
+                } else if (!aborted) {
+                    // Like ListJob, carry on with the rest of the tree
+                    qCWarning(KIOHTTP_LOG) << "Could not list" << dirUrl << reply->errorString();
                 }
-            }
 
-            if (stat) {
-                // return an item
-                statEntry(entry);
-                return KIO::WorkerResult::pass();
-            }
-            listEntry(entry);
-        } else {
-            // qCDebug(KIO_HTTP) << "Error: no URL contained in response to PROPFIND on" << url;
+                startRequests();
+                if (runningReplies.isEmpty()) {
+                    loop.quit();
+                }
+            });
         }
+    };
+
+    QObject::connect(this, &HTTPProtocol::errorOut, &loop, [&](KIO::Error error) {
+        lastError = error;
+        aborted = true;
+        const auto replies = runningReplies;
+        for (QNetworkReply *reply : replies) {
+            reply->abort();
+        }
+        loop.quit();
+    });
+
+    startRequests();
+    if (!runningReplies.isEmpty()) {
+        loop.exec();
     }
 
-    if (stat || !hasResponse) {
+    if (aborted) {
+        return KIO::WorkerResult::fail(lastError, url.toDisplayString());
+    }
+
+    if (!baseListed) {
         return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
     }
 
     return KIO::WorkerResult::pass();
 }
 
-void HTTPProtocol::davParsePropstats(const QDomNodeList &propstats, KIO::UDSEntry &entry)
+void HTTPProtocol::davParseResponse(const DavElement &response, const QUrl &resource, KIO::UDSEntry &entry)
+{
+    davParsePropstats(response, entry);
+
+    // Since a lot of webdav servers seem not to send the content-type information
+    // for the requested directory listings, we attempt to guess the MIME type from
+    // the resource name so long as the resource is not a directory.
+    if (entry.stringValue(KIO::UDSEntry::UDS_MIME_TYPE).isEmpty() && entry.numberValue(KIO::UDSEntry::UDS_FILE_TYPE) != S_IFDIR) {
+        QMimeDatabase db;
+        QMimeType mime = db.mimeTypeForFile(resource.path(), QMimeDatabase::MatchExtension);
+        if (mime.isValid() && !mime.isDefault()) {
+            // qCDebug(KIO_HTTP) << "Setting" << mime.name() << "as guessed MIME type for" << resource.path();
+            entry.fastInsert(KIO::UDSEntry::UDS_GUESSED_MIME_TYPE, mime.name());
+        }
+    }
+}
+
+void HTTPProtocol::davParsePropstats(const DavElement &response, KIO::UDSEntry &entry)
 {
     QString mimeType;
     bool foundExecutable = false;
@@ -914,143 +1258,138 @@ void HTTPProtocol::davParsePropstats(const QDomNodeList &propstats, KIO::UDSEntr
     qlonglong quotaUsed = -1;
     qlonglong quotaAvailable = -1;
 
-    for (int i = 0; i < propstats.count(); i++) {
-        QDomElement propstat = propstats.item(i).toElement();
+    for (const DavElement &propstat : response.children) {
+        if (propstat.name != QLatin1String("propstat")) {
+            continue;
+        }
 
-        QDomElement status = propstat.namedItem(QStringLiteral("status")).toElement();
-        if (status.isNull()) {
+        const DavElement *status = propstat.child(QLatin1StringView("status"));
+        if (!status) {
             // error, no status code in this propstat
             // qCDebug(KIO_HTTP) << "Error, no status code in this propstat";
             return;
         }
 
-        int code = codeFromResponse(status.text());
+        int code = codeFromResponse(status->text);
 
         if (code != 200) {
             // qCDebug(KIO_HTTP) << "Got status code" << code << "(this may mean that some properties are unavailable)";
             continue;
         }
 
-        QDomElement prop = propstat.namedItem(QStringLiteral("prop")).toElement();
-        if (prop.isNull()) {
+        const DavElement *prop = propstat.child(QLatin1StringView("prop"));
+        if (!prop) {
             // qCDebug(KIO_HTTP) << "Error: no prop segment in this propstat.";
             return;
         }
 
         // TODO unnecessary?
         if (hasMetaData(QStringLiteral("davRequestResponse"))) {
-            QDomDocument doc;
-            doc.appendChild(prop);
-            entry.replace(KIO::UDSEntry::UDS_XML_PROPERTIES, doc.toString());
+            entry.replace(KIO::UDSEntry::UDS_XML_PROPERTIES, prop->toXml());
         }
 
-        for (QDomNode n = prop.firstChild(); !n.isNull(); n = n.nextSibling()) {
-            QDomElement property = n.toElement();
-            if (property.isNull()) {
-                continue;
-            }
-
-            if (property.namespaceURI() != QLatin1String("DAV:")) {
+        for (const DavElement &property : prop->children) {
+            if (property.namespaceUri != QLatin1String("DAV:")) {
                 // break out - we're only interested in properties from the DAV namespace
                 continue;
             }
 
-            if (property.tagName() == QLatin1String("creationdate")) {
+            if (property.name == QLatin1String("creationdate")) {
                 // Resource creation date. Should be is ISO 8601 format.
-                auto datetime = parseDateTime(property.text(), property.attribute(QStringLiteral("dt")));
+                auto datetime = parseDateTime(property.text, property.attribute(QLatin1StringView("dt")));
                 if (datetime.isValid()) {
                     entry.replace(KIO::UDSEntry::UDS_CREATION_TIME, datetime.toSecsSinceEpoch());
                 } else {
-                    qWarning() << "Failed to parse creationdate" << property.text() << property.attribute(QStringLiteral("dt"));
+                    qWarning() << "Failed to parse creationdate" << property.text << property.attribute(QLatin1StringView("dt"));
                 }
-            } else if (property.tagName() == QLatin1String("getcontentlength")) {
+            } else if (property.name == QLatin1String("getcontentlength")) {
                 // Content length (file size)
-                entry.replace(KIO::UDSEntry::UDS_SIZE, property.text().toULong());
-            } else if (property.tagName() == QLatin1String("displayname")) {
+                entry.replace(KIO::UDSEntry::UDS_SIZE, property.text.toULong());
+            } else if (property.name == QLatin1String("displayname")) {
                 // Name suitable for presentation to the user
-                setMetaData(QStringLiteral("davDisplayName"), property.text());
-            } else if (property.tagName() == QLatin1String("source")) {
+                setMetaData(QStringLiteral("davDisplayName"), property.text);
+            } else if (property.name == QLatin1String("source")) {
                 // Source template location
-                QDomElement source = property.namedItem(QStringLiteral("link")).toElement().namedItem(QStringLiteral("dst")).toElement();
-                if (!source.isNull()) {
-                    setMetaData(QStringLiteral("davSource"), source.text());
+                const DavElement *link = property.child(QLatin1StringView("link"));
+                const DavElement *source = link ? link->child(QLatin1StringView("dst")) : nullptr;
+                if (source) {
+                    setMetaData(QStringLiteral("davSource"), source->text);
                 }
-            } else if (property.tagName() == QLatin1String("getcontentlanguage")) {
+            } else if (property.name == QLatin1String("getcontentlanguage")) {
                 // equiv. to Content-Language header on a GET
-                setMetaData(QStringLiteral("davContentLanguage"), property.text());
-            } else if (property.tagName() == QLatin1String("getcontenttype")) {
+                setMetaData(QStringLiteral("davContentLanguage"), property.text);
+            } else if (property.name == QLatin1String("getcontenttype")) {
                 // Content type (MIME type)
                 // This may require adjustments for other server-side webdav implementations
                 // (tested with Apache + mod_dav 1.0.3)
-                if (property.text() == QLatin1String("httpd/unix-directory")) {
+                if (property.text == QLatin1String("httpd/unix-directory")) {
                     isDirectory = true;
-                } else if (property.text() != QLatin1String("application/octet-stream")) {
+                } else if (property.text != QLatin1String("application/octet-stream")) {
                     // The server could be lazy and always return application/octet-stream;
                     // we will guess the MIME type later in that case.
-                    mimeType = property.text();
+                    mimeType = property.text;
                 }
-            } else if (property.tagName() == QLatin1String("executable")) {
+            } else if (property.name == QLatin1String("executable")) {
                 // File executable status
-                if (property.text() == QLatin1Char('T')) {
+                if (property.text == QLatin1Char('T')) {
                     foundExecutable = true;
                 }
 
-            } else if (property.tagName() == QLatin1String("getlastmodified")) {
+            } else if (property.name == QLatin1String("getlastmodified")) {
                 // Last modification date
-                auto datetime = parseDateTime(property.text(), property.attribute(QStringLiteral("dt")));
+                auto datetime = parseDateTime(property.text, property.attribute(QLatin1StringView("dt")));
                 if (datetime.isValid()) {
                     entry.replace(KIO::UDSEntry::UDS_MODIFICATION_TIME, datetime.toSecsSinceEpoch());
                     entry.replace(KIO::UDSEntry::UDS_MODIFICATION_TIME_NS_OFFSET, datetime.time().msec() * 1000000);
                 } else {
-                    qWarning() << "Failed to parse getlastmodified" << property.text() << property.attribute(QStringLiteral("dt"));
+                    qWarning() << "Failed to parse getlastmodified" << property.text << property.attribute(QLatin1StringView("dt"));
                 }
-            } else if (property.tagName() == QLatin1String("getetag")) {
+            } else if (property.name == QLatin1String("getetag")) {
                 // Entity tag
-                setMetaData(QStringLiteral("davEntityTag"), property.text());
-            } else if (property.tagName() == QLatin1String("supportedlock")) {
+                setMetaData(QStringLiteral("davEntityTag"), property.text);
+            } else if (property.name == QLatin1String("supportedlock")) {
                 // Supported locking specifications
-                for (QDomNode n2 = property.firstChild(); !n2.isNull(); n2 = n2.nextSibling()) {
-                    QDomElement lockEntry = n2.toElement();
-                    if (lockEntry.tagName() == QLatin1String("lockentry")) {
-                        QDomElement lockScope = lockEntry.namedItem(QStringLiteral("lockscope")).toElement();
-                        QDomElement lockType = lockEntry.namedItem(QStringLiteral("locktype")).toElement();
-                        if (!lockScope.isNull() && !lockType.isNull()) {
+                for (const DavElement &lockEntry : property.children) {
+                    if (lockEntry.name == QLatin1String("lockentry")) {
+                        const DavElement *lockScope = lockEntry.child(QLatin1StringView("lockscope"));
+                        const DavElement *lockType = lockEntry.child(QLatin1StringView("locktype"));
+                        if (lockScope && lockType) {
                             // Lock type was properly specified
                             supportedLockCount++;
                             const QString lockCountStr = QString::number(supportedLockCount);
-                            const QString scope = lockScope.firstChild().toElement().tagName();
-                            const QString type = lockType.firstChild().toElement().tagName();
+                            const QString scope = elementName(lockScope->firstChild());
+                            const QString type = elementName(lockType->firstChild());
 
                             setMetaData(QLatin1String("davSupportedLockScope") + lockCountStr, scope);
                             setMetaData(QLatin1String("davSupportedLockType") + lockCountStr, type);
                         }
                     }
                 }
-            } else if (property.tagName() == QLatin1String("lockdiscovery")) {
+            } else if (property.name == QLatin1String("lockdiscovery")) {
                 // Lists the available locks
-                davParseActiveLocks(property.elementsByTagName(QStringLiteral("activelock")), lockCount);
-            } else if (property.tagName() == QLatin1String("resourcetype")) {
+                davParseActiveLocks(property, lockCount);
+            } else if (property.name == QLatin1String("resourcetype")) {
                 // Resource type. "Specifies the nature of the resource."
-                if (!property.namedItem(QStringLiteral("collection")).toElement().isNull()) {
+                if (property.child(QLatin1StringView("collection"))) {
                     // This is a collection (directory)
                     isDirectory = true;
                 }
-            } else if (property.tagName() == QLatin1String("quota-used-bytes")) {
+            } else if (property.name == QLatin1String("quota-used-bytes")) {
                 // Quota-used-bytes. "Contains the amount of storage already in use."
                 bool ok;
-                qlonglong used = property.text().toLongLong(&ok);
+                qlonglong used = property.text.toLongLong(&ok);
                 if (ok) {
                     quotaUsed = used;
                 }
-            } else if (property.tagName() == QLatin1String("quota-available-bytes")) {
+            } else if (property.name == QLatin1String("quota-available-bytes")) {
                 // Quota-available-bytes. "Indicates the maximum amount of additional storage available."
                 bool ok;
-                qlonglong available = property.text().toLongLong(&ok);
+                qlonglong available = property.text.toLongLong(&ok);
                 if (ok) {
                     quotaAvailable = available;
                 }
             } else {
-                // qCDebug(KIO_HTTP) << "Found unknown webdav property:" << property.tagName();
+                // qCDebug(KIO_HTTP) << "Found unknown webdav property:" << property.name;
             }
         }
     }
@@ -1078,45 +1417,47 @@ void HTTPProtocol::davParsePropstats(const QDomNodeList &propstats, KIO::UDSEntr
     }
 }
 
-void HTTPProtocol::davParseActiveLocks(const QDomNodeList &activeLocks, uint &lockCount)
+void HTTPProtocol::davParseActiveLocks(const DavElement &lockDiscovery, uint &lockCount)
 {
-    for (int i = 0; i < activeLocks.count(); i++) {
-        const QDomElement activeLock = activeLocks.item(i).toElement();
+    for (const DavElement &activeLock : lockDiscovery.children) {
+        if (activeLock.name != QLatin1String("activelock")) {
+            continue;
+        }
 
         lockCount++;
         // required
-        const QDomElement lockScope = activeLock.namedItem(QStringLiteral("lockscope")).toElement();
-        const QDomElement lockType = activeLock.namedItem(QStringLiteral("locktype")).toElement();
-        const QDomElement lockDepth = activeLock.namedItem(QStringLiteral("depth")).toElement();
+        const DavElement *lockScope = activeLock.child(QLatin1StringView("lockscope"));
+        const DavElement *lockType = activeLock.child(QLatin1StringView("locktype"));
+        const DavElement *lockDepth = activeLock.child(QLatin1StringView("depth"));
         // optional
-        const QDomElement lockOwner = activeLock.namedItem(QStringLiteral("owner")).toElement();
-        const QDomElement lockTimeout = activeLock.namedItem(QStringLiteral("timeout")).toElement();
-        const QDomElement lockToken = activeLock.namedItem(QStringLiteral("locktoken")).toElement();
+        const DavElement *lockOwner = activeLock.child(QLatin1StringView("owner"));
+        const DavElement *lockTimeout = activeLock.child(QLatin1StringView("timeout"));
+        const DavElement *lockToken = activeLock.child(QLatin1StringView("locktoken"));
 
-        if (!lockScope.isNull() && !lockType.isNull() && !lockDepth.isNull()) {
+        if (lockScope && lockType && lockDepth) {
             // lock was properly specified
             lockCount++;
             const QString lockCountStr = QString::number(lockCount);
-            const QString scope = lockScope.firstChild().toElement().tagName();
-            const QString type = lockType.firstChild().toElement().tagName();
-            const QString depth = lockDepth.text();
+            const QString scope = elementName(lockScope->firstChild());
+            const QString type = elementName(lockType->firstChild());
+            const QString depth = lockDepth->text;
 
             setMetaData(QLatin1String("davLockScope") + lockCountStr, scope);
             setMetaData(QLatin1String("davLockType") + lockCountStr, type);
             setMetaData(QLatin1String("davLockDepth") + lockCountStr, depth);
 
-            if (!lockOwner.isNull()) {
-                setMetaData(QLatin1String("davLockOwner") + lockCountStr, lockOwner.text());
+            if (lockOwner) {
+                setMetaData(QLatin1String("davLockOwner") + lockCountStr, lockOwner->text);
             }
 
-            if (!lockTimeout.isNull()) {
-                setMetaData(QLatin1String("davLockTimeout") + lockCountStr, lockTimeout.text());
+            if (lockTimeout) {
+                setMetaData(QLatin1String("davLockTimeout") + lockCountStr, lockTimeout->text);
             }
 
-            if (!lockToken.isNull()) {
-                QDomElement tokenVal = lockScope.namedItem(QStringLiteral("href")).toElement();
-                if (!tokenVal.isNull()) {
-                    setMetaData(QLatin1String("davLockToken") + lockCountStr, tokenVal.text());
+            if (lockToken) {
+                const DavElement *tokenVal = lockScope->child(QLatin1StringView("href"));
+                if (tokenVal) {
+                    setMetaData(QLatin1String("davLockToken") + lockCountStr, tokenVal->text);
                 }
             }
         }
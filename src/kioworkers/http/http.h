@@ -22,7 +22,11 @@
 
 #include "httpmethod_p.h"
 
-class QDomNodeList;
+#include <functional>
+
+struct DavElement;
+class QNetworkAccessManager;
+class Cookies;
 
 class HTTPProtocol : public QObject, public KIO::WorkerBase
 {
@@ -42,6 +46,7 @@ public:
     KIO::WorkerResult copy(const QUrl &src, const QUrl &dest, int, KIO::JobFlags flags) override;
     KIO::WorkerResult del(const QUrl &url, bool _isfile) override;
     KIO::WorkerResult fileSystemFreeSpace(const QUrl &url) override;
+    void closeConnection() override;
 
 Q_SIGNALS:
     void errorOut(KIO::Error error);
@@ -54,8 +59,13 @@ private:
         Return,
         // discard any response data
         Discard,
+        // pass successful (2xx) response data to the StreamHandler as it is received,
+        // anything else is returned like in Return mode
+        Stream,
     };
 
+    using StreamHandler = std::function<void(const QByteArray &data)>;
+
     struct Response {
         int httpCode;
         QByteArray data;
@@ -69,10 +79,35 @@ private:
 
     void handleSslErrors(QNetworkReply *reply, const QList<QSslError> errors);
 
+    /*!
+     * Returns the access manager shared by all requests of this worker,
+     * creating it on first use. Keeping it alive lets Qt reuse TCP
+     * connections and TLS sessions between requests to the same host.
+     */
+    QNetworkAccessManager *networkAccessManager();
+
+    /*!
+     * Returns a request for \a url carrying the headers asked for by the job's
+     * metadata and \a extraHeaders.
+     */
+    QNetworkRequest prepareRequest(const QUrl &url, const QMap<QByteArray, QByteArray> &extraHeaders);
+
     [[nodiscard]] KIO::WorkerResult davStatList(const QUrl &url, bool stat);
-    void davParsePropstats(const QDomNodeList &propstats, KIO::UDSEntry &entry);
+
+    /*!
+     * Lists the whole tree below \a url with a single Depth: infinity PROPFIND,
+     * falling back to davListByLevel() if the server refuses that.
+     * Entries are named by their path relative to \a url.
+     */
+    [[nodiscard]] KIO::WorkerResult davListRecursive(const QUrl &url);
+    /*!
+     * Lists the tree below \a url with concurrent Depth: 1 requests.
+     */
+    [[nodiscard]] KIO::WorkerResult davListByLevel(const QUrl &url);
+    void davParseResponse(const DavElement &response, const QUrl &resource, KIO::UDSEntry &entry);
+    void davParsePropstats(const DavElement &response, KIO::UDSEntry &entry);
     QDateTime parseDateTime(const QString &input, const QString &type);
-    void davParseActiveLocks(const QDomNodeList &activeLocks, uint &lockCount);
+    void davParseActiveLocks(const DavElement &lockDiscovery, uint &lockCount);
     int codeFromResponse(const QString &response);
     bool davDestinationExists(const QUrl &url);
     QByteArray getData();
@@ -80,12 +115,27 @@ private:
 
     [[nodiscard]] KIO::WorkerResult post(const QUrl &url, qint64 size);
     [[nodiscard]] Response
-    makeRequest(const QUrl &url, KIO::HTTP_METHOD method, QIODevice *inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders = {});
+    makeRequest(const QUrl &url,
+                KIO::HTTP_METHOD method,
+                QIODevice *inputData,
+                DataMode dataMode,
+                const QMap<QByteArray, QByteArray> &extraHeaders = {},
+                const StreamHandler &streamHandler = {});
 
     [[nodiscard]] Response
-    makeDavRequest(const QUrl &url, KIO::HTTP_METHOD, QByteArray &inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders = {});
+    makeDavRequest(const QUrl &url,
+                   KIO::HTTP_METHOD,
+                   QByteArray &inputData,
+                   DataMode dataMode,
+                   const QMap<QByteArray, QByteArray> &extraHeaders = {},
+                   const StreamHandler &streamHandler = {});
     [[nodiscard]] Response
-    makeRequest(const QUrl &url, KIO::HTTP_METHOD, QByteArray &inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders = {});
+    makeRequest(const QUrl &url,
+                KIO::HTTP_METHOD,
+                QByteArray &inputData,
+                DataMode dataMode,
+                const QMap<QByteArray, QByteArray> &extraHeaders = {},
+                const StreamHandler &streamHandler = {});
 
     [[nodiscard]] KIO::WorkerResult davError(KIO::HTTP_METHOD method, const QUrl &url, const Response &response);
     [[nodiscard]] KIO::WorkerResult davError(QString &errorMsg, KIO::HTTP_METHOD method, int code, const QUrl &_url, const QByteArray &responseData);
@@ -114,6 +164,10 @@ private:
     KIO::Error lastError = (KIO::Error)KJob::NoError;
     QString m_hostName;
     QString m_defaultUserAgent;
+    QNetworkAccessManager *m_networkAccessManager = nullptr;
+    Cookies *m_cookieJar = nullptr;
+    // The URL of the request in flight, used when answering authentication challenges
+    QUrl m_requestUrl;
 };
 
 #endif
@@ -39,6 +39,8 @@
 #include <QTemporaryFile>
 #include <QUrl>
 
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 // There are two ways to test encoding things:
@@ -321,6 +323,18 @@ static void createTestFile(const QString &path)
     QVERIFY(QFile::exists(path));
 }
 
+// The original path of a file in the home trash as listed by impl, empty when it is not listed
+static QString origPathOf(TrashImpl &impl, const QString &fileId)
+{
+    const TrashImpl::TrashedFileInfoList infos = impl.list();
+    for (const TrashImpl::TrashedFileInfo &info : infos) {
+        if (info.trashId == 0 && info.fileId == fileId) {
+            return info.origPath;
+        }
+    }
+    return QString();
+}
+
 [[maybe_unused]] static bool dirListerContainsDisplayName(const KCoreDirLister &lister, const QString &displayName)
 {
     const KFileItemList items = lister.items();
@@ -775,6 +789,81 @@ void TestTrash::testRemoveStaleInfofile()
     QVERIFY(!QFile(infoPath).exists());
 }
 
+void TestTrash::testInfoFileChangedBehindIndex()
+{
+    TrashImpl impl;
+    QVERIFY(impl.init());
+
+    // Written by another implementation of the trash, which knows nothing about the index
+    const QString fileId = QStringLiteral("fileFromElsewhere");
+    const QString infoPath = m_trashDir + QLatin1String("/info/") + fileId + QLatin1String(".trashinfo");
+    const auto writeInfoFile = [&infoPath](const QByteArray &origPath) {
+        QFile infoFile(infoPath);
+        QVERIFY(infoFile.open(QIODevice::WriteOnly));
+        infoFile.write("[Trash Info]\nPath=" + origPath + "\nDeletionDate=2026-01-01T12:00:00\n");
+    };
+    createTestFile(m_trashDir + QLatin1String("/files/") + fileId);
+    QCOMPARE(origPathOf(impl, fileId), QString());
+
+    writeInfoFile("/tmp/fileFromElsewhere");
+    QCOMPARE(origPathOf(impl, fileId), QStringLiteral("/tmp/fileFromElsewhere"));
+
+    // Same name, another file
+    QVERIFY(QFile::remove(infoPath));
+    writeInfoFile("/tmp/other%20file");
+    QCOMPARE(origPathOf(impl, fileId), QStringLiteral("/tmp/other file"));
+
+    removeFile(m_trashDir, QLatin1String("/info/") + fileId + QLatin1String(".trashinfo"));
+    removeFile(m_trashDir, QLatin1String("/files/") + fileId);
+    QCOMPARE(origPathOf(impl, fileId), QString());
+}
+
+// Once the info directory is old enough for its modification time to be trusted, the index is
+// written along with it, and a file added behind its back still shows up.
+void TestTrash::testIndexOfStableInfoDir()
+{
+    TrashImpl impl;
+    QVERIFY(impl.init());
+
+    const QString infoDir = m_trashDir + QLatin1String("/info");
+    // Always the same time, the index must find the directory as it left it
+    const time_t pastTime = ::time(nullptr) - 60;
+    const auto backdateInfoDir = [&infoDir, pastTime]() {
+        const struct timespec times[2] = {{0, UTIME_OMIT}, {pastTime, 0}};
+        QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(infoDir).constData(), times, 0), 0);
+    };
+    const auto writeInfoFile = [&infoDir](const QString &fileId, const QByteArray &origPath) {
+        QFile infoFile(infoDir + QLatin1Char('/') + fileId + QLatin1String(".trashinfo"));
+        QVERIFY(infoFile.open(QIODevice::WriteOnly));
+        infoFile.write("[Trash Info]\nPath=" + origPath + "\nDeletionDate=2026-01-01T12:00:00\n");
+    };
+
+    const QString fileId = QStringLiteral("fileInStableDir");
+    createTestFile(m_trashDir + QLatin1String("/files/") + fileId);
+    writeInfoFile(fileId, "/tmp/fileInStableDir1");
+    backdateInfoDir();
+    // Writes the index along with the modification time of the directory
+    QCOMPARE(origPathOf(impl, fileId), QStringLiteral("/tmp/fileInStableDir1"));
+
+    // Rewriting a file in place leaves the directory alone, so the index is not checked against
+    // it. Which path is listed until the directory changes is left open.
+    writeInfoFile(fileId, "/tmp/fileInStableDir2");
+    backdateInfoDir();
+
+    // Adding one changes the directory: the new file is found, the rewritten one read again
+    const QString addedId = QStringLiteral("fileAddedToStableDir");
+    createTestFile(m_trashDir + QLatin1String("/files/") + addedId);
+    writeInfoFile(addedId, "/tmp/fileAddedToStableDir");
+    QCOMPARE(origPathOf(impl, addedId), QStringLiteral("/tmp/fileAddedToStableDir"));
+    QCOMPARE(origPathOf(impl, fileId), QStringLiteral("/tmp/fileInStableDir2"));
+
+    for (const QString &id : {fileId, addedId}) {
+        removeFile(m_trashDir, QLatin1String("/info/") + id + QLatin1String(".trashinfo"));
+        removeFile(m_trashDir, QLatin1String("/files/") + id);
+    }
+    QCOMPARE(origPathOf(impl, addedId), QString());
+}
+
 void TestTrash::delRootFile()
 {
     // test deleting a trashed file
@@ -61,6 +61,8 @@ private Q_SLOTS:
     void statInvalid();
     void statBrokenSymlinkInSubdir();
     void testRemoveStaleInfofile();
+    void testInfoFileChangedBehindIndex();
+    void testIndexOfStableInfoDir();
 
     void copyFileFromTrash();
     void copyFileInDirectoryFromTrash();
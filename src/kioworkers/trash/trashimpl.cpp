@@ -8,6 +8,7 @@
 #include "trashimpl.h"
 #include "discspaceutil.h"
 #include "kiotrashdebug.h"
+#include "trashinfoindex.h"
 #include "trashsizecache.h"
 
 #include "../utils_p.h"
@@ -326,6 +327,8 @@ bool TrashImpl::createInfo(const QString &origPath, quint64 &trashId, QString &f
 
     ::fclose(file);
 
+    TrashInfoIndex(trashDirectoryPath(trashId)).add(fileId);
+
     // qCDebug(KIO_TRASH) << "info file created in trashId=" << trashId << ":" << fileId;
     return true;
 }
@@ -378,6 +381,7 @@ bool TrashImpl::deleteInfo(quint64 trashId, const QString &fileId)
 #endif
 
     if (QFile::remove(infoPath(trashId, fileId))) {
+        TrashInfoIndex(trashDirectoryPath(trashId)).remove(fileId);
         fileRemoved();
         return true;
     }
@@ -557,6 +561,9 @@ bool TrashImpl::moveInTrash(quint64 trashId, const QString &oldFileId, const QSt
                 TrashSizeCache trashSize(trashDirectoryPath(trashId));
                 trashSize.rename(oldFileId, newFileId);
             }
+            TrashInfoIndex index(trashDirectoryPath(trashId));
+            index.remove(oldFileId);
+            index.add(newFileId);
             return true;
         } else {
             // rollback
@@ -596,6 +603,7 @@ bool TrashImpl::del(quint64 trashId, const QString &fileId)
     }
 
     QFile::remove(info);
+    TrashInfoIndex(trashDirectoryPath(trashId)).remove(fileId);
     fileRemoved();
     return true;
 }
@@ -697,28 +705,16 @@ TrashImpl::TrashedFileInfoList TrashImpl::list()
     // For each known trash directory...
     for (auto it = m_trashDirectories.cbegin(); it != m_trashDirectories.cend(); ++it) {
         const quint64 trashId = it.key();
-        QString infoPath = it.value();
-        infoPath += QLatin1String("/info");
-        // Code taken from kio_file
-        const QStringList entryNames = listDir(infoPath);
-        // char path_buffer[PATH_MAX];
-        // getcwd(path_buffer, PATH_MAX - 1);
-        // if ( chdir( infoPathEnc ) )
-        //    continue;
-
-        const QLatin1String tail(".trashinfo");
-        const int tailLength = tail.size();
-        for (const QString &fileName : entryNames) {
-            if (fileName == QLatin1Char('.') || fileName == QLatin1String("..")) {
-                continue;
-            }
-            if (!fileName.endsWith(tail)) {
-                qCWarning(KIO_TRASH) << "Invalid info file found in" << infoPath << ":" << fileName;
-                continue;
-            }
-
+        // Reads only the info files that changed since the last listing
+        TrashInfoIndex index(it.value());
+        const QList<TrashInfoIndex::Record> records = index.records();
+        lst.reserve(lst.size() + records.size());
+        for (const TrashInfoIndex::Record &record : records) {
             TrashedFileInfo info;
-            if (infoForFile(trashId, fileName.chopped(tailLength), info)) {
+            info.trashId = trashId;
+            info.fileId = record.fileId;
+            info.physicalPath = filesPath(trashId, record.fileId);
+            if (readInfoRecord(record, info, trashId)) {
                 lst << info;
             }
         }
@@ -774,13 +770,17 @@ bool TrashImpl::trashSpaceInfo(const QString &path, TrashSpaceInfo &info)
 
 bool TrashImpl::readInfoFile(const QString &infoPath, TrashedFileInfo &info, quint64 trashId)
 {
-    KConfig cfg(infoPath, KConfig::SimpleConfig);
-    if (!cfg.hasGroup(QStringLiteral("Trash Info"))) {
+    TrashInfoIndex::Record record;
+    if (!TrashInfoIndex::readInfoFile(infoPath, record)) {
         error(KIO::ERR_CANNOT_OPEN_FOR_READING, infoPath);
         return false;
     }
-    const KConfigGroup group = cfg.group(QStringLiteral("Trash Info"));
-    info.origPath = QUrl::fromPercentEncoding(group.readEntry("Path").toLatin1());
+    return readInfoRecord(record, info, trashId);
+}
+
+bool TrashImpl::readInfoRecord(const TrashInfoIndex::Record &record, TrashedFileInfo &info, quint64 trashId)
+{
+    info.origPath = record.path;
     if (info.origPath.isEmpty()) {
         return false; // path is mandatory...
     }
@@ -792,10 +792,7 @@ bool TrashImpl::readInfoFile(const QString &infoPath, TrashedFileInfo &info, qui
             info.origPath.prepend(topdir);
         }
     }
-    const QString line = group.readEntry("DeletionDate");
-    if (!line.isEmpty()) {
-        info.deletionDate = QDateTime::fromString(line, Qt::ISODate);
-    }
+    info.deletionDate = record.deletionDate;
     return true;
 }
 
@@ -9,6 +9,7 @@
 #define TRASHIMPL_H
 
 #include "global.h"
+#include "trashinfoindex.h"
 #include "udsentry.h"
 #include <kio/job.h>
 
@@ -141,6 +142,7 @@ private:
     void error(int e, const QString &s);
 
     bool readInfoFile(const QString &infoPath, TrashedFileInfo &info, quint64 trashId);
+    bool readInfoRecord(const TrashInfoIndex::Record &record, TrashedFileInfo &info, quint64 trashId);
 
     QString infoPath(quint64 trashId, const QString &fileId) const;
     QString filesPath(quint64 trashId, const QString &fileId) const;
@@ -204,11 +206,10 @@ private:
 
     mutable KConfig m_config;
 
-    // We don't cache any data related to the trashed files.
-    // Another KIO worker could change that behind our feet.
-    // If we want to start caching data - and avoiding some race conditions -,
-    // we should turn this class into a kded module and use DCOP to talk to it
-    // from the KIO worker.
+    // We don't cache any data related to the trashed files in memory.
+    // Another KIO worker could change that behind our feet. The only
+    // cache, TrashInfoIndex, is checked against the info directory
+    // each time the trash is listed.
 };
 
 #endif
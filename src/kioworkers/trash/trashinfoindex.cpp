@@ -0,0 +1,269 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "trashinfoindex.h"
+
+#include "kiotrashdebug.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static constexpr quint32 s_indexMagic = 0x4b544949; // "KTII"
+static constexpr quint32 s_indexVersion = 1;
+
+enum IndexOperation : quint8 {
+    AddEntry = 1,
+    RemoveEntry = 2,
+};
+
+// The modification time of a directory is only trusted once it is that old: a change made
+// within the same tick of the file system clock would not change it
+static constexpr qint64 s_stableMTimeNSecs = 2000000000LL;
+
+static qint64 mtimeOf(const struct stat &buff)
+{
+#ifdef Q_OS_MACOS
+    return buff.st_mtimespec.tv_sec * 1000000000LL + buff.st_mtimespec.tv_nsec;
+#else
+    return buff.st_mtim.tv_sec * 1000000000LL + buff.st_mtim.tv_nsec;
+#endif
+}
+
+TrashInfoIndex::TrashInfoIndex(const QString &trashPath)
+    : mInfoPath(trashPath + QLatin1String("/info"))
+{
+    const QByteArray hash = QCryptographicHash::hash(QFile::encodeName(mInfoPath), QCryptographicHash::Sha1).toHex();
+    mIndexPath = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kio_trash/") + QString::fromLatin1(hash)
+        + QLatin1String(".index");
+}
+
+QList<TrashInfoIndex::Record> TrashInfoIndex::records()
+{
+    // Before listing the directory, so that a change made meanwhile is noticed next time
+    const QByteArray infoPath_c = QFile::encodeName(mInfoPath);
+    struct stat dirBuff;
+    if (::stat(infoPath_c.constData(), &dirBuff) != 0) {
+        return {};
+    }
+    const qint64 infoDirMTime = mtimeOf(dirBuff);
+
+    Entries entries;
+    qint64 indexedMTime = 0;
+    // Whether entries were appended since the index was written, or it is damaged
+    bool appended = false;
+    QFile file(mIndexPath);
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+        quint32 magic = 0;
+        quint32 version = 0;
+        QString infoPath;
+        quint32 count = 0;
+        stream >> magic >> version >> infoPath >> indexedMTime >> count;
+        if (stream.status() != QDataStream::Ok || magic != s_indexMagic || version != s_indexVersion || infoPath != mInfoPath) {
+            indexedMTime = 0;
+        } else {
+            // The count is only a hint, and a damaged index must not make us reserve gigabytes:
+            // no operation takes less than 5 bytes in the file
+            entries.reserve(std::min<qint64>(count, file.size() / 5));
+            for (quint32 i = 0; !stream.atEnd(); ++i) {
+                quint8 operation = 0;
+                QString fileId;
+                stream >> operation >> fileId;
+                Entry entry;
+                if (operation == AddEntry) {
+                    stream >> entry.inode >> entry.mtime >> entry.size >> entry.record.path >> entry.record.deletionDate;
+                }
+                if (stream.status() != QDataStream::Ok || (operation != AddEntry && operation != RemoveEntry)) {
+                    // Cut short by a crash, or written by two processes at once
+                    appended = true;
+                    break;
+                }
+                appended = appended || i >= count;
+                if (operation == AddEntry) {
+                    entry.record.fileId = fileId;
+                    entries.insert(fileId, entry);
+                } else {
+                    entries.remove(fileId);
+                }
+            }
+        }
+        file.close();
+    }
+
+    bool changed = false;
+    if (appended || indexedMTime == 0 || indexedMTime != infoDirMTime) {
+        DIR *dp = ::opendir(infoPath_c.constData());
+        if (!dp) {
+            return {};
+        }
+        const QLatin1String tail(".trashinfo");
+        Entries found;
+        found.reserve(entries.size());
+        while (const struct dirent *ep = ::readdir(dp)) {
+            const QString fileName = QFile::decodeName(ep->d_name);
+            if (fileName == QLatin1Char('.') || fileName == QLatin1String("..")) {
+                continue;
+            }
+            if (!fileName.endsWith(tail)) {
+                qCWarning(KIO_TRASH) << "Invalid info file found in" << mInfoPath << ":" << fileName;
+                continue;
+            }
+            const QString fileId = fileName.chopped(tail.size());
+
+            struct stat buff;
+            const auto it = entries.constFind(fileId);
+            if (it != entries.cend() && ::fstatat(::dirfd(dp), ep->d_name, &buff, 0) == 0 && it->inode == quint64(buff.st_ino)
+                && it->mtime == mtimeOf(buff) && it->size == qint64(buff.st_size)) {
+                found.insert(fileId, *it);
+                continue;
+            }
+            changed = true;
+            Entry entry;
+            if (readEntry(fileId, entry)) {
+                found.insert(fileId, entry);
+            }
+        }
+        ::closedir(dp);
+        changed = changed || found.size() != entries.size();
+        entries = std::move(found);
+    }
+
+    const bool stable = QDateTime::currentMSecsSinceEpoch() * 1000000LL - infoDirMTime > s_stableMTimeNSecs;
+    if (changed || appended || indexedMTime != (stable ? infoDirMTime : 0)) {
+        write(entries, stable ? infoDirMTime : 0);
+    }
+
+    QList<Record> records;
+    records.reserve(entries.size());
+    for (const Entry &entry : std::as_const(entries)) {
+        records.append(entry.record);
+    }
+    // The order of QDir::entryList(), used before there was an index
+    std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.fileId.compare(b.fileId, Qt::CaseInsensitive) < 0;
+    });
+    return records;
+}
+
+void TrashInfoIndex::add(const QString &fileId)
+{
+    Entry entry;
+    if (!readEntry(fileId, entry)) {
+        return;
+    }
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << quint8(AddEntry) << fileId << entry.inode << entry.mtime << entry.size << entry.record.path << entry.record.deletionDate;
+    append(data);
+}
+
+void TrashInfoIndex::remove(const QString &fileId)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << quint8(RemoveEntry) << fileId;
+    append(data);
+}
+
+bool TrashInfoIndex::readInfoFile(const QString &infoPath, Record &record)
+{
+    QFile file(infoPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // The subset of the desktop entry format written by implementations of the specification;
+    // KConfig takes far longer to set up than to read these few lines
+    bool hasGroup = false;
+    bool inGroup = false;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.startsWith('[')) {
+            inGroup = line == "[Trash Info]";
+            hasGroup = hasGroup || inGroup;
+            continue;
+        }
+        const int equal = line.indexOf('=');
+        if (!inGroup || equal < 0) {
+            continue;
+        }
+        const QByteArray key = line.left(equal).trimmed();
+        const QByteArray value = line.mid(equal + 1).trimmed();
+        if (key == "Path") {
+            record.path = QUrl::fromPercentEncoding(value);
+        } else if (key == "DeletionDate") {
+            record.deletionDate = QDateTime::fromString(QString::fromLatin1(value), Qt::ISODate);
+        }
+    }
+    return hasGroup;
+}
+
+bool TrashInfoIndex::readEntry(const QString &fileId, Entry &entry) const
+{
+    const QString infoPath = mInfoPath + QLatin1Char('/') + fileId + QLatin1String(".trashinfo");
+    struct stat buff;
+    if (::stat(QFile::encodeName(infoPath).constData(), &buff) != 0) {
+        return false;
+    }
+    entry.inode = buff.st_ino;
+    entry.mtime = mtimeOf(buff);
+    entry.size = buff.st_size;
+    entry.record = Record();
+    entry.record.fileId = fileId;
+    // An invalid file is indexed too, with an empty path, not to be read again each time
+    readInfoFile(infoPath, entry.record);
+    return true;
+}
+
+void TrashInfoIndex::append(const QByteArray &data)
+{
+    QFile file(mIndexPath);
+    // Without an index there is nothing to keep up to date, records() writes it
+    if (!file.exists()) {
+        return;
+    }
+    // A single write to a file opened for appending, which other processes may append to as well
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        file.write(data);
+    }
+}
+
+void TrashInfoIndex::write(const Entries &entries, qint64 infoDirMTime)
+{
+    // Private to the user like the trash itself, the index lists the original paths of the files
+    const QString indexDir = QFileInfo(mIndexPath).path();
+    if (!QDir(indexDir).exists()) {
+        if (!QDir().mkpath(QFileInfo(indexDir).path()) || !QDir().mkdir(indexDir, QFile::ReadUser | QFile::WriteUser | QFile::ExeUser)) { // 0700
+            return;
+        }
+    }
+    QSaveFile file(mIndexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KIO_TRASH) << "Cannot write the trash index" << mIndexPath << file.errorString();
+        return;
+    }
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << s_indexMagic << s_indexVersion << mInfoPath << infoDirMTime << quint32(entries.size());
+    for (const Entry &entry : entries) {
+        stream << quint8(AddEntry) << entry.record.fileId << entry.inode << entry.mtime << entry.size << entry.record.path << entry.record.deletionDate;
+    }
+    file.commit();
+}
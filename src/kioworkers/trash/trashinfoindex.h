@@ -0,0 +1,82 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KIO contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef TRASHINFOINDEX_H
+#define TRASHINFOINDEX_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/*!
+ * @short The content of the .trashinfo files of a trash directory, kept in a single file.
+ *
+ * Listing the trash would otherwise mean reading every .trashinfo file of it. The index lives in
+ * the cache directory of the user, not in the trash directory, which other implementations of
+ * the trash specification share without knowing about it.
+ *
+ * The index is only ever a cache: records() checks it against the info directory, and reads
+ * again the .trashinfo files it doesn't know, or which changed since. Adding or removing an
+ * entry appends it to the index, which records() then writes again in one piece. When the info
+ * directory did not change since then, records() does not even look at the files in it.
+ */
+class TrashInfoIndex
+{
+public:
+    struct Record {
+        QString fileId;
+        // The Path entry, decoded; relative to the top directory, except for the home trash
+        QString path;
+        QDateTime deletionDate;
+    };
+
+    /*!
+     * Creates the index of the trash directory at @p trashPath.
+     */
+    explicit TrashInfoIndex(const QString &trashPath);
+
+    /*!
+     * Returns the records of all the .trashinfo files of the trash directory, sorted by fileId.
+     */
+    QList<Record> records();
+
+    /*!
+     * Adds the .trashinfo file of @p fileId, just written, to the index.
+     */
+    void add(const QString &fileId);
+
+    /*!
+     * Removes @p fileId, whose .trashinfo file was just removed, from the index.
+     */
+    void remove(const QString &fileId);
+
+    /*!
+     * Reads the .trashinfo file at @p infoPath into @p record, but for its fileId.
+     * Returns false if it has no [Trash Info] group.
+     */
+    static bool readInfoFile(const QString &infoPath, Record &record);
+
+private:
+    struct Entry {
+        Record record;
+        // What tells whether the .trashinfo file is still the one the record was read from
+        quint64 inode = 0;
+        qint64 mtime = 0;
+        qint64 size = 0;
+    };
+    using Entries = QHash<QString, Entry>;
+
+    bool readEntry(const QString &fileId, Entry &entry) const;
+    void append(const QByteArray &data);
+    void write(const Entries &entries, qint64 infoDirMTime);
+
+    QString mInfoPath;
+    QString mIndexPath;
+};
+
+#endif
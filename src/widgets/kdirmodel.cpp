@@ -84,8 +84,23 @@ public:
         return m_parent;
     }
 
-    // linear search
-    int rowNumber() const; // O(n)
+    // O(1), kept up to date by the parent
+    int rowNumber() const
+    {
+        return m_row;
+    }
+
+    // Whether KDirModelPrivate finds this node by its url rather than by its name in its parent,
+    // its url not being that of its parent followed by its name (e.g. search results)
+    bool isFoundByUrl() const
+    {
+        return m_foundByUrl;
+    }
+
+    void setFoundByUrl(bool foundByUrl)
+    {
+        m_foundByUrl = foundByUrl;
+    }
 
     QIcon preview() const
     {
@@ -114,10 +129,14 @@ public:
     }
 
 private:
+    friend class KDirModelDirNode;
+
     KFileItem m_item;
     KDirModelDirNode *const m_parent;
     QIcon m_preview;
+    int m_row = 0;
     bool m_previewHandlesSequences = true; // First sequence is always allowed
+    bool m_foundByUrl = false;
 };
 
 // Specialization for directory nodes
@@ -139,7 +158,66 @@ public:
     {
         qDeleteAll(m_childNodes);
     }
-    QList<KDirModelNode *> m_childNodes; // owns the nodes
+    QList<KDirModelNode *> m_childNodes; // owns the nodes, only changed through the methods below
+
+    void appendChild(KDirModelNode *node)
+    {
+        node->m_row = m_childNodes.count();
+        m_childNodes.append(node);
+    }
+
+    // Deletes the child at row and puts node in its place
+    void replaceChild(int row, KDirModelNode *node)
+    {
+        delete m_childNodes.at(row);
+        node->m_row = row;
+        m_childNodes[row] = node;
+    }
+
+    // Deletes the children from first to last, and renumbers those after them
+    void removeChildren(int first, int last)
+    {
+        for (int r = first; r <= last; ++r) {
+            delete m_childNodes.at(r);
+        }
+        m_childNodes.remove(first, last - first + 1);
+        for (int r = first; r < m_childNodes.count(); ++r) {
+            m_childNodes.at(r)->m_row = r;
+        }
+    }
+
+    // The child named name, among those not found by their url. The names are only hashed once a
+    // lookup goes through this directory, most listed directories never see one.
+    KDirModelNode *childByName(const QString &name) const
+    {
+        if (!m_childrenByNameBuilt) {
+            m_childrenByName.reserve(m_childNodes.count());
+            for (KDirModelNode *node : m_childNodes) {
+                if (!node->isFoundByUrl()) {
+                    m_childrenByName.insert(node->item().name(), node);
+                }
+            }
+            m_childrenByNameBuilt = true;
+        }
+        return m_childrenByName.value(name);
+    }
+
+    void addChildName(KDirModelNode *node)
+    {
+        if (m_childrenByNameBuilt) {
+            m_childrenByName.insert(node->item().name(), node);
+        }
+    }
+
+    void removeChildName(KDirModelNode *node)
+    {
+        if (m_childrenByNameBuilt) {
+            const auto it = m_childrenByName.find(node->item().name());
+            if (it != m_childrenByName.end() && it.value() == node) {
+                m_childrenByName.erase(it);
+            }
+        }
+    }
 
     void setItem(const KFileItem &item) override
     {
@@ -180,22 +258,9 @@ public:
         return m_fsType == NetworkFs;
     }
 
-    // For removing all child urls from the global hash.
-    QList<QUrl> collectAllChildUrls() const
-    {
-        QList<QUrl> urls;
-        urls.reserve(urls.size() + m_childNodes.size());
-        for (KDirModelNode *node : m_childNodes) {
-            const KFileItem &item = node->item();
-            urls.append(cleanupUrl(item.url()));
-            if (item.isDir()) {
-                urls += static_cast<KDirModelDirNode *>(node)->collectAllChildUrls();
-            }
-        }
-        return urls;
-    }
-
 private:
+    mutable QHash<QString, KDirModelNode *> m_childrenByName;
+    mutable bool m_childrenByNameBuilt = false;
     int m_childCount : 31;
     bool m_populated : 1;
     // Network file system? (nfs/smb/ssh)
@@ -206,12 +271,22 @@ private:
     } m_fsType : 3;
 };
 
-int KDirModelNode::rowNumber() const
+// Whether item, in the directory at dirUrl, is found by KDirModelPrivate::nodeForUrl() going
+// down from that directory by name
+static bool hasChildUrl(const KFileItem &item, const QUrl &dirUrl)
 {
-    if (!m_parent) {
-        return 0;
+    const QUrl url = item.url();
+    if (url.hasQuery() || url.hasFragment() || dirUrl.hasQuery() || dirUrl.hasFragment() || url.scheme() != dirUrl.scheme()
+        || url.authority() != dirUrl.authority()) {
+        return false;
     }
-    return m_parent->m_childNodes.indexOf(const_cast<KDirModelNode *>(this));
+    const QString name = item.name();
+    const QString path = url.path();
+    QString dirPath = dirUrl.path();
+    if (!dirPath.endsWith(QLatin1Char('/'))) {
+        dirPath += QLatin1Char('/');
+    }
+    return !name.isEmpty() && path.size() == dirPath.size() + name.size() && path.startsWith(dirPath) && path.endsWith(name);
 }
 
 ////
@@ -249,7 +324,8 @@ public:
     // last known parent if there is no node for this url
     KDirModelNode *expandAllParentsUntil(const QUrl &url) const;
 
-    // Return the node for a given url, using the hash.
+    // Return the node for a given url, going down by name from the root or from the closest node
+    // found by its url
     KDirModelNode *nodeForUrl(const QUrl &url) const;
     KDirModelNode *nodeForIndex(const QModelIndex &index) const;
     QModelIndex indexForNode(KDirModelNode *node, int rowNumber = -1 /*unknown*/) const;
@@ -294,7 +370,12 @@ public:
         return url;
     }
 
-    void removeFromNodeHash(KDirModelNode *node, const QUrl &url);
+    // Makes node, a child of its parent already, found by nodeForUrl()
+    void addToIndex(KDirModelNode *node);
+    // Undoes addToIndex() for node
+    void removeFromIndex(KDirModelNode *node);
+    // Undoes addToIndex() for node, and for the nodes below it found by their url, before deleting it
+    void removeTreeFromIndex(KDirModelNode *node);
     void clearAllPreviews(KDirModelDirNode *node);
 #ifndef NDEBUG
     void dump();
@@ -310,28 +391,86 @@ public:
     // key = current known parent node (always a KDirModelDirNode but KDirModelNode is more convenient),
     // value = final url[s] being fetched
     QMap<KDirModelNode *, QList<QUrl>> m_urlsBeingFetched;
-    QHash<QUrl, KDirModelNode *> m_nodeHash; // global node hash: url -> node
+    // The nodes found by their url, the others are found by name from their parent
+    QHash<QUrl, KDirModelNode *> m_nodesByUrl;
     QStringList m_allCurrentDestUrls; // list of all dest urls that have jobs on them (e.g. copy, download)
 };
 
-KDirModelNode *KDirModelPrivate::nodeForUrl(const QUrl &_url) const // O(1), well, O(length of url as a string)
+KDirModelNode *KDirModelPrivate::nodeForUrl(const QUrl &_url) const // O(depth)
 {
     QUrl url = cleanupUrl(_url);
-    if (url == urlForNode(m_rootNode)) {
-        return m_rootNode;
+    const QUrl rootUrl = cleanupUrl(urlForNode(m_rootNode));
+
+    // Up to the root or to a node found by its url...
+    QStringList names;
+    KDirModelNode *node = nullptr;
+    while (!node) {
+        if (url == rootUrl) {
+            node = m_rootNode;
+        } else if (!m_nodesByUrl.isEmpty()) {
+            node = m_nodesByUrl.value(url);
+        }
+        if (!node) {
+            const QUrl parentUrl = url.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
+            if (parentUrl == url || url.hasQuery() || url.hasFragment()) {
+                return nullptr;
+            }
+            names.append(url.fileName());
+            url = parentUrl;
+        }
+    }
+
+    // ...then down by name
+    for (auto it = names.crbegin(); it != names.crend(); ++it) {
+        if (!isDir(node)) {
+            return nullptr;
+        }
+        node = static_cast<KDirModelDirNode *>(node)->childByName(*it);
+        if (!node) {
+            return nullptr;
+        }
+    }
+    return node;
+}
+
+void KDirModelPrivate::addToIndex(KDirModelNode *node)
+{
+    KDirModelDirNode *dirNode = node->parent();
+    const bool foundByUrl = !hasChildUrl(node->item(), cleanupUrl(urlForNode(dirNode)));
+    node->setFoundByUrl(foundByUrl);
+    if (foundByUrl) {
+        m_nodesByUrl.insert(cleanupUrl(node->item().url()), node);
+    } else {
+        dirNode->addChildName(node);
+    }
+}
+
+void KDirModelPrivate::removeFromIndex(KDirModelNode *node)
+{
+    if (node->isFoundByUrl()) {
+        m_nodesByUrl.remove(cleanupUrl(node->item().url()));
+    } else {
+        node->parent()->removeChildName(node);
     }
-    return m_nodeHash.value(url);
 }
 
-void KDirModelPrivate::removeFromNodeHash(KDirModelNode *node, const QUrl &url)
+void KDirModelPrivate::removeTreeFromIndex(KDirModelNode *node)
 {
-    if (node->item().isDir()) {
-        const QList<QUrl> urls = static_cast<KDirModelDirNode *>(node)->collectAllChildUrls();
-        for (const QUrl &u : urls) {
-            m_nodeHash.remove(u);
+    removeFromIndex(node);
+    // The nodes found by name go away with their parent
+    QList<KDirModelNode *> nodes{node};
+    while (!m_nodesByUrl.isEmpty() && !nodes.isEmpty()) {
+        KDirModelNode *n = nodes.takeLast();
+        if (!n->item().isDir()) {
+            continue;
+        }
+        for (KDirModelNode *child : std::as_const(static_cast<KDirModelDirNode *>(n)->m_childNodes)) {
+            if (child->isFoundByUrl()) {
+                m_nodesByUrl.remove(cleanupUrl(child->item().url()));
+            }
+            nodes.append(child);
         }
     }
-    m_nodeHash.remove(cleanupUrl(url));
 }
 
 KDirModelNode *KDirModelPrivate::expandAllParentsUntil(const QUrl &_url) const // O(depth)
@@ -410,15 +549,20 @@ KDirModelNode *KDirModelPrivate::expandAllParentsUntil(const QUrl &_url) const /
 void KDirModelPrivate::dump()
 {
     qCDebug(category) << "Dumping contents of KDirModel" << q << "dirLister url:" << m_dirLister->url();
-    QHashIterator<QUrl, KDirModelNode *> it(m_nodeHash);
-    while (it.hasNext()) {
-        it.next();
-        qCDebug(category) << it.key() << it.value();
+    QList<KDirModelDirNode *> dirNodes{m_rootNode};
+    while (!dirNodes.isEmpty()) {
+        const KDirModelDirNode *dirNode = dirNodes.takeLast();
+        for (KDirModelNode *node : dirNode->m_childNodes) {
+            qCDebug(category) << cleanupUrl(node->item().url()) << node;
+            if (node->item().isDir()) {
+                dirNodes.append(static_cast<KDirModelDirNode *>(node));
+            }
+        }
     }
 }
 #endif
 
-// node -> index. If rowNumber is set (or node is root): O(1). Otherwise: O(n).
+// node -> index. O(1)
 QModelIndex KDirModelPrivate::indexForNode(KDirModelNode *node, int rowNumber) const
 {
     if (node == m_rootNode) {
@@ -558,7 +702,7 @@ void KDirModelPrivate::_k_slotNewItems(const QUrl &directoryUrl, const KFileItem
     Q_ASSERT(isDir(result));
     KDirModelDirNode *dirNode = static_cast<KDirModelDirNode *>(result);
 
-    const QModelIndex index = indexForNode(dirNode); // O(n)
+    const QModelIndex index = indexForNode(dirNode); // O(1)
     const int newItemsCount = items.count();
     const int newRowCount = dirNode->m_childNodes.count() + newItemsCount;
 
@@ -587,9 +731,9 @@ void KDirModelPrivate::_k_slotNewItems(const QUrl &directoryUrl, const KFileItem
         //    abort();
         //}
 #endif
-        dirNode->m_childNodes.append(node);
+        dirNode->appendChild(node);
+        addToIndex(node);
         const QUrl url = item.url();
-        m_nodeHash.insert(cleanupUrl(url), node);
 
         if (!urlsBeingFetched.isEmpty()) {
             const QUrl &dirUrl = url;
@@ -663,14 +807,14 @@ void KDirModelPrivate::_k_slotDeleteItems(const KFileItemList &items)
         return;
     }
 
-    QModelIndex parentIndex = indexForNode(dirNode); // O(n)
+    QModelIndex parentIndex = indexForNode(dirNode); // O(1)
 
     // Short path for deleting a single item
     if (items.count() == 1) {
         const int r = node->rowNumber();
         q->beginRemoveRows(parentIndex, r, r);
-        removeFromNodeHash(node, url);
-        delete dirNode->m_childNodes.takeAt(r);
+        removeTreeFromIndex(node);
+        dirNode->removeChildren(r, r);
         q->endRemoveRows();
         return;
     }
@@ -691,8 +835,8 @@ void KDirModelPrivate::_k_slotDeleteItems(const KFileItemList &items)
             // see https://bugs.kde.org/show_bug.cgi?id=196695
             return;
         }
-        rowNumbers.setBit(node->rowNumber(), 1); // O(n)
-        removeFromNodeHash(node, url);
+        rowNumbers.setBit(node->rowNumber(), 1); // O(1)
+        removeTreeFromIndex(node);
     }
 
     int start = -1;
@@ -709,10 +853,7 @@ void KDirModelPrivate::_k_slotDeleteItems(const KFileItemList &items)
             start = val ? i : i + 1;
             // qDebug() << "beginRemoveRows" << start << end;
             q->beginRemoveRows(parentIndex, start, end);
-            for (int r = end; r >= start; --r) { // reverse because takeAt changes indexes ;)
-                // qDebug() << "Removing from m_childNodes at" << r;
-                delete dirNode->m_childNodes.takeAt(r);
-            }
+            dirNode->removeChildren(start, end);
             q->endRemoveRows();
         }
         lastVal = val;
@@ -731,33 +872,30 @@ void KDirModelPrivate::_k_slotRefreshItems(const QList<QPair<KFileItem, KFileIte
         Q_ASSERT(!newItem.isNull());
         const QUrl oldUrl = oldItem.url();
         const QUrl newUrl = newItem.url();
-        KDirModelNode *node = nodeForUrl(oldUrl); // O(n); maybe we could look up to the parent only once
+        KDirModelNode *node = nodeForUrl(oldUrl); // O(depth); maybe we could look up to the parent only once
         // qDebug() << "in model for" << m_dirLister->url() << ":" << oldUrl << "->" << newUrl << "node=" << node;
         if (!node) { // not found [can happen when renaming a dir, redirection was emitted already]
             continue;
         }
         if (node != m_rootNode) { // we never set an item in the rootnode, we use m_dirLister->rootItem instead.
-            bool hasNewNode = false;
             // A file became directory (well, it was overwritten)
             if (oldItem.isDir() != newItem.isDir()) {
                 // qDebug() << "DIR/FILE STATUS CHANGE";
-                const int r = node->rowNumber();
-                removeFromNodeHash(node, oldUrl);
+                removeTreeFromIndex(node);
                 KDirModelDirNode *dirNode = node->parent();
-                delete dirNode->m_childNodes.takeAt(r); // i.e. "delete node"
+                const int r = node->rowNumber();
                 node = newItem.isDir() ? new KDirModelDirNode(dirNode, newItem) : new KDirModelNode(dirNode, newItem);
-                dirNode->m_childNodes.insert(r, node); // same position!
-                hasNewNode = true;
+                dirNode->replaceChild(r, node); // same position!
+                addToIndex(node);
+            } else if (oldUrl != newUrl || oldItem.name() != newItem.name()) {
+                // What if a renamed dir had children? -> kdirlister takes care of emitting for each item
+                // qDebug() << "Renaming" << oldUrl << "to" << newUrl << "in the index";
+                removeFromIndex(node);
+                node->setItem(newItem);
+                addToIndex(node);
             } else {
                 node->setItem(newItem);
             }
-
-            if (oldUrl != newUrl || hasNewNode) {
-                // What if a renamed dir had children? -> kdirlister takes care of emitting for each item
-                // qDebug() << "Renaming" << oldUrl << "to" << newUrl << "in node hash";
-                m_nodeHash.remove(cleanupUrl(oldUrl));
-                m_nodeHash.insert(cleanupUrl(newUrl), node);
-            }
             // MIME type changed -> forget cached icon (e.g. from "cut", #164185 comment #13)
             if (oldItem.determineMimeType().name() != newItem.determineMimeType().name()) {
                 node->setPreview(QIcon());
@@ -785,16 +923,16 @@ void KDirModelPrivate::_k_slotRedirection(const QUrl &oldUrl, const QUrl &newUrl
     if (!node) {
         return;
     }
-    m_nodeHash.remove(cleanupUrl(oldUrl));
-    m_nodeHash.insert(cleanupUrl(newUrl), node);
 
     // Ensure the node's URL is updated. In case of a listjob redirection
     // we won't get a refreshItem, and in case of renaming a directory
-    // we'll get it too late (so the hash won't find the old url anymore).
+    // we'll get it too late (so the lookup won't find the old url anymore).
     KFileItem item = node->item();
     if (!item.isNull()) { // null if root item, #180156
+        removeFromIndex(node);
         item.setUrl(newUrl);
         node->setItem(item);
+        addToIndex(node);
     }
 
     // The items inside the renamed directory have been handled before,
@@ -807,7 +945,7 @@ void KDirModelPrivate::_k_slotClear()
     if (numRows > 0) {
         q->beginRemoveRows(QModelIndex(), 0, numRows - 1);
     }
-    m_nodeHash.clear();
+    m_nodesByUrl.clear();
     clear();
     if (numRows > 0) {
         q->endRemoveRows();
@@ -1103,11 +1241,11 @@ QModelIndex KDirModel::parent(const QModelIndex &index) const
     Q_ASSERT(childNode);
     KDirModelNode *parentNode = childNode->parent();
     Q_ASSERT(parentNode);
-    return d->indexForNode(parentNode); // O(n)
+    return d->indexForNode(parentNode); // O(1)
 }
 
 // Reimplemented to avoid the default implementation which calls parent
-// (O(n) for finding the parent's row number for nothing). This implementation is O(1).
+// (creating the parent's index for nothing). This implementation is O(1).
 QModelIndex KDirModel::sibling(int row, int column, const QModelIndex &index) const
 {
     if (!index.isValid()) {
@@ -1231,10 +1369,10 @@ KFileItem KDirModel::itemForIndex(const QModelIndex &index) const
 
 QModelIndex KDirModel::indexForItem(const KFileItem &item) const
 {
-    return indexForUrl(item.url()); // O(n)
+    return indexForUrl(item.url()); // O(depth)
 }
 
-// url -> index. O(n)
+// url -> index. O(depth)
 QModelIndex KDirModel::indexForUrl(const QUrl &url) const
 {
     KDirModelNode *node = d->nodeForUrl(url); // O(depth)
@@ -1242,7 +1380,7 @@ QModelIndex KDirModel::indexForUrl(const QUrl &url) const
         // qDebug() << url << "not found";
         return QModelIndex();
     }
-    return d->indexForNode(node); // O(n)
+    return d->indexForNode(node); // O(1)
 }
 
 QModelIndex KDirModel::index(int row, int column, const QModelIndex &parent) const
@@ -1447,7 +1585,7 @@ void KDirModel::expandToUrl(const QUrl &url)
     qCDebug(category) << "Remembering to emit expand after listing" << result->item().url();
 
     // start a new fetch to look for the next level down the URL
-    const QModelIndex parentIndex = d->indexForNode(result); // O(n)
+    const QModelIndex parentIndex = d->indexForNode(result); // O(1)
     Q_ASSERT(parentIndex.isValid());
     fetchMore(parentIndex);
 }